@@ -59,6 +59,14 @@ macro(test_example_as_cpp_if_toplevel aTarget)
     endif()
 endmacro()
 
+# Links the example against sdl_gpu_common when the full repo was configured with
+# SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY, otherwise the example keeps compiling its own copy.
+macro(link_common_library_if_enabled aTarget)
+    if (SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY AND TARGET sdl_gpu_common)
+        target_link_libraries(${aTarget} PRIVATE sdl_gpu_common)
+    endif()
+endmacro()
+
 macro(list_directories result)
     message(STATUS "List Dir: ${CMAKE_CURRENT_LIST_DIR}")
     #file(GLOB children LIST_DIRECTORIES true RELATIVE CONFIGURE_DEPENDS ${CMAKE_CURRENT_LIST_DIR})
@@ -189,7 +197,19 @@ macro(set_up_example_top_level)
         # the directory you specify. Once done executing it comes back up to here and continues.
         if (${INSIDE_FULL_REPO})
             add_subdirectory(external)
+
+            # 014_GLTF always builds against sdl_gpu_common. The earlier examples only do with this on,
+            # it's off by default so each lesson builds from the copy of the code it teaches.
+            option(SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY "Link the examples against sdl_gpu_common instead of their own copies of the shared code" OFF)
+            add_subdirectory(common)
+
             add_subdirectory(source)
+
+            option(SDL_GPU_BY_EXAMPLE_BENCHMARKS "Build the CPU side microbenchmarks in code/benchmarks" ON)
+            if (SDL_GPU_BY_EXAMPLE_BENCHMARKS)
+                enable_testing()
+                add_subdirectory(benchmarks)
+            endif()
         else()
             # FetchContent downloads and configures dependencies
             include(FetchContent)
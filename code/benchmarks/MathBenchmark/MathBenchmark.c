@@ -0,0 +1,511 @@
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_main.h>
+
+#include "GpuCommon.h"
+
+// Times the scalar and SIMD versions of the float4x4 math that 014_GLTF uses, along with the older
+// versions of functions that have since been rewritten. The code under test comes from sdl_gpu_common,
+// the same code 014_GLTF builds against, so only the older versions live here. Exits with 1 if any of the
+// faster versions disagree with the one they replace, which is what the add_test registration checks.
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Previous Versions
+// These build each matrix separately and multiply them together, the closed form versions in
+// sdl_gpu_common are checked against them.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+float4x4 CreateModelMatrix_Multiply(float4 aPosition, float4 aScale, float4 aRotation) {
+  float4x4 translation = TranslationMatrix(aPosition);
+  float4x4 rotation = RotationMatrix(aRotation);
+  float4x4 scale = ScaleMatrix(aScale);
+
+  float4x4 scale_rotation = Float4x4_Multiply(&rotation, &scale);
+
+  return Float4x4_Multiply(&translation, &scale_rotation);
+}
+
+float4x4 CreateModelMatrixWithQuaternion_Multiply(float4 aPosition, float4 aScale, float4 aRotation) {
+  float4x4 translation = TranslationMatrix(aPosition);
+  float4x4 rotation = RotationMatrixFromQuaternion(aRotation);
+  float4x4 scale = ScaleMatrix(aScale);
+
+  float4x4 scale_rotation = Float4x4_Multiply(&rotation, &scale);
+
+  return Float4x4_Multiply(&translation, &scale_rotation);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark Code
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const size_t cElementCount = 4096;
+static const size_t cIterations = 2000;
+static const size_t cTransformCount = 1000000;
+static const size_t cTransformIterations = 20;
+
+// SinCos_Batch is good to a couple of ulps, this leaves plenty of room over that while still catching
+// a wrong octant or sign.
+static const float cSinCosTolerance = 1e-5f;
+
+typedef struct BenchmarkData {
+  float4x4* mLeftMatrices;
+  float4x4* mRightMatrices;
+  float4* mVectors;
+  float4x4* mMatrixResults;
+  float4* mVectorResults;
+  float* mDotResults;
+
+  float3* mPoints;
+  float3* mPointResults;
+  float* mPointsX;
+  float* mPointsY;
+  float* mPointsZ;
+  float* mPointResultsX;
+  float* mPointResultsY;
+  float* mPointResultsZ;
+
+  float4* mPositions;
+  float4* mScales;
+  float4* mRotations;
+  float4* mQuaternions;
+  float4x4* mModelMatrices;
+} BenchmarkData;
+
+// Deterministic so runs can be compared with each other.
+float RandomFloat(Uint32* aState)
+{
+  *aState = (*aState * 1664525u) + 1013904223u;
+  return ((float)(*aState >> 8) / (float)(1u << 24)) * 2.0f - 1.0f;
+}
+
+float4 RandomFloat4(Uint32* aState)
+{
+  float4 toReturn = { RandomFloat(aState), RandomFloat(aState), RandomFloat(aState), RandomFloat(aState) };
+  return toReturn;
+}
+
+BenchmarkData CreateBenchmarkData()
+{
+  BenchmarkData data;
+  data.mLeftMatrices = (float4x4*)SDL_malloc(sizeof(float4x4) * cElementCount);
+  data.mRightMatrices = (float4x4*)SDL_malloc(sizeof(float4x4) * cElementCount);
+  data.mVectors = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mMatrixResults = (float4x4*)SDL_malloc(sizeof(float4x4) * cElementCount);
+  data.mVectorResults = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mDotResults = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPoints = (float3*)SDL_malloc(sizeof(float3) * cElementCount);
+  data.mPointResults = (float3*)SDL_malloc(sizeof(float3) * cElementCount);
+  data.mPointsX = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPointsY = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPointsZ = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPointResultsX = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPointResultsY = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPointResultsZ = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  data.mPositions = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mScales = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mRotations = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mQuaternions = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  data.mModelMatrices = (float4x4*)SDL_malloc(sizeof(float4x4) * cElementCount);
+
+  Uint32 state = 0x5EED;
+  for (size_t i = 0; i < cElementCount; ++i) {
+    for (size_t column = 0; column < 4; ++column) {
+      data.mLeftMatrices[i].columns[column] = RandomFloat4(&state);
+      data.mRightMatrices[i].columns[column] = RandomFloat4(&state);
+    }
+    data.mVectors[i] = RandomFloat4(&state);
+    data.mPoints[i] = Float4_XYZ(RandomFloat4(&state));
+    data.mPointsX[i] = data.mPoints[i].x;
+    data.mPointsY[i] = data.mPoints[i].y;
+    data.mPointsZ[i] = data.mPoints[i].z;
+
+    data.mPositions[i] = Float4_Scalar_Multiply(RandomFloat4(&state), 100.0f);
+    data.mRotations[i] = Float4_Scalar_Multiply(RandomFloat4(&state), SDL_PI_F);
+
+    // Keep the scale away from zero so the inverses are well behaved.
+    float4 scale = RandomFloat4(&state);
+    data.mScales[i].x = 1.5f + scale.x;
+    data.mScales[i].y = 1.5f + scale.y;
+    data.mScales[i].z = 1.5f + scale.z;
+    data.mScales[i].w = 1.0f;
+
+    float4 quaternion = RandomFloat4(&state);
+    data.mQuaternions[i] = Float4_Scalar_Multiply(quaternion, 1.0f / SDL_sqrtf(Float4_Dot(quaternion, quaternion)));
+
+    data.mModelMatrices[i] = CreateModelMatrix(data.mPositions[i], data.mScales[i], data.mRotations[i]);
+  }
+
+  return data;
+}
+
+void DestroyBenchmarkData(BenchmarkData* aData)
+{
+  SDL_free(aData->mLeftMatrices);
+  SDL_free(aData->mRightMatrices);
+  SDL_free(aData->mVectors);
+  SDL_free(aData->mMatrixResults);
+  SDL_free(aData->mVectorResults);
+  SDL_free(aData->mDotResults);
+  SDL_free(aData->mPoints);
+  SDL_free(aData->mPointResults);
+  SDL_free(aData->mPointsX);
+  SDL_free(aData->mPointsY);
+  SDL_free(aData->mPointsZ);
+  SDL_free(aData->mPointResultsX);
+  SDL_free(aData->mPointResultsY);
+  SDL_free(aData->mPointResultsZ);
+  SDL_free(aData->mPositions);
+  SDL_free(aData->mScales);
+  SDL_free(aData->mRotations);
+  SDL_free(aData->mQuaternions);
+  SDL_free(aData->mModelMatrices);
+}
+
+// Runs aOperation over every element cIterations times. The right hand side is offset by the iteration
+// so the compiler can't notice every pass computes the same thing and hoist the work out of the loop.
+#define RUN_BENCHMARK(aName, aOperation)                                                \
+  do {                                                                                  \
+    Uint64 start = SDL_GetPerformanceCounter();                                         \
+    for (size_t iteration = 0; iteration < cIterations; ++iteration) {                  \
+      for (size_t i = 0; i < cElementCount; ++i) {                                      \
+        size_t j = (i + iteration) % cElementCount;                                     \
+        aOperation;                                                                     \
+      }                                                                                 \
+    }                                                                                   \
+    ReportBenchmark(aName, SDL_GetPerformanceCounter() - start);                        \
+  } while (0)
+
+// Same idea for the batch functions, which are handed the whole array each iteration.
+#define RUN_BATCH_BENCHMARK(aName, aOperation)                                          \
+  do {                                                                                  \
+    Uint64 start = SDL_GetPerformanceCounter();                                         \
+    for (size_t iteration = 0; iteration < cIterations; ++iteration) {                  \
+      size_t j = iteration % cElementCount;                                             \
+      (void)j;                                                                          \
+      aOperation;                                                                       \
+    }                                                                                   \
+    ReportBenchmark(aName, SDL_GetPerformanceCounter() - start);                        \
+  } while (0)
+
+void TransformPointsPerElement(const float4x4* aMatrix, const float3* aPoints, float3* aResults)
+{
+  for (size_t i = 0; i < cElementCount; ++i) {
+    float4 point = { aPoints[i].x, aPoints[i].y, aPoints[i].z, 1.0f };
+    aResults[i] = Float4_XYZ(Float4x4_Float4_Multiply(aMatrix, point));
+  }
+}
+
+void ReportBenchmark(const char* aName, Uint64 aTicks)
+{
+  double nanoseconds = (double)aTicks * 1000000000.0 / (double)SDL_GetPerformanceFrequency();
+  SDL_Log("  %-36s %8.3f ns/op", aName, nanoseconds / (double)(cElementCount * cIterations));
+}
+
+// The SIMD paths reorder the additions, so they won't be bit exact with the scalar ones.
+bool NearlyEqual(float aLeft, float aRight)
+{
+  return SDL_fabsf(aLeft - aRight) <= 1e-4f * SDL_max(1.0f, SDL_fabsf(aLeft));
+}
+
+bool VerifyMatrices(const char* aName, const float4x4* aExpected, const float4x4* aActual)
+{
+  for (size_t i = 0; i < cElementCount; ++i) {
+    for (size_t j = 0; j < 16; ++j) {
+      if (!NearlyEqual(aExpected[i].data[j / 4][j % 4], aActual[i].data[j / 4][j % 4])) {
+        SDL_Log("  %s: mismatch at element %zu", aName, i);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool VerifyVectors(const char* aName, const float4* aExpected, const float4* aActual)
+{
+  for (size_t i = 0; i < cElementCount; ++i) {
+    if (!NearlyEqual(aExpected[i].x, aActual[i].x) || !NearlyEqual(aExpected[i].y, aActual[i].y) ||
+        !NearlyEqual(aExpected[i].z, aActual[i].z) || !NearlyEqual(aExpected[i].w, aActual[i].w)) {
+      SDL_Log("  %s: mismatch at element %zu", aName, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool VerifyFloats(const char* aName, const float* aExpected, const float* aActual)
+{
+  for (size_t i = 0; i < cElementCount; ++i) {
+    if (!NearlyEqual(aExpected[i], aActual[i])) {
+      SDL_Log("  %s: mismatch at element %zu", aName, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  (void)argc;
+  (void)argv;
+
+  BenchmarkData data = CreateBenchmarkData();
+
+  // The last iteration of each run leaves j == (i + cIterations - 1) % cElementCount, every run
+  // ends on the same inputs so the results can be checked against the scalar run.
+  float4x4* expectedMatrices = (float4x4*)SDL_malloc(sizeof(float4x4) * cElementCount);
+  float4* expectedVectors = (float4*)SDL_malloc(sizeof(float4) * cElementCount);
+  float* expectedDots = (float*)SDL_malloc(sizeof(float) * cElementCount);
+  size_t failures = 0;
+
+  SDL_Log("%zu elements x %zu iterations", cElementCount, cIterations);
+
+  SDL_Log("Float4x4_Multiply:");
+  RUN_BENCHMARK("Scalar", data.mMatrixResults[i] = Float4x4_Multiply_Scalar(&data.mLeftMatrices[i], &data.mRightMatrices[j]));
+  SDL_memcpy(expectedMatrices, data.mMatrixResults, sizeof(float4x4) * cElementCount);
+#if defined(MATH_SSE2)
+  RUN_BENCHMARK("SSE2", data.mMatrixResults[i] = Float4x4_Multiply_SSE2(&data.mLeftMatrices[i], &data.mRightMatrices[j]));
+  failures += !VerifyMatrices("SSE2", expectedMatrices, data.mMatrixResults);
+#endif
+#if defined(MATH_AVX)
+  if (SDL_HasAVX()) {
+    RUN_BENCHMARK("AVX", data.mMatrixResults[i] = Float4x4_Multiply_AVX(&data.mLeftMatrices[i], &data.mRightMatrices[j]));
+    failures += !VerifyMatrices("AVX", expectedMatrices, data.mMatrixResults);
+  }
+#endif
+#if defined(MATH_NEON)
+  RUN_BENCHMARK("NEON", data.mMatrixResults[i] = Float4x4_Multiply_NEON(&data.mLeftMatrices[i], &data.mRightMatrices[j]));
+  failures += !VerifyMatrices("NEON", expectedMatrices, data.mMatrixResults);
+#endif
+
+  SDL_Log("Float4x4_Float4_Multiply:");
+  RUN_BENCHMARK("Scalar", data.mVectorResults[i] = Float4x4_Float4_Multiply_Scalar(&data.mLeftMatrices[i], data.mVectors[j]));
+  SDL_memcpy(expectedVectors, data.mVectorResults, sizeof(float4) * cElementCount);
+#if defined(MATH_SSE2)
+  RUN_BENCHMARK("SSE2", data.mVectorResults[i] = Float4x4_Float4_Multiply_SSE2(&data.mLeftMatrices[i], data.mVectors[j]));
+  failures += !VerifyVectors("SSE2", expectedVectors, data.mVectorResults);
+#endif
+#if defined(MATH_NEON)
+  RUN_BENCHMARK("NEON", data.mVectorResults[i] = Float4x4_Float4_Multiply_NEON(&data.mLeftMatrices[i], data.mVectors[j]));
+  failures += !VerifyVectors("NEON", expectedVectors, data.mVectorResults);
+#endif
+
+  SDL_Log("Float4_Dot:");
+  RUN_BENCHMARK("Scalar", data.mDotResults[i] = Float4_Dot_Scalar(data.mVectors[i], data.mLeftMatrices[j].columns[0]));
+  SDL_memcpy(expectedDots, data.mDotResults, sizeof(float) * cElementCount);
+#if defined(MATH_SSE2)
+  RUN_BENCHMARK("SSE2", data.mDotResults[i] = Float4_Dot_SSE2(data.mVectors[i], data.mLeftMatrices[j].columns[0]));
+  failures += !VerifyFloats("SSE2", expectedDots, data.mDotResults);
+#endif
+#if defined(MATH_NEON)
+  RUN_BENCHMARK("NEON", data.mDotResults[i] = Float4_Dot_NEON(data.mVectors[i], data.mLeftMatrices[j].columns[0]));
+  failures += !VerifyFloats("NEON", expectedDots, data.mDotResults);
+#endif
+
+  // The batch runs all end on j == (cIterations - 1) % cElementCount, so each one is checked against
+  // the per element run before it.
+  SDL_Log("Float4x4_Multiply_Batch:");
+  RUN_BATCH_BENCHMARK("Per element", for (size_t i = 0; i < cElementCount; ++i) data.mMatrixResults[i] = Float4x4_Multiply(&data.mLeftMatrices[j], &data.mRightMatrices[i]));
+  SDL_memcpy(expectedMatrices, data.mMatrixResults, sizeof(float4x4) * cElementCount);
+  RUN_BATCH_BENCHMARK("Batch", Float4x4_Multiply_Batch(&data.mLeftMatrices[j], data.mRightMatrices, data.mMatrixResults, cElementCount));
+  failures += !VerifyMatrices("Batch", expectedMatrices, data.mMatrixResults);
+
+  SDL_Log("Float4x4_TransformVectors_Batch:");
+  RUN_BATCH_BENCHMARK("Per element", for (size_t i = 0; i < cElementCount; ++i) data.mVectorResults[i] = Float4x4_Float4_Multiply(&data.mLeftMatrices[j], data.mVectors[i]));
+  SDL_memcpy(expectedVectors, data.mVectorResults, sizeof(float4) * cElementCount);
+  RUN_BATCH_BENCHMARK("Batch", Float4x4_TransformVectors_Batch(&data.mLeftMatrices[j], data.mVectors, data.mVectorResults, cElementCount));
+  failures += !VerifyVectors("Batch", expectedVectors, data.mVectorResults);
+
+  SDL_Log("Float4x4_TransformPoints_Batch/SoA:");
+  RUN_BATCH_BENCHMARK("Per element", TransformPointsPerElement(&data.mLeftMatrices[j], data.mPoints, data.mPointResults));
+  for (size_t i = 0; i < cElementCount; ++i) {
+    expectedVectors[i].x = data.mPointResults[i].x;
+    expectedVectors[i].y = data.mPointResults[i].y;
+    expectedVectors[i].z = data.mPointResults[i].z;
+    expectedVectors[i].w = 0.0f;
+  }
+  RUN_BATCH_BENCHMARK("Batch", Float4x4_TransformPoints_Batch(&data.mLeftMatrices[j], data.mPoints, data.mPointResults, cElementCount));
+  for (size_t i = 0; i < cElementCount; ++i) {
+    data.mVectorResults[i].x = data.mPointResults[i].x;
+    data.mVectorResults[i].y = data.mPointResults[i].y;
+    data.mVectorResults[i].z = data.mPointResults[i].z;
+    data.mVectorResults[i].w = 0.0f;
+  }
+  failures += !VerifyVectors("Batch", expectedVectors, data.mVectorResults);
+  RUN_BATCH_BENCHMARK("SoA", Float4x4_TransformPoints_SoA(&data.mLeftMatrices[j],
+    data.mPointsX, data.mPointsY, data.mPointsZ,
+    data.mPointResultsX, data.mPointResultsY, data.mPointResultsZ,
+    cElementCount));
+  for (size_t i = 0; i < cElementCount; ++i) {
+    data.mVectorResults[i].x = data.mPointResultsX[i];
+    data.mVectorResults[i].y = data.mPointResultsY[i];
+    data.mVectorResults[i].z = data.mPointResultsZ[i];
+    data.mVectorResults[i].w = 0.0f;
+  }
+  failures += !VerifyVectors("SoA", expectedVectors, data.mVectorResults);
+
+  SDL_Log("CreateModelMatrix:");
+  RUN_BENCHMARK("Matrix multiplies", data.mMatrixResults[i] = CreateModelMatrix_Multiply(data.mPositions[i], data.mScales[i], data.mRotations[j]));
+  SDL_memcpy(expectedMatrices, data.mMatrixResults, sizeof(float4x4) * cElementCount);
+  RUN_BENCHMARK("Closed form", data.mMatrixResults[i] = CreateModelMatrix(data.mPositions[i], data.mScales[i], data.mRotations[j]));
+  failures += !VerifyMatrices("Closed form", expectedMatrices, data.mMatrixResults);
+
+  SDL_Log("CreateModelMatrixWithQuaternion:");
+  RUN_BENCHMARK("Matrix multiplies", data.mMatrixResults[i] = CreateModelMatrixWithQuaternion_Multiply(data.mPositions[i], data.mScales[i], data.mQuaternions[j]));
+  SDL_memcpy(expectedMatrices, data.mMatrixResults, sizeof(float4x4) * cElementCount);
+  RUN_BENCHMARK("Closed form", data.mMatrixResults[i] = CreateModelMatrixWithQuaternion(data.mPositions[i], data.mScales[i], data.mQuaternions[j]));
+  failures += !VerifyMatrices("Closed form", expectedMatrices, data.mMatrixResults);
+
+  SDL_Log("Inverse of a model matrix:");
+  RUN_BENCHMARK("Float4x4_Inverse", data.mMatrixResults[i] = Float4x4_Inverse(&data.mModelMatrices[j]));
+  SDL_memcpy(expectedMatrices, data.mMatrixResults, sizeof(float4x4) * cElementCount);
+  RUN_BENCHMARK("Float4x4_AffineInverse", data.mMatrixResults[i] = Float4x4_AffineInverse(&data.mModelMatrices[j]));
+  failures += !VerifyMatrices("Float4x4_AffineInverse", expectedMatrices, data.mMatrixResults);
+
+  SDL_Log("SinCos_Batch:");
+  {
+    float* angles = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    float* sines = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    float* cosines = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    for (size_t i = 0; i < cElementCount; ++i) {
+      angles[i] = data.mRotations[i].x * 4.0f;
+    }
+
+    RUN_BATCH_BENCHMARK("SDL_sinf/SDL_cosf", for (size_t i = 0; i < cElementCount; ++i) { sines[i] = SDL_sinf(angles[i]); cosines[i] = SDL_cosf(angles[i]); });
+    RUN_BATCH_BENCHMARK("SinCos_Batch", SinCos_Batch(angles, sines, cosines, cElementCount));
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < cElementCount; ++i) {
+      maxError = SDL_max(maxError, SDL_fabsf(sines[i] - SDL_sinf(angles[i])));
+      maxError = SDL_max(maxError, SDL_fabsf(cosines[i] - SDL_cosf(angles[i])));
+    }
+    SDL_Log("  max error %g", maxError);
+    if (maxError > cSinCosTolerance) {
+      SDL_Log("  SinCos_Batch: mismatch");
+      ++failures;
+    }
+
+    SDL_free(angles);
+    SDL_free(sines);
+    SDL_free(cosines);
+  }
+
+  SDL_Log("BuildTransformStoreMatrices, %zu transforms:", cTransformCount);
+  {
+    TransformStore store = CreateTransformStore(cTransformCount);
+    for (size_t i = 0; i < cTransformCount; ++i) {
+      size_t j = i % cElementCount;
+      AddTransform(&store, data.mPositions[j], data.mScales[j], data.mRotations[(j * 7) % cElementCount]);
+    }
+
+    float4x4* matrices = (float4x4*)SDL_aligned_alloc(64, sizeof(float4x4) * cTransformCount);
+    float4x4* expected = (float4x4*)SDL_malloc(sizeof(float4x4) * cTransformCount);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (size_t iteration = 0; iteration < cTransformIterations; ++iteration) {
+      for (size_t i = 0; i < cTransformCount; ++i) {
+        expected[i] = CreateModelMatrixFromTransformStore(&store, i);
+      }
+    }
+    double perElement = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency() / (double)cTransformIterations;
+    SDL_Log("  %-36s %8.3f ms/frame", "Per element", perElement);
+
+    start = SDL_GetPerformanceCounter();
+    for (size_t iteration = 0; iteration < cTransformIterations; ++iteration) {
+      BuildTransformStoreMatrices(&store, matrices);
+    }
+    double batched = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency() / (double)cTransformIterations;
+    SDL_Log("  %-36s %8.3f ms/frame", "BuildTransformStoreMatrices", batched);
+
+    // The polynomial sin/cos isn't bit exact with SDL's, so this uses a looser tolerance.
+    float maxError = 0.0f;
+    for (size_t i = 0; i < cTransformCount; ++i) {
+      for (size_t k = 0; k < 16; ++k) {
+        float difference = SDL_fabsf(expected[i].data[k / 4][k % 4] - matrices[i].data[k / 4][k % 4]);
+        maxError = SDL_max(maxError, difference / SDL_max(1.0f, SDL_fabsf(expected[i].data[k / 4][k % 4])));
+      }
+    }
+    SDL_Log("  max relative error %g", maxError);
+    if (maxError > cSinCosTolerance) {
+      SDL_Log("  BuildTransformStoreMatrices: mismatch");
+      ++failures;
+    }
+
+    SDL_aligned_free(matrices);
+    SDL_free(expected);
+    DestroyTransformStore(&store);
+  }
+
+  SDL_Log("Frustum culling:");
+  {
+    float4x4 projection = InfinitePerspectiveProjectionLHOZ(45.0f * SDL_PI_F / 180.0f, 16.0f / 9.0f, 0.1f);
+    Frustum frustum = ExtractFrustum(&projection);
+    SDL_Log("  %u planes from the infinite reversed Z projection", frustum.mPlanesCount);
+
+    // Spread the bounds around the camera so roughly a quarter of them are visible.
+    float* radii = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    for (size_t i = 0; i < cElementCount; ++i) {
+      radii[i] = data.mScales[i].x;
+    }
+
+    Uint32* visible = (Uint32*)SDL_malloc(sizeof(Uint32) * cElementCount);
+    Uint32* expectedVisible = (Uint32*)SDL_malloc(sizeof(Uint32) * cElementCount);
+
+    size_t expectedCount = 0;
+    for (size_t i = 0; i < cElementCount; ++i) {
+      float3 center = { data.mPointsX[i] * 50.0f, data.mPointsY[i] * 50.0f, data.mPointsZ[i] * 50.0f };
+      data.mPointResultsX[i] = center.x;
+      data.mPointResultsY[i] = center.y;
+      data.mPointResultsZ[i] = center.z;
+      if (SphereInFrustum(&frustum, center, radii[i])) {
+        expectedVisible[expectedCount++] = (Uint32)i;
+      }
+    }
+
+    size_t visibleCount = 0;
+    RUN_BATCH_BENCHMARK("CullSpheres", visibleCount = CullSpheres(&frustum, data.mPointResultsX, data.mPointResultsY, data.mPointResultsZ, radii, cElementCount, visible));
+    if (visibleCount != expectedCount || SDL_memcmp(visible, expectedVisible, sizeof(Uint32) * visibleCount) != 0) {
+      SDL_Log("  CullSpheres: mismatch");
+      ++failures;
+    }
+    SDL_Log("  %zu of %zu spheres visible", visibleCount, cElementCount);
+
+    expectedCount = 0;
+    for (size_t i = 0; i < cElementCount; ++i) {
+      float3 center = { data.mPointResultsX[i], data.mPointResultsY[i], data.mPointResultsZ[i] };
+      float3 extent = { radii[i], radii[i] * 0.5f, radii[i] * 2.0f };
+      if (AabbInFrustum(&frustum, center, extent)) {
+        expectedVisible[expectedCount++] = (Uint32)i;
+      }
+    }
+
+    float* extentY = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    float* extentZ = (float*)SDL_malloc(sizeof(float) * cElementCount);
+    for (size_t i = 0; i < cElementCount; ++i) {
+      extentY[i] = radii[i] * 0.5f;
+      extentZ[i] = radii[i] * 2.0f;
+    }
+
+    RUN_BATCH_BENCHMARK("CullAabbs", visibleCount = CullAabbs(&frustum, data.mPointResultsX, data.mPointResultsY, data.mPointResultsZ, radii, extentY, extentZ, cElementCount, visible));
+    if (visibleCount != expectedCount || SDL_memcmp(visible, expectedVisible, sizeof(Uint32) * visibleCount) != 0) {
+      SDL_Log("  CullAabbs: mismatch");
+      ++failures;
+    }
+    SDL_Log("  %zu of %zu boxes visible", visibleCount, cElementCount);
+
+    SDL_free(radii);
+    SDL_free(extentY);
+    SDL_free(extentZ);
+    SDL_free(visible);
+    SDL_free(expectedVisible);
+  }
+
+  SDL_free(expectedMatrices);
+  SDL_free(expectedVectors);
+  SDL_free(expectedDots);
+  DestroyBenchmarkData(&data);
+
+  if (failures != 0) {
+    SDL_Log("%zu mismatches", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,4338 @@
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "GpuCommon.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MATH
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////
+// Downcasts
+
+float2 Float3_XY(float3 aValue) {
+  float2 toReturn = { aValue.x, aValue.y };
+  return toReturn;
+}
+
+float2 Float4_XY(float4 aValue) {
+  float2 toReturn = { aValue.x, aValue.y };
+  return toReturn;
+}
+
+float3 Float4_XYZ(float4 aValue) {
+  float3 toReturn = { aValue.x, aValue.y, aValue.z };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Subtraction
+
+float2 Float2_Subtract(float2 aLeft, float2 aRight) {
+  float2 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y };
+  return toReturn;
+}
+
+float3 Float3_Subtract(float3 aLeft, float3 aRight) {
+  float3 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z };
+  return toReturn;
+}
+
+float4 Float4_Subtract(float4 aLeft, float4 aRight) {
+  float4 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z, aLeft.w - aRight.w };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Addition
+
+float2 Float2_Add(float2 aLeft, float2 aRight) {
+  float2 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y };
+  return toReturn;
+}
+
+float3 Float3_Add(float3 aLeft, float3 aRight) {
+  float3 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z };
+  return toReturn;
+}
+
+float4 Float4_Add(float4 aLeft, float4 aRight) {
+  float4 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z, aLeft.w + aRight.w };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Scalar Addition
+
+float2 Float2_Scalar_Add(float2 aLeft, float aRight) {
+  float2 toReturn = { aLeft.x + aRight, aLeft.y + aRight };
+  return toReturn;
+}
+
+float3 Float3_Scalar_Add(float3 aLeft, float aRight) {
+  float3 toReturn = { aLeft.x + aRight, aLeft.y + aRight, aLeft.z + aRight };
+  return toReturn;
+}
+
+float4 Float4_Scalar_Add(float4 aLeft, float aRight) {
+  float4 toReturn = { aLeft.x + aRight, aLeft.y + aRight, aLeft.z + aRight, aLeft.w + aRight };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Scalar Multiplication
+
+float2 Float2_Scalar_Multiply(float2 aLeft, float aRight) {
+  float2 toReturn = { aLeft.x * aRight, aLeft.y * aRight };
+  return toReturn;
+}
+
+float3 Float3_Scalar_Multiply(float3 aLeft, float aRight) {
+  float3 toReturn = { aLeft.x * aRight, aLeft.y * aRight, aLeft.z * aRight };
+  return toReturn;
+}
+
+float4 Float4_Scalar_Multiply(float4 aLeft, float aRight) {
+  float4 toReturn = { aLeft.x * aRight, aLeft.y * aRight, aLeft.z * aRight, aLeft.w * aRight };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Scalar Multiplication
+
+float2 Float2_Scalar_Division(float2 aLeft, float aRight) {
+  float2 toReturn = { aLeft.x / aRight, aLeft.y / aRight };
+  return toReturn;
+}
+
+float3 Float3_Scalar_Division(float3 aLeft, float aRight) {
+  float3 toReturn = { aLeft.x / aRight, aLeft.y / aRight, aLeft.z / aRight };
+  return toReturn;
+}
+
+float4 Float4_Scalar_Division(float4 aLeft, float aRight) {
+  float4 toReturn = { aLeft.x / aRight, aLeft.y / aRight, aLeft.z / aRight, aLeft.w / aRight };
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// SIMD Selection
+// The scalar versions are always compiled so they can be compared against, the plain names then
+// forward to the widest instruction set the compiler is targeting. AVX can't be assumed on x64 any
+// more than AVX2 can, so like the AVX2 batch functions it's compiled with SDL_TARGETING and picked
+// at runtime. Define MATH_FORCE_SCALAR to opt out.
+
+#if !defined(MATH_FORCE_SCALAR)
+#if defined(SDL_SSE2_INTRINSICS) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#elif defined(SDL_NEON_INTRINSICS)
+#endif
+#endif
+
+//////////////////////////////////////////////////////
+// Dot Product
+
+float Float2_Dot(float2 aLeft, float2 aRight) {
+  return
+    (aLeft.x * aRight.x) +
+    (aLeft.y * aRight.y);
+}
+
+float Float3_Dot(float3 aLeft, float3 aRight) {
+  return
+    (aLeft.x * aRight.x) +
+    (aLeft.y * aRight.y) +
+    (aLeft.z * aRight.z);
+}
+
+float Float4_Dot_Scalar(float4 aLeft, float4 aRight) {
+  return
+    (aLeft.x * aRight.x) +
+    (aLeft.y * aRight.y) +
+    (aLeft.z * aRight.z) +
+    (aLeft.w * aRight.w);
+}
+
+#if defined(MATH_SSE2)
+float Float4_Dot_SSE2(float4 aLeft, float4 aRight) {
+  __m128 products = _mm_mul_ps(_mm_loadu_ps(&aLeft.x), _mm_loadu_ps(&aRight.x));
+
+  // Horizontal add: (x + y, x + y, z + w, z + w) then add the high pair onto the low pair.
+  __m128 shuffled = _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(products, shuffled);
+  shuffled = _mm_movehl_ps(shuffled, sums);
+  sums = _mm_add_ss(sums, shuffled);
+
+  return _mm_cvtss_f32(sums);
+}
+#endif
+
+#if defined(MATH_NEON)
+float Float4_Dot_NEON(float4 aLeft, float4 aRight) {
+  float32x4_t products = vmulq_f32(vld1q_f32(&aLeft.x), vld1q_f32(&aRight.x));
+  float32x2_t sums = vadd_f32(vget_low_f32(products), vget_high_f32(products));
+  sums = vpadd_f32(sums, sums);
+
+  return vget_lane_f32(sums, 0);
+}
+#endif
+
+// A single dot product doesn't fill a register for long enough to pay for the horizontal add, the
+// SSE2 version measures around 3x slower than this in MathBenchmark, so the SIMD ones are only kept
+// to compare against.
+float Float4_Dot(float4 aLeft, float4 aRight) {
+  return Float4_Dot_Scalar(aLeft, aRight);
+}
+
+//////////////////////////////////////////////////////
+// Cross Product
+
+float3 Float3_Cross(float3 aLeft, float3 aRight) {
+  float3 toReturn = {
+    (aLeft.y * aRight.z) - (aLeft.z * aRight.y),
+    (aLeft.z * aRight.x) - (aLeft.x * aRight.z),
+    (aLeft.x * aRight.y) - (aLeft.y * aRight.x)
+  };
+
+  return toReturn;
+}
+
+// Convience function that ignores the 4th component, assuming it was irrelevant.
+float3 Float4_Cross(float4 aLeft, float4 aRight) {
+  float3 toReturn = {
+    (aLeft.y * aRight.z) - (aLeft.z * aRight.y),
+    (aLeft.z * aRight.x) - (aLeft.x * aRight.z),
+    (aLeft.x * aRight.y) - (aLeft.y * aRight.x)
+  };
+
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Magnitude
+
+float Float2_Magnitude(float2 aValue) {
+  return SDL_sqrt(Float2_Dot(aValue, aValue));
+}
+
+float Float3_Magnitude(float3 aValue) {
+  return SDL_sqrt(Float3_Dot(aValue, aValue));
+}
+
+float Float4_Magnitude(float4 aValue) {
+  return SDL_sqrt(Float4_Dot(aValue, aValue));
+}
+
+//////////////////////////////////////////////////////
+// Normalization
+
+float2 Float2_Normalize(float2 aValue) {
+  float magnitude = Float2_Magnitude(aValue);
+
+  float2 toReturn = {
+    aValue.x / magnitude,
+    aValue.y / magnitude
+  };
+
+  return toReturn;
+}
+
+float3 Float3_Normalize(float3 aValue) {
+  float magnitude = Float3_Magnitude(aValue);
+
+  float3 toReturn = {
+    aValue.x / magnitude,
+    aValue.y / magnitude,
+    aValue.z / magnitude
+  };
+
+  return toReturn;
+}
+
+float4 Float4_Normalize(float4 aValue) {
+  float magnitude = Float4_Magnitude(aValue);
+
+  float4 toReturn = {
+    aValue.x / magnitude,
+    aValue.y / magnitude,
+    aValue.z / magnitude,
+    aValue.w / magnitude
+  };
+
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Matrix Operations
+
+float4 Float4x4_Float4_Multiply_Scalar(const float4x4* aLeft, const float4 aRight)
+{
+  float4 toReturn;
+  toReturn.x =
+    (aLeft->data[0][0] * aRight.x) +
+    (aLeft->data[1][0] * aRight.y) +
+    (aLeft->data[2][0] * aRight.z) +
+    (aLeft->data[3][0] * aRight.w);
+  toReturn.y =
+    (aLeft->data[0][1] * aRight.x) +
+    (aLeft->data[1][1] * aRight.y) +
+    (aLeft->data[2][1] * aRight.z) +
+    (aLeft->data[3][1] * aRight.w);
+  toReturn.z =
+    (aLeft->data[0][2] * aRight.x) +
+    (aLeft->data[1][2] * aRight.y) +
+    (aLeft->data[2][2] * aRight.z) +
+    (aLeft->data[3][2] * aRight.w);
+  toReturn.w =
+    (aLeft->data[0][3] * aRight.x) +
+    (aLeft->data[1][3] * aRight.y) +
+    (aLeft->data[2][3] * aRight.z) +
+    (aLeft->data[3][3] * aRight.w);
+
+  return toReturn;
+}
+
+float4x4 Float4x4_Multiply_Scalar(const float4x4* aLeft, const float4x4* aRight)
+{
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  for (size_t i = 0; i < 4; ++i)
+  {
+    toReturn.data[i][0] =
+      aLeft->data[0][0] * aRight->data[i][0] +
+      aLeft->data[1][0] * aRight->data[i][1] +
+      aLeft->data[2][0] * aRight->data[i][2] +
+      aLeft->data[3][0] * aRight->data[i][3];
+
+    toReturn.data[i][1] =
+      aLeft->data[0][1] * aRight->data[i][0] +
+      aLeft->data[1][1] * aRight->data[i][1] +
+      aLeft->data[2][1] * aRight->data[i][2] +
+      aLeft->data[3][1] * aRight->data[i][3];
+
+    toReturn.data[i][2] =
+      aLeft->data[0][2] * aRight->data[i][0] +
+      aLeft->data[1][2] * aRight->data[i][1] +
+      aLeft->data[2][2] * aRight->data[i][2] +
+      aLeft->data[3][2] * aRight->data[i][3];
+
+    toReturn.data[i][3] =
+      aLeft->data[0][3] * aRight->data[i][0] +
+      aLeft->data[1][3] * aRight->data[i][1] +
+      aLeft->data[2][3] * aRight->data[i][2] +
+      aLeft->data[3][3] * aRight->data[i][3];
+  }
+  return toReturn;
+}
+
+// The matrices are column major, so every column of the result is a linear combination of the
+// columns of aLeft, weighted by the matching column of aRight. That maps directly onto 4 wide registers.
+#if defined(MATH_SSE2)
+float4 Float4x4_Float4_Multiply_SSE2(const float4x4* aLeft, const float4 aRight)
+{
+  __m128 toReturn = _mm_mul_ps(_mm_loadu_ps(aLeft->data[0]), _mm_set1_ps(aRight.x));
+  toReturn = _mm_add_ps(toReturn, _mm_mul_ps(_mm_loadu_ps(aLeft->data[1]), _mm_set1_ps(aRight.y)));
+  toReturn = _mm_add_ps(toReturn, _mm_mul_ps(_mm_loadu_ps(aLeft->data[2]), _mm_set1_ps(aRight.z)));
+  toReturn = _mm_add_ps(toReturn, _mm_mul_ps(_mm_loadu_ps(aLeft->data[3]), _mm_set1_ps(aRight.w)));
+
+  float4 result;
+  _mm_storeu_ps(&result.x, toReturn);
+  return result;
+}
+
+float4x4 Float4x4_Multiply_SSE2(const float4x4* aLeft, const float4x4* aRight)
+{
+  __m128 left0 = _mm_loadu_ps(aLeft->data[0]);
+  __m128 left1 = _mm_loadu_ps(aLeft->data[1]);
+  __m128 left2 = _mm_loadu_ps(aLeft->data[2]);
+  __m128 left3 = _mm_loadu_ps(aLeft->data[3]);
+
+  float4x4 toReturn;
+
+  for (size_t i = 0; i < 4; ++i)
+  {
+    __m128 column = _mm_mul_ps(left0, _mm_set1_ps(aRight->data[i][0]));
+    column = _mm_add_ps(column, _mm_mul_ps(left1, _mm_set1_ps(aRight->data[i][1])));
+    column = _mm_add_ps(column, _mm_mul_ps(left2, _mm_set1_ps(aRight->data[i][2])));
+    column = _mm_add_ps(column, _mm_mul_ps(left3, _mm_set1_ps(aRight->data[i][3])));
+    _mm_storeu_ps(toReturn.data[i], column);
+  }
+
+  return toReturn;
+}
+#endif
+
+// AVX works on two result columns at once, each 128 bit lane holds a copy of the aLeft column.
+#if defined(MATH_AVX)
+SDL_TARGETING("avx") float4x4 Float4x4_Multiply_AVX(const float4x4* aLeft, const float4x4* aRight)
+{
+  __m256 left0 = _mm256_broadcast_ps((const __m128*)aLeft->data[0]);
+  __m256 left1 = _mm256_broadcast_ps((const __m128*)aLeft->data[1]);
+  __m256 left2 = _mm256_broadcast_ps((const __m128*)aLeft->data[2]);
+  __m256 left3 = _mm256_broadcast_ps((const __m128*)aLeft->data[3]);
+
+  float4x4 toReturn;
+
+  for (size_t i = 0; i < 4; i += 2)
+  {
+    __m256 right = _mm256_loadu_ps(aRight->data[i]);
+
+    __m256 columns = _mm256_mul_ps(left0, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(0, 0, 0, 0)));
+    columns = _mm256_add_ps(columns, _mm256_mul_ps(left1, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(1, 1, 1, 1))));
+    columns = _mm256_add_ps(columns, _mm256_mul_ps(left2, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(2, 2, 2, 2))));
+    columns = _mm256_add_ps(columns, _mm256_mul_ps(left3, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(3, 3, 3, 3))));
+    _mm256_storeu_ps(toReturn.data[i], columns);
+  }
+
+  return toReturn;
+}
+#endif
+
+#if defined(MATH_NEON)
+float4 Float4x4_Float4_Multiply_NEON(const float4x4* aLeft, const float4 aRight)
+{
+  float32x4_t toReturn = vmulq_n_f32(vld1q_f32(aLeft->data[0]), aRight.x);
+  toReturn = vmlaq_n_f32(toReturn, vld1q_f32(aLeft->data[1]), aRight.y);
+  toReturn = vmlaq_n_f32(toReturn, vld1q_f32(aLeft->data[2]), aRight.z);
+  toReturn = vmlaq_n_f32(toReturn, vld1q_f32(aLeft->data[3]), aRight.w);
+
+  float4 result;
+  vst1q_f32(&result.x, toReturn);
+  return result;
+}
+
+float4x4 Float4x4_Multiply_NEON(const float4x4* aLeft, const float4x4* aRight)
+{
+  float32x4_t left0 = vld1q_f32(aLeft->data[0]);
+  float32x4_t left1 = vld1q_f32(aLeft->data[1]);
+  float32x4_t left2 = vld1q_f32(aLeft->data[2]);
+  float32x4_t left3 = vld1q_f32(aLeft->data[3]);
+
+  float4x4 toReturn;
+
+  for (size_t i = 0; i < 4; ++i)
+  {
+    float32x4_t column = vmulq_n_f32(left0, aRight->data[i][0]);
+    column = vmlaq_n_f32(column, left1, aRight->data[i][1]);
+    column = vmlaq_n_f32(column, left2, aRight->data[i][2]);
+    column = vmlaq_n_f32(column, left3, aRight->data[i][3]);
+    vst1q_f32(toReturn.data[i], column);
+  }
+
+  return toReturn;
+}
+#endif
+
+float4 Float4x4_Float4_Multiply(const float4x4* aLeft, const float4 aRight)
+{
+#if defined(MATH_SSE2)
+  return Float4x4_Float4_Multiply_SSE2(aLeft, aRight);
+#elif defined(MATH_NEON)
+  return Float4x4_Float4_Multiply_NEON(aLeft, aRight);
+#else
+  return Float4x4_Float4_Multiply_Scalar(aLeft, aRight);
+#endif
+}
+
+// Float4x4_Multiply_AVX isn't used here, it doesn't measure faster than SSE2 in MathBenchmark.
+float4x4 Float4x4_Multiply(const float4x4* aLeft, const float4x4* aRight)
+{
+#if defined(MATH_SSE2)
+  return Float4x4_Multiply_SSE2(aLeft, aRight);
+#elif defined(MATH_NEON)
+  return Float4x4_Multiply_NEON(aLeft, aRight);
+#else
+  return Float4x4_Multiply_Scalar(aLeft, aRight);
+#endif
+}
+
+// Inverse for matrices whose bottom row is (0, 0, 0, 1), which is everything CreateModelMatrix
+// produces. Only the upper 3x3 needs a real inverse, and the translation then falls out of it.
+float4x4 Float4x4_AffineInverse(const float4x4* aValue)
+{
+  const float3 a = Float4_XYZ(aValue->columns[0]);
+  const float3 b = Float4_XYZ(aValue->columns[1]);
+  const float3 c = Float4_XYZ(aValue->columns[2]);
+  const float3 d = Float4_XYZ(aValue->columns[3]);
+
+  // The rows of the inverse of [a b c] are the cross products of its columns, over the determinant.
+  const float3 bc = Float3_Cross(b, c);
+  const float determinant_inverse = 1.0f / Float3_Dot(a, bc);
+
+  const float3 row0 = Float3_Scalar_Multiply(bc, determinant_inverse);
+  const float3 row1 = Float3_Scalar_Multiply(Float3_Cross(c, a), determinant_inverse);
+  const float3 row2 = Float3_Scalar_Multiply(Float3_Cross(a, b), determinant_inverse);
+
+  float4x4 toReturn;
+  toReturn.data[0][0] = row0.x;
+  toReturn.data[0][1] = row1.x;
+  toReturn.data[0][2] = row2.x;
+  toReturn.data[0][3] = 0.0f;
+
+  toReturn.data[1][0] = row0.y;
+  toReturn.data[1][1] = row1.y;
+  toReturn.data[1][2] = row2.y;
+  toReturn.data[1][3] = 0.0f;
+
+  toReturn.data[2][0] = row0.z;
+  toReturn.data[2][1] = row1.z;
+  toReturn.data[2][2] = row2.z;
+  toReturn.data[2][3] = 0.0f;
+
+  toReturn.data[3][0] = -Float3_Dot(row0, d);
+  toReturn.data[3][1] = -Float3_Dot(row1, d);
+  toReturn.data[3][2] = -Float3_Dot(row2, d);
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
+////////////////////////////////////////////////////////////
+/// Core Matrices
+
+float4x4 IdentityMatrix() {
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  toReturn.data[0][0] = 1.0f;
+  toReturn.data[1][1] = 1.0f;
+  toReturn.data[2][2] = 1.0f;
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
+float4x4 TranslationMatrix(float4 aPosition) {
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[3][0] = aPosition.x;
+  toReturn.data[3][1] = aPosition.y;
+  toReturn.data[3][2] = aPosition.z;
+
+  return toReturn;
+}
+
+float4x4 ScaleMatrix(float4 aScale) {
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[0][0] = aScale.x;
+  toReturn.data[1][1] = aScale.y;
+  toReturn.data[2][2] = aScale.z;
+
+  return toReturn;
+}
+
+float4x4 RotationMatrixX(float aAngle) {
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[1][1] = SDL_cosf(aAngle);
+  toReturn.data[1][2] = SDL_sinf(aAngle);
+  toReturn.data[2][1] = -SDL_sinf(aAngle);
+  toReturn.data[2][2] = SDL_cosf(aAngle);
+
+  return toReturn;
+}
+
+float4x4 RotationMatrixY(float aAngle) {
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[0][0] = SDL_cosf(aAngle);
+  toReturn.data[0][2] = -SDL_sinf(aAngle);
+  toReturn.data[2][0] = SDL_sinf(aAngle);
+  toReturn.data[2][2] = SDL_cosf(aAngle);
+
+  return toReturn;
+}
+
+float4x4 RotationMatrixZ(float aAngle) {
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[0][0] = SDL_cosf(aAngle);
+  toReturn.data[0][1] = SDL_sinf(aAngle);
+  toReturn.data[1][0] = -SDL_sinf(aAngle);
+  toReturn.data[1][1] = SDL_cosf(aAngle);
+
+  return toReturn;
+}
+
+float4x4 RotationMatrix(float4 aPosition) {
+  float4x4 xRotation = RotationMatrixX(aPosition.x);
+  float4x4 yRotation = RotationMatrixY(aPosition.y);
+  float4x4 zRotation = RotationMatrixZ(aPosition.z);
+
+  float4x4 xyRotation = Float4x4_Multiply(&yRotation, &xRotation);
+
+  return Float4x4_Multiply(&zRotation, &xyRotation);
+}
+
+float4x4 RotationMatrixFromQuaternion(float4 aQuaternion) {
+  float x2 = aQuaternion.x * aQuaternion.x;
+  float y2 = aQuaternion.y * aQuaternion.y;
+  float z2 = aQuaternion.z * aQuaternion.z;
+
+  float xy = aQuaternion.x * aQuaternion.y;
+  float xz = aQuaternion.x * aQuaternion.z;
+  float yz = aQuaternion.y * aQuaternion.z;
+
+  float wx = aQuaternion.w * aQuaternion.x;
+  float wy = aQuaternion.w * aQuaternion.y;
+  float wz = aQuaternion.w * aQuaternion.z;
+
+  float4x4 toReturn = IdentityMatrix();
+
+  toReturn.data[0][0] = 1.0f - 2.0f * (y2 + z2);
+  toReturn.data[0][1] =        2.0f * (xy + wz);
+  toReturn.data[0][2] =        2.0f * (xz - wy);
+
+  toReturn.data[1][0] =        2.0f * (xy - wz);
+  toReturn.data[1][1] = 1.0f - 2.0f * (x2 + z2);
+  toReturn.data[1][2] =        2.0f * (yz + wx);
+
+  toReturn.data[2][0] =        2.0f * (xz + wy);
+  toReturn.data[2][1] =        2.0f * (yz - wx);
+  toReturn.data[2][2] = 1.0f - 2.0f * (x2 + y2);
+
+  return toReturn;
+}
+
+// Same result as TranslationMatrix * RotationMatrix * ScaleMatrix, written out directly. The rotation
+// is Z * Y * X, so each axis only needs one sin and cos, and scaling and translating it only touch
+// the columns, none of the intermediate 4x4 multiplies are needed.
+float4x4 CreateModelMatrix(float4 aPosition, float4 aScale, float4 aRotation) {
+  const float sx = SDL_sinf(aRotation.x);
+  const float cx = SDL_cosf(aRotation.x);
+  const float sy = SDL_sinf(aRotation.y);
+  const float cy = SDL_cosf(aRotation.y);
+  const float sz = SDL_sinf(aRotation.z);
+  const float cz = SDL_cosf(aRotation.z);
+
+  float4x4 toReturn;
+
+  toReturn.data[0][0] = (cy * cz) * aScale.x;
+  toReturn.data[0][1] = (cy * sz) * aScale.x;
+  toReturn.data[0][2] = -sy * aScale.x;
+  toReturn.data[0][3] = 0.0f;
+
+  toReturn.data[1][0] = (cz * sy * sx - sz * cx) * aScale.y;
+  toReturn.data[1][1] = (sz * sy * sx + cz * cx) * aScale.y;
+  toReturn.data[1][2] = (cy * sx) * aScale.y;
+  toReturn.data[1][3] = 0.0f;
+
+  toReturn.data[2][0] = (cz * sy * cx + sz * sx) * aScale.z;
+  toReturn.data[2][1] = (sz * sy * cx - cz * sx) * aScale.z;
+  toReturn.data[2][2] = (cy * cx) * aScale.z;
+  toReturn.data[2][3] = 0.0f;
+
+  toReturn.data[3][0] = aPosition.x;
+  toReturn.data[3][1] = aPosition.y;
+  toReturn.data[3][2] = aPosition.z;
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
+// Same as CreateModelMatrix, but with the rotation as a unit quaternion.
+float4x4 CreateModelMatrixWithQuaternion(float4 aPosition, float4 aScale, float4 aRotation) {
+  float x2 = aRotation.x * aRotation.x;
+  float y2 = aRotation.y * aRotation.y;
+  float z2 = aRotation.z * aRotation.z;
+
+  float xy = aRotation.x * aRotation.y;
+  float xz = aRotation.x * aRotation.z;
+  float yz = aRotation.y * aRotation.z;
+
+  float wx = aRotation.w * aRotation.x;
+  float wy = aRotation.w * aRotation.y;
+  float wz = aRotation.w * aRotation.z;
+
+  float4x4 toReturn;
+
+  toReturn.data[0][0] = (1.0f - 2.0f * (y2 + z2)) * aScale.x;
+  toReturn.data[0][1] = (       2.0f * (xy + wz)) * aScale.x;
+  toReturn.data[0][2] = (       2.0f * (xz - wy)) * aScale.x;
+  toReturn.data[0][3] = 0.0f;
+
+  toReturn.data[1][0] = (       2.0f * (xy - wz)) * aScale.y;
+  toReturn.data[1][1] = (1.0f - 2.0f * (x2 + z2)) * aScale.y;
+  toReturn.data[1][2] = (       2.0f * (yz + wx)) * aScale.y;
+  toReturn.data[1][3] = 0.0f;
+
+  toReturn.data[2][0] = (       2.0f * (xz + wy)) * aScale.z;
+  toReturn.data[2][1] = (       2.0f * (yz - wx)) * aScale.z;
+  toReturn.data[2][2] = (1.0f - 2.0f * (x2 + y2)) * aScale.z;
+  toReturn.data[2][3] = 0.0f;
+
+  toReturn.data[3][0] = aPosition.x;
+  toReturn.data[3][1] = aPosition.y;
+  toReturn.data[3][2] = aPosition.z;
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
+float4x4 OrthographicProjectionLHZO(float aLeft, float aRight, float aBottom, float aTop, float aNear, float aFar) {
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  toReturn.data[0][0] = 2.0f / (aRight - aLeft);
+  toReturn.data[1][1] = 2.0f / (aTop - aBottom);
+  toReturn.data[2][2] = 1.0f / (aFar - aNear);
+
+  toReturn.data[3][0] = -(aRight + aLeft) / (aRight - aLeft);
+  toReturn.data[3][1] = -(aTop + aBottom) / (aTop - aBottom);
+  toReturn.data[3][2] = -aNear / (aFar - aNear);
+
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
+float4x4 PerspectiveProjectionLHZO(float aFovY, float aAspectRatio, float aNear, float aFar) {
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
+  const float k = aFar / (aFar - aNear);
+
+  toReturn.data[0][0] = focalLength / aAspectRatio;
+  toReturn.data[1][1] = focalLength;
+  toReturn.data[2][2] = k;
+  toReturn.data[2][3] = 1.0f;
+  toReturn.data[3][2] = -aNear * k;
+
+  return toReturn;
+}
+
+float4x4 PerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear, float aFar) {
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
+  const float k = aNear / (aNear - aFar);
+
+  toReturn.data[0][0] = focalLength / aAspectRatio;
+  toReturn.data[1][1] = focalLength;
+  toReturn.data[2][2] = k;
+  toReturn.data[2][3] = 1.0f;
+  toReturn.data[3][2] = -aFar * k;
+
+  return toReturn;
+}
+
+float4x4 InfinitePerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear) {
+  float4x4 toReturn;
+  SDL_zero(toReturn);
+
+  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
+
+  // For ease of use we're hardcoding the epsilon to what's recommended in Foundations of Game Engine
+  // Development: Rendering, which is 2^(-20).
+  const float epsilon = SDL_powf(2, -20);
+
+  toReturn.data[0][0] = focalLength / aAspectRatio;
+  toReturn.data[1][1] = focalLength;
+  toReturn.data[2][2] = epsilon;
+  toReturn.data[2][3] = 1.0f;
+  toReturn.data[3][2] = aNear / (1.0f - epsilon);
+
+  return toReturn;
+}
+
+//////////////////////////////////////////////////////
+// Batch Operations
+// Same math as above, but over whole arrays so the SIMD registers are kept full across elements
+// rather than within a single one. The AVX2 versions are picked at runtime since, unlike SSE2, we
+// can't assume every x64 CPU running this has it.
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") void Float4x4_Multiply_Batch_AVX2(const float4x4* aLeft, const float4x4* aRights, float4x4* aResults, size_t aCount)
+{
+  __m256 left0 = _mm256_broadcast_ps((const __m128*)aLeft->data[0]);
+  __m256 left1 = _mm256_broadcast_ps((const __m128*)aLeft->data[1]);
+  __m256 left2 = _mm256_broadcast_ps((const __m128*)aLeft->data[2]);
+  __m256 left3 = _mm256_broadcast_ps((const __m128*)aLeft->data[3]);
+
+  for (size_t i = 0; i < aCount; ++i) {
+    for (size_t j = 0; j < 4; j += 2) {
+      __m256 right = _mm256_loadu_ps(aRights[i].data[j]);
+
+      __m256 columns = _mm256_mul_ps(left0, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(0, 0, 0, 0)));
+      columns = _mm256_add_ps(columns, _mm256_mul_ps(left1, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(1, 1, 1, 1))));
+      columns = _mm256_add_ps(columns, _mm256_mul_ps(left2, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(2, 2, 2, 2))));
+      columns = _mm256_add_ps(columns, _mm256_mul_ps(left3, _mm256_shuffle_ps(right, right, _MM_SHUFFLE(3, 3, 3, 3))));
+      _mm256_storeu_ps(aResults[i].data[j], columns);
+    }
+  }
+}
+
+// Two vectors per register, one in each 128 bit lane.
+SDL_TARGETING("avx2") void Float4x4_TransformVectors_Batch_AVX2(const float4x4* aMatrix, const float4* aVectors, float4* aResults, size_t aCount)
+{
+  __m256 column0 = _mm256_broadcast_ps((const __m128*)aMatrix->data[0]);
+  __m256 column1 = _mm256_broadcast_ps((const __m128*)aMatrix->data[1]);
+  __m256 column2 = _mm256_broadcast_ps((const __m128*)aMatrix->data[2]);
+  __m256 column3 = _mm256_broadcast_ps((const __m128*)aMatrix->data[3]);
+
+  size_t i = 0;
+  for (; i + 2 <= aCount; i += 2) {
+    __m256 vectors = _mm256_loadu_ps(&aVectors[i].x);
+
+    __m256 result = _mm256_mul_ps(column0, _mm256_shuffle_ps(vectors, vectors, _MM_SHUFFLE(0, 0, 0, 0)));
+    result = _mm256_add_ps(result, _mm256_mul_ps(column1, _mm256_shuffle_ps(vectors, vectors, _MM_SHUFFLE(1, 1, 1, 1))));
+    result = _mm256_add_ps(result, _mm256_mul_ps(column2, _mm256_shuffle_ps(vectors, vectors, _MM_SHUFFLE(2, 2, 2, 2))));
+    result = _mm256_add_ps(result, _mm256_mul_ps(column3, _mm256_shuffle_ps(vectors, vectors, _MM_SHUFFLE(3, 3, 3, 3))));
+    _mm256_storeu_ps(&aResults[i].x, result);
+  }
+
+  for (; i < aCount; ++i) {
+    aResults[i] = Float4x4_Float4_Multiply(aMatrix, aVectors[i]);
+  }
+}
+
+// Eight points per register, one per lane. aBroadcast holds the top three rows of the matrix with
+// each element splatted across a register.
+SDL_TARGETING("avx2") void Float4x4_BroadcastAffine_AVX2(const float4x4* aMatrix, __m256 aBroadcast[12])
+{
+  for (size_t column = 0; column < 4; ++column) {
+    for (size_t row = 0; row < 3; ++row) {
+      aBroadcast[column * 3 + row] = _mm256_set1_ps(aMatrix->data[column][row]);
+    }
+  }
+}
+
+SDL_TARGETING("avx2") void Float4x4_TransformPoints8_AVX2(const __m256 aBroadcast[12], __m256* aX, __m256* aY, __m256* aZ)
+{
+  __m256 x = *aX;
+  __m256 y = *aY;
+  __m256 z = *aZ;
+
+  *aX = _mm256_add_ps(aBroadcast[9], _mm256_mul_ps(aBroadcast[0], x));
+  *aX = _mm256_add_ps(*aX, _mm256_mul_ps(aBroadcast[3], y));
+  *aX = _mm256_add_ps(*aX, _mm256_mul_ps(aBroadcast[6], z));
+
+  *aY = _mm256_add_ps(aBroadcast[10], _mm256_mul_ps(aBroadcast[1], x));
+  *aY = _mm256_add_ps(*aY, _mm256_mul_ps(aBroadcast[4], y));
+  *aY = _mm256_add_ps(*aY, _mm256_mul_ps(aBroadcast[7], z));
+
+  *aZ = _mm256_add_ps(aBroadcast[11], _mm256_mul_ps(aBroadcast[2], x));
+  *aZ = _mm256_add_ps(*aZ, _mm256_mul_ps(aBroadcast[5], y));
+  *aZ = _mm256_add_ps(*aZ, _mm256_mul_ps(aBroadcast[8], z));
+}
+
+SDL_TARGETING("avx2") void Float4x4_TransformPoints_SoA_AVX2(
+  const float4x4* aMatrix,
+  const float* aX, const float* aY, const float* aZ,
+  float* aResultX, float* aResultY, float* aResultZ,
+  size_t aCount)
+{
+  __m256 broadcast[12];
+  Float4x4_BroadcastAffine_AVX2(aMatrix, broadcast);
+
+  size_t i = 0;
+  for (; i + 8 <= aCount; i += 8) {
+    __m256 x = _mm256_loadu_ps(aX + i);
+    __m256 y = _mm256_loadu_ps(aY + i);
+    __m256 z = _mm256_loadu_ps(aZ + i);
+
+    Float4x4_TransformPoints8_AVX2(broadcast, &x, &y, &z);
+
+    _mm256_storeu_ps(aResultX + i, x);
+    _mm256_storeu_ps(aResultY + i, y);
+    _mm256_storeu_ps(aResultZ + i, z);
+  }
+
+  for (; i < aCount; ++i) {
+    float4 point = { aX[i], aY[i], aZ[i], 1.0f };
+    float4 result = Float4x4_Float4_Multiply(aMatrix, point);
+    aResultX[i] = result.x;
+    aResultY[i] = result.y;
+    aResultZ[i] = result.z;
+  }
+}
+#endif
+
+// aResults[i] = aLeft * aRights[i]
+void Float4x4_Multiply_Batch(const float4x4* aLeft, const float4x4* aRights, float4x4* aResults, size_t aCount)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    Float4x4_Multiply_Batch_AVX2(aLeft, aRights, aResults, aCount);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < aCount; ++i) {
+    aResults[i] = Float4x4_Multiply(aLeft, &aRights[i]);
+  }
+}
+
+// aResults[i] = aMatrix * aVectors[i]
+void Float4x4_TransformVectors_Batch(const float4x4* aMatrix, const float4* aVectors, float4* aResults, size_t aCount)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    Float4x4_TransformVectors_Batch_AVX2(aMatrix, aVectors, aResults, aCount);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < aCount; ++i) {
+    aResults[i] = Float4x4_Float4_Multiply(aMatrix, aVectors[i]);
+  }
+}
+
+// Points are treated as having a w of 1, and aMatrix is assumed to be affine so there's no divide.
+// float3 isn't a friendly stride for 8 wide registers (gathering them measured slower than this),
+// so prefer Float4x4_TransformPoints_SoA for large arrays.
+void Float4x4_TransformPoints_Batch(const float4x4* aMatrix, const float3* aPoints, float3* aResults, size_t aCount)
+{
+  for (size_t i = 0; i < aCount; ++i) {
+    float4 point = { aPoints[i].x, aPoints[i].y, aPoints[i].z, 1.0f };
+    aResults[i] = Float4_XYZ(Float4x4_Float4_Multiply(aMatrix, point));
+  }
+}
+
+// Structure of arrays version of Float4x4_TransformPoints_Batch, the input and output arrays may alias.
+void Float4x4_TransformPoints_SoA(
+  const float4x4* aMatrix,
+  const float* aX, const float* aY, const float* aZ,
+  float* aResultX, float* aResultY, float* aResultZ,
+  size_t aCount)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    Float4x4_TransformPoints_SoA_AVX2(aMatrix, aX, aY, aZ, aResultX, aResultY, aResultZ, aCount);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < aCount; ++i) {
+    float4 point = { aX[i], aY[i], aZ[i], 1.0f };
+    float4 result = Float4x4_Float4_Multiply(aMatrix, point);
+    aResultX[i] = result.x;
+    aResultY[i] = result.y;
+    aResultZ[i] = result.z;
+  }
+}
+
+//////////////////////////////////////////////////////
+// Vectorized Sine and Cosine
+// Cephes style: reduce the angle into [-pi/4, pi/4] around the nearest multiple of pi/4, evaluate
+// both minimax polynomials, then pick and flip signs depending on which octant the angle was in.
+// Good to a couple of ulps for angles up to around 8192 radians, which covers any sane rotation.
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") void SinCos8_AVX2(__m256 aAngles, __m256* aSines, __m256* aCosines)
+{
+  const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+  __m256 x = _mm256_andnot_ps(signMask, aAngles);
+  __m256 sinSign = _mm256_and_ps(aAngles, signMask);
+
+  // j is the octant, rounded up to even so the reduced angle is centered on zero.
+  __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+  j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+  j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+  __m256 y = _mm256_cvtepi32_ps(j);
+
+  // Subtracting y * pi/4 in three parts keeps the precision float would otherwise lose.
+  x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(0.78515625f)));
+  x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f)));
+  x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(3.77489497744594108e-8f)));
+
+  __m256 sinFlip = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+  __m256 cosFlip = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+  __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+
+  __m256 z = _mm256_mul_ps(x, x);
+
+  __m256 cosine = _mm256_set1_ps(2.443315711809948e-5f);
+  cosine = _mm256_add_ps(_mm256_mul_ps(cosine, z), _mm256_set1_ps(-1.388731625493765e-3f));
+  cosine = _mm256_add_ps(_mm256_mul_ps(cosine, z), _mm256_set1_ps(4.166664568298827e-2f));
+  cosine = _mm256_mul_ps(_mm256_mul_ps(cosine, z), z);
+  cosine = _mm256_sub_ps(cosine, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+  cosine = _mm256_add_ps(cosine, _mm256_set1_ps(1.0f));
+
+  __m256 sine = _mm256_set1_ps(-1.9515295891e-4f);
+  sine = _mm256_add_ps(_mm256_mul_ps(sine, z), _mm256_set1_ps(8.3321608736e-3f));
+  sine = _mm256_add_ps(_mm256_mul_ps(sine, z), _mm256_set1_ps(-1.6666654611e-1f));
+  sine = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sine, z), x), x);
+
+  *aSines = _mm256_xor_ps(_mm256_blendv_ps(cosine, sine, swap), _mm256_xor_ps(sinSign, sinFlip));
+  *aCosines = _mm256_xor_ps(_mm256_blendv_ps(sine, cosine, swap), cosFlip);
+}
+
+SDL_TARGETING("avx2") void SinCos_Batch_AVX2(const float* aAngles, float* aSines, float* aCosines, size_t aCount)
+{
+  size_t i = 0;
+  for (; i + 8 <= aCount; i += 8) {
+    __m256 sines;
+    __m256 cosines;
+    SinCos8_AVX2(_mm256_loadu_ps(aAngles + i), &sines, &cosines);
+    _mm256_storeu_ps(aSines + i, sines);
+    _mm256_storeu_ps(aCosines + i, cosines);
+  }
+
+  for (; i < aCount; ++i) {
+    aSines[i] = SDL_sinf(aAngles[i]);
+    aCosines[i] = SDL_cosf(aAngles[i]);
+  }
+}
+#endif
+
+void SinCos_Batch(const float* aAngles, float* aSines, float* aCosines, size_t aCount)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    SinCos_Batch_AVX2(aAngles, aSines, aCosines, aCount);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < aCount; ++i) {
+    aSines[i] = SDL_sinf(aAngles[i]);
+    aCosines[i] = SDL_cosf(aAngles[i]);
+  }
+}
+
+//////////////////////////////////////////////////////
+// Transform Store
+// Position, scale and Euler rotation for many objects, one array per component, so that building
+// their matrices can work on 8 objects per register without shuffling anything in.
+
+TransformStore CreateTransformStore(size_t aCapacity)
+{
+  TransformStore store;
+  SDL_zero(store);
+
+  // One allocation, split into the nine component arrays.
+  float* components = (float*)SDL_malloc(sizeof(float) * 9 * aCapacity);
+  SDL_assert(components);
+
+  store.mPositionX = components + (0 * aCapacity);
+  store.mPositionY = components + (1 * aCapacity);
+  store.mPositionZ = components + (2 * aCapacity);
+  store.mScaleX = components + (3 * aCapacity);
+  store.mScaleY = components + (4 * aCapacity);
+  store.mScaleZ = components + (5 * aCapacity);
+  store.mRotationX = components + (6 * aCapacity);
+  store.mRotationY = components + (7 * aCapacity);
+  store.mRotationZ = components + (8 * aCapacity);
+  store.mCapacity = aCapacity;
+
+  return store;
+}
+
+void DestroyTransformStore(TransformStore* aStore)
+{
+  SDL_free(aStore->mPositionX);
+  SDL_zero(*aStore);
+}
+
+size_t AddTransform(TransformStore* aStore, float4 aPosition, float4 aScale, float4 aRotation)
+{
+  SDL_assert(aStore->mCount < aStore->mCapacity);
+
+  size_t index = aStore->mCount++;
+  aStore->mPositionX[index] = aPosition.x;
+  aStore->mPositionY[index] = aPosition.y;
+  aStore->mPositionZ[index] = aPosition.z;
+  aStore->mScaleX[index] = aScale.x;
+  aStore->mScaleY[index] = aScale.y;
+  aStore->mScaleZ[index] = aScale.z;
+  aStore->mRotationX[index] = aRotation.x;
+  aStore->mRotationY[index] = aRotation.y;
+  aStore->mRotationZ[index] = aRotation.z;
+
+  return index;
+}
+
+float4x4 CreateModelMatrixFromTransformStore(const TransformStore* aStore, size_t aIndex)
+{
+  float4 position = { aStore->mPositionX[aIndex], aStore->mPositionY[aIndex], aStore->mPositionZ[aIndex], 1.0f };
+  float4 scale = { aStore->mScaleX[aIndex], aStore->mScaleY[aIndex], aStore->mScaleZ[aIndex], 1.0f };
+  float4 rotation = { aStore->mRotationX[aIndex], aStore->mRotationY[aIndex], aStore->mRotationZ[aIndex], 0.0f };
+
+  return CreateModelMatrix(position, scale, rotation);
+}
+
+#if defined(MATH_AVX2)
+// Standard 8x8 transpose, aRows[i] ends up holding lane i of every input register.
+SDL_TARGETING("avx2") void Transpose8x8_AVX2(__m256 aRows[8])
+{
+  __m256 t0 = _mm256_unpacklo_ps(aRows[0], aRows[1]);
+  __m256 t1 = _mm256_unpackhi_ps(aRows[0], aRows[1]);
+  __m256 t2 = _mm256_unpacklo_ps(aRows[2], aRows[3]);
+  __m256 t3 = _mm256_unpackhi_ps(aRows[2], aRows[3]);
+  __m256 t4 = _mm256_unpacklo_ps(aRows[4], aRows[5]);
+  __m256 t5 = _mm256_unpackhi_ps(aRows[4], aRows[5]);
+  __m256 t6 = _mm256_unpacklo_ps(aRows[6], aRows[7]);
+  __m256 t7 = _mm256_unpackhi_ps(aRows[6], aRows[7]);
+
+  __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+  aRows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+  aRows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+  aRows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+  aRows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+  aRows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+  aRows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+  aRows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+  aRows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// The same closed form as CreateModelMatrix, one object per lane. Each matrix element is computed
+// for 8 objects at once, then two 8x8 transposes turn that into 8 whole matrices.
+SDL_TARGETING("avx2") void BuildTransformStoreMatrices_AVX2(const TransformStore* aStore, float4x4* aResults)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  // Large stores are many times the size of the cache, so when the output is aligned the matrices
+  // are streamed straight to memory rather than pulling every cache line in just to overwrite it.
+  const bool stream = ((uintptr_t)aResults & 31) == 0;
+
+  size_t i = 0;
+  for (; i + 8 <= aStore->mCount; i += 8) {
+    __m256 sx, cx, sy, cy, sz, cz;
+    SinCos8_AVX2(_mm256_loadu_ps(aStore->mRotationX + i), &sx, &cx);
+    SinCos8_AVX2(_mm256_loadu_ps(aStore->mRotationY + i), &sy, &cy);
+    SinCos8_AVX2(_mm256_loadu_ps(aStore->mRotationZ + i), &sz, &cz);
+
+    __m256 scaleX = _mm256_loadu_ps(aStore->mScaleX + i);
+    __m256 scaleY = _mm256_loadu_ps(aStore->mScaleY + i);
+    __m256 scaleZ = _mm256_loadu_ps(aStore->mScaleZ + i);
+
+    __m256 szsy = _mm256_mul_ps(sz, sy);
+    __m256 czsy = _mm256_mul_ps(cz, sy);
+
+    // Columns 0 and 1, in the order they're laid out in memory.
+    __m256 lower[8];
+    lower[0] = _mm256_mul_ps(_mm256_mul_ps(cy, cz), scaleX);
+    lower[1] = _mm256_mul_ps(_mm256_mul_ps(cy, sz), scaleX);
+    lower[2] = _mm256_mul_ps(_mm256_sub_ps(zero, sy), scaleX);
+    lower[3] = zero;
+    lower[4] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(czsy, sx), _mm256_mul_ps(sz, cx)), scaleY);
+    lower[5] = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(szsy, sx), _mm256_mul_ps(cz, cx)), scaleY);
+    lower[6] = _mm256_mul_ps(_mm256_mul_ps(cy, sx), scaleY);
+    lower[7] = zero;
+
+    // Columns 2 and 3.
+    __m256 upper[8];
+    upper[0] = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(czsy, cx), _mm256_mul_ps(sz, sx)), scaleZ);
+    upper[1] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(szsy, cx), _mm256_mul_ps(cz, sx)), scaleZ);
+    upper[2] = _mm256_mul_ps(_mm256_mul_ps(cy, cx), scaleZ);
+    upper[3] = zero;
+    upper[4] = _mm256_loadu_ps(aStore->mPositionX + i);
+    upper[5] = _mm256_loadu_ps(aStore->mPositionY + i);
+    upper[6] = _mm256_loadu_ps(aStore->mPositionZ + i);
+    upper[7] = one;
+
+    Transpose8x8_AVX2(lower);
+    Transpose8x8_AVX2(upper);
+
+    if (stream) {
+      for (size_t j = 0; j < 8; ++j) {
+        _mm256_stream_ps(aResults[i + j].data[0], lower[j]);
+        _mm256_stream_ps(aResults[i + j].data[2], upper[j]);
+      }
+    }
+    else {
+      for (size_t j = 0; j < 8; ++j) {
+        _mm256_storeu_ps(aResults[i + j].data[0], lower[j]);
+        _mm256_storeu_ps(aResults[i + j].data[2], upper[j]);
+      }
+    }
+  }
+
+  if (stream) {
+    _mm_sfence();
+  }
+
+  for (; i < aStore->mCount; ++i) {
+    aResults[i] = CreateModelMatrixFromTransformStore(aStore, i);
+  }
+}
+#endif
+
+// Fills aResults[0, aStore->mCount) with the model matrix of each transform.
+void BuildTransformStoreMatrices(const TransformStore* aStore, float4x4* aResults)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    BuildTransformStoreMatrices_AVX2(aStore, aResults);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < aStore->mCount; ++i) {
+    aResults[i] = CreateModelMatrixFromTransformStore(aStore, i);
+  }
+}
+
+//////////////////////////////////////////////////////
+// Frustum Culling
+
+// Gribb/Hartmann extraction, the planes come straight out of the rows of the matrix. Works for any
+// projection, including the reversed Z infinite one from InfinitePerspectiveProjectionLHOZ.
+Frustum ExtractFrustum(const float4x4* aWorldToNDC)
+{
+  float4 rows[4];
+  for (size_t i = 0; i < 4; ++i) {
+    rows[i].x = aWorldToNDC->data[0][i];
+    rows[i].y = aWorldToNDC->data[1][i];
+    rows[i].z = aWorldToNDC->data[2][i];
+    rows[i].w = aWorldToNDC->data[3][i];
+  }
+
+  // SDL_GPU clip space is -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+  float4 planes[6];
+  planes[0] = Float4_Add(rows[3], rows[0]);
+  planes[1] = Float4_Subtract(rows[3], rows[0]);
+  planes[2] = Float4_Add(rows[3], rows[1]);
+  planes[3] = Float4_Subtract(rows[3], rows[1]);
+  planes[4] = rows[2];
+  planes[5] = Float4_Subtract(rows[3], rows[2]);
+
+  Frustum toReturn;
+  SDL_zero(toReturn);
+
+  for (size_t i = 0; i < 6; ++i) {
+    float length = Float3_Magnitude(Float4_XYZ(planes[i]));
+
+    // An infinite projection puts one depth plane at infinity, which comes out with a (nearly) zero
+    // normal. Everything is in front of it, so rather than normalize it into garbage we drop it.
+    if (length < 1e-5f) {
+      continue;
+    }
+
+    toReturn.mPlanes[toReturn.mPlanesCount++] = Float4_Scalar_Division(planes[i], length);
+  }
+
+  return toReturn;
+}
+
+bool SphereInFrustum(const Frustum* aFrustum, float3 aCenter, float aRadius)
+{
+  for (Uint32 i = 0; i < aFrustum->mPlanesCount; ++i) {
+    const float4* plane = &aFrustum->mPlanes[i];
+    if (Float3_Dot(Float4_XYZ(*plane), aCenter) + plane->w < -aRadius) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// aExtent is the half size of the box on each axis.
+bool AabbInFrustum(const Frustum* aFrustum, float3 aCenter, float3 aExtent)
+{
+  for (Uint32 i = 0; i < aFrustum->mPlanesCount; ++i) {
+    const float4* plane = &aFrustum->mPlanes[i];
+    float radius =
+      SDL_fabsf(plane->x) * aExtent.x +
+      SDL_fabsf(plane->y) * aExtent.y +
+      SDL_fabsf(plane->z) * aExtent.z;
+
+    if (Float3_Dot(Float4_XYZ(*plane), aCenter) + plane->w < -radius) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The batch versions take their bounds as separate arrays, and test 4 (SSE2) or 8 (AVX2) against
+// each plane at a time. Indices are appended without branching: every lane writes its index, but
+// the count only moves past the ones that were visible. That never writes beyond aVisible[i].
+#if defined(MATH_SSE2)
+size_t CullSpheres_SSE2(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible)
+{
+  size_t visibleCount = 0;
+
+  size_t i = 0;
+  for (; i + 4 <= aCount; i += 4) {
+    __m128 x = _mm_loadu_ps(aX + i);
+    __m128 y = _mm_loadu_ps(aY + i);
+    __m128 z = _mm_loadu_ps(aZ + i);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(aRadius + i));
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (Uint32 j = 0; j < aFrustum->mPlanesCount; ++j) {
+      const float4* plane = &aFrustum->mPlanes[j];
+      __m128 distance = _mm_set1_ps(plane->w);
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->x), x));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->y), y));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->z), z));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int k = 0; k < 4; ++k) {
+      aVisible[visibleCount] = (Uint32)(i + k);
+      visibleCount += (mask >> k) & 1;
+    }
+  }
+
+  for (; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    aVisible[visibleCount] = (Uint32)i;
+    visibleCount += SphereInFrustum(aFrustum, center, aRadius[i]) ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+
+size_t CullAabbs_SSE2(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible)
+{
+  size_t visibleCount = 0;
+
+  size_t i = 0;
+  for (; i + 4 <= aCount; i += 4) {
+    __m128 x = _mm_loadu_ps(aX + i);
+    __m128 y = _mm_loadu_ps(aY + i);
+    __m128 z = _mm_loadu_ps(aZ + i);
+    __m128 extentX = _mm_loadu_ps(aExtentX + i);
+    __m128 extentY = _mm_loadu_ps(aExtentY + i);
+    __m128 extentZ = _mm_loadu_ps(aExtentZ + i);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (Uint32 j = 0; j < aFrustum->mPlanesCount; ++j) {
+      const float4* plane = &aFrustum->mPlanes[j];
+      __m128 distance = _mm_set1_ps(plane->w);
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->x), x));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->y), y));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane->z), z));
+
+      __m128 radius = _mm_mul_ps(_mm_set1_ps(SDL_fabsf(plane->x)), extentX);
+      radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(SDL_fabsf(plane->y)), extentY));
+      radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(SDL_fabsf(plane->z)), extentZ));
+
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int k = 0; k < 4; ++k) {
+      aVisible[visibleCount] = (Uint32)(i + k);
+      visibleCount += (mask >> k) & 1;
+    }
+  }
+
+  for (; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    float3 extent = { aExtentX[i], aExtentY[i], aExtentZ[i] };
+    aVisible[visibleCount] = (Uint32)i;
+    visibleCount += AabbInFrustum(aFrustum, center, extent) ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+#endif
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") size_t CullSpheres_AVX2(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible)
+{
+  size_t visibleCount = 0;
+
+  size_t i = 0;
+  for (; i + 8 <= aCount; i += 8) {
+    __m256 x = _mm256_loadu_ps(aX + i);
+    __m256 y = _mm256_loadu_ps(aY + i);
+    __m256 z = _mm256_loadu_ps(aZ + i);
+    __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(aRadius + i));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (Uint32 j = 0; j < aFrustum->mPlanesCount; ++j) {
+      const float4* plane = &aFrustum->mPlanes[j];
+      __m256 distance = _mm256_set1_ps(plane->w);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->x), x));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->y), y));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->z), z));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int k = 0; k < 8; ++k) {
+      aVisible[visibleCount] = (Uint32)(i + k);
+      visibleCount += (mask >> k) & 1;
+    }
+  }
+
+  for (; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    aVisible[visibleCount] = (Uint32)i;
+    visibleCount += SphereInFrustum(aFrustum, center, aRadius[i]) ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+
+SDL_TARGETING("avx2") size_t CullAabbs_AVX2(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible)
+{
+  size_t visibleCount = 0;
+
+  size_t i = 0;
+  for (; i + 8 <= aCount; i += 8) {
+    __m256 x = _mm256_loadu_ps(aX + i);
+    __m256 y = _mm256_loadu_ps(aY + i);
+    __m256 z = _mm256_loadu_ps(aZ + i);
+    __m256 extentX = _mm256_loadu_ps(aExtentX + i);
+    __m256 extentY = _mm256_loadu_ps(aExtentY + i);
+    __m256 extentZ = _mm256_loadu_ps(aExtentZ + i);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (Uint32 j = 0; j < aFrustum->mPlanesCount; ++j) {
+      const float4* plane = &aFrustum->mPlanes[j];
+      __m256 distance = _mm256_set1_ps(plane->w);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->x), x));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->y), y));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane->z), z));
+
+      __m256 radius = _mm256_mul_ps(_mm256_set1_ps(SDL_fabsf(plane->x)), extentX);
+      radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(SDL_fabsf(plane->y)), extentY));
+      radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(SDL_fabsf(plane->z)), extentZ));
+
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int k = 0; k < 8; ++k) {
+      aVisible[visibleCount] = (Uint32)(i + k);
+      visibleCount += (mask >> k) & 1;
+    }
+  }
+
+  for (; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    float3 extent = { aExtentX[i], aExtentY[i], aExtentZ[i] };
+    aVisible[visibleCount] = (Uint32)i;
+    visibleCount += AabbInFrustum(aFrustum, center, extent) ? 1 : 0;
+  }
+
+  return visibleCount;
+}
+#endif
+
+// Writes the index of every sphere at least partially inside aFrustum to aVisible, in order, and
+// returns how many there were. aVisible needs room for aCount indices.
+size_t CullSpheres(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    return CullSpheres_AVX2(aFrustum, aX, aY, aZ, aRadius, aCount, aVisible);
+  }
+#endif
+#if defined(MATH_SSE2)
+  return CullSpheres_SSE2(aFrustum, aX, aY, aZ, aRadius, aCount, aVisible);
+#else
+  size_t visibleCount = 0;
+  for (size_t i = 0; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    if (SphereInFrustum(aFrustum, center, aRadius[i])) {
+      aVisible[visibleCount++] = (Uint32)i;
+    }
+  }
+  return visibleCount;
+#endif
+}
+
+// Same as CullSpheres, for boxes given as centers and half extents.
+size_t CullAabbs(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible)
+{
+#if defined(MATH_AVX2)
+  if (SDL_HasAVX2()) {
+    return CullAabbs_AVX2(aFrustum, aX, aY, aZ, aExtentX, aExtentY, aExtentZ, aCount, aVisible);
+  }
+#endif
+#if defined(MATH_SSE2)
+  return CullAabbs_SSE2(aFrustum, aX, aY, aZ, aExtentX, aExtentY, aExtentZ, aCount, aVisible);
+#else
+  size_t visibleCount = 0;
+  for (size_t i = 0; i < aCount; ++i) {
+    float3 center = { aX[i], aY[i], aZ[i] };
+    float3 extent = { aExtentX[i], aExtentY[i], aExtentZ[i] };
+    if (AabbInFrustum(aFrustum, center, extent)) {
+      aVisible[visibleCount++] = (Uint32)i;
+    }
+  }
+  return visibleCount;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared GPU Code
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+GpuConfig GetDefaultGpuConfig(void)
+{
+  GpuConfig config;
+  SDL_zero(config);
+  config.mPresentMode = SDL_GPU_PRESENTMODE_VSYNC;
+  config.mFramesInFlight = 2;
+  config.mDebug = true;
+  config.mMaxFramesPerSecond = 0;
+  config.mParallelStartup = true;
+  return config;
+}
+
+const char* GetPresentModeName(SDL_GPUPresentMode aPresentMode)
+{
+  switch (aPresentMode) {
+  case SDL_GPU_PRESENTMODE_VSYNC: return "vsync";
+  case SDL_GPU_PRESENTMODE_MAILBOX: return "mailbox";
+  case SDL_GPU_PRESENTMODE_IMMEDIATE: return "immediate";
+  }
+  return "unknown";
+}
+
+bool ParseConfigBool(const char* aValue, bool* aResult)
+{
+  if (SDL_strcasecmp(aValue, "true") == 0 || SDL_strcasecmp(aValue, "on") == 0 || SDL_strcmp(aValue, "1") == 0) {
+    *aResult = true;
+    return true;
+  }
+
+  if (SDL_strcasecmp(aValue, "false") == 0 || SDL_strcasecmp(aValue, "off") == 0 || SDL_strcmp(aValue, "0") == 0) {
+    *aResult = false;
+    return true;
+  }
+
+  return false;
+}
+
+// strtoul happily wraps "-1" around to the largest value, so signs are rejected up front, and
+// anything that doesn't fit a Uint32 after.
+bool ParseConfigUint(const char* aValue, Uint32* aResult)
+{
+  if (!SDL_isdigit(aValue[0])) {
+    return false;
+  }
+
+  char* end = NULL;
+  unsigned long long value = SDL_strtoull(aValue, &end, 10);
+  if (*end != '\0' || value > SDL_MAX_UINT32) {
+    return false;
+  }
+
+  *aResult = (Uint32)value;
+  return true;
+}
+
+// aKey is normalized in place. Logs and returns false for unknown keys or bad values.
+bool ApplyGpuConfigSetting(GpuConfig* aConfig, char* aKey, const char* aValue)
+{
+  for (char* c = aKey; *c; ++c) {
+    if (*c == '-') {
+      *c = '_';
+    }
+  }
+
+  bool valid = false;
+  if (SDL_strcmp(aKey, "present_mode") == 0) {
+    const SDL_GPUPresentMode modes[] = { SDL_GPU_PRESENTMODE_VSYNC, SDL_GPU_PRESENTMODE_MAILBOX, SDL_GPU_PRESENTMODE_IMMEDIATE };
+    for (size_t i = 0; i < SDL_arraysize(modes); ++i) {
+      if (SDL_strcasecmp(aValue, GetPresentModeName(modes[i])) == 0) {
+        aConfig->mPresentMode = modes[i];
+        valid = true;
+      }
+    }
+  }
+  else if (SDL_strcmp(aKey, "frames_in_flight") == 0) {
+    Uint32 framesInFlight = 0;
+    valid = ParseConfigUint(aValue, &framesInFlight) && framesInFlight >= 1 && framesInFlight <= 3;
+    if (valid) {
+      aConfig->mFramesInFlight = framesInFlight;
+    }
+  }
+  else if (SDL_strcmp(aKey, "debug") == 0) {
+    valid = ParseConfigBool(aValue, &aConfig->mDebug);
+  }
+  else if (SDL_strcmp(aKey, "max_fps") == 0) {
+    valid = ParseConfigUint(aValue, &aConfig->mMaxFramesPerSecond);
+  }
+  else if (SDL_strcmp(aKey, "parallel_startup") == 0) {
+    valid = ParseConfigBool(aValue, &aConfig->mParallelStartup);
+  }
+  else {
+    SDL_Log("GpuConfig: Unknown setting %s", aKey);
+    return false;
+  }
+
+  if (!valid) {
+    SDL_Log("GpuConfig: Invalid value \"%s\" for %s", aValue, aKey);
+  }
+
+  return valid;
+}
+
+char* TrimConfigString(char* aString)
+{
+  while (SDL_isspace(*aString)) {
+    ++aString;
+  }
+
+  char* end = aString + SDL_strlen(aString);
+  while (end > aString && SDL_isspace(end[-1])) {
+    --end;
+  }
+
+  *end = '\0';
+  return aString;
+}
+
+bool LoadGpuConfigFile(GpuConfig* aConfig, const char* aPath)
+{
+  size_t fileSize = 0;
+  char* fileData = (char*)SDL_LoadFile(aPath, &fileSize);
+  if (!fileData) {
+    return false;
+  }
+
+  // SDL_LoadFile null terminates, so the lines can be cut up in place.
+  char* line = fileData;
+  while (line) {
+    char* next = SDL_strchr(line, '\n');
+    if (next) {
+      *next++ = '\0';
+    }
+
+    char* comment = SDL_strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+
+    char* equals = SDL_strchr(line, '=');
+    if (equals) {
+      *equals = '\0';
+      ApplyGpuConfigSetting(aConfig, TrimConfigString(line), TrimConfigString(equals + 1));
+    }
+    else if (*TrimConfigString(line) != '\0') {
+      SDL_Log("GpuConfig: Ignoring \"%s\" in %s", line, aPath);
+    }
+
+    line = next;
+  }
+
+  SDL_free(fileData);
+  return true;
+}
+
+// The command line wins over the config file, which wins over the defaults.
+GpuConfig LoadGpuConfig(int aArgumentsCount, char** aArguments)
+{
+  GpuConfig config = GetDefaultGpuConfig();
+
+  const char* path = NULL;
+  for (int i = 1; i < aArgumentsCount; ++i) {
+    if (SDL_strncmp(aArguments[i], "--config=", 9) == 0) {
+      path = aArguments[i] + 9;
+    }
+  }
+
+  if (path && !LoadGpuConfigFile(&config, path)) {
+    SDL_Log("GpuConfig: Couldn't read %s: %s", path, SDL_GetError());
+  }
+  else if (!path) {
+    LoadGpuConfigFile(&config, cGpuConfigDefaultPath);
+  }
+
+  for (int i = 1; i < aArgumentsCount; ++i) {
+    if (SDL_strncmp(aArguments[i], "--", 2) != 0 || SDL_strncmp(aArguments[i], "--config=", 9) == 0) {
+      continue;
+    }
+
+    char argument[256];
+    SDL_strlcpy(argument, aArguments[i] + 2, sizeof(argument));
+
+    // A bare --key is short for --key=true.
+    char* equals = SDL_strchr(argument, '=');
+    const char* value = "true";
+    if (equals) {
+      *equals = '\0';
+      value = equals + 1;
+    }
+
+    ApplyGpuConfigSetting(&config, argument, value);
+  }
+
+  return config;
+}
+
+GpuContext gContext;
+
+void CreateGpuContextWithConfig(SDL_Window* aWindow, const GpuConfig* aConfig) {
+  SDL_zero(gContext);
+
+  gContext.mWindow = aWindow;
+  gContext.mConfig = *aConfig;
+  gContext.mDevice = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_MSL, aConfig->mDebug, NULL);
+  SDL_assert(gContext.mDevice);
+
+  SDL_assert(SDL_ClaimWindowForGPUDevice(gContext.mDevice, gContext.mWindow));
+
+  // Vsync is the only mode that's always supported.
+  if (!SDL_WindowSupportsGPUPresentMode(gContext.mDevice, gContext.mWindow, gContext.mConfig.mPresentMode)) {
+    SDL_Log("GpuConfig: %s presentation isn't supported, falling back to vsync", GetPresentModeName(gContext.mConfig.mPresentMode));
+    gContext.mConfig.mPresentMode = SDL_GPU_PRESENTMODE_VSYNC;
+  }
+
+  SDL_assert(SDL_SetGPUSwapchainParameters(gContext.mDevice, gContext.mWindow, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, gContext.mConfig.mPresentMode));
+  SDL_assert(SDL_SetGPUAllowedFramesInFlight(gContext.mDevice, gContext.mConfig.mFramesInFlight));
+
+  gContext.mProperties = SDL_CreateProperties();
+  SDL_assert(gContext.mProperties);
+
+  SDL_GPUShaderFormat availableFormats = SDL_GetGPUShaderFormats(gContext.mDevice);
+  gContext.mShaderEntryPoint = NULL;
+
+  if (availableFormats & SDL_GPU_SHADERFORMAT_SPIRV)
+  {
+    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_SPIRV;
+    gContext.mShaderEntryPoint = "main";
+    gContext.mChosenBackendFormatExtension = "spv";
+  }
+  else if (availableFormats & SDL_GPU_SHADERFORMAT_MSL)
+  {
+    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_MSL;
+    gContext.mShaderEntryPoint = "main0";
+    gContext.mChosenBackendFormatExtension = "msl";
+  }
+  else if (availableFormats & SDL_GPU_SHADERFORMAT_DXIL)
+  {
+    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_DXIL;
+    gContext.mShaderEntryPoint = "main";
+    gContext.mChosenBackendFormatExtension = "dxil";
+  }
+}
+
+void CreateGpuContext(SDL_Window* aWindow) {
+  GpuConfig config = GetDefaultGpuConfig();
+  CreateGpuContextWithConfig(aWindow, &config);
+}
+
+void DestroyGpuContext() {
+  SDL_DestroyProperties(gContext.mProperties);
+  SDL_DestroyGPUDevice(gContext.mDevice);
+  SDL_DestroyWindow(gContext.mWindow);
+  SDL_zero(gContext);
+}
+
+// Call once a frame, after submitting. Waits out whatever is left of the frame's share of
+// mMaxFramesPerSecond, SDL_DelayPrecise spins through the last bit rather than oversleeping.
+void LimitFrameRate(void) {
+  if (gContext.mConfig.mMaxFramesPerSecond == 0) {
+    return;
+  }
+
+  Uint64 frameNS = 1000000000ull / gContext.mConfig.mMaxFramesPerSecond;
+  Uint64 now = SDL_GetTicksNS();
+
+  if (gContext.mNextFrameNS > now) {
+    SDL_DelayPrecise(gContext.mNextFrameNS - now);
+    gContext.mNextFrameNS += frameNS;
+  }
+  else {
+    // Running behind, start over from now instead of rushing out frames to catch up.
+    gContext.mNextFrameNS = now + frameNS;
+  }
+}
+
+SDL_GPUShader* CreateShaderForTarget(
+  const char* aTargetName,
+  const char* aShaderFilename,
+  SDL_GPUShaderStage aShaderStage,
+  Uint32 aSamplerCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aStorageBufferCount,
+  Uint32 aStorageTextureCount,
+  SDL_PropertiesID aProperties)
+{
+  char shader_path[4096];
+  SDL_snprintf(shader_path, SDL_arraysize(shader_path), "Assets/Shaders/%s/%s.%s", aTargetName, aShaderFilename, gContext.mChosenBackendFormatExtension);
+
+  size_t fileSize = 0;
+  void* fileData = SDL_LoadFile(shader_path, &fileSize);
+  SDL_assert(fileData);
+
+  SDL_GPUShaderCreateInfo shaderCreateInfo;
+  SDL_zero(shaderCreateInfo);
+
+  // Properties of its own unless some were passed in, this can be called from any thread.
+  SDL_PropertiesID properties = aProperties;
+
+  if (aProperties == SDL_PROPERTY_TYPE_INVALID) {
+    properties = SDL_CreateProperties();
+  }
+
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_SHADER_CREATE_NAME_STRING, aShaderFilename);
+
+  shaderCreateInfo.entrypoint = gContext.mShaderEntryPoint;
+  shaderCreateInfo.format = gContext.mChosenBackendFormat;
+  shaderCreateInfo.code = (Uint8*)fileData;
+  shaderCreateInfo.code_size = fileSize;
+  shaderCreateInfo.stage = aShaderStage;
+  shaderCreateInfo.num_samplers = aSamplerCount;
+  shaderCreateInfo.num_uniform_buffers = aUniformBufferCount;
+  shaderCreateInfo.num_storage_buffers = aStorageBufferCount;
+  shaderCreateInfo.num_storage_textures = aStorageTextureCount;
+  shaderCreateInfo.props = properties;
+
+  SDL_GPUShader* shader = SDL_CreateGPUShader(gContext.mDevice, &shaderCreateInfo);
+
+  if (aProperties == SDL_PROPERTY_TYPE_INVALID) {
+    SDL_DestroyProperties(properties);
+  }
+
+  SDL_free(fileData);
+  SDL_assert(shader);
+
+  return shader;
+}
+
+SDL_GPUComputePipeline* CreateComputePipelineForTarget(
+  const char* aTargetName,
+  const char* aShaderFilename,
+  Uint32 aSamplerCount,
+  Uint32 aReadOnlyStorageTextureCount,
+  Uint32 aReadOnlyStorageBufferCount,
+  Uint32 aReadWriteStorageTextureCount,
+  Uint32 aReadWriteStorageBufferCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aThreadCountX,
+  Uint32 aThreadCountY,
+  Uint32 aThreadCountZ)
+{
+  char shader_path[4096];
+  SDL_snprintf(shader_path, SDL_arraysize(shader_path), "Assets/Shaders/%s/%s.%s", aTargetName, aShaderFilename, gContext.mChosenBackendFormatExtension);
+
+  size_t fileSize = 0;
+  void* fileData = SDL_LoadFile(shader_path, &fileSize);
+  SDL_assert(fileData);
+
+  // Properties of its own, gContext.mProperties could be renamed by another thread midway.
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_COMPUTEPIPELINE_CREATE_NAME_STRING, aShaderFilename);
+
+  SDL_GPUComputePipelineCreateInfo pipelineCreateInfo;
+  SDL_zero(pipelineCreateInfo);
+
+  pipelineCreateInfo.entrypoint = gContext.mShaderEntryPoint;
+  pipelineCreateInfo.format = gContext.mChosenBackendFormat;
+  pipelineCreateInfo.code = (Uint8*)fileData;
+  pipelineCreateInfo.code_size = fileSize;
+  pipelineCreateInfo.num_samplers = aSamplerCount;
+  pipelineCreateInfo.num_readonly_storage_textures = aReadOnlyStorageTextureCount;
+  pipelineCreateInfo.num_readonly_storage_buffers = aReadOnlyStorageBufferCount;
+  pipelineCreateInfo.num_readwrite_storage_textures = aReadWriteStorageTextureCount;
+  pipelineCreateInfo.num_readwrite_storage_buffers = aReadWriteStorageBufferCount;
+  pipelineCreateInfo.num_uniform_buffers = aUniformBufferCount;
+  pipelineCreateInfo.threadcount_x = aThreadCountX;
+  pipelineCreateInfo.threadcount_y = aThreadCountY;
+  pipelineCreateInfo.threadcount_z = aThreadCountZ;
+  pipelineCreateInfo.props = properties;
+
+  SDL_GPUComputePipeline* pipeline = SDL_CreateGPUComputePipeline(gContext.mDevice, &pipelineCreateInfo);
+  SDL_DestroyProperties(properties);
+
+  SDL_free(fileData);
+  SDL_assert(pipeline);
+
+  return pipeline;
+}
+
+SDL_GPUBuffer* CreateGPUBuffer(Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+{
+  SDL_GPUBufferCreateInfo createInfo;
+
+  // Like the rest of the Create functions, these run on the upload worker as well as the render
+  // thread, so each call names its object through properties of its own.
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_BUFFER_CREATE_NAME_STRING, aName);
+  createInfo.props = properties;
+  createInfo.size = aSize;
+  createInfo.usage = aUsage;
+
+  SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer(gContext.mDevice, &createInfo);
+  SDL_DestroyProperties(properties);
+  SDL_assert(buffer);
+
+  return buffer;
+}
+
+SDL_GPUTransferBuffer* CreateTransferBuffer(Uint32 aSize, SDL_GPUTransferBufferUsage aUsage, const char* aName)
+{
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_TRANSFERBUFFER_CREATE_NAME_STRING, aName);
+
+  SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
+  SDL_zero(transferBufferCreateInfo);
+  transferBufferCreateInfo.props = properties;
+  transferBufferCreateInfo.size = aSize;
+  transferBufferCreateInfo.usage = aUsage;
+
+  SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(gContext.mDevice, &transferBufferCreateInfo);
+  SDL_DestroyProperties(properties);
+  SDL_assert(transferBuffer);
+
+  return transferBuffer;
+}
+
+SDL_GPUTexture* CreateTexture(Uint32 aWidth, Uint32 aHeight, Uint32 layers_or_depth, Uint32 levels, SDL_GPUTextureUsageFlags aUsage, SDL_GPUTextureFormat aFormat, const char* aName)
+{
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_TEXTURE_CREATE_NAME_STRING, aName);
+
+  SDL_GPUTextureCreateInfo textureCreateInfo;
+  SDL_zero(textureCreateInfo);
+  textureCreateInfo.width = aWidth;
+  textureCreateInfo.height = aHeight;
+  textureCreateInfo.layer_count_or_depth = layers_or_depth;
+  textureCreateInfo.num_levels = levels;
+  textureCreateInfo.usage = aUsage;
+  textureCreateInfo.format = aFormat;
+  textureCreateInfo.props = properties;
+
+  SDL_GPUTexture* texture = SDL_CreateGPUTexture(gContext.mDevice, &textureCreateInfo);
+  SDL_DestroyProperties(properties);
+  return texture;
+}
+
+//////////////////////////////////////////////////////
+// Upload Batch
+// Collects any number of buffer and texture uploads and submits them as one copy pass. The staging
+// memory is a chain of mapped transfer buffers, each twice the size of the last, and once the batch
+// is recorded they're collapsed into a single transfer buffer big enough for the whole batch. That
+// one is kept and cycled when mapped again, so a batch that's reused doesn't allocate at all.
+// Transfer buffers are only created once something is allocated from them.
+
+UploadBatch CreateUploadBatch(Uint32 aInitialSize)
+{
+  UploadBatch batch;
+  SDL_zero(batch);
+
+  batch.mBlocksCapacity = 4;
+  batch.mBlocks = (UploadBlock*)SDL_calloc(batch.mBlocksCapacity, sizeof(UploadBlock));
+
+  batch.mBlocks[0].mSize = SDL_max(aInitialSize, 64 * 1024);
+  batch.mBlocksCount = 1;
+
+  return batch;
+}
+
+UploadAllocation AllocateUpload(UploadBatch* aBatch, Uint32 aSize)
+{
+  UploadBlock* block = &aBatch->mBlocks[aBatch->mBlocksCount - 1];
+  Uint32 offset = (block->mUsed + cUploadAlignment - 1) & ~(cUploadAlignment - 1);
+
+  if (offset + aSize > block->mSize && !block->mTransferBuffer) {
+    // Nothing has been written to this one yet, so it can just be made bigger.
+    block->mSize = SDL_max(block->mSize * 2, aSize);
+  }
+  else if (offset + aSize > block->mSize) {
+    Uint32 size = SDL_max(block->mSize * 2, aSize);
+
+    if (aBatch->mBlocksCount == aBatch->mBlocksCapacity) {
+      aBatch->mBlocksCapacity *= 2;
+      aBatch->mBlocks = (UploadBlock*)SDL_realloc(aBatch->mBlocks, aBatch->mBlocksCapacity * sizeof(UploadBlock));
+    }
+
+    block = &aBatch->mBlocks[aBatch->mBlocksCount++];
+    SDL_zerop(block);
+    block->mSize = size;
+    offset = 0;
+  }
+
+  if (!block->mTransferBuffer) {
+    block->mTransferBuffer = CreateTransferBuffer(block->mSize, SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, "UploadBatch Staging");
+  }
+
+  // The kept block may still be in use by the GPU from the last submit, so it's cycled.
+  if (!block->mMapped) {
+    block->mMapped = (Uint8*)SDL_MapGPUTransferBuffer(gContext.mDevice, block->mTransferBuffer, true);
+    SDL_assert(block->mMapped);
+  }
+
+  block->mUsed = offset + aSize;
+
+  UploadAllocation allocation;
+  allocation.mData = block->mMapped + offset;
+  allocation.mTransferBuffer = block->mTransferBuffer;
+  allocation.mOffset = offset;
+  return allocation;
+}
+
+UploadCopy* PushUploadCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset)
+{
+  if (aBatch->mCopiesCount == aBatch->mCopiesCapacity) {
+    aBatch->mCopiesCapacity = SDL_max(aBatch->mCopiesCapacity * 2, 16);
+    aBatch->mCopies = (UploadCopy*)SDL_realloc(aBatch->mCopies, aBatch->mCopiesCapacity * sizeof(UploadCopy));
+  }
+
+  UploadCopy* copy = &aBatch->mCopies[aBatch->mCopiesCount++];
+  SDL_zerop(copy);
+  copy->mTransferBuffer = aSource->mTransferBuffer;
+  copy->mTransferOffset = aSource->mOffset + aSourceOffset;
+  return copy;
+}
+
+// Copies aSize bytes, starting aSourceOffset bytes into aSource, to aBuffer at aBufferOffset.
+void QueueBufferCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset, SDL_GPUBuffer* aBuffer, Uint32 aBufferOffset, Uint32 aSize)
+{
+  UploadCopy* copy = PushUploadCopy(aBatch, aSource, aSourceOffset);
+  copy->mBuffer = aBuffer;
+  copy->mBufferOffset = aBufferOffset;
+  copy->mSize = aSize;
+}
+
+// The pixels are expected to be tightly packed, aRegion->w by aRegion->h.
+void QueueTextureCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset, const SDL_GPUTextureRegion* aRegion)
+{
+  UploadCopy* copy = PushUploadCopy(aBatch, aSource, aSourceOffset);
+  copy->mTextureRegion = *aRegion;
+}
+
+// Fills in every level below the first from it, after the batch's copies. aTexture needs
+// SDL_GPU_TEXTUREUSAGE_COLOR_TARGET as well as SAMPLER.
+void QueueTextureMipmaps(UploadBatch* aBatch, SDL_GPUTexture* aTexture)
+{
+  if (aBatch->mMipmapTexturesCount == aBatch->mMipmapTexturesCapacity) {
+    aBatch->mMipmapTexturesCapacity = SDL_max(aBatch->mMipmapTexturesCapacity * 2, 4);
+    aBatch->mMipmapTextures = (SDL_GPUTexture**)SDL_realloc(aBatch->mMipmapTextures, aBatch->mMipmapTexturesCapacity * sizeof(SDL_GPUTexture*));
+  }
+
+  aBatch->mMipmapTextures[aBatch->mMipmapTexturesCount++] = aTexture;
+}
+
+void UploadToBuffer(UploadBatch* aBatch, SDL_GPUBuffer* aBuffer, Uint32 aOffset, const void* aData, Uint32 aSize)
+{
+  UploadAllocation allocation = AllocateUpload(aBatch, aSize);
+  SDL_memcpy(allocation.mData, aData, aSize);
+  QueueBufferCopy(aBatch, &allocation, 0, aBuffer, aOffset, aSize);
+}
+
+// Records every queued copy into aCopyPass and readies the batch to be filled again.
+void RecordUploadBatch(UploadBatch* aBatch, SDL_GPUCopyPass* aCopyPass)
+{
+  Uint32 totalSize = 0;
+  Uint32 totalCapacity = 0;
+  for (size_t i = 0; i < aBatch->mBlocksCount; ++i) {
+    UploadBlock* block = &aBatch->mBlocks[i];
+    if (block->mMapped) {
+      SDL_UnmapGPUTransferBuffer(gContext.mDevice, block->mTransferBuffer);
+      block->mMapped = NULL;
+    }
+    totalSize += block->mUsed;
+    totalCapacity += block->mSize;
+  }
+
+  for (size_t i = 0; i < aBatch->mCopiesCount; ++i) {
+    const UploadCopy* copy = &aBatch->mCopies[i];
+
+    if (copy->mBuffer) {
+      SDL_GPUTransferBufferLocation source;
+      source.transfer_buffer = copy->mTransferBuffer;
+      source.offset = copy->mTransferOffset;
+
+      SDL_GPUBufferRegion destination;
+      destination.buffer = copy->mBuffer;
+      destination.offset = copy->mBufferOffset;
+      destination.size = copy->mSize;
+
+      SDL_UploadToGPUBuffer(aCopyPass, &source, &destination, copy->mCycle);
+    }
+    else {
+      SDL_GPUTextureTransferInfo source;
+      SDL_zero(source);
+      source.transfer_buffer = copy->mTransferBuffer;
+      source.offset = copy->mTransferOffset;
+      source.pixels_per_row = copy->mTextureRegion.w;
+      source.rows_per_layer = copy->mTextureRegion.h;
+
+      SDL_UploadToGPUTexture(aCopyPass, &source, &copy->mTextureRegion, false);
+    }
+  }
+
+  aBatch->mSubmittedBytes += totalSize;
+  aBatch->mSubmittedCopies += (Uint32)aBatch->mCopiesCount;
+  aBatch->mCopiesCount = 0;
+
+  // The released transfer buffers stay alive until the GPU is done with them. Next time around the
+  // whole batch fits in one, with the same headroom the chain had.
+  if (aBatch->mBlocksCount > 1) {
+    for (size_t i = 0; i < aBatch->mBlocksCount; ++i) {
+      if (aBatch->mBlocks[i].mTransferBuffer) {
+        SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aBatch->mBlocks[i].mTransferBuffer);
+      }
+    }
+
+    SDL_zerop(&aBatch->mBlocks[0]);
+    aBatch->mBlocks[0].mSize = totalCapacity;
+    aBatch->mBlocksCount = 1;
+  }
+
+  aBatch->mBlocks[0].mUsed = 0;
+}
+
+// Blits each queued texture's top level down its mip chain, has to be recorded after the copy
+// pass that uploaded them has ended.
+void GenerateUploadBatchMipmaps(UploadBatch* aBatch, SDL_GPUCommandBuffer* aCommandBuffer)
+{
+  for (size_t i = 0; i < aBatch->mMipmapTexturesCount; ++i) {
+    SDL_GenerateMipmapsForGPUTexture(aCommandBuffer, aBatch->mMipmapTextures[i]);
+  }
+
+  aBatch->mMipmapTexturesCount = 0;
+}
+
+// Records the batch into its own command buffer and submits it, the returned fence must be
+// released with SDL_ReleaseGPUFence.
+SDL_GPUFence* SubmitUploadBatch(UploadBatch* aBatch)
+{
+  SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
+  SDL_assert(commandBuffer);
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+  SDL_assert(copyPass);
+
+  RecordUploadBatch(aBatch, copyPass);
+
+  SDL_EndGPUCopyPass(copyPass);
+  GenerateUploadBatchMipmaps(aBatch, commandBuffer);
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(commandBuffer);
+  SDL_assert(fence);
+
+  return fence;
+}
+
+void DestroyUploadBatch(UploadBatch* aBatch)
+{
+  for (size_t i = 0; i < aBatch->mBlocksCount; ++i) {
+    if (!aBatch->mBlocks[i].mTransferBuffer) {
+      continue;
+    }
+
+    if (aBatch->mBlocks[i].mMapped) {
+      SDL_UnmapGPUTransferBuffer(gContext.mDevice, aBatch->mBlocks[i].mTransferBuffer);
+    }
+    SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aBatch->mBlocks[i].mTransferBuffer);
+  }
+
+  SDL_free(aBatch->mBlocks);
+  SDL_free(aBatch->mCopies);
+  SDL_free(aBatch->mMipmapTextures);
+  SDL_zerop(aBatch);
+}
+
+SDL_GPUBuffer* CreateAndUploadBufferBatched(UploadBatch* aBatch, const void* aData, Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+{
+  SDL_GPUBuffer* buffer = CreateGPUBuffer(aSize, aUsage, aName);
+  UploadToBuffer(aBatch, buffer, 0, aData, aSize);
+  return buffer;
+}
+
+//////////////////////////////////////////////////////
+// Compressed Textures
+// DDS and KTX2 files already hold their mips in the format the GPU samples, so they're uploaded
+// as they are. If the device can't sample the format, BC1 through BC5 get decoded to RGBA8 on the
+// CPU instead, which costs the memory back but still draws. BC6H, BC7 and ASTC have no fallback.
+
+// Uncompressed formats count as 1x1 blocks. Returns false for formats neither loader produces.
+bool GetTextureFormatBlock(SDL_GPUTextureFormat aFormat, Uint32* aBlockWidth, Uint32* aBlockHeight, Uint32* aBlockSize)
+{
+  Uint32 width = 4;
+  Uint32 height = 4;
+  Uint32 size = 16;
+
+  switch (aFormat) {
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB: width = 1; height = 1; size = 4; break;
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM: size = 8; break;
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC6H_RGB_FLOAT:
+    case SDL_GPU_TEXTUREFORMAT_BC6H_RGB_UFLOAT:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB: break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_4x4_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_4x4_UNORM_SRGB: break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_5x4_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_5x4_UNORM_SRGB: width = 5; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_5x5_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_5x5_UNORM_SRGB: width = 5; height = 5; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_6x5_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_6x5_UNORM_SRGB: width = 6; height = 5; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_6x6_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_6x6_UNORM_SRGB: width = 6; height = 6; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x5_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x5_UNORM_SRGB: width = 8; height = 5; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x6_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x6_UNORM_SRGB: width = 8; height = 6; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_8x8_UNORM_SRGB: width = 8; height = 8; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x5_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x5_UNORM_SRGB: width = 10; height = 5; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x6_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x6_UNORM_SRGB: width = 10; height = 6; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x8_UNORM_SRGB: width = 10; height = 8; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x10_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_10x10_UNORM_SRGB: width = 10; height = 10; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_12x10_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_12x10_UNORM_SRGB: width = 12; height = 10; break;
+    case SDL_GPU_TEXTUREFORMAT_ASTC_12x12_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_ASTC_12x12_UNORM_SRGB: width = 12; height = 12; break;
+    default: return false;
+  }
+
+  *aBlockWidth = width;
+  *aBlockHeight = height;
+  *aBlockSize = size;
+  return true;
+}
+
+Uint32 GetTextureLevelSize(SDL_GPUTextureFormat aFormat, Uint32 aWidth, Uint32 aHeight)
+{
+  Uint32 blockWidth, blockHeight, blockSize;
+  if (!GetTextureFormatBlock(aFormat, &blockWidth, &blockHeight, &blockSize)) {
+    return 0;
+  }
+
+  return ((aWidth + blockWidth - 1) / blockWidth) * ((aHeight + blockHeight - 1) / blockHeight) * blockSize;
+}
+
+// What DecodeTextureLevel turns aFormat into, SDL_GPU_TEXTUREFORMAT_INVALID if it can't.
+SDL_GPUTextureFormat GetTextureDecodeFormat(SDL_GPUTextureFormat aFormat)
+{
+  switch (aFormat) {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+    default: return SDL_GPU_TEXTUREFORMAT_INVALID;
+  }
+}
+
+Uint32 ReadU32(const Uint8* aData)
+{
+  return (Uint32)aData[0] | ((Uint32)aData[1] << 8) | ((Uint32)aData[2] << 16) | ((Uint32)aData[3] << 24);
+}
+
+Uint64 ReadU64(const Uint8* aData)
+{
+  return (Uint64)ReadU32(aData) | ((Uint64)ReadU32(aData + 4) << 32);
+}
+
+#define MAKE_FOURCC(a, b, c, d) ((Uint32)(a) | ((Uint32)(b) << 8) | ((Uint32)(c) << 16) | ((Uint32)(d) << 24))
+
+SDL_GPUTextureFormat DxgiFormatToSDL(Uint32 aFormat)
+{
+  switch (aFormat) {
+    case 28: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    case 29: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+    case 71: return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    case 72: return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB;
+    case 74: return SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM;
+    case 75: return SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB;
+    case 77: return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    case 78: return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB;
+    case 80: return SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM;
+    case 83: return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+    case 95: return SDL_GPU_TEXTUREFORMAT_BC6H_RGB_UFLOAT;
+    case 96: return SDL_GPU_TEXTUREFORMAT_BC6H_RGB_FLOAT;
+    case 98: return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+    case 99: return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB;
+    default: return SDL_GPU_TEXTUREFORMAT_INVALID;
+  }
+}
+
+SDL_GPUTextureFormat VkFormatToSDL(Uint32 aFormat)
+{
+  switch (aFormat) {
+    case 37: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    case 43: return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+    case 131:
+    case 133: return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    case 132:
+    case 134: return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB;
+    case 135: return SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM;
+    case 136: return SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB;
+    case 137: return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    case 138: return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB;
+    case 139: return SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM;
+    case 141: return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+    case 143: return SDL_GPU_TEXTUREFORMAT_BC6H_RGB_UFLOAT;
+    case 144: return SDL_GPU_TEXTUREFORMAT_BC6H_RGB_FLOAT;
+    case 145: return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+    case 146: return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB;
+    case 157: return SDL_GPU_TEXTUREFORMAT_ASTC_4x4_UNORM;
+    case 158: return SDL_GPU_TEXTUREFORMAT_ASTC_4x4_UNORM_SRGB;
+    case 159: return SDL_GPU_TEXTUREFORMAT_ASTC_5x4_UNORM;
+    case 160: return SDL_GPU_TEXTUREFORMAT_ASTC_5x4_UNORM_SRGB;
+    case 161: return SDL_GPU_TEXTUREFORMAT_ASTC_5x5_UNORM;
+    case 162: return SDL_GPU_TEXTUREFORMAT_ASTC_5x5_UNORM_SRGB;
+    case 163: return SDL_GPU_TEXTUREFORMAT_ASTC_6x5_UNORM;
+    case 164: return SDL_GPU_TEXTUREFORMAT_ASTC_6x5_UNORM_SRGB;
+    case 165: return SDL_GPU_TEXTUREFORMAT_ASTC_6x6_UNORM;
+    case 166: return SDL_GPU_TEXTUREFORMAT_ASTC_6x6_UNORM_SRGB;
+    case 167: return SDL_GPU_TEXTUREFORMAT_ASTC_8x5_UNORM;
+    case 168: return SDL_GPU_TEXTUREFORMAT_ASTC_8x5_UNORM_SRGB;
+    case 169: return SDL_GPU_TEXTUREFORMAT_ASTC_8x6_UNORM;
+    case 170: return SDL_GPU_TEXTUREFORMAT_ASTC_8x6_UNORM_SRGB;
+    case 171: return SDL_GPU_TEXTUREFORMAT_ASTC_8x8_UNORM;
+    case 172: return SDL_GPU_TEXTUREFORMAT_ASTC_8x8_UNORM_SRGB;
+    case 173: return SDL_GPU_TEXTUREFORMAT_ASTC_10x5_UNORM;
+    case 174: return SDL_GPU_TEXTUREFORMAT_ASTC_10x5_UNORM_SRGB;
+    case 175: return SDL_GPU_TEXTUREFORMAT_ASTC_10x6_UNORM;
+    case 176: return SDL_GPU_TEXTUREFORMAT_ASTC_10x6_UNORM_SRGB;
+    case 177: return SDL_GPU_TEXTUREFORMAT_ASTC_10x8_UNORM;
+    case 178: return SDL_GPU_TEXTUREFORMAT_ASTC_10x8_UNORM_SRGB;
+    case 179: return SDL_GPU_TEXTUREFORMAT_ASTC_10x10_UNORM;
+    case 180: return SDL_GPU_TEXTUREFORMAT_ASTC_10x10_UNORM_SRGB;
+    case 181: return SDL_GPU_TEXTUREFORMAT_ASTC_12x10_UNORM;
+    case 182: return SDL_GPU_TEXTUREFORMAT_ASTC_12x10_UNORM_SRGB;
+    case 183: return SDL_GPU_TEXTUREFORMAT_ASTC_12x12_UNORM;
+    case 184: return SDL_GPU_TEXTUREFORMAT_ASTC_12x12_UNORM_SRGB;
+    default: return SDL_GPU_TEXTUREFORMAT_INVALID;
+  }
+}
+
+// Points each level of aFile at its data, checking that all of it is actually in the file.
+bool SetTextureFileLevel(TextureFile* aFile, Uint32 aLevel, Uint64 aOffset, Uint64 aSize, size_t aFileSize)
+{
+  Uint32 expected = GetTextureLevelSize(aFile->mFormat, SDL_max(aFile->mWidth >> aLevel, 1), SDL_max(aFile->mHeight >> aLevel, 1));
+  if (aSize < expected || aOffset > aFileSize || aFileSize - aOffset < expected) {
+    return false;
+  }
+
+  aFile->mLevels[aLevel] = (const Uint8*)aFile->mFileData + aOffset;
+  aFile->mLevelSizes[aLevel] = expected;
+  return true;
+}
+
+// Only plain 2D textures, no arrays, cubemaps or volumes.
+bool ParseDDS(TextureFile* aFile, size_t aFileSize)
+{
+  const Uint8* data = (const Uint8*)aFile->mFileData;
+  if (aFileSize < 128 || ReadU32(data) != MAKE_FOURCC('D', 'D', 'S', ' ')) {
+    return false;
+  }
+
+  aFile->mHeight = ReadU32(data + 12);
+  aFile->mWidth = ReadU32(data + 16);
+  aFile->mLevelsCount = SDL_clamp(ReadU32(data + 28), 1, SDL_arraysize(aFile->mLevels));
+
+  Uint32 pixelFormatFlags = ReadU32(data + 80);
+  Uint32 fourCC = ReadU32(data + 84);
+  Uint32 caps2 = ReadU32(data + 112);
+  size_t dataOffset = 128;
+
+  // Cubemap or volume.
+  if (caps2 & 0x00200200) {
+    return false;
+  }
+
+  if (pixelFormatFlags & 0x4) {
+    switch (fourCC) {
+      case MAKE_FOURCC('D', 'X', 'T', '1'): aFile->mFormat = SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM; break;
+      case MAKE_FOURCC('D', 'X', 'T', '3'): aFile->mFormat = SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM; break;
+      case MAKE_FOURCC('D', 'X', 'T', '5'): aFile->mFormat = SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM; break;
+      case MAKE_FOURCC('A', 'T', 'I', '1'):
+      case MAKE_FOURCC('B', 'C', '4', 'U'): aFile->mFormat = SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM; break;
+      case MAKE_FOURCC('A', 'T', 'I', '2'):
+      case MAKE_FOURCC('B', 'C', '5', 'U'): aFile->mFormat = SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM; break;
+      case MAKE_FOURCC('D', 'X', '1', '0'): {
+        if (aFileSize < 148) {
+          return false;
+        }
+
+        Uint32 dimension = ReadU32(data + 132);
+        Uint32 arraySize = ReadU32(data + 140);
+        if (dimension != 3 || arraySize > 1) {
+          return false;
+        }
+
+        aFile->mFormat = DxgiFormatToSDL(ReadU32(data + 128));
+        dataOffset = 148;
+        break;
+      }
+      default: return false;
+    }
+  }
+  else if ((pixelFormatFlags & 0x40) && ReadU32(data + 88) == 32 && ReadU32(data + 92) == 0x000000FF && ReadU32(data + 96) == 0x0000FF00 && ReadU32(data + 100) == 0x00FF0000) {
+    aFile->mFormat = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+  }
+  else {
+    return false;
+  }
+
+  if (aFile->mFormat == SDL_GPU_TEXTUREFORMAT_INVALID) {
+    return false;
+  }
+
+  // The levels follow each other, biggest first.
+  Uint64 offset = dataOffset;
+  for (Uint32 level = 0; level < aFile->mLevelsCount; ++level) {
+    if (!SetTextureFileLevel(aFile, level, offset, aFileSize - SDL_min(offset, aFileSize), aFileSize)) {
+      return false;
+    }
+    offset += aFile->mLevelSizes[level];
+  }
+
+  return true;
+}
+
+// Only plain 2D textures without supercompression, so no Basis Universal or Zstandard.
+bool ParseKTX2(TextureFile* aFile, size_t aFileSize)
+{
+  static const Uint8 cIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+  const Uint8* data = (const Uint8*)aFile->mFileData;
+  if (aFileSize < 80 || SDL_memcmp(data, cIdentifier, sizeof(cIdentifier)) != 0) {
+    return false;
+  }
+
+  Uint32 vkFormat = ReadU32(data + 12);
+  aFile->mWidth = ReadU32(data + 20);
+  aFile->mHeight = ReadU32(data + 24);
+  Uint32 depth = ReadU32(data + 28);
+  Uint32 layers = ReadU32(data + 32);
+  Uint32 faces = ReadU32(data + 36);
+  Uint32 levels = ReadU32(data + 40);
+  Uint32 supercompression = ReadU32(data + 44);
+
+  if (depth > 1 || layers > 1 || faces != 1 || supercompression != 0) {
+    return false;
+  }
+
+  aFile->mFormat = VkFormatToSDL(vkFormat);
+  if (aFile->mFormat == SDL_GPU_TEXTUREFORMAT_INVALID) {
+    return false;
+  }
+
+  // Zero levels asks for them to be generated, which we can't do for block compressed formats.
+  aFile->mLevelsCount = SDL_clamp(levels, 1, SDL_arraysize(aFile->mLevels));
+  if ((Uint64)80 + (Uint64)aFile->mLevelsCount * 24 > aFileSize) {
+    return false;
+  }
+
+  for (Uint32 level = 0; level < aFile->mLevelsCount; ++level) {
+    const Uint8* entry = data + 80 + level * 24;
+    if (!SetTextureFileLevel(aFile, level, ReadU64(entry), ReadU64(entry + 8), aFileSize)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Fills 16 RGBA8 texels from a BC1 color block. BC2 and BC3 always use the four color mode.
+void DecodeBC1Block(const Uint8* aBlock, Uint8* aTexels, bool aAlwaysFourColors)
+{
+  Uint32 endpoints[2] = { (Uint32)(aBlock[0] | (aBlock[1] << 8)), (Uint32)(aBlock[2] | (aBlock[3] << 8)) };
+  Uint8 palette[4][4];
+
+  for (int i = 0; i < 2; ++i) {
+    Uint32 r = (endpoints[i] >> 11) & 31;
+    Uint32 g = (endpoints[i] >> 5) & 63;
+    Uint32 b = endpoints[i] & 31;
+    palette[i][0] = (Uint8)((r << 3) | (r >> 2));
+    palette[i][1] = (Uint8)((g << 2) | (g >> 4));
+    palette[i][2] = (Uint8)((b << 3) | (b >> 2));
+    palette[i][3] = 255;
+  }
+
+  bool fourColors = aAlwaysFourColors || endpoints[0] > endpoints[1];
+  for (int c = 0; c < 3; ++c) {
+    if (fourColors) {
+      palette[2][c] = (Uint8)((2 * palette[0][c] + palette[1][c]) / 3);
+      palette[3][c] = (Uint8)((palette[0][c] + 2 * palette[1][c]) / 3);
+    }
+    else {
+      palette[2][c] = (Uint8)((palette[0][c] + palette[1][c]) / 2);
+      palette[3][c] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = fourColors ? 255 : 0;
+
+  Uint32 indices = ReadU32(aBlock + 4);
+  for (int i = 0; i < 16; ++i) {
+    SDL_memcpy(aTexels + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+  }
+}
+
+// The BC3 alpha block, also the single channel of BC4 and both channels of BC5. Writes every
+// aStride bytes starting at aOutput.
+void DecodeBC4Block(const Uint8* aBlock, Uint8* aOutput, int aStride)
+{
+  Uint32 values[8];
+  values[0] = aBlock[0];
+  values[1] = aBlock[1];
+
+  if (values[0] > values[1]) {
+    for (Uint32 i = 1; i < 7; ++i) {
+      values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+    }
+  }
+  else {
+    for (Uint32 i = 1; i < 5; ++i) {
+      values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+    }
+    values[6] = 0;
+    values[7] = 255;
+  }
+
+  Uint64 indices = 0;
+  for (int i = 0; i < 6; ++i) {
+    indices |= (Uint64)aBlock[2 + i] << (8 * i);
+  }
+
+  for (int i = 0; i < 16; ++i) {
+    aOutput[i * aStride] = (Uint8)values[(indices >> (3 * i)) & 7];
+  }
+}
+
+void DecodeBlock(SDL_GPUTextureFormat aFormat, const Uint8* aBlock, Uint8* aTexels)
+{
+  switch (aFormat) {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB: {
+      DecodeBC1Block(aBlock, aTexels, false);
+      break;
+    }
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB: {
+      DecodeBC1Block(aBlock + 8, aTexels, true);
+      for (int i = 0; i < 16; ++i) {
+        Uint8 alpha = (aBlock[i / 2] >> (4 * (i & 1))) & 15;
+        aTexels[i * 4 + 3] = (Uint8)(alpha * 17);
+      }
+      break;
+    }
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB: {
+      DecodeBC1Block(aBlock + 8, aTexels, true);
+      DecodeBC4Block(aBlock, aTexels + 3, 4);
+      break;
+    }
+    case SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM: {
+      for (int i = 0; i < 16; ++i) {
+        aTexels[i * 4 + 1] = 0;
+        aTexels[i * 4 + 2] = 0;
+        aTexels[i * 4 + 3] = 255;
+      }
+
+      DecodeBC4Block(aBlock, aTexels, 4);
+      if (aFormat == SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM) {
+        DecodeBC4Block(aBlock + 8, aTexels + 1, 4);
+      }
+      break;
+    }
+    default: SDL_assert(false); break;
+  }
+}
+
+// Decodes a whole level of a format GetTextureDecodeFormat accepts into tightly packed RGBA8.
+void DecodeTextureLevel(SDL_GPUTextureFormat aFormat, const Uint8* aSource, Uint32 aWidth, Uint32 aHeight, Uint8* aDestination)
+{
+  Uint32 blockWidth, blockHeight, blockSize;
+  GetTextureFormatBlock(aFormat, &blockWidth, &blockHeight, &blockSize);
+
+  Uint32 blocksX = (aWidth + 3) / 4;
+  Uint32 blocksY = (aHeight + 3) / 4;
+
+  for (Uint32 by = 0; by < blocksY; ++by) {
+    for (Uint32 bx = 0; bx < blocksX; ++bx) {
+      Uint8 texels[16 * 4];
+      DecodeBlock(aFormat, aSource + (by * blocksX + bx) * blockSize, texels);
+
+      // Blocks hanging off the edge of small levels only write what's inside it.
+      for (Uint32 y = 0; y < 4 && by * 4 + y < aHeight; ++y) {
+        Uint32 width = SDL_min(4, aWidth - bx * 4);
+        SDL_memcpy(aDestination + ((by * 4 + y) * aWidth + bx * 4) * 4, texels + y * 16, width * 4);
+      }
+    }
+  }
+}
+
+// Takes ownership of aFileData, which has to stay alive as long as aFile.
+bool ParseTextureFile(TextureFile* aFile, void* aFileData, size_t aFileSize)
+{
+  SDL_zerop(aFile);
+  aFile->mFileData = aFileData;
+  return ParseDDS(aFile, aFileSize) || ParseKTX2(aFile, aFileSize);
+}
+
+void DestroyTextureFile(TextureFile* aFile)
+{
+  SDL_free(aFile->mFileData);
+  SDL_zerop(aFile);
+}
+
+// Uploads every level the file has, there's no generating mipmaps for block compressed formats.
+SDL_GPUTexture* CreateAndUploadTextureFileBatched(UploadBatch* aBatch, const TextureFile* aFile, const char* aName)
+{
+  SDL_GPUTextureFormat format = aFile->mFormat;
+  bool decode = !SDL_GPUTextureSupportsFormat(gContext.mDevice, format, SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER);
+
+  if (decode) {
+    format = GetTextureDecodeFormat(aFile->mFormat);
+    if (format == SDL_GPU_TEXTUREFORMAT_INVALID) {
+      SDL_Log("%s: format %d isn't supported by this device and can't be decoded", aName, (int)aFile->mFormat);
+      return NULL;
+    }
+  }
+
+  SDL_GPUTexture* texture = CreateTexture(aFile->mWidth, aFile->mHeight, 1, aFile->mLevelsCount, SDL_GPU_TEXTUREUSAGE_SAMPLER, format, aName);
+  SDL_assert(texture);
+
+  Uint32 totalSize = 0;
+  Uint32 uncompressedSize = 0;
+  for (Uint32 level = 0; level < aFile->mLevelsCount; ++level) {
+    Uint32 width = SDL_max(aFile->mWidth >> level, 1);
+    Uint32 height = SDL_max(aFile->mHeight >> level, 1);
+    Uint32 size = decode ? width * height * 4 : aFile->mLevelSizes[level];
+
+    UploadAllocation allocation = AllocateUpload(aBatch, size);
+    if (decode) {
+      DecodeTextureLevel(aFile->mFormat, aFile->mLevels[level], width, height, allocation.mData);
+    }
+    else {
+      SDL_memcpy(allocation.mData, aFile->mLevels[level], size);
+    }
+
+    SDL_GPUTextureRegion textureRegion;
+    SDL_zero(textureRegion);
+    textureRegion.texture = texture;
+    textureRegion.mip_level = level;
+    textureRegion.w = width;
+    textureRegion.h = height;
+    textureRegion.d = 1;
+
+    QueueTextureCopy(aBatch, &allocation, 0, &textureRegion);
+    totalSize += size;
+    uncompressedSize += width * height * 4;
+  }
+
+  SDL_Log("%s: %ux%u, %u levels, %u bytes against %u as RGBA8%s", aName, aFile->mWidth, aFile->mHeight, aFile->mLevelsCount, totalSize, uncompressedSize, decode ? ", decoded on the CPU" : "");
+  return texture;
+}
+
+SDL_GPUTexture* CreateAndUploadCompressedTextureBatched(UploadBatch* aBatch, const char* aTextureName)
+{
+  char stringBuffer[4096];
+  SDL_snprintf(stringBuffer, SDL_arraysize(stringBuffer), "Assets/Images/%s", aTextureName);
+
+  size_t fileSize = 0;
+  void* fileData = SDL_LoadFile(stringBuffer, &fileSize);
+  if (!fileData) {
+    SDL_Log("Failed to load %s: %s", stringBuffer, SDL_GetError());
+    return NULL;
+  }
+
+  TextureFile file;
+  SDL_GPUTexture* texture = NULL;
+  if (ParseTextureFile(&file, fileData, fileSize)) {
+    texture = CreateAndUploadTextureFileBatched(aBatch, &file, aTextureName);
+  }
+  else {
+    SDL_Log("%s isn't a DDS or KTX2 file we can load", stringBuffer);
+  }
+
+  DestroyTextureFile(&file);
+  return texture;
+}
+
+// Enough levels to take the larger side all the way down to 1.
+Uint32 GetMipLevelsCount(Uint32 aWidth, Uint32 aHeight)
+{
+  Uint32 size = SDL_max(aWidth, aHeight);
+  Uint32 levels = 1;
+  while (size > 1) {
+    size >>= 1;
+    ++levels;
+  }
+  return levels;
+}
+
+// With aGenerateMipmaps the texture gets a full mip chain, generated when the batch is submitted,
+// or by GenerateUploadBatchMipmaps for batches recorded into someone else's copy pass.
+SDL_GPUTexture* CreateAndUploadTextureBatched(UploadBatch* aBatch, const char* aTextureName, bool aGenerateMipmaps)
+{
+  // These bring their own mips.
+  const char* extension = SDL_strrchr(aTextureName, '.');
+  if (extension && (SDL_strcasecmp(extension, ".dds") == 0 || SDL_strcasecmp(extension, ".ktx2") == 0)) {
+    return CreateAndUploadCompressedTextureBatched(aBatch, aTextureName);
+  }
+
+  char stringBuffer[4096];
+  SDL_snprintf(stringBuffer, SDL_arraysize(stringBuffer), "Assets/Images/%s", aTextureName);
+  SDL_Surface* surface = SDL_LoadSurface(stringBuffer);
+
+  // A missing image still gets a texture, a single white texel, so whatever samples it draws untextured.
+  if (!surface) {
+    SDL_Log("Couldn't load image %s, it will be untextured: %s", stringBuffer, SDL_GetError());
+    surface = SDL_CreateSurface(1, 1, SDL_PIXELFORMAT_RGBA32);
+    SDL_memset(surface->pixels, 0xFF, 4);
+  }
+
+  if (surface->format != SDL_PIXELFORMAT_RGBA32)
+  {
+    SDL_Surface* temp = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(surface);
+    surface = temp;
+  }
+
+  Uint32 levels = aGenerateMipmaps ? GetMipLevelsCount(surface->w, surface->h) : 1;
+
+  // Generating mipmaps blits between the levels, so they need to be usable as color targets.
+  SDL_GPUTextureUsageFlags usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
+  if (levels > 1) {
+    usage |= SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+  }
+
+  SDL_GPUTexture* texture = CreateTexture(surface->w, surface->h, 1, levels, usage, SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, aTextureName);
+  SDL_assert(texture);
+
+  // Rows are packed as we copy them in, so a padded pitch doesn't matter.
+  Uint32 rowSize = surface->w * 4;
+  UploadAllocation allocation = AllocateUpload(aBatch, rowSize * surface->h);
+  for (int y = 0; y < surface->h; ++y) {
+    SDL_memcpy(allocation.mData + (y * rowSize), (Uint8*)surface->pixels + (y * surface->pitch), rowSize);
+  }
+
+  SDL_GPUTextureRegion textureRegion;
+  SDL_zero(textureRegion);
+  textureRegion.texture = texture;
+  textureRegion.w = surface->w;
+  textureRegion.h = surface->h;
+  textureRegion.d = 1;
+
+  QueueTextureCopy(aBatch, &allocation, 0, &textureRegion);
+
+  if (levels > 1) {
+    QueueTextureMipmaps(aBatch, texture);
+  }
+
+  SDL_DestroySurface(surface);
+
+  return texture;
+}
+
+// Recorded into aCopyPass there's nowhere to generate mipmaps, so only a submit of its own gets them.
+SDL_GPUTexture* CreateAndUploadTexture(SDL_GPUCopyPass* aCopyPass, const char* aTextureName) {
+  UploadBatch batch = CreateUploadBatch(0);
+  SDL_GPUTexture* texture = CreateAndUploadTextureBatched(&batch, aTextureName, aCopyPass == NULL);
+
+  if (aCopyPass) {
+    RecordUploadBatch(&batch, aCopyPass);
+  }
+  else {
+    SDL_ReleaseGPUFence(gContext.mDevice, SubmitUploadBatch(&batch));
+  }
+
+  DestroyUploadBatch(&batch);
+  return texture;
+}
+
+SDL_GPUTextureFormat GetSupportedDepthFormat()
+{
+  SDL_GPUTextureFormat possibleFormats[] = {
+    SDL_GPU_TEXTUREFORMAT_D32_FLOAT_S8_UINT,
+    SDL_GPU_TEXTUREFORMAT_D24_UNORM_S8_UINT,
+    SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
+    SDL_GPU_TEXTUREFORMAT_D24_UNORM,
+    SDL_GPU_TEXTUREFORMAT_D16_UNORM,
+  };
+
+  for (size_t i = 0; i < SDL_arraysize(possibleFormats); ++i) {
+    if (SDL_GPUTextureSupportsFormat(gContext.mDevice,
+      possibleFormats[i],
+      SDL_GPU_TEXTURETYPE_2D,
+      SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET))
+    {
+      return possibleFormats[i];
+    }
+  }
+
+  // Didn't find a suitable depth format.
+  SDL_assert(false);
+
+  return SDL_GPU_TEXTUREFORMAT_INVALID;
+}
+
+SDL_GPUBuffer* CreateAndUploadBuffer(const void* aData, Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+{
+  UploadBatch batch = CreateUploadBatch(aSize);
+  SDL_GPUBuffer* buffer = CreateAndUploadBufferBatched(&batch, aData, aSize, aUsage, aName);
+  SDL_ReleaseGPUFence(gContext.mDevice, SubmitUploadBatch(&batch));
+  DestroyUploadBatch(&batch);
+  return buffer;
+}
+
+//////////////////////////////////////////////////////
+// Upload Ring
+// Persistent staging for data that changes every frame. Each of the N frames in flight gets its own
+// slice of staging memory that allocations just bump through, and a fence from the submit that last
+// read it. Coming back around to a slice waits on that fence first, which is counted as a stall, so
+// nothing is written while the GPU could still be copying out of it.
+
+UploadRing CreateUploadRing(Uint32 aFramesCount, Uint32 aFrameSize)
+{
+  UploadRing ring;
+  SDL_zero(ring);
+
+  ring.mFramesCount = aFramesCount;
+  ring.mFrameSize = aFrameSize;
+  ring.mFrames = (UploadRingFrame*)SDL_calloc(aFramesCount, sizeof(UploadRingFrame));
+
+  for (Uint32 i = 0; i < aFramesCount; ++i) {
+    ring.mFrames[i].mTransferBuffer = CreateTransferBuffer(aFrameSize, SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, "UploadRing Frame");
+  }
+
+  // Starts on the last frame so the first BeginUploadRingFrame lands on frame 0.
+  ring.mCurrentFrame = aFramesCount - 1;
+  ring.mBatch = CreateUploadBatch(0);
+
+  return ring;
+}
+
+void BeginUploadRingFrame(UploadRing* aRing)
+{
+  aRing->mCurrentFrame = (aRing->mCurrentFrame + 1) % aRing->mFramesCount;
+  UploadRingFrame* frame = &aRing->mFrames[aRing->mCurrentFrame];
+
+  if (frame->mFence) {
+    if (!SDL_QueryGPUFence(gContext.mDevice, frame->mFence)) {
+      Uint64 stallStart = SDL_GetTicksNS();
+      SDL_WaitForGPUFences(gContext.mDevice, true, &frame->mFence, 1);
+      aRing->mStallNS += SDL_GetTicksNS() - stallStart;
+      ++aRing->mStalls;
+    }
+
+    SDL_ReleaseGPUFence(gContext.mDevice, frame->mFence);
+    frame->mFence = NULL;
+  }
+
+  // The fence says the GPU is done with it, so cycling shouldn't ever need to hand back new memory.
+  aRing->mMapped = (Uint8*)SDL_MapGPUTransferBuffer(gContext.mDevice, frame->mTransferBuffer, true);
+  SDL_assert(aRing->mMapped);
+  aRing->mUsed = 0;
+  ++aRing->mFrameCount;
+}
+
+UploadAllocation AllocateFromUploadRing(UploadRing* aRing, Uint32 aSize)
+{
+  SDL_assert(aRing->mMapped);
+
+  Uint32 offset = (aRing->mUsed + cUploadAlignment - 1) & ~(cUploadAlignment - 1);
+
+  if (offset + aSize > aRing->mFrameSize) {
+    ++aRing->mOverflows;
+    return AllocateUpload(&aRing->mBatch, aSize);
+  }
+
+  aRing->mUsed = offset + aSize;
+  aRing->mPeakUsed = SDL_max(aRing->mPeakUsed, aRing->mUsed);
+
+  UploadAllocation allocation;
+  allocation.mData = aRing->mMapped + offset;
+  allocation.mTransferBuffer = aRing->mFrames[aRing->mCurrentFrame].mTransferBuffer;
+  allocation.mOffset = offset;
+  return allocation;
+}
+
+DynamicBuffer CreateDynamicBuffer(Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+{
+  DynamicBuffer buffer;
+  buffer.mBuffer = CreateGPUBuffer(aSize, aUsage, aName);
+  buffer.mSize = aSize;
+  return buffer;
+}
+
+void DestroyDynamicBuffer(DynamicBuffer* aBuffer)
+{
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aBuffer->mBuffer);
+  SDL_zerop(aBuffer);
+}
+
+// Returns where to write aSize bytes of new contents for aBuffer, starting at aOffset. Rewriting
+// the whole buffer cycles it, so last frame's draws can keep reading the old contents. Partial
+// updates can't cycle, the rest of the buffer would be lost.
+void* UpdateDynamicBuffer(UploadRing* aRing, DynamicBuffer* aBuffer, Uint32 aOffset, Uint32 aSize)
+{
+  SDL_assert(aOffset + aSize <= aBuffer->mSize);
+
+  UploadAllocation allocation = AllocateFromUploadRing(aRing, aSize);
+  UploadCopy* copy = PushUploadCopy(&aRing->mBatch, &allocation, 0);
+  copy->mBuffer = aBuffer->mBuffer;
+  copy->mBufferOffset = aOffset;
+  copy->mSize = aSize;
+  copy->mCycle = aOffset == 0 && aSize == aBuffer->mSize;
+  return allocation.mData;
+}
+
+// Records this frame's copies into a copy pass on aCommandBuffer. Has to happen before any pass
+// that reads the buffers, and outside of them.
+void RecordUploadRingFrame(UploadRing* aRing, SDL_GPUCommandBuffer* aCommandBuffer)
+{
+  if (aRing->mMapped) {
+    SDL_UnmapGPUTransferBuffer(gContext.mDevice, aRing->mFrames[aRing->mCurrentFrame].mTransferBuffer);
+    aRing->mMapped = NULL;
+  }
+
+  if (aRing->mBatch.mCopiesCount == 0) {
+    return;
+  }
+
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(aCommandBuffer);
+  RecordUploadBatch(&aRing->mBatch, copyPass);
+  SDL_EndGPUCopyPass(copyPass);
+}
+
+// Submits the frame's command buffer in place of SDL_SubmitGPUCommandBuffer, keeping its fence to
+// guard this frame's slice.
+bool SubmitUploadRingFrame(UploadRing* aRing, SDL_GPUCommandBuffer* aCommandBuffer)
+{
+  // Copies recorded here would land after the frame's passes, this is only to unmap the slice.
+  SDL_assert(aRing->mBatch.mCopiesCount == 0);
+  RecordUploadRingFrame(aRing, aCommandBuffer);
+
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(aCommandBuffer);
+  aRing->mFrames[aRing->mCurrentFrame].mFence = fence;
+  return fence != NULL;
+}
+
+void DestroyUploadRing(UploadRing* aRing)
+{
+  if (aRing->mMapped) {
+    SDL_UnmapGPUTransferBuffer(gContext.mDevice, aRing->mFrames[aRing->mCurrentFrame].mTransferBuffer);
+  }
+
+  for (Uint32 i = 0; i < aRing->mFramesCount; ++i) {
+    if (aRing->mFrames[i].mFence) {
+      SDL_WaitForGPUFences(gContext.mDevice, true, &aRing->mFrames[i].mFence, 1);
+      SDL_ReleaseGPUFence(gContext.mDevice, aRing->mFrames[i].mFence);
+    }
+    SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aRing->mFrames[i].mTransferBuffer);
+  }
+
+  DestroyUploadBatch(&aRing->mBatch);
+  SDL_free(aRing->mFrames);
+  SDL_zerop(aRing);
+}
+
+//////////////////////////////////////////////////////
+// Buffer Heap
+// A buddy allocator over a few large GPU buffers, so vertex and index data from any number of
+// models can share the same bindings. Every block is a power of two multiple of the smallest block
+// and naturally aligned to its size, so freeing merges a block back with its buddy whenever the
+// buddy is free as well.
+
+Uint32 NextPowerOfTwo(Uint32 aValue)
+{
+  Uint32 value = 1;
+  while (value < aValue) {
+    value <<= 1;
+  }
+  return value;
+}
+
+Uint32 Log2(Uint32 aPowerOfTwo)
+{
+  Uint32 log = 0;
+  while ((1u << log) < aPowerOfTwo) {
+    ++log;
+  }
+  return log;
+}
+
+void PushBufferHeapFreeBlock(BufferHeapPage* aPage, Uint32 aBlock)
+{
+  Uint32* head = &aPage->mFreeLists[aPage->mOrders[aBlock]];
+
+  aPage->mStates[aBlock] = BufferHeapBlockState_Free;
+  aPage->mPrev[aBlock] = cBufferHeapNoBlock;
+  aPage->mNext[aBlock] = *head;
+
+  if (*head != cBufferHeapNoBlock) {
+    aPage->mPrev[*head] = aBlock;
+  }
+
+  *head = aBlock;
+}
+
+void RemoveBufferHeapFreeBlock(BufferHeapPage* aPage, Uint32 aBlock)
+{
+  Uint32 next = aPage->mNext[aBlock];
+  Uint32 prev = aPage->mPrev[aBlock];
+
+  if (prev != cBufferHeapNoBlock) {
+    aPage->mNext[prev] = next;
+  }
+  else {
+    aPage->mFreeLists[aPage->mOrders[aBlock]] = next;
+  }
+
+  if (next != cBufferHeapNoBlock) {
+    aPage->mPrev[next] = prev;
+  }
+}
+
+BufferHeapPage CreateBufferHeapPage(BufferHeap* aHeap, Uint32 aSize)
+{
+  BufferHeapPage page;
+  SDL_zero(page);
+
+  page.mBuffer = CreateGPUBuffer(aSize, aHeap->mUsage, aHeap->mName);
+  page.mSize = aSize;
+  page.mBlocksCount = aSize / cBufferHeapMinBlockSize;
+  page.mMaxOrder = Log2(page.mBlocksCount);
+
+  page.mOrders = (Uint8*)SDL_calloc(page.mBlocksCount, sizeof(Uint8));
+  page.mStates = (Uint8*)SDL_calloc(page.mBlocksCount, sizeof(Uint8));
+  page.mNext = (Uint32*)SDL_malloc(page.mBlocksCount * sizeof(Uint32));
+  page.mPrev = (Uint32*)SDL_malloc(page.mBlocksCount * sizeof(Uint32));
+
+  for (size_t i = 0; i < SDL_arraysize(page.mFreeLists); ++i) {
+    page.mFreeLists[i] = cBufferHeapNoBlock;
+  }
+
+  // The whole page starts out as one free block.
+  page.mOrders[0] = (Uint8)page.mMaxOrder;
+  PushBufferHeapFreeBlock(&page, 0);
+
+  return page;
+}
+
+void DestroyBufferHeapPage(BufferHeapPage* aPage)
+{
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aPage->mBuffer);
+  SDL_free(aPage->mOrders);
+  SDL_free(aPage->mStates);
+  SDL_free(aPage->mNext);
+  SDL_free(aPage->mPrev);
+  SDL_zerop(aPage);
+}
+
+// Returns the first smallest block of the allocation, or cBufferHeapNoBlock if the page is too full.
+Uint32 AllocateBufferHeapBlock(BufferHeapPage* aPage, Uint32 aOrder)
+{
+  Uint32 order = aOrder;
+  while (order <= aPage->mMaxOrder && aPage->mFreeLists[order] == cBufferHeapNoBlock) {
+    ++order;
+  }
+
+  if (order > aPage->mMaxOrder) {
+    return cBufferHeapNoBlock;
+  }
+
+  Uint32 block = aPage->mFreeLists[order];
+  RemoveBufferHeapFreeBlock(aPage, block);
+
+  // Split down to the size we want, the upper half of each split goes back on the free lists.
+  while (order > aOrder) {
+    --order;
+    Uint32 buddy = block + (1u << order);
+    aPage->mOrders[buddy] = (Uint8)order;
+    PushBufferHeapFreeBlock(aPage, buddy);
+  }
+
+  aPage->mOrders[block] = (Uint8)aOrder;
+  aPage->mStates[block] = BufferHeapBlockState_Used;
+  return block;
+}
+
+void FreeBufferHeapBlock(BufferHeapPage* aPage, Uint32 aBlock)
+{
+  Uint32 block = aBlock;
+  Uint32 order = aPage->mOrders[block];
+  aPage->mStates[block] = BufferHeapBlockState_Interior;
+
+  while (order < aPage->mMaxOrder) {
+    Uint32 buddy = block ^ (1u << order);
+    if (aPage->mStates[buddy] != BufferHeapBlockState_Free || aPage->mOrders[buddy] != order) {
+      break;
+    }
+
+    RemoveBufferHeapFreeBlock(aPage, buddy);
+    aPage->mStates[buddy] = BufferHeapBlockState_Interior;
+    block = SDL_min(block, buddy);
+    ++order;
+  }
+
+  aPage->mOrders[block] = (Uint8)order;
+  PushBufferHeapFreeBlock(aPage, block);
+}
+
+// aPageSize is rounded up to a power of two, allocations bigger than it get a page to themselves.
+BufferHeap CreateBufferHeap(Uint32 aPageSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+{
+  BufferHeap heap;
+  SDL_zero(heap);
+  heap.mPageSize = NextPowerOfTwo(SDL_max(aPageSize, cBufferHeapMinBlockSize));
+  heap.mUsage = aUsage;
+  heap.mName = aName;
+  return heap;
+}
+
+BufferHeapAllocation AllocateFromBufferHeap(BufferHeap* aHeap, Uint32 aSize, Uint32 aAlignment)
+{
+  BufferHeapAllocation allocation;
+  SDL_zero(allocation);
+
+  // Blocks are aligned to their own size, so rounding the size up covers the alignment too.
+  Uint32 blockSize = NextPowerOfTwo(SDL_max(SDL_max(aSize, aAlignment), cBufferHeapMinBlockSize));
+  Uint32 order = Log2(blockSize / cBufferHeapMinBlockSize);
+
+  Uint32 block = cBufferHeapNoBlock;
+  size_t pageIndex = 0;
+  for (; pageIndex < aHeap->mPagesCount; ++pageIndex) {
+    BufferHeapPage* page = &aHeap->mPages[pageIndex];
+    if (page->mBuffer && page->mMaxOrder >= order) {
+      block = AllocateBufferHeapBlock(page, order);
+      if (block != cBufferHeapNoBlock) {
+        break;
+      }
+    }
+  }
+
+  if (block == cBufferHeapNoBlock) {
+    // Reuse the slot of a page that was released, the page index is part of every allocation.
+    for (pageIndex = 0; pageIndex < aHeap->mPagesCount; ++pageIndex) {
+      if (!aHeap->mPages[pageIndex].mBuffer) {
+        break;
+      }
+    }
+
+    if (pageIndex == aHeap->mPagesCount) {
+      if (aHeap->mPagesCount == aHeap->mPagesCapacity) {
+        aHeap->mPagesCapacity = SDL_max(aHeap->mPagesCapacity * 2, 4);
+        aHeap->mPages = (BufferHeapPage*)SDL_realloc(aHeap->mPages, aHeap->mPagesCapacity * sizeof(BufferHeapPage));
+      }
+      ++aHeap->mPagesCount;
+    }
+
+    aHeap->mPages[pageIndex] = CreateBufferHeapPage(aHeap, SDL_max(aHeap->mPageSize, blockSize));
+    if (!aHeap->mPages[pageIndex].mBuffer) {
+      return allocation;
+    }
+
+    block = AllocateBufferHeapBlock(&aHeap->mPages[pageIndex], order);
+  }
+
+  BufferHeapPage* page = &aHeap->mPages[pageIndex];
+  page->mAllocatedBytes += blockSize;
+
+  aHeap->mAllocatedBytes += blockSize;
+  aHeap->mRequestedBytes += aSize;
+  ++aHeap->mAllocationsCount;
+
+  allocation.mBuffer = page->mBuffer;
+  allocation.mOffset = block * cBufferHeapMinBlockSize;
+  allocation.mSize = aSize;
+  allocation.mBlockSize = blockSize;
+  allocation.mPage = (Uint32)pageIndex;
+  return allocation;
+}
+
+// Pages that end up empty are released, other than the last one standing.
+void FreeFromBufferHeap(BufferHeap* aHeap, BufferHeapAllocation* aAllocation)
+{
+  if (!aAllocation->mBuffer) {
+    return;
+  }
+
+  BufferHeapPage* page = &aHeap->mPages[aAllocation->mPage];
+  FreeBufferHeapBlock(page, aAllocation->mOffset / cBufferHeapMinBlockSize);
+  page->mAllocatedBytes -= aAllocation->mBlockSize;
+
+  aHeap->mAllocatedBytes -= aAllocation->mBlockSize;
+  aHeap->mRequestedBytes -= aAllocation->mSize;
+  --aHeap->mAllocationsCount;
+
+  if (page->mAllocatedBytes == 0) {
+    size_t livePages = 0;
+    for (size_t i = 0; i < aHeap->mPagesCount; ++i) {
+      livePages += aHeap->mPages[i].mBuffer != NULL;
+    }
+
+    if (livePages > 1) {
+      DestroyBufferHeapPage(page);
+    }
+  }
+
+  SDL_zerop(aAllocation);
+}
+
+BufferHeapStats GetBufferHeapStats(const BufferHeap* aHeap)
+{
+  BufferHeapStats stats;
+  SDL_zero(stats);
+
+  stats.mAllocatedBytes = aHeap->mAllocatedBytes;
+  stats.mRequestedBytes = aHeap->mRequestedBytes;
+  stats.mAllocationsCount = aHeap->mAllocationsCount;
+
+  for (size_t i = 0; i < aHeap->mPagesCount; ++i) {
+    const BufferHeapPage* page = &aHeap->mPages[i];
+    if (!page->mBuffer) {
+      continue;
+    }
+
+    ++stats.mPagesCount;
+    stats.mReservedBytes += page->mSize;
+
+    for (Uint32 order = page->mMaxOrder + 1; order-- > 0;) {
+      if (page->mFreeLists[order] != cBufferHeapNoBlock) {
+        stats.mLargestFreeBlock = SDL_max(stats.mLargestFreeBlock, cBufferHeapMinBlockSize << order);
+        break;
+      }
+    }
+  }
+
+  return stats;
+}
+
+int CompareBufferHeapAllocationsBySize(const void* aLeft, const void* aRight)
+{
+  const BufferHeapAllocation* left = *(const BufferHeapAllocation* const*)aLeft;
+  const BufferHeapAllocation* right = *(const BufferHeapAllocation* const*)aRight;
+
+  if (left->mBlockSize != right->mBlockSize) {
+    return left->mBlockSize > right->mBlockSize ? -1 : 1;
+  }
+  return 0;
+}
+
+// Moves every allocation into new pages, biggest first so the buddies pack with no holes, and
+// records the copies into aCopyPass. aAllocations has to hold every live allocation, they're
+// updated in place, so anything built from their buffers or offsets has to be rebuilt after.
+// Returns false, without touching anything, if it wouldn't free up at least one page.
+bool DefragmentBufferHeap(BufferHeap* aHeap, SDL_GPUCopyPass* aCopyPass, BufferHeapAllocation** aAllocations, size_t aAllocationsCount)
+{
+  SDL_assert(aAllocationsCount == aHeap->mAllocationsCount);
+
+  BufferHeapStats stats = GetBufferHeapStats(aHeap);
+  Uint64 pagesNeeded = SDL_max((aHeap->mAllocatedBytes + aHeap->mPageSize - 1) / aHeap->mPageSize, 1);
+  if (pagesNeeded >= stats.mPagesCount) {
+    return false;
+  }
+
+  BufferHeapAllocation** sorted = (BufferHeapAllocation**)SDL_malloc(aAllocationsCount * sizeof(BufferHeapAllocation*));
+  SDL_memcpy(sorted, aAllocations, aAllocationsCount * sizeof(BufferHeapAllocation*));
+  SDL_qsort(sorted, aAllocationsCount, sizeof(BufferHeapAllocation*), CompareBufferHeapAllocationsBySize);
+
+  BufferHeapPage* oldPages = aHeap->mPages;
+  size_t oldPagesCount = aHeap->mPagesCount;
+
+  aHeap->mPages = NULL;
+  aHeap->mPagesCount = 0;
+  aHeap->mPagesCapacity = 0;
+  aHeap->mAllocatedBytes = 0;
+  aHeap->mRequestedBytes = 0;
+  aHeap->mAllocationsCount = 0;
+
+  for (size_t i = 0; i < aAllocationsCount; ++i) {
+    BufferHeapAllocation* allocation = sorted[i];
+
+    // Asking for the old block size as the alignment lands it in a block of the same size.
+    BufferHeapAllocation moved = AllocateFromBufferHeap(aHeap, allocation->mSize, allocation->mBlockSize);
+    SDL_assert(moved.mBuffer);
+
+    if (allocation->mSize > 0) {
+      SDL_GPUBufferLocation source;
+      source.buffer = allocation->mBuffer;
+      source.offset = allocation->mOffset;
+
+      SDL_GPUBufferLocation destination;
+      destination.buffer = moved.mBuffer;
+      destination.offset = moved.mOffset;
+
+      SDL_CopyGPUBufferToBuffer(aCopyPass, &source, &destination, allocation->mSize, false);
+    }
+
+    *allocation = moved;
+  }
+
+  // Releasing is deferred by SDL until the GPU is done with them, so the copies above are fine.
+  for (size_t i = 0; i < oldPagesCount; ++i) {
+    if (oldPages[i].mBuffer) {
+      DestroyBufferHeapPage(&oldPages[i]);
+    }
+  }
+
+  SDL_free(oldPages);
+  SDL_free(sorted);
+  return true;
+}
+
+void DestroyBufferHeap(BufferHeap* aHeap)
+{
+  for (size_t i = 0; i < aHeap->mPagesCount; ++i) {
+    if (aHeap->mPages[i].mBuffer) {
+      DestroyBufferHeapPage(&aHeap->mPages[i]);
+    }
+  }
+
+  SDL_free(aHeap->mPages);
+  SDL_zerop(aHeap);
+}
+
+//////////////////////////////////////////////////////
+// Upload Worker
+// A thread of its own for loading and uploading, so none of it happens on the frame loop. Jobs run
+// on the worker, filling in its UploadBatch, and each job's batch goes out in its own submit. The
+// render thread only hears about a job once the fence of that submit has signaled, at which point
+// everything the job created is safe to use.
+
+void PushUploadJob(UploadJobQueue* aQueue, const UploadJob* aJob)
+{
+  if (aQueue->mCount == aQueue->mCapacity) {
+    aQueue->mCapacity = SDL_max(aQueue->mCapacity * 2, 8);
+    aQueue->mJobs = (UploadJob*)SDL_realloc(aQueue->mJobs, aQueue->mCapacity * sizeof(UploadJob));
+  }
+
+  aQueue->mJobs[aQueue->mCount++] = *aJob;
+}
+
+// Jobs are run in the order they were queued.
+UploadJob PopUploadJob(UploadJobQueue* aQueue)
+{
+  UploadJob job = aQueue->mJobs[0];
+  --aQueue->mCount;
+  SDL_memmove(aQueue->mJobs, aQueue->mJobs + 1, aQueue->mCount * sizeof(UploadJob));
+  return job;
+}
+
+// Moves every in flight job whose fence has signaled over to the completed queue.
+void RetireUploadJobs(UploadWorker* aWorker)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < aWorker->mInFlight.mCount; ++i) {
+    UploadJob* job = &aWorker->mInFlight.mJobs[i];
+
+    if (job->mFence && !SDL_QueryGPUFence(gContext.mDevice, job->mFence)) {
+      aWorker->mInFlight.mJobs[kept++] = *job;
+      continue;
+    }
+
+    if (job->mFence) {
+      SDL_ReleaseGPUFence(gContext.mDevice, job->mFence);
+      job->mFence = NULL;
+    }
+
+    SDL_LockMutex(aWorker->mMutex);
+    PushUploadJob(&aWorker->mCompleted, job);
+    SDL_UnlockMutex(aWorker->mMutex);
+  }
+
+  aWorker->mInFlight.mCount = kept;
+}
+
+int UploadWorkerThread(void* aUserData)
+{
+  UploadWorker* worker = (UploadWorker*)aUserData;
+
+  for (;;) {
+    SDL_LockMutex(worker->mMutex);
+
+    while (worker->mRunning && worker->mPending.mCount == 0 && worker->mInFlight.mCount == 0) {
+      SDL_WaitCondition(worker->mCondition, worker->mMutex);
+    }
+
+    // Finishes everything it was given before it goes.
+    if (!worker->mRunning && worker->mPending.mCount == 0 && worker->mInFlight.mCount == 0) {
+      SDL_UnlockMutex(worker->mMutex);
+      break;
+    }
+
+    bool hasJob = worker->mPending.mCount != 0;
+    UploadJob job;
+    SDL_zero(job);
+    if (hasJob) {
+      job = PopUploadJob(&worker->mPending);
+    }
+    else {
+      // Only waiting on fences, check back every so often unless more work turns up.
+      SDL_WaitConditionTimeout(worker->mCondition, worker->mMutex, 1);
+    }
+
+    SDL_UnlockMutex(worker->mMutex);
+
+    if (hasJob) {
+      job.mRun(&worker->mBatch, job.mUserData);
+      job.mFence = SubmitUploadBatch(&worker->mBatch);
+      PushUploadJob(&worker->mInFlight, &job);
+    }
+
+    RetireUploadJobs(worker);
+  }
+
+  return 0;
+}
+
+UploadWorker* CreateUploadWorker(void)
+{
+  UploadWorker* worker = (UploadWorker*)SDL_calloc(1, sizeof(UploadWorker));
+  worker->mMutex = SDL_CreateMutex();
+  worker->mCondition = SDL_CreateCondition();
+  worker->mBatch = CreateUploadBatch(0);
+  worker->mRunning = true;
+
+  worker->mThread = SDL_CreateThread(UploadWorkerThread, "UploadWorker", worker);
+  SDL_assert(worker->mThread);
+  return worker;
+}
+
+// aUserData has to stay alive until aPublish has been called with it.
+void QueueUploadJob(UploadWorker* aWorker, UploadJobFunction aRun, UploadJobPublishFunction aPublish, void* aUserData)
+{
+  UploadJob job;
+  SDL_zero(job);
+  job.mRun = aRun;
+  job.mPublish = aPublish;
+  job.mUserData = aUserData;
+
+  SDL_LockMutex(aWorker->mMutex);
+  PushUploadJob(&aWorker->mPending, &job);
+  SDL_SignalCondition(aWorker->mCondition);
+  SDL_UnlockMutex(aWorker->mMutex);
+}
+
+// Call from the render thread, once a frame. Returns how many jobs were published.
+size_t PublishUploadJobs(UploadWorker* aWorker)
+{
+  SDL_LockMutex(aWorker->mMutex);
+  UploadJobQueue completed = aWorker->mCompleted;
+  SDL_zero(aWorker->mCompleted);
+  SDL_UnlockMutex(aWorker->mMutex);
+
+  for (size_t i = 0; i < completed.mCount; ++i) {
+    if (completed.mJobs[i].mPublish) {
+      completed.mJobs[i].mPublish(completed.mJobs[i].mUserData);
+    }
+  }
+
+  SDL_free(completed.mJobs);
+  return completed.mCount;
+}
+
+// Waits for the worker to finish every job it was given, and publishes them.
+void DestroyUploadWorker(UploadWorker* aWorker)
+{
+  SDL_LockMutex(aWorker->mMutex);
+  aWorker->mRunning = false;
+  SDL_SignalCondition(aWorker->mCondition);
+  SDL_UnlockMutex(aWorker->mMutex);
+
+  SDL_WaitThread(aWorker->mThread, NULL);
+  PublishUploadJobs(aWorker);
+
+  DestroyUploadBatch(&aWorker->mBatch);
+  SDL_free(aWorker->mPending.mJobs);
+  SDL_free(aWorker->mInFlight.mJobs);
+  SDL_DestroyCondition(aWorker->mCondition);
+  SDL_DestroyMutex(aWorker->mMutex);
+  SDL_free(aWorker);
+}
+
+//////////////////////////////////////////////////////
+// Sampler Cache
+// Samplers are tiny and there are only so many distinct ones, but loaders tend to ask for one per
+// material. Asking the cache instead hands back the same SDL_GPUSampler for the same create info,
+// counting references so it's only released when the last user is done with it. props isn't part
+// of the key, a sampler keeps whatever name it was first created with.
+
+Uint32 HashBytes(Uint32 aHash, const void* aData, size_t aSize)
+{
+  const Uint8* bytes = (const Uint8*)aData;
+  for (size_t i = 0; i < aSize; ++i) {
+    aHash = (aHash ^ bytes[i]) * 16777619u;
+  }
+  return aHash;
+}
+
+// Field by field so neither padding nor props end up in the key.
+Uint32 HashSamplerCreateInfo(const SDL_GPUSamplerCreateInfo* aInfo)
+{
+  Uint32 hash = 2166136261u;
+  hash = HashBytes(hash, &aInfo->min_filter, sizeof(aInfo->min_filter));
+  hash = HashBytes(hash, &aInfo->mag_filter, sizeof(aInfo->mag_filter));
+  hash = HashBytes(hash, &aInfo->mipmap_mode, sizeof(aInfo->mipmap_mode));
+  hash = HashBytes(hash, &aInfo->address_mode_u, sizeof(aInfo->address_mode_u));
+  hash = HashBytes(hash, &aInfo->address_mode_v, sizeof(aInfo->address_mode_v));
+  hash = HashBytes(hash, &aInfo->address_mode_w, sizeof(aInfo->address_mode_w));
+  hash = HashBytes(hash, &aInfo->mip_lod_bias, sizeof(aInfo->mip_lod_bias));
+  hash = HashBytes(hash, &aInfo->max_anisotropy, sizeof(aInfo->max_anisotropy));
+  hash = HashBytes(hash, &aInfo->compare_op, sizeof(aInfo->compare_op));
+  hash = HashBytes(hash, &aInfo->min_lod, sizeof(aInfo->min_lod));
+  hash = HashBytes(hash, &aInfo->max_lod, sizeof(aInfo->max_lod));
+  hash = HashBytes(hash, &aInfo->enable_anisotropy, sizeof(aInfo->enable_anisotropy));
+  hash = HashBytes(hash, &aInfo->enable_compare, sizeof(aInfo->enable_compare));
+  return hash;
+}
+
+bool SamplerCreateInfosEqual(const SDL_GPUSamplerCreateInfo* aLeft, const SDL_GPUSamplerCreateInfo* aRight)
+{
+  return aLeft->min_filter == aRight->min_filter &&
+    aLeft->mag_filter == aRight->mag_filter &&
+    aLeft->mipmap_mode == aRight->mipmap_mode &&
+    aLeft->address_mode_u == aRight->address_mode_u &&
+    aLeft->address_mode_v == aRight->address_mode_v &&
+    aLeft->address_mode_w == aRight->address_mode_w &&
+    aLeft->mip_lod_bias == aRight->mip_lod_bias &&
+    aLeft->max_anisotropy == aRight->max_anisotropy &&
+    aLeft->compare_op == aRight->compare_op &&
+    aLeft->min_lod == aRight->min_lod &&
+    aLeft->max_lod == aRight->max_lod &&
+    aLeft->enable_anisotropy == aRight->enable_anisotropy &&
+    aLeft->enable_compare == aRight->enable_compare;
+}
+
+SamplerCache CreateSamplerCache(void)
+{
+  SamplerCache cache;
+  SDL_zero(cache);
+
+  cache.mFreeEntries = cSamplerCacheNoEntry;
+  cache.mBucketsCount = 16;
+  cache.mBuckets = (Uint32*)SDL_malloc(cache.mBucketsCount * sizeof(Uint32));
+  for (Uint32 i = 0; i < cache.mBucketsCount; ++i) {
+    cache.mBuckets[i] = cSamplerCacheNoEntry;
+  }
+
+  return cache;
+}
+
+// Keeps the chains short by doubling the buckets once there are more samplers than buckets.
+void GrowSamplerCacheBuckets(SamplerCache* aCache)
+{
+  aCache->mBucketsCount *= 2;
+  aCache->mBuckets = (Uint32*)SDL_realloc(aCache->mBuckets, aCache->mBucketsCount * sizeof(Uint32));
+  for (Uint32 i = 0; i < aCache->mBucketsCount; ++i) {
+    aCache->mBuckets[i] = cSamplerCacheNoEntry;
+  }
+
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    SamplerCacheEntry* entry = &aCache->mEntries[i];
+    if (!entry->mSampler) {
+      continue;
+    }
+
+    Uint32 bucket = entry->mHash & (aCache->mBucketsCount - 1);
+    entry->mNext = aCache->mBuckets[bucket];
+    aCache->mBuckets[bucket] = i;
+  }
+}
+
+// Every sampler acquired has to be given back with ReleaseCachedSampler rather than released.
+SDL_GPUSampler* AcquireCachedSampler(SamplerCache* aCache, const SDL_GPUSamplerCreateInfo* aInfo)
+{
+  Uint32 hash = HashSamplerCreateInfo(aInfo);
+  Uint32 bucket = hash & (aCache->mBucketsCount - 1);
+
+  for (Uint32 i = aCache->mBuckets[bucket]; i != cSamplerCacheNoEntry; i = aCache->mEntries[i].mNext) {
+    SamplerCacheEntry* entry = &aCache->mEntries[i];
+    if (entry->mHash == hash && SamplerCreateInfosEqual(&entry->mInfo, aInfo)) {
+      ++entry->mReferences;
+      ++aCache->mHits;
+      return entry->mSampler;
+    }
+  }
+
+  SDL_GPUSampler* sampler = SDL_CreateGPUSampler(gContext.mDevice, aInfo);
+  if (!sampler) {
+    return NULL;
+  }
+
+  ++aCache->mMisses;
+
+  Uint32 index = aCache->mFreeEntries;
+  if (index != cSamplerCacheNoEntry) {
+    aCache->mFreeEntries = aCache->mEntries[index].mNext;
+  }
+  else {
+    if (aCache->mEntriesCount == aCache->mEntriesCapacity) {
+      aCache->mEntriesCapacity = SDL_max(aCache->mEntriesCapacity * 2, 16);
+      aCache->mEntries = (SamplerCacheEntry*)SDL_realloc(aCache->mEntries, aCache->mEntriesCapacity * sizeof(SamplerCacheEntry));
+    }
+    index = aCache->mEntriesCount++;
+  }
+
+  SamplerCacheEntry* entry = &aCache->mEntries[index];
+  entry->mInfo = *aInfo;
+  entry->mSampler = sampler;
+  entry->mHash = hash;
+  entry->mReferences = 1;
+  entry->mNext = aCache->mBuckets[bucket];
+  aCache->mBuckets[bucket] = index;
+
+  if (++aCache->mSamplersCount > aCache->mBucketsCount) {
+    GrowSamplerCacheBuckets(aCache);
+  }
+
+  return sampler;
+}
+
+void ReleaseCachedSampler(SamplerCache* aCache, SDL_GPUSampler* aSampler)
+{
+  if (!aSampler) {
+    return;
+  }
+
+  // Samplers are few enough that walking the chains is cheaper than keeping a second map around.
+  for (Uint32 bucket = 0; bucket < aCache->mBucketsCount; ++bucket) {
+    for (Uint32* link = &aCache->mBuckets[bucket]; *link != cSamplerCacheNoEntry; link = &aCache->mEntries[*link].mNext) {
+      Uint32 index = *link;
+      SamplerCacheEntry* entry = &aCache->mEntries[index];
+      if (entry->mSampler != aSampler) {
+        continue;
+      }
+
+      if (--entry->mReferences == 0) {
+        SDL_ReleaseGPUSampler(gContext.mDevice, entry->mSampler);
+        *link = entry->mNext;
+
+        SDL_zerop(entry);
+        entry->mNext = aCache->mFreeEntries;
+        aCache->mFreeEntries = index;
+        --aCache->mSamplersCount;
+      }
+      return;
+    }
+  }
+
+  // Wasn't acquired from this cache.
+  SDL_assert(false);
+}
+
+void DestroySamplerCache(SamplerCache* aCache)
+{
+  if (aCache->mSamplersCount != 0) {
+    SDL_Log("SamplerCache: %u samplers still referenced on destruction", aCache->mSamplersCount);
+  }
+
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    if (aCache->mEntries[i].mSampler) {
+      SDL_ReleaseGPUSampler(gContext.mDevice, aCache->mEntries[i].mSampler);
+    }
+  }
+
+  SDL_free(aCache->mEntries);
+  SDL_free(aCache->mBuckets);
+  SDL_zerop(aCache);
+}
+
+//////////////////////////////////////////////////////
+// Pipeline Cache
+// Same idea as the Sampler Cache, but for graphics pipelines, which are far more expensive to create.
+// The whole create info is flattened into a key, following the vertex layout and color target
+// pointers, so two create infos built separately still match. Shaders are keyed by pointer, so
+// sharing a pipeline means sharing the SDL_GPUShader objects as well. props isn't part of the key.
+// Safe to use from several threads.
+
+void AppendPipelineKey(PipelineKey* aKey, const void* aData, size_t aSize)
+{
+  if (aKey->mSize + aSize > aKey->mCapacity) {
+    aKey->mCapacity = SDL_max(aKey->mCapacity * 2, (Uint32)(aKey->mSize + aSize));
+    aKey->mCapacity = SDL_max(aKey->mCapacity, 256);
+    aKey->mData = (Uint8*)SDL_realloc(aKey->mData, aKey->mCapacity);
+  }
+
+  SDL_memcpy(aKey->mData + aKey->mSize, aData, aSize);
+  aKey->mSize += (Uint32)aSize;
+}
+
+#define APPEND_PIPELINE_KEY(aKey, aField) AppendPipelineKey((aKey), &(aField), sizeof(aField))
+
+// Field by field so neither padding nor props end up in the key.
+void BuildPipelineKey(PipelineKey* aKey, const SDL_GPUGraphicsPipelineCreateInfo* aInfo)
+{
+  aKey->mSize = 0;
+
+  APPEND_PIPELINE_KEY(aKey, aInfo->vertex_shader);
+  APPEND_PIPELINE_KEY(aKey, aInfo->fragment_shader);
+
+  const SDL_GPUVertexInputState* vertexInput = &aInfo->vertex_input_state;
+  APPEND_PIPELINE_KEY(aKey, vertexInput->num_vertex_buffers);
+  for (Uint32 i = 0; i < vertexInput->num_vertex_buffers; ++i) {
+    const SDL_GPUVertexBufferDescription* buffer = &vertexInput->vertex_buffer_descriptions[i];
+    APPEND_PIPELINE_KEY(aKey, buffer->slot);
+    APPEND_PIPELINE_KEY(aKey, buffer->pitch);
+    APPEND_PIPELINE_KEY(aKey, buffer->input_rate);
+    APPEND_PIPELINE_KEY(aKey, buffer->instance_step_rate);
+  }
+
+  APPEND_PIPELINE_KEY(aKey, vertexInput->num_vertex_attributes);
+  for (Uint32 i = 0; i < vertexInput->num_vertex_attributes; ++i) {
+    const SDL_GPUVertexAttribute* attribute = &vertexInput->vertex_attributes[i];
+    APPEND_PIPELINE_KEY(aKey, attribute->location);
+    APPEND_PIPELINE_KEY(aKey, attribute->buffer_slot);
+    APPEND_PIPELINE_KEY(aKey, attribute->format);
+    APPEND_PIPELINE_KEY(aKey, attribute->offset);
+  }
+
+  APPEND_PIPELINE_KEY(aKey, aInfo->primitive_type);
+
+  const SDL_GPURasterizerState* rasterizer = &aInfo->rasterizer_state;
+  APPEND_PIPELINE_KEY(aKey, rasterizer->fill_mode);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->cull_mode);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->front_face);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->depth_bias_constant_factor);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->depth_bias_clamp);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->depth_bias_slope_factor);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->enable_depth_bias);
+  APPEND_PIPELINE_KEY(aKey, rasterizer->enable_depth_clip);
+
+  const SDL_GPUMultisampleState* multisample = &aInfo->multisample_state;
+  APPEND_PIPELINE_KEY(aKey, multisample->sample_count);
+  APPEND_PIPELINE_KEY(aKey, multisample->sample_mask);
+  APPEND_PIPELINE_KEY(aKey, multisample->enable_mask);
+  APPEND_PIPELINE_KEY(aKey, multisample->enable_alpha_to_coverage);
+
+  const SDL_GPUDepthStencilState* depthStencil = &aInfo->depth_stencil_state;
+  const SDL_GPUStencilOpState* stencils[2] = { &depthStencil->back_stencil_state, &depthStencil->front_stencil_state };
+  APPEND_PIPELINE_KEY(aKey, depthStencil->compare_op);
+  for (Uint32 i = 0; i < 2; ++i) {
+    APPEND_PIPELINE_KEY(aKey, stencils[i]->fail_op);
+    APPEND_PIPELINE_KEY(aKey, stencils[i]->pass_op);
+    APPEND_PIPELINE_KEY(aKey, stencils[i]->depth_fail_op);
+    APPEND_PIPELINE_KEY(aKey, stencils[i]->compare_op);
+  }
+  APPEND_PIPELINE_KEY(aKey, depthStencil->compare_mask);
+  APPEND_PIPELINE_KEY(aKey, depthStencil->write_mask);
+  APPEND_PIPELINE_KEY(aKey, depthStencil->enable_depth_test);
+  APPEND_PIPELINE_KEY(aKey, depthStencil->enable_depth_write);
+  APPEND_PIPELINE_KEY(aKey, depthStencil->enable_stencil_test);
+
+  const SDL_GPUGraphicsPipelineTargetInfo* targets = &aInfo->target_info;
+  APPEND_PIPELINE_KEY(aKey, targets->num_color_targets);
+  for (Uint32 i = 0; i < targets->num_color_targets; ++i) {
+    const SDL_GPUColorTargetDescription* target = &targets->color_target_descriptions[i];
+    const SDL_GPUColorTargetBlendState* blend = &target->blend_state;
+    APPEND_PIPELINE_KEY(aKey, target->format);
+    APPEND_PIPELINE_KEY(aKey, blend->src_color_blendfactor);
+    APPEND_PIPELINE_KEY(aKey, blend->dst_color_blendfactor);
+    APPEND_PIPELINE_KEY(aKey, blend->color_blend_op);
+    APPEND_PIPELINE_KEY(aKey, blend->src_alpha_blendfactor);
+    APPEND_PIPELINE_KEY(aKey, blend->dst_alpha_blendfactor);
+    APPEND_PIPELINE_KEY(aKey, blend->alpha_blend_op);
+    APPEND_PIPELINE_KEY(aKey, blend->color_write_mask);
+    APPEND_PIPELINE_KEY(aKey, blend->enable_blend);
+    APPEND_PIPELINE_KEY(aKey, blend->enable_color_write_mask);
+  }
+  APPEND_PIPELINE_KEY(aKey, targets->depth_stencil_format);
+  APPEND_PIPELINE_KEY(aKey, targets->has_depth_stencil_target);
+}
+
+#undef APPEND_PIPELINE_KEY
+
+PipelineCache CreatePipelineCache(void)
+{
+  PipelineCache cache;
+  SDL_zero(cache);
+
+  cache.mMutex = SDL_CreateMutex();
+  cache.mFreeEntries = cPipelineCacheNoEntry;
+  cache.mBucketsCount = 16;
+  cache.mBuckets = (Uint32*)SDL_malloc(cache.mBucketsCount * sizeof(Uint32));
+  for (Uint32 i = 0; i < cache.mBucketsCount; ++i) {
+    cache.mBuckets[i] = cPipelineCacheNoEntry;
+  }
+
+  return cache;
+}
+
+// Keeps the chains short by doubling the buckets once there are more pipelines than buckets.
+void GrowPipelineCacheBuckets(PipelineCache* aCache)
+{
+  aCache->mBucketsCount *= 2;
+  aCache->mBuckets = (Uint32*)SDL_realloc(aCache->mBuckets, aCache->mBucketsCount * sizeof(Uint32));
+  for (Uint32 i = 0; i < aCache->mBucketsCount; ++i) {
+    aCache->mBuckets[i] = cPipelineCacheNoEntry;
+  }
+
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    PipelineCacheEntry* entry = &aCache->mEntries[i];
+    if (!entry->mPipeline) {
+      continue;
+    }
+
+    Uint32 bucket = entry->mHash & (aCache->mBucketsCount - 1);
+    entry->mNext = aCache->mBuckets[bucket];
+    aCache->mBuckets[bucket] = i;
+  }
+}
+
+// Called with mMutex held, adds a reference to the pipeline if it finds one. Leaves the statistics
+// to the caller.
+SDL_GPUGraphicsPipeline* FindCachedPipeline(PipelineCache* aCache, const PipelineKey* aKey, Uint32 aHash)
+{
+  Uint32 bucket = aHash & (aCache->mBucketsCount - 1);
+  for (Uint32 i = aCache->mBuckets[bucket]; i != cPipelineCacheNoEntry; i = aCache->mEntries[i].mNext) {
+    PipelineCacheEntry* entry = &aCache->mEntries[i];
+    if (entry->mHash == aHash && entry->mKeySize == aKey->mSize && SDL_memcmp(entry->mKey, aKey->mData, aKey->mSize) == 0) {
+      ++entry->mReferences;
+      return entry->mPipeline;
+    }
+  }
+
+  return NULL;
+}
+
+// Every pipeline acquired has to be given back with ReleaseCachedPipeline rather than released.
+SDL_GPUGraphicsPipeline* AcquireCachedPipeline(PipelineCache* aCache, const SDL_GPUGraphicsPipelineCreateInfo* aInfo)
+{
+  PipelineKey key;
+  SDL_zero(key);
+  BuildPipelineKey(&key, aInfo);
+
+  Uint32 hash = HashBytes(2166136261u, key.mData, key.mSize);
+
+  SDL_LockMutex(aCache->mMutex);
+  SDL_GPUGraphicsPipeline* pipeline = FindCachedPipeline(aCache, &key, hash);
+  if (pipeline) {
+    ++aCache->mHits;
+  }
+  SDL_UnlockMutex(aCache->mMutex);
+
+  if (pipeline) {
+    SDL_free(key.mData);
+    return pipeline;
+  }
+
+  Uint64 start = SDL_GetTicksNS();
+  pipeline = SDL_CreateGPUGraphicsPipeline(gContext.mDevice, aInfo);
+  Uint64 createTimeNS = SDL_GetTicksNS() - start;
+  if (!pipeline) {
+    SDL_free(key.mData);
+    return NULL;
+  }
+
+  SDL_LockMutex(aCache->mMutex);
+  aCache->mCreateTimeNS += createTimeNS;
+
+  ++aCache->mMisses;
+
+  // Another thread may have created the same pipeline in the meantime, in which case theirs is kept.
+  // This one was still created, so it stays a miss.
+  SDL_GPUGraphicsPipeline* existing = FindCachedPipeline(aCache, &key, hash);
+  if (existing) {
+    ++aCache->mLostRaces;
+    SDL_UnlockMutex(aCache->mMutex);
+    SDL_ReleaseGPUGraphicsPipeline(gContext.mDevice, pipeline);
+    SDL_free(key.mData);
+    return existing;
+  }
+
+  Uint32 index = aCache->mFreeEntries;
+  if (index != cPipelineCacheNoEntry) {
+    aCache->mFreeEntries = aCache->mEntries[index].mNext;
+  }
+  else {
+    if (aCache->mEntriesCount == aCache->mEntriesCapacity) {
+      aCache->mEntriesCapacity = SDL_max(aCache->mEntriesCapacity * 2, 16);
+      aCache->mEntries = (PipelineCacheEntry*)SDL_realloc(aCache->mEntries, aCache->mEntriesCapacity * sizeof(PipelineCacheEntry));
+    }
+    index = aCache->mEntriesCount++;
+  }
+
+  Uint32 bucket = hash & (aCache->mBucketsCount - 1);
+  PipelineCacheEntry* entry = &aCache->mEntries[index];
+  entry->mKey = key.mData;
+  entry->mKeySize = key.mSize;
+  entry->mPipeline = pipeline;
+  entry->mHash = hash;
+  entry->mReferences = 1;
+  entry->mNext = aCache->mBuckets[bucket];
+  aCache->mBuckets[bucket] = index;
+
+  if (++aCache->mPipelinesCount > aCache->mBucketsCount) {
+    GrowPipelineCacheBuckets(aCache);
+  }
+
+  SDL_UnlockMutex(aCache->mMutex);
+  return pipeline;
+}
+
+void ReleaseCachedPipeline(PipelineCache* aCache, SDL_GPUGraphicsPipeline* aPipeline)
+{
+  if (!aPipeline) {
+    return;
+  }
+
+  SDL_LockMutex(aCache->mMutex);
+
+  for (Uint32 bucket = 0; bucket < aCache->mBucketsCount; ++bucket) {
+    for (Uint32* link = &aCache->mBuckets[bucket]; *link != cPipelineCacheNoEntry; link = &aCache->mEntries[*link].mNext) {
+      Uint32 index = *link;
+      PipelineCacheEntry* entry = &aCache->mEntries[index];
+      if (entry->mPipeline != aPipeline) {
+        continue;
+      }
+
+      if (--entry->mReferences == 0) {
+        SDL_ReleaseGPUGraphicsPipeline(gContext.mDevice, entry->mPipeline);
+        SDL_free(entry->mKey);
+        *link = entry->mNext;
+
+        SDL_zerop(entry);
+        entry->mNext = aCache->mFreeEntries;
+        aCache->mFreeEntries = index;
+        --aCache->mPipelinesCount;
+      }
+
+      SDL_UnlockMutex(aCache->mMutex);
+      return;
+    }
+  }
+
+  SDL_UnlockMutex(aCache->mMutex);
+
+  // Wasn't acquired from this cache.
+  SDL_assert(false);
+}
+
+void DestroyPipelineCache(PipelineCache* aCache)
+{
+  if (aCache->mPipelinesCount != 0) {
+    SDL_Log("PipelineCache: %u pipelines still referenced on destruction", aCache->mPipelinesCount);
+  }
+
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    if (aCache->mEntries[i].mPipeline) {
+      SDL_ReleaseGPUGraphicsPipeline(gContext.mDevice, aCache->mEntries[i].mPipeline);
+      SDL_free(aCache->mEntries[i].mKey);
+    }
+  }
+
+  SDL_free(aCache->mEntries);
+  SDL_free(aCache->mBuckets);
+  SDL_DestroyMutex(aCache->mMutex);
+  SDL_zerop(aCache);
+}
+
+//////////////////////////////////////////////////////
+// Shader Cache
+// CreateShader reads the file and creates a new SDL_GPUShader on every call, even when another
+// pipeline already loaded the same one. The cache keeps every shader it creates alive until it's
+// destroyed, keyed by name, stage and resource counts, so pipelines can share them. It also times
+// the file loads and shader creation separately, per shader and in total. Safe to use from several
+// threads.
+
+Uint32 HashShaderDescription(const ShaderDescription* aDescription)
+{
+  Uint32 hash = 2166136261u;
+  hash = HashBytes(hash, aDescription->mName, SDL_strlen(aDescription->mName));
+  hash = HashBytes(hash, &aDescription->mStage, sizeof(aDescription->mStage));
+  hash = HashBytes(hash, &aDescription->mSamplerCount, sizeof(aDescription->mSamplerCount));
+  hash = HashBytes(hash, &aDescription->mUniformBufferCount, sizeof(aDescription->mUniformBufferCount));
+  hash = HashBytes(hash, &aDescription->mStorageBufferCount, sizeof(aDescription->mStorageBufferCount));
+  hash = HashBytes(hash, &aDescription->mStorageTextureCount, sizeof(aDescription->mStorageTextureCount));
+  return hash;
+}
+
+bool ShaderDescriptionsEqual(const ShaderDescription* aLeft, const ShaderDescription* aRight)
+{
+  return SDL_strcmp(aLeft->mName, aRight->mName) == 0 &&
+    aLeft->mStage == aRight->mStage &&
+    aLeft->mSamplerCount == aRight->mSamplerCount &&
+    aLeft->mUniformBufferCount == aRight->mUniformBufferCount &&
+    aLeft->mStorageBufferCount == aRight->mStorageBufferCount &&
+    aLeft->mStorageTextureCount == aRight->mStorageTextureCount;
+}
+
+ShaderCache CreateShaderCacheForTarget(const char* aTargetName)
+{
+  ShaderCache cache;
+  SDL_zero(cache);
+  cache.mMutex = SDL_CreateMutex();
+  cache.mTargetName = aTargetName;
+  return cache;
+}
+
+// Called with mMutex held. A technique only has a handful of shaders, a linear walk over the hashes
+// is plenty.
+ShaderCacheEntry* FindCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription, Uint32 aHash)
+{
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    ShaderCacheEntry* entry = &aCache->mEntries[i];
+    if (entry->mHash == aHash && ShaderDescriptionsEqual(&entry->mDescription, aDescription)) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+void* LoadShaderCode(ShaderCache* aCache, const char* aName, size_t* aSize, Uint64* aLoadTimeNS)
+{
+  char shader_path[4096];
+  SDL_snprintf(shader_path, SDL_arraysize(shader_path), "Assets/Shaders/%s/%s.%s", aCache->mTargetName, aName, gContext.mChosenBackendFormatExtension);
+
+  Uint64 start = SDL_GetTicksNS();
+  void* fileData = SDL_LoadFile(shader_path, aSize);
+  *aLoadTimeNS = SDL_GetTicksNS() - start;
+
+  if (!fileData) {
+    SDL_Log("ShaderCache: Couldn't load %s: %s", shader_path, SDL_GetError());
+  }
+
+  return fileData;
+}
+
+// Takes ownership of aCode.
+SDL_GPUShader* CreateCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription, Uint32 aHash, void* aCode, size_t aCodeSize, Uint64 aLoadTimeNS)
+{
+  // Properties of its own, gContext.mProperties could be renamed by another thread midway.
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_assert(SDL_SetStringProperty(properties, SDL_PROP_GPU_SHADER_CREATE_NAME_STRING, aDescription->mName));
+
+  SDL_GPUShaderCreateInfo shaderCreateInfo;
+  SDL_zero(shaderCreateInfo);
+  shaderCreateInfo.entrypoint = gContext.mShaderEntryPoint;
+  shaderCreateInfo.format = gContext.mChosenBackendFormat;
+  shaderCreateInfo.code = (Uint8*)aCode;
+  shaderCreateInfo.code_size = aCodeSize;
+  shaderCreateInfo.stage = aDescription->mStage;
+  shaderCreateInfo.num_samplers = aDescription->mSamplerCount;
+  shaderCreateInfo.num_uniform_buffers = aDescription->mUniformBufferCount;
+  shaderCreateInfo.num_storage_buffers = aDescription->mStorageBufferCount;
+  shaderCreateInfo.num_storage_textures = aDescription->mStorageTextureCount;
+  shaderCreateInfo.props = properties;
+
+  Uint64 start = SDL_GetTicksNS();
+  SDL_GPUShader* shader = SDL_CreateGPUShader(gContext.mDevice, &shaderCreateInfo);
+  Uint64 createTimeNS = SDL_GetTicksNS() - start;
+
+  SDL_DestroyProperties(properties);
+  SDL_free(aCode);
+  if (!shader) {
+    return NULL;
+  }
+
+  SDL_LockMutex(aCache->mMutex);
+
+  ++aCache->mMisses;
+  aCache->mLoadTimeNS += aLoadTimeNS;
+  aCache->mCreateTimeNS += createTimeNS;
+
+  // Another thread may have created the same shader in the meantime, in which case theirs is kept.
+  // This one was still loaded and created, so it stays a miss.
+  ShaderCacheEntry* existing = FindCachedShader(aCache, aDescription, aHash);
+  if (existing) {
+    SDL_GPUShader* existingShader = existing->mShader;
+    ++aCache->mLostRaces;
+    SDL_UnlockMutex(aCache->mMutex);
+
+    SDL_ReleaseGPUShader(gContext.mDevice, shader);
+    return existingShader;
+  }
+
+  if (aCache->mEntriesCount == aCache->mEntriesCapacity) {
+    aCache->mEntriesCapacity = SDL_max(aCache->mEntriesCapacity * 2, 16);
+    aCache->mEntries = (ShaderCacheEntry*)SDL_realloc(aCache->mEntries, aCache->mEntriesCapacity * sizeof(ShaderCacheEntry));
+  }
+
+  ShaderCacheEntry* entry = &aCache->mEntries[aCache->mEntriesCount++];
+  entry->mDescription = *aDescription;
+  entry->mDescription.mName = SDL_strdup(aDescription->mName);
+  entry->mShader = shader;
+  entry->mHash = aHash;
+  entry->mLoadTimeNS = aLoadTimeNS;
+  entry->mCreateTimeNS = createTimeNS;
+
+  SDL_UnlockMutex(aCache->mMutex);
+  return shader;
+}
+
+// Loads and creates every shader of a technique that isn't cached yet. All the files are read
+// first and only then handed to the driver, rather than alternating between the two.
+bool PreloadShaders(ShaderCache* aCache, const ShaderDescription* aShaders, Uint32 aShadersCount)
+{
+  void** codes = (void**)SDL_calloc(aShadersCount, sizeof(void*));
+  size_t* codeSizes = (size_t*)SDL_calloc(aShadersCount, sizeof(size_t));
+  Uint64* loadTimes = (Uint64*)SDL_calloc(aShadersCount, sizeof(Uint64));
+  bool succeeded = true;
+
+  for (Uint32 i = 0; i < aShadersCount; ++i) {
+    SDL_LockMutex(aCache->mMutex);
+    bool cached = FindCachedShader(aCache, &aShaders[i], HashShaderDescription(&aShaders[i])) != NULL;
+    SDL_UnlockMutex(aCache->mMutex);
+
+    // The same shader can be listed twice, only the first one gets loaded.
+    for (Uint32 j = 0; j < i && !cached; ++j) {
+      cached = ShaderDescriptionsEqual(&aShaders[j], &aShaders[i]);
+    }
+
+    if (cached) {
+      continue;
+    }
+
+    codes[i] = LoadShaderCode(aCache, aShaders[i].mName, &codeSizes[i], &loadTimes[i]);
+    succeeded = succeeded && codes[i];
+  }
+
+  for (Uint32 i = 0; i < aShadersCount; ++i) {
+    if (codes[i]) {
+      Uint32 hash = HashShaderDescription(&aShaders[i]);
+      succeeded = CreateCachedShader(aCache, &aShaders[i], hash, codes[i], codeSizes[i], loadTimes[i]) && succeeded;
+    }
+  }
+
+  SDL_free(loadTimes);
+  SDL_free(codeSizes);
+  SDL_free(codes);
+  return succeeded;
+}
+
+// The shader belongs to the cache, don't release it.
+SDL_GPUShader* GetCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription)
+{
+  Uint32 hash = HashShaderDescription(aDescription);
+
+  SDL_LockMutex(aCache->mMutex);
+  ShaderCacheEntry* entry = FindCachedShader(aCache, aDescription, hash);
+  SDL_GPUShader* shader = entry ? entry->mShader : NULL;
+  if (shader) {
+    ++aCache->mHits;
+  }
+  SDL_UnlockMutex(aCache->mMutex);
+
+  if (shader) {
+    return shader;
+  }
+
+  size_t codeSize = 0;
+  Uint64 loadTimeNS = 0;
+  void* code = LoadShaderCode(aCache, aDescription->mName, &codeSize, &loadTimeNS);
+  if (!code) {
+    return NULL;
+  }
+
+  return CreateCachedShader(aCache, aDescription, hash, code, codeSize, loadTimeNS);
+}
+
+void LogShaderCache(const ShaderCache* aCache)
+{
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    const ShaderCacheEntry* entry = &aCache->mEntries[i];
+    SDL_Log(
+      "ShaderCache: %s loaded in %.3f ms, created in %.3f ms",
+      entry->mDescription.mName,
+      (double)entry->mLoadTimeNS / 1000000.0,
+      (double)entry->mCreateTimeNS / 1000000.0
+    );
+  }
+
+  SDL_Log(
+    "ShaderCache: %" SDL_PRIu64 " hits and %" SDL_PRIu64 " misses (%" SDL_PRIu64 " lost a race), %.3f ms loading and %.3f ms creating shaders",
+    aCache->mHits,
+    aCache->mMisses,
+    aCache->mLostRaces,
+    (double)aCache->mLoadTimeNS / 1000000.0,
+    (double)aCache->mCreateTimeNS / 1000000.0
+  );
+}
+
+void DestroyShaderCache(ShaderCache* aCache)
+{
+  for (Uint32 i = 0; i < aCache->mEntriesCount; ++i) {
+    SDL_ReleaseGPUShader(gContext.mDevice, aCache->mEntries[i].mShader);
+    SDL_free((void*)aCache->mEntries[i].mDescription.mName);
+  }
+
+  SDL_free(aCache->mEntries);
+  SDL_DestroyMutex(aCache->mMutex);
+  SDL_zerop(aCache);
+}
+
+//////////////////////////////////////////////////////
+// Thread Pool
+// A handful of worker threads running small jobs, for work like shader and pipeline creation that
+// doesn't have to happen on the main thread. Jobs can depend on jobs added before them and are only
+// run once those have finished. Jobs are added and waited on from a single thread.
+
+// Called with mMutex held, which is dropped while the job runs.
+void RunThreadPoolJob(ThreadPool* aPool, Uint32 aIndex)
+{
+  ThreadPoolJobFunction run = aPool->mJobs[aIndex].mRun;
+  void* userData = aPool->mJobs[aIndex].mUserData;
+
+  SDL_UnlockMutex(aPool->mMutex);
+  run(userData);
+  SDL_LockMutex(aPool->mMutex);
+
+  ThreadPoolJob* job = &aPool->mJobs[aIndex];
+  job->mFinished = true;
+
+  for (Uint32 i = 0; i < job->mDependentsCount; ++i) {
+    Uint32 dependent = job->mDependents[i];
+    if (--aPool->mJobs[dependent].mWaitingOn == 0) {
+      aPool->mReady[aPool->mReadyEnd++] = dependent;
+      SDL_SignalCondition(aPool->mJobReady);
+    }
+  }
+
+  --aPool->mUnfinishedCount;
+  SDL_BroadcastCondition(aPool->mJobFinished);
+}
+
+int ThreadPoolThread(void* aUserData)
+{
+  ThreadPool* pool = (ThreadPool*)aUserData;
+
+  SDL_LockMutex(pool->mMutex);
+
+  for (;;) {
+    while (pool->mRunning && pool->mReadyBegin == pool->mReadyEnd) {
+      SDL_WaitCondition(pool->mJobReady, pool->mMutex);
+    }
+
+    if (pool->mReadyBegin == pool->mReadyEnd) {
+      break;
+    }
+
+    RunThreadPoolJob(pool, pool->mReady[pool->mReadyBegin++]);
+  }
+
+  SDL_UnlockMutex(pool->mMutex);
+  return 0;
+}
+
+// With no threads, every job is run by WaitThreadPool on the calling thread instead.
+ThreadPool* CreateThreadPool(Uint32 aThreadsCount)
+{
+  ThreadPool* pool = (ThreadPool*)SDL_calloc(1, sizeof(ThreadPool));
+  pool->mMutex = SDL_CreateMutex();
+  pool->mJobReady = SDL_CreateCondition();
+  pool->mJobFinished = SDL_CreateCondition();
+  pool->mRunning = true;
+
+  pool->mThreadsCount = aThreadsCount;
+  pool->mThreads = (SDL_Thread**)SDL_calloc(SDL_max(aThreadsCount, 1), sizeof(SDL_Thread*));
+  for (Uint32 i = 0; i < aThreadsCount; ++i) {
+    pool->mThreads[i] = SDL_CreateThread(ThreadPoolThread, "ThreadPool", pool);
+    SDL_assert(pool->mThreads[i]);
+  }
+
+  return pool;
+}
+
+// Returns the job's handle, which is what later jobs pass in aDependencies to wait on it.
+Uint32 AddThreadPoolJob(ThreadPool* aPool, ThreadPoolJobFunction aRun, void* aUserData, const Uint32* aDependencies, Uint32 aDependenciesCount)
+{
+  SDL_LockMutex(aPool->mMutex);
+
+  if (aPool->mJobsCount == aPool->mJobsCapacity) {
+    aPool->mJobsCapacity = SDL_max(aPool->mJobsCapacity * 2, 16);
+    aPool->mJobs = (ThreadPoolJob*)SDL_realloc(aPool->mJobs, aPool->mJobsCapacity * sizeof(ThreadPoolJob));
+    aPool->mReady = (Uint32*)SDL_realloc(aPool->mReady, aPool->mJobsCapacity * sizeof(Uint32));
+  }
+
+  Uint32 index = aPool->mJobsCount++;
+  ThreadPoolJob* job = &aPool->mJobs[index];
+  SDL_zerop(job);
+  job->mRun = aRun;
+  job->mUserData = aUserData;
+
+  for (Uint32 i = 0; i < aDependenciesCount; ++i) {
+    SDL_assert(aDependencies[i] < index);
+    ThreadPoolJob* dependency = &aPool->mJobs[aDependencies[i]];
+    if (dependency->mFinished) {
+      continue;
+    }
+
+    if (dependency->mDependentsCount == dependency->mDependentsCapacity) {
+      dependency->mDependentsCapacity = SDL_max(dependency->mDependentsCapacity * 2, 4);
+      dependency->mDependents = (Uint32*)SDL_realloc(dependency->mDependents, dependency->mDependentsCapacity * sizeof(Uint32));
+    }
+
+    dependency->mDependents[dependency->mDependentsCount++] = index;
+    ++job->mWaitingOn;
+  }
+
+  ++aPool->mUnfinishedCount;
+  if (job->mWaitingOn == 0) {
+    aPool->mReady[aPool->mReadyEnd++] = index;
+    SDL_SignalCondition(aPool->mJobReady);
+  }
+
+  SDL_UnlockMutex(aPool->mMutex);
+  return index;
+}
+
+// Helps run jobs until every one added so far has finished, after which their handles are reused.
+void WaitThreadPool(ThreadPool* aPool)
+{
+  SDL_LockMutex(aPool->mMutex);
+
+  while (aPool->mUnfinishedCount != 0) {
+    if (aPool->mReadyBegin != aPool->mReadyEnd) {
+      RunThreadPoolJob(aPool, aPool->mReady[aPool->mReadyBegin++]);
+    }
+    else {
+      SDL_WaitCondition(aPool->mJobFinished, aPool->mMutex);
+    }
+  }
+
+  for (Uint32 i = 0; i < aPool->mJobsCount; ++i) {
+    SDL_free(aPool->mJobs[i].mDependents);
+  }
+
+  aPool->mJobsCount = 0;
+  aPool->mReadyBegin = 0;
+  aPool->mReadyEnd = 0;
+
+  SDL_UnlockMutex(aPool->mMutex);
+}
+
+void DestroyThreadPool(ThreadPool* aPool)
+{
+  WaitThreadPool(aPool);
+
+  SDL_LockMutex(aPool->mMutex);
+  aPool->mRunning = false;
+  SDL_BroadcastCondition(aPool->mJobReady);
+  SDL_UnlockMutex(aPool->mMutex);
+
+  for (Uint32 i = 0; i < aPool->mThreadsCount; ++i) {
+    SDL_WaitThread(aPool->mThreads[i], NULL);
+  }
+
+  SDL_free(aPool->mThreads);
+  SDL_free(aPool->mJobs);
+  SDL_free(aPool->mReady);
+  SDL_DestroyCondition(aPool->mJobFinished);
+  SDL_DestroyCondition(aPool->mJobReady);
+  SDL_DestroyMutex(aPool->mMutex);
+  SDL_free(aPool);
+}
+
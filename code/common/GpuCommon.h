@@ -0,0 +1,1184 @@
+// The MATH and Shared GPU Code sections the examples each carry a copy of. 014_GLTF builds against
+// these directly, 005 to 010 only when SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY is on.
+#ifndef SDL_GPU_COMMON_H
+#define SDL_GPU_COMMON_H
+
+#include <SDL3/SDL.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MATH
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+typedef struct float2 {
+  float x, y;
+} float2;
+
+typedef struct float3 {
+  float x, y, z;
+} float3;
+
+typedef struct float4 {
+  float x, y, z, w;
+} float4;
+
+typedef struct float4x4 {
+  union {
+    float4 columns[4];
+    float data[4][4];
+  };
+} float4x4;
+
+//////////////////////////////////////////////////////
+// Downcasts
+
+float2 Float3_XY(float3 aValue);
+
+float2 Float4_XY(float4 aValue);
+
+float3 Float4_XYZ(float4 aValue);
+
+//////////////////////////////////////////////////////
+// Subtraction
+
+float2 Float2_Subtract(float2 aLeft, float2 aRight);
+
+float3 Float3_Subtract(float3 aLeft, float3 aRight);
+
+float4 Float4_Subtract(float4 aLeft, float4 aRight);
+
+//////////////////////////////////////////////////////
+// Addition
+
+float2 Float2_Add(float2 aLeft, float2 aRight);
+
+float3 Float3_Add(float3 aLeft, float3 aRight);
+
+float4 Float4_Add(float4 aLeft, float4 aRight);
+
+//////////////////////////////////////////////////////
+// Scalar Addition
+
+float2 Float2_Scalar_Add(float2 aLeft, float aRight);
+
+float3 Float3_Scalar_Add(float3 aLeft, float aRight);
+
+float4 Float4_Scalar_Add(float4 aLeft, float aRight);
+
+//////////////////////////////////////////////////////
+// Scalar Multiplication
+
+float2 Float2_Scalar_Multiply(float2 aLeft, float aRight);
+
+float3 Float3_Scalar_Multiply(float3 aLeft, float aRight);
+
+float4 Float4_Scalar_Multiply(float4 aLeft, float aRight);
+
+//////////////////////////////////////////////////////
+// Scalar Multiplication
+
+float2 Float2_Scalar_Division(float2 aLeft, float aRight);
+
+float3 Float3_Scalar_Division(float3 aLeft, float aRight);
+
+float4 Float4_Scalar_Division(float4 aLeft, float aRight);
+
+//////////////////////////////////////////////////////
+// SIMD Selection
+// The scalar versions are always compiled so they can be compared against, the plain names then
+// forward to the widest instruction set the compiler is targeting. AVX can't be assumed on x64 any
+// more than AVX2 can, so like the AVX2 batch functions it's compiled with SDL_TARGETING, but only
+// MathBenchmark calls it. Define MATH_FORCE_SCALAR to opt out.
+
+#if !defined(MATH_FORCE_SCALAR)
+#if defined(SDL_SSE2_INTRINSICS) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATH_SSE2 1
+#if defined(SDL_AVX_INTRINSICS)
+#define MATH_AVX 1
+#endif
+#elif defined(SDL_NEON_INTRINSICS)
+#define MATH_NEON 1
+#endif
+#endif
+
+//////////////////////////////////////////////////////
+// Dot Product
+
+float Float2_Dot(float2 aLeft, float2 aRight);
+
+float Float3_Dot(float3 aLeft, float3 aRight);
+
+float Float4_Dot_Scalar(float4 aLeft, float4 aRight);
+
+#if defined(MATH_SSE2)
+float Float4_Dot_SSE2(float4 aLeft, float4 aRight);
+#endif
+
+#if defined(MATH_NEON)
+float Float4_Dot_NEON(float4 aLeft, float4 aRight);
+#endif
+
+float Float4_Dot(float4 aLeft, float4 aRight);
+
+//////////////////////////////////////////////////////
+// Cross Product
+
+float3 Float3_Cross(float3 aLeft, float3 aRight);
+
+// Convience function that ignores the 4th component, assuming it was irrelevant.
+float3 Float4_Cross(float4 aLeft, float4 aRight);
+
+//////////////////////////////////////////////////////
+// Magnitude
+
+float Float2_Magnitude(float2 aValue);
+
+float Float3_Magnitude(float3 aValue);
+
+float Float4_Magnitude(float4 aValue);
+
+//////////////////////////////////////////////////////
+// Normalization
+
+float2 Float2_Normalize(float2 aValue);
+
+float3 Float3_Normalize(float3 aValue);
+
+float4 Float4_Normalize(float4 aValue);
+
+//////////////////////////////////////////////////////
+// Matrix Operations
+
+float4 Float4x4_Float4_Multiply_Scalar(const float4x4* aLeft, const float4 aRight);
+
+float4x4 Float4x4_Multiply_Scalar(const float4x4* aLeft, const float4x4* aRight);
+
+// The matrices are column major, so every column of the result is a linear combination of the
+// columns of aLeft, weighted by the matching column of aRight. That maps directly onto 4 wide registers.
+#if defined(MATH_SSE2)
+float4 Float4x4_Float4_Multiply_SSE2(const float4x4* aLeft, const float4 aRight);
+
+float4x4 Float4x4_Multiply_SSE2(const float4x4* aLeft, const float4x4* aRight);
+#endif
+
+// AVX works on two result columns at once, each 128 bit lane holds a copy of the aLeft column.
+#if defined(MATH_AVX)
+SDL_TARGETING("avx") float4x4 Float4x4_Multiply_AVX(const float4x4* aLeft, const float4x4* aRight);
+#endif
+
+#if defined(MATH_NEON)
+float4 Float4x4_Float4_Multiply_NEON(const float4x4* aLeft, const float4 aRight);
+
+float4x4 Float4x4_Multiply_NEON(const float4x4* aLeft, const float4x4* aRight);
+#endif
+
+float4 Float4x4_Float4_Multiply(const float4x4* aLeft, const float4 aRight);
+
+float4x4 Float4x4_Multiply(const float4x4* aLeft, const float4x4* aRight);
+
+// Inverse for matrices whose bottom row is (0, 0, 0, 1), which is everything CreateModelMatrix
+// produces. Only the upper 3x3 needs a real inverse, and the translation then falls out of it.
+float4x4 Float4x4_AffineInverse(const float4x4* aValue);
+
+////////////////////////////////////////////////////////////
+/// Core Matrices
+
+float4x4 IdentityMatrix(void);
+
+float4x4 TranslationMatrix(float4 aPosition);
+
+float4x4 ScaleMatrix(float4 aScale);
+
+float4x4 RotationMatrixX(float aAngle);
+
+float4x4 RotationMatrixY(float aAngle);
+
+float4x4 RotationMatrixZ(float aAngle);
+
+float4x4 RotationMatrix(float4 aPosition);
+
+float4x4 RotationMatrixFromQuaternion(float4 aQuaternion);
+
+// Same result as TranslationMatrix * RotationMatrix * ScaleMatrix, written out directly. The rotation
+// is Z * Y * X, so each axis only needs one sin and cos, and scaling and translating it only touch
+// the columns, none of the intermediate 4x4 multiplies are needed.
+float4x4 CreateModelMatrix(float4 aPosition, float4 aScale, float4 aRotation);
+
+// Same as CreateModelMatrix, but with the rotation as a unit quaternion.
+float4x4 CreateModelMatrixWithQuaternion(float4 aPosition, float4 aScale, float4 aRotation);
+
+float4x4 OrthographicProjectionLHZO(float aLeft, float aRight, float aBottom, float aTop, float aNear, float aFar);
+
+float4x4 PerspectiveProjectionLHZO(float aFovY, float aAspectRatio, float aNear, float aFar);
+
+float4x4 PerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear, float aFar);
+
+float4x4 InfinitePerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear);
+
+//////////////////////////////////////////////////////
+// Batch Operations
+// Same math as above, but over whole arrays so the SIMD registers are kept full across elements
+// rather than within a single one. The AVX2 versions are picked at runtime since, unlike SSE2, we
+// can't assume every x64 CPU running this has it.
+
+#if !defined(MATH_FORCE_SCALAR) && defined(SDL_AVX2_INTRINSICS)
+#define MATH_AVX2 1
+#endif
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") void Float4x4_Multiply_Batch_AVX2(const float4x4* aLeft, const float4x4* aRights, float4x4* aResults, size_t aCount);
+
+// Two vectors per register, one in each 128 bit lane.
+SDL_TARGETING("avx2") void Float4x4_TransformVectors_Batch_AVX2(const float4x4* aMatrix, const float4* aVectors, float4* aResults, size_t aCount);
+
+// Eight points per register, one per lane. aBroadcast holds the top three rows of the matrix with
+// each element splatted across a register.
+SDL_TARGETING("avx2") void Float4x4_BroadcastAffine_AVX2(const float4x4* aMatrix, __m256 aBroadcast[12]);
+
+SDL_TARGETING("avx2") void Float4x4_TransformPoints8_AVX2(const __m256 aBroadcast[12], __m256* aX, __m256* aY, __m256* aZ);
+
+SDL_TARGETING("avx2") void Float4x4_TransformPoints_SoA_AVX2(
+  const float4x4* aMatrix,
+  const float* aX, const float* aY, const float* aZ,
+  float* aResultX, float* aResultY, float* aResultZ,
+  size_t aCount);
+#endif
+
+// aResults[i] = aLeft * aRights[i]
+void Float4x4_Multiply_Batch(const float4x4* aLeft, const float4x4* aRights, float4x4* aResults, size_t aCount);
+
+// aResults[i] = aMatrix * aVectors[i]
+void Float4x4_TransformVectors_Batch(const float4x4* aMatrix, const float4* aVectors, float4* aResults, size_t aCount);
+
+// Points are treated as having a w of 1, and aMatrix is assumed to be affine so there's no divide.
+// float3 isn't a friendly stride for 8 wide registers (gathering them measured slower than this),
+// so prefer Float4x4_TransformPoints_SoA for large arrays.
+void Float4x4_TransformPoints_Batch(const float4x4* aMatrix, const float3* aPoints, float3* aResults, size_t aCount);
+
+// Structure of arrays version of Float4x4_TransformPoints_Batch, the input and output arrays may alias.
+void Float4x4_TransformPoints_SoA(
+  const float4x4* aMatrix,
+  const float* aX, const float* aY, const float* aZ,
+  float* aResultX, float* aResultY, float* aResultZ,
+  size_t aCount);
+
+//////////////////////////////////////////////////////
+// Vectorized Sine and Cosine
+// Cephes style: reduce the angle into [-pi/4, pi/4] around the nearest multiple of pi/4, evaluate
+// both minimax polynomials, then pick and flip signs depending on which octant the angle was in.
+// Good to a couple of ulps for angles up to around 8192 radians, which covers any sane rotation.
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") void SinCos8_AVX2(__m256 aAngles, __m256* aSines, __m256* aCosines);
+
+SDL_TARGETING("avx2") void SinCos_Batch_AVX2(const float* aAngles, float* aSines, float* aCosines, size_t aCount);
+#endif
+
+void SinCos_Batch(const float* aAngles, float* aSines, float* aCosines, size_t aCount);
+
+//////////////////////////////////////////////////////
+// Transform Store
+// Position, scale and Euler rotation for many objects, one array per component, so that building
+// their matrices can work on 8 objects per register without shuffling anything in.
+
+typedef struct TransformStore {
+  float* mPositionX;
+  float* mPositionY;
+  float* mPositionZ;
+  float* mScaleX;
+  float* mScaleY;
+  float* mScaleZ;
+  float* mRotationX;
+  float* mRotationY;
+  float* mRotationZ;
+  size_t mCount;
+  size_t mCapacity;
+} TransformStore;
+
+TransformStore CreateTransformStore(size_t aCapacity);
+
+void DestroyTransformStore(TransformStore* aStore);
+
+size_t AddTransform(TransformStore* aStore, float4 aPosition, float4 aScale, float4 aRotation);
+
+float4x4 CreateModelMatrixFromTransformStore(const TransformStore* aStore, size_t aIndex);
+
+#if defined(MATH_AVX2)
+// Standard 8x8 transpose, aRows[i] ends up holding lane i of every input register.
+SDL_TARGETING("avx2") void Transpose8x8_AVX2(__m256 aRows[8]);
+
+// The same closed form as CreateModelMatrix, one object per lane. Each matrix element is computed
+// for 8 objects at once, then two 8x8 transposes turn that into 8 whole matrices.
+SDL_TARGETING("avx2") void BuildTransformStoreMatrices_AVX2(const TransformStore* aStore, float4x4* aResults);
+#endif
+
+// Fills aResults[0, aStore->mCount) with the model matrix of each transform.
+void BuildTransformStoreMatrices(const TransformStore* aStore, float4x4* aResults);
+
+//////////////////////////////////////////////////////
+// Frustum Culling
+
+typedef struct Frustum {
+  // xyz is the inward facing normal and w the distance, so p is inside when Dot(xyz, p) + w >= 0.
+  float4 mPlanes[6];
+  Uint32 mPlanesCount;
+} Frustum;
+
+// Gribb/Hartmann extraction, the planes come straight out of the rows of the matrix. Works for any
+// projection, including the reversed Z infinite one from InfinitePerspectiveProjectionLHOZ.
+Frustum ExtractFrustum(const float4x4* aWorldToNDC);
+
+bool SphereInFrustum(const Frustum* aFrustum, float3 aCenter, float aRadius);
+
+// aExtent is the half size of the box on each axis.
+bool AabbInFrustum(const Frustum* aFrustum, float3 aCenter, float3 aExtent);
+
+// The batch versions take their bounds as separate arrays, and test 4 (SSE2) or 8 (AVX2) against
+// each plane at a time. Indices are appended without branching: every lane writes its index, but
+// the count only moves past the ones that were visible. That never writes beyond aVisible[i].
+#if defined(MATH_SSE2)
+size_t CullSpheres_SSE2(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible);
+
+size_t CullAabbs_SSE2(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible);
+#endif
+
+#if defined(MATH_AVX2)
+SDL_TARGETING("avx2") size_t CullSpheres_AVX2(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible);
+
+SDL_TARGETING("avx2") size_t CullAabbs_AVX2(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible);
+#endif
+
+// Writes the index of every sphere at least partially inside aFrustum to aVisible, in order, and
+// returns how many there were. aVisible needs room for aCount indices.
+size_t CullSpheres(const Frustum* aFrustum, const float* aX, const float* aY, const float* aZ, const float* aRadius, size_t aCount, Uint32* aVisible);
+
+// Same as CullSpheres, for boxes given as centers and half extents.
+size_t CullAabbs(
+  const Frustum* aFrustum,
+  const float* aX, const float* aY, const float* aZ,
+  const float* aExtentX, const float* aExtentY, const float* aExtentZ,
+  size_t aCount, Uint32* aVisible);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared GPU Code
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Everything that can be tuned per machine without recompiling. GetDefaultGpuConfig matches what
+// the examples did before, LoadGpuConfig layers a config file and then the command line over it.
+// Both take the same keys, a file has one "key = value" per line with # starting a comment, the
+// command line takes them as --key=value. Dashes and underscores in keys are interchangeable.
+//   --config=<path>              Config file to read, GpuConfig.ini if it exists otherwise.
+//   --present-mode=<mode>        vsync, mailbox or immediate.
+//   --frames-in-flight=<1-3>     Passed to SDL_SetGPUAllowedFramesInFlight.
+//   --debug[=<true|false>]       Creates the device in debug mode, with validation where available.
+//   --max-fps=<fps>              Frame rate cap, 0 to leave it to the present mode.
+typedef struct GpuConfig {
+  SDL_GPUPresentMode mPresentMode;
+  Uint32 mFramesInFlight;
+  bool mDebug;
+  Uint32 mMaxFramesPerSecond;
+
+  // Shaders and pipelines are created on a ThreadPool while main carries on with the rest of
+  // startup, turn it off to time the same jobs run one after another on the main thread.
+  bool mParallelStartup;
+} GpuConfig;
+
+static const char cGpuConfigDefaultPath[] = "GpuConfig.ini";
+
+GpuConfig GetDefaultGpuConfig(void);
+
+const char* GetPresentModeName(SDL_GPUPresentMode aPresentMode);
+
+bool ParseConfigBool(const char* aValue, bool* aResult);
+
+// strtoul happily wraps "-1" around to the largest value, so signs are rejected up front, and
+// anything that doesn't fit a Uint32 after.
+bool ParseConfigUint(const char* aValue, Uint32* aResult);
+
+// aKey is normalized in place. Logs and returns false for unknown keys or bad values.
+bool ApplyGpuConfigSetting(GpuConfig* aConfig, char* aKey, const char* aValue);
+
+char* TrimConfigString(char* aString);
+
+bool LoadGpuConfigFile(GpuConfig* aConfig, const char* aPath);
+
+// The command line wins over the config file, which wins over the defaults.
+GpuConfig LoadGpuConfig(int aArgumentsCount, char** aArguments);
+
+typedef struct GpuContext {
+  SDL_Window* mWindow;
+  SDL_GPUDevice* mDevice;
+  SDL_PropertiesID mProperties;
+  const char* mShaderEntryPoint;
+  SDL_GPUShaderFormat mChosenBackendFormat;
+  const char* mChosenBackendFormatExtension;
+  float4x4 WorldToNDC;
+
+  // What was asked for, except mPresentMode which is what the window actually got.
+  GpuConfig mConfig;
+
+  // When LimitFrameRate lets the next frame start.
+  Uint64 mNextFrameNS;
+} GpuContext;
+
+extern GpuContext gContext;
+
+void CreateGpuContextWithConfig(SDL_Window* aWindow, const GpuConfig* aConfig);
+
+void CreateGpuContext(SDL_Window* aWindow);
+
+void DestroyGpuContext(void);
+
+// Call once a frame, after submitting. Waits out whatever is left of the frame's share of
+// mMaxFramesPerSecond, SDL_DelayPrecise spins through the last bit rather than oversleeping.
+void LimitFrameRate(void);
+
+SDL_GPUShader* CreateShaderForTarget(
+  const char* aTargetName,
+  const char* aShaderFilename,
+  SDL_GPUShaderStage aShaderStage,
+  Uint32 aSamplerCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aStorageBufferCount,
+  Uint32 aStorageTextureCount,
+  SDL_PropertiesID aProperties);
+
+SDL_GPUComputePipeline* CreateComputePipelineForTarget(
+  const char* aTargetName,
+  const char* aShaderFilename,
+  Uint32 aSamplerCount,
+  Uint32 aReadOnlyStorageTextureCount,
+  Uint32 aReadOnlyStorageBufferCount,
+  Uint32 aReadWriteStorageTextureCount,
+  Uint32 aReadWriteStorageBufferCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aThreadCountX,
+  Uint32 aThreadCountY,
+  Uint32 aThreadCountZ);
+
+SDL_GPUBuffer* CreateGPUBuffer(Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName);
+
+SDL_GPUTransferBuffer* CreateTransferBuffer(Uint32 aSize, SDL_GPUTransferBufferUsage aUsage, const char* aName);
+
+SDL_GPUTexture* CreateTexture(Uint32 aWidth, Uint32 aHeight, Uint32 layers_or_depth, Uint32 levels, SDL_GPUTextureUsageFlags aUsage, SDL_GPUTextureFormat aFormat, const char* aName);
+
+//////////////////////////////////////////////////////
+// Upload Batch
+// Collects any number of buffer and texture uploads and submits them as one copy pass. The staging
+// memory is a chain of mapped transfer buffers, each twice the size of the last, and once the batch
+// is recorded they're collapsed into a single transfer buffer big enough for the whole batch. That
+// one is kept and cycled when mapped again, so a batch that's reused doesn't allocate at all.
+// Transfer buffers are only created once something is allocated from them.
+
+typedef struct UploadBlock {
+  SDL_GPUTransferBuffer* mTransferBuffer;
+  Uint8* mMapped;
+  Uint32 mSize;
+  Uint32 mUsed;
+} UploadBlock;
+
+// Where a piece of staging memory lives, mData is where to write it on the CPU.
+typedef struct UploadAllocation {
+  Uint8* mData;
+  SDL_GPUTransferBuffer* mTransferBuffer;
+  Uint32 mOffset;
+} UploadAllocation;
+
+// mBuffer is NULL for texture uploads, which use mTextureRegion instead.
+typedef struct UploadCopy {
+  SDL_GPUTransferBuffer* mTransferBuffer;
+  Uint32 mTransferOffset;
+  SDL_GPUBuffer* mBuffer;
+  Uint32 mBufferOffset;
+  Uint32 mSize;
+  SDL_GPUTextureRegion mTextureRegion;
+  bool mCycle;
+} UploadCopy;
+
+typedef struct UploadBatch {
+  UploadBlock* mBlocks;
+  size_t mBlocksCount;
+  size_t mBlocksCapacity;
+
+  UploadCopy* mCopies;
+  size_t mCopiesCount;
+  size_t mCopiesCapacity;
+
+  // Textures whose mip chains get generated from their top level once the copies are done.
+  SDL_GPUTexture** mMipmapTextures;
+  size_t mMipmapTexturesCount;
+  size_t mMipmapTexturesCapacity;
+
+  // Totals for the uploads recorded so far, for logging.
+  Uint32 mSubmittedBytes;
+  Uint32 mSubmittedCopies;
+} UploadBatch;
+
+// Keeps every staging allocation aligned well enough for any texel block or vertex format.
+static const Uint32 cUploadAlignment = 16;
+
+UploadBatch CreateUploadBatch(Uint32 aInitialSize);
+
+UploadAllocation AllocateUpload(UploadBatch* aBatch, Uint32 aSize);
+
+UploadCopy* PushUploadCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset);
+
+// Copies aSize bytes, starting aSourceOffset bytes into aSource, to aBuffer at aBufferOffset.
+void QueueBufferCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset, SDL_GPUBuffer* aBuffer, Uint32 aBufferOffset, Uint32 aSize);
+
+// The pixels are expected to be tightly packed, aRegion->w by aRegion->h.
+void QueueTextureCopy(UploadBatch* aBatch, const UploadAllocation* aSource, Uint32 aSourceOffset, const SDL_GPUTextureRegion* aRegion);
+
+// Fills in every level below the first from it, after the batch's copies. aTexture needs
+// SDL_GPU_TEXTUREUSAGE_COLOR_TARGET as well as SAMPLER.
+void QueueTextureMipmaps(UploadBatch* aBatch, SDL_GPUTexture* aTexture);
+
+void UploadToBuffer(UploadBatch* aBatch, SDL_GPUBuffer* aBuffer, Uint32 aOffset, const void* aData, Uint32 aSize);
+
+// Records every queued copy into aCopyPass and readies the batch to be filled again.
+void RecordUploadBatch(UploadBatch* aBatch, SDL_GPUCopyPass* aCopyPass);
+
+// Blits each queued texture's top level down its mip chain, has to be recorded after the copy
+// pass that uploaded them has ended.
+void GenerateUploadBatchMipmaps(UploadBatch* aBatch, SDL_GPUCommandBuffer* aCommandBuffer);
+
+// Records the batch into its own command buffer and submits it, the returned fence must be
+// released with SDL_ReleaseGPUFence.
+SDL_GPUFence* SubmitUploadBatch(UploadBatch* aBatch);
+
+void DestroyUploadBatch(UploadBatch* aBatch);
+
+SDL_GPUBuffer* CreateAndUploadBufferBatched(UploadBatch* aBatch, const void* aData, Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName);
+
+//////////////////////////////////////////////////////
+// Compressed Textures
+// DDS and KTX2 files already hold their mips in the format the GPU samples, so they're uploaded
+// as they are. If the device can't sample the format, BC1 through BC5 get decoded to RGBA8 on the
+// CPU instead, which costs the memory back but still draws. BC6H, BC7 and ASTC have no fallback.
+
+typedef struct TextureFile {
+  void* mFileData;
+  SDL_GPUTextureFormat mFormat;
+  Uint32 mWidth;
+  Uint32 mHeight;
+  Uint32 mLevelsCount;
+  const Uint8* mLevels[16];
+  Uint32 mLevelSizes[16];
+} TextureFile;
+
+// Uncompressed formats count as 1x1 blocks. Returns false for formats neither loader produces.
+bool GetTextureFormatBlock(SDL_GPUTextureFormat aFormat, Uint32* aBlockWidth, Uint32* aBlockHeight, Uint32* aBlockSize);
+
+Uint32 GetTextureLevelSize(SDL_GPUTextureFormat aFormat, Uint32 aWidth, Uint32 aHeight);
+
+// What DecodeTextureLevel turns aFormat into, SDL_GPU_TEXTUREFORMAT_INVALID if it can't.
+SDL_GPUTextureFormat GetTextureDecodeFormat(SDL_GPUTextureFormat aFormat);
+
+Uint32 ReadU32(const Uint8* aData);
+
+Uint64 ReadU64(const Uint8* aData);
+
+SDL_GPUTextureFormat DxgiFormatToSDL(Uint32 aFormat);
+
+SDL_GPUTextureFormat VkFormatToSDL(Uint32 aFormat);
+
+// Points each level of aFile at its data, checking that all of it is actually in the file.
+bool SetTextureFileLevel(TextureFile* aFile, Uint32 aLevel, Uint64 aOffset, Uint64 aSize, size_t aFileSize);
+
+// Only plain 2D textures, no arrays, cubemaps or volumes.
+bool ParseDDS(TextureFile* aFile, size_t aFileSize);
+
+// Only plain 2D textures without supercompression, so no Basis Universal or Zstandard.
+bool ParseKTX2(TextureFile* aFile, size_t aFileSize);
+
+// Fills 16 RGBA8 texels from a BC1 color block. BC2 and BC3 always use the four color mode.
+void DecodeBC1Block(const Uint8* aBlock, Uint8* aTexels, bool aAlwaysFourColors);
+
+// The BC3 alpha block, also the single channel of BC4 and both channels of BC5. Writes every
+// aStride bytes starting at aOutput.
+void DecodeBC4Block(const Uint8* aBlock, Uint8* aOutput, int aStride);
+
+void DecodeBlock(SDL_GPUTextureFormat aFormat, const Uint8* aBlock, Uint8* aTexels);
+
+// Decodes a whole level of a format GetTextureDecodeFormat accepts into tightly packed RGBA8.
+void DecodeTextureLevel(SDL_GPUTextureFormat aFormat, const Uint8* aSource, Uint32 aWidth, Uint32 aHeight, Uint8* aDestination);
+
+// Takes ownership of aFileData, which has to stay alive as long as aFile.
+bool ParseTextureFile(TextureFile* aFile, void* aFileData, size_t aFileSize);
+
+void DestroyTextureFile(TextureFile* aFile);
+
+// Uploads every level the file has, there's no generating mipmaps for block compressed formats.
+SDL_GPUTexture* CreateAndUploadTextureFileBatched(UploadBatch* aBatch, const TextureFile* aFile, const char* aName);
+
+SDL_GPUTexture* CreateAndUploadCompressedTextureBatched(UploadBatch* aBatch, const char* aTextureName);
+
+// Enough levels to take the larger side all the way down to 1.
+Uint32 GetMipLevelsCount(Uint32 aWidth, Uint32 aHeight);
+
+// With aGenerateMipmaps the texture gets a full mip chain, generated when the batch is submitted,
+// or by GenerateUploadBatchMipmaps for batches recorded into someone else's copy pass.
+SDL_GPUTexture* CreateAndUploadTextureBatched(UploadBatch* aBatch, const char* aTextureName, bool aGenerateMipmaps);
+
+// Recorded into aCopyPass there's nowhere to generate mipmaps, so only a submit of its own gets them.
+SDL_GPUTexture* CreateAndUploadTexture(SDL_GPUCopyPass* aCopyPass, const char* aTextureName);
+
+SDL_GPUTextureFormat GetSupportedDepthFormat(void);
+
+SDL_GPUBuffer* CreateAndUploadBuffer(const void* aData, Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName);
+
+//////////////////////////////////////////////////////
+// Upload Ring
+// Persistent staging for data that changes every frame. Each of the N frames in flight gets its own
+// slice of staging memory that allocations just bump through, and a fence from the submit that last
+// read it. Coming back around to a slice waits on that fence first, which is counted as a stall, so
+// nothing is written while the GPU could still be copying out of it.
+
+typedef struct UploadRingFrame {
+  SDL_GPUTransferBuffer* mTransferBuffer;
+  SDL_GPUFence* mFence;
+} UploadRingFrame;
+
+typedef struct UploadRing {
+  UploadRingFrame* mFrames;
+  Uint32 mFramesCount;
+  Uint32 mFrameSize;
+  Uint32 mCurrentFrame;
+
+  Uint8* mMapped;
+  Uint32 mUsed;
+
+  // Holds the frame's queued copies, and the staging for anything that didn't fit in the frame's
+  // slice so it spills over rather than failing.
+  UploadBatch mBatch;
+
+  // Statistics, mPeakUsed is the most of a slice any one frame has used.
+  Uint64 mFrameCount;
+  Uint32 mPeakUsed;
+  Uint64 mStalls;
+  Uint64 mStallNS;
+  Uint64 mOverflows;
+} UploadRing;
+
+// A GPU buffer whose contents are rewritten from an UploadRing, usually every frame.
+typedef struct DynamicBuffer {
+  SDL_GPUBuffer* mBuffer;
+  Uint32 mSize;
+} DynamicBuffer;
+
+UploadRing CreateUploadRing(Uint32 aFramesCount, Uint32 aFrameSize);
+
+void BeginUploadRingFrame(UploadRing* aRing);
+
+UploadAllocation AllocateFromUploadRing(UploadRing* aRing, Uint32 aSize);
+
+DynamicBuffer CreateDynamicBuffer(Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName);
+
+void DestroyDynamicBuffer(DynamicBuffer* aBuffer);
+
+// Returns where to write aSize bytes of new contents for aBuffer, starting at aOffset. Rewriting
+// the whole buffer cycles it, so last frame's draws can keep reading the old contents. Partial
+// updates can't cycle, the rest of the buffer would be lost.
+void* UpdateDynamicBuffer(UploadRing* aRing, DynamicBuffer* aBuffer, Uint32 aOffset, Uint32 aSize);
+
+// Records this frame's copies into a copy pass on aCommandBuffer. Has to happen before any pass
+// that reads the buffers, and outside of them.
+void RecordUploadRingFrame(UploadRing* aRing, SDL_GPUCommandBuffer* aCommandBuffer);
+
+// Submits the frame's command buffer in place of SDL_SubmitGPUCommandBuffer, keeping its fence to
+// guard this frame's slice.
+bool SubmitUploadRingFrame(UploadRing* aRing, SDL_GPUCommandBuffer* aCommandBuffer);
+
+void DestroyUploadRing(UploadRing* aRing);
+
+//////////////////////////////////////////////////////
+// Buffer Heap
+// A buddy allocator over a few large GPU buffers, so vertex and index data from any number of
+// models can share the same bindings. Every block is a power of two multiple of the smallest block
+// and naturally aligned to its size, so freeing merges a block back with its buddy whenever the
+// buddy is free as well.
+
+typedef enum BufferHeapBlockState {
+  BufferHeapBlockState_Interior,
+  BufferHeapBlockState_Free,
+  BufferHeapBlockState_Used,
+} BufferHeapBlockState;
+
+typedef struct BufferHeapPage {
+  SDL_GPUBuffer* mBuffer;
+  Uint32 mSize;
+  Uint32 mBlocksCount;
+  Uint32 mMaxOrder;
+
+  // Indexed by smallest block, mOrders and the free list links only mean something at the
+  // start of a block.
+  Uint8* mOrders;
+  Uint8* mStates;
+  Uint32* mNext;
+  Uint32* mPrev;
+  Uint32 mFreeLists[32];
+
+  Uint32 mAllocatedBytes;
+} BufferHeapPage;
+
+typedef struct BufferHeap {
+  BufferHeapPage* mPages;
+  size_t mPagesCount;
+  size_t mPagesCapacity;
+
+  Uint32 mPageSize;
+  SDL_GPUBufferUsageFlags mUsage;
+  const char* mName;
+
+  // Live totals, mAllocatedBytes counts whole blocks so the difference is lost to rounding up.
+  Uint64 mAllocatedBytes;
+  Uint64 mRequestedBytes;
+  Uint32 mAllocationsCount;
+} BufferHeap;
+
+// mBuffer is NULL if the allocation failed.
+typedef struct BufferHeapAllocation {
+  SDL_GPUBuffer* mBuffer;
+  Uint32 mOffset;
+  Uint32 mSize;
+  Uint32 mBlockSize;
+  Uint32 mPage;
+} BufferHeapAllocation;
+
+typedef struct BufferHeapStats {
+  Uint32 mPagesCount;
+  Uint64 mReservedBytes;
+  Uint64 mAllocatedBytes;
+  Uint64 mRequestedBytes;
+  Uint32 mAllocationsCount;
+  Uint32 mLargestFreeBlock;
+} BufferHeapStats;
+
+static const Uint32 cBufferHeapNoBlock = 0xFFFFFFFF;
+
+// Comfortably covers the offset alignment of any vertex format or index size.
+static const Uint32 cBufferHeapMinBlockSize = 256;
+
+Uint32 NextPowerOfTwo(Uint32 aValue);
+
+Uint32 Log2(Uint32 aPowerOfTwo);
+
+void PushBufferHeapFreeBlock(BufferHeapPage* aPage, Uint32 aBlock);
+
+void RemoveBufferHeapFreeBlock(BufferHeapPage* aPage, Uint32 aBlock);
+
+BufferHeapPage CreateBufferHeapPage(BufferHeap* aHeap, Uint32 aSize);
+
+void DestroyBufferHeapPage(BufferHeapPage* aPage);
+
+// Returns the first smallest block of the allocation, or cBufferHeapNoBlock if the page is too full.
+Uint32 AllocateBufferHeapBlock(BufferHeapPage* aPage, Uint32 aOrder);
+
+void FreeBufferHeapBlock(BufferHeapPage* aPage, Uint32 aBlock);
+
+// aPageSize is rounded up to a power of two, allocations bigger than it get a page to themselves.
+BufferHeap CreateBufferHeap(Uint32 aPageSize, SDL_GPUBufferUsageFlags aUsage, const char* aName);
+
+BufferHeapAllocation AllocateFromBufferHeap(BufferHeap* aHeap, Uint32 aSize, Uint32 aAlignment);
+
+// Pages that end up empty are released, other than the last one standing.
+void FreeFromBufferHeap(BufferHeap* aHeap, BufferHeapAllocation* aAllocation);
+
+BufferHeapStats GetBufferHeapStats(const BufferHeap* aHeap);
+
+int CompareBufferHeapAllocationsBySize(const void* aLeft, const void* aRight);
+
+// Moves every allocation into new pages, biggest first so the buddies pack with no holes, and
+// records the copies into aCopyPass. aAllocations has to hold every live allocation, they're
+// updated in place, so anything built from their buffers or offsets has to be rebuilt after.
+// Returns false, without touching anything, if it wouldn't free up at least one page.
+bool DefragmentBufferHeap(BufferHeap* aHeap, SDL_GPUCopyPass* aCopyPass, BufferHeapAllocation** aAllocations, size_t aAllocationsCount);
+
+void DestroyBufferHeap(BufferHeap* aHeap);
+
+//////////////////////////////////////////////////////
+// Upload Worker
+// A thread of its own for loading and uploading, so none of it happens on the frame loop. Jobs run
+// on the worker, filling in its UploadBatch, and each job's batch goes out in its own submit. The
+// render thread only hears about a job once the fence of that submit has signaled, at which point
+// everything the job created is safe to use.
+
+// Runs on the worker thread, queues the job's uploads into aBatch.
+typedef void (*UploadJobFunction)(UploadBatch* aBatch, void* aUserData);
+
+// Runs on the render thread, from PublishUploadJobs, once the job's uploads have landed.
+typedef void (*UploadJobPublishFunction)(void* aUserData);
+
+typedef struct UploadJob {
+  UploadJobFunction mRun;
+  UploadJobPublishFunction mPublish;
+  void* mUserData;
+  SDL_GPUFence* mFence;
+} UploadJob;
+
+typedef struct UploadJobQueue {
+  UploadJob* mJobs;
+  size_t mCount;
+  size_t mCapacity;
+} UploadJobQueue;
+
+typedef struct UploadWorker {
+  SDL_Thread* mThread;
+  SDL_Mutex* mMutex;
+  SDL_Condition* mCondition;
+  bool mRunning;
+
+  // Guarded by mMutex.
+  UploadJobQueue mPending;
+  UploadJobQueue mCompleted;
+
+  // Only ever touched by the worker thread.
+  UploadJobQueue mInFlight;
+  UploadBatch mBatch;
+} UploadWorker;
+
+void PushUploadJob(UploadJobQueue* aQueue, const UploadJob* aJob);
+
+// Jobs are run in the order they were queued.
+UploadJob PopUploadJob(UploadJobQueue* aQueue);
+
+// Moves every in flight job whose fence has signaled over to the completed queue.
+void RetireUploadJobs(UploadWorker* aWorker);
+
+int UploadWorkerThread(void* aUserData);
+
+UploadWorker* CreateUploadWorker(void);
+
+// aUserData has to stay alive until aPublish has been called with it.
+void QueueUploadJob(UploadWorker* aWorker, UploadJobFunction aRun, UploadJobPublishFunction aPublish, void* aUserData);
+
+// Call from the render thread, once a frame. Returns how many jobs were published.
+size_t PublishUploadJobs(UploadWorker* aWorker);
+
+// Waits for the worker to finish every job it was given, and publishes them.
+void DestroyUploadWorker(UploadWorker* aWorker);
+
+//////////////////////////////////////////////////////
+// Sampler Cache
+// Samplers are tiny and there are only so many distinct ones, but loaders tend to ask for one per
+// material. Asking the cache instead hands back the same SDL_GPUSampler for the same create info,
+// counting references so it's only released when the last user is done with it. props isn't part
+// of the key, a sampler keeps whatever name it was first created with.
+
+static const Uint32 cSamplerCacheNoEntry = 0xFFFFFFFF;
+
+typedef struct SamplerCacheEntry {
+  SDL_GPUSamplerCreateInfo mInfo;
+  SDL_GPUSampler* mSampler;
+  Uint32 mHash;
+  Uint32 mReferences;
+
+  // Next entry in the same bucket, or in the free list once released.
+  Uint32 mNext;
+} SamplerCacheEntry;
+
+typedef struct SamplerCache {
+  SamplerCacheEntry* mEntries;
+  Uint32 mEntriesCount;
+  Uint32 mEntriesCapacity;
+  Uint32 mFreeEntries;
+
+  // Power of two, each is the first entry of its chain.
+  Uint32* mBuckets;
+  Uint32 mBucketsCount;
+
+  // Statistics, mSamplersCount is how many samplers are alive right now.
+  Uint32 mSamplersCount;
+  Uint64 mHits;
+  Uint64 mMisses;
+} SamplerCache;
+
+Uint32 HashBytes(Uint32 aHash, const void* aData, size_t aSize);
+
+// Field by field so neither padding nor props end up in the key.
+Uint32 HashSamplerCreateInfo(const SDL_GPUSamplerCreateInfo* aInfo);
+
+bool SamplerCreateInfosEqual(const SDL_GPUSamplerCreateInfo* aLeft, const SDL_GPUSamplerCreateInfo* aRight);
+
+SamplerCache CreateSamplerCache(void);
+
+// Keeps the chains short by doubling the buckets once there are more samplers than buckets.
+void GrowSamplerCacheBuckets(SamplerCache* aCache);
+
+// Every sampler acquired has to be given back with ReleaseCachedSampler rather than released.
+SDL_GPUSampler* AcquireCachedSampler(SamplerCache* aCache, const SDL_GPUSamplerCreateInfo* aInfo);
+
+void ReleaseCachedSampler(SamplerCache* aCache, SDL_GPUSampler* aSampler);
+
+void DestroySamplerCache(SamplerCache* aCache);
+
+//////////////////////////////////////////////////////
+// Pipeline Cache
+// Same idea as the Sampler Cache, but for graphics pipelines, which are far more expensive to create.
+// The whole create info is flattened into a key, following the vertex layout and color target
+// pointers, so two create infos built separately still match. Shaders are keyed by pointer, so
+// sharing a pipeline means sharing the SDL_GPUShader objects as well. props isn't part of the key.
+// Safe to use from several threads.
+
+static const Uint32 cPipelineCacheNoEntry = 0xFFFFFFFF;
+
+typedef struct PipelineKey {
+  Uint8* mData;
+  Uint32 mSize;
+  Uint32 mCapacity;
+} PipelineKey;
+
+typedef struct PipelineCacheEntry {
+  // Owned copy of the key the pipeline was created with.
+  Uint8* mKey;
+  Uint32 mKeySize;
+  SDL_GPUGraphicsPipeline* mPipeline;
+  Uint32 mHash;
+  Uint32 mReferences;
+
+  // Next entry in the same bucket, or in the free list once released.
+  Uint32 mNext;
+} PipelineCacheEntry;
+
+typedef struct PipelineCache {
+  // Held for lookups and bookkeeping, but not while a pipeline is being created.
+  SDL_Mutex* mMutex;
+
+  PipelineCacheEntry* mEntries;
+  Uint32 mEntriesCount;
+  Uint32 mEntriesCapacity;
+  Uint32 mFreeEntries;
+
+  // Power of two, each is the first entry of its chain.
+  Uint32* mBuckets;
+  Uint32 mBucketsCount;
+
+  // Statistics, mPipelinesCount is how many pipelines are alive right now and mCreateTimeNS is the
+  // time spent in SDL_CreateGPUGraphicsPipeline over every miss, summed across threads. A miss that
+  // lost the race to another thread creating the same pipeline is also counted in mLostRaces.
+  Uint32 mPipelinesCount;
+  Uint64 mHits;
+  Uint64 mMisses;
+  Uint64 mLostRaces;
+  Uint64 mCreateTimeNS;
+} PipelineCache;
+
+void AppendPipelineKey(PipelineKey* aKey, const void* aData, size_t aSize);
+
+// Field by field so neither padding nor props end up in the key.
+void BuildPipelineKey(PipelineKey* aKey, const SDL_GPUGraphicsPipelineCreateInfo* aInfo);
+
+PipelineCache CreatePipelineCache(void);
+
+// Keeps the chains short by doubling the buckets once there are more pipelines than buckets.
+void GrowPipelineCacheBuckets(PipelineCache* aCache);
+
+// Called with mMutex held, adds a reference to the pipeline if it finds one. Leaves the statistics
+// to the caller.
+SDL_GPUGraphicsPipeline* FindCachedPipeline(PipelineCache* aCache, const PipelineKey* aKey, Uint32 aHash);
+
+// Every pipeline acquired has to be given back with ReleaseCachedPipeline rather than released.
+SDL_GPUGraphicsPipeline* AcquireCachedPipeline(PipelineCache* aCache, const SDL_GPUGraphicsPipelineCreateInfo* aInfo);
+
+void ReleaseCachedPipeline(PipelineCache* aCache, SDL_GPUGraphicsPipeline* aPipeline);
+
+void DestroyPipelineCache(PipelineCache* aCache);
+
+//////////////////////////////////////////////////////
+// Shader Cache
+// CreateShader reads the file and creates a new SDL_GPUShader on every call, even when another
+// pipeline already loaded the same one. The cache keeps every shader it creates alive until it's
+// destroyed, keyed by name, stage and resource counts, so pipelines can share them. It also times
+// the file loads and shader creation separately, per shader and in total. Safe to use from several
+// threads.
+
+typedef struct ShaderDescription {
+  const char* mName;
+  SDL_GPUShaderStage mStage;
+  Uint32 mSamplerCount;
+  Uint32 mUniformBufferCount;
+  Uint32 mStorageBufferCount;
+  Uint32 mStorageTextureCount;
+} ShaderDescription;
+
+typedef struct ShaderCacheEntry {
+  // mDescription.mName is owned by the entry.
+  ShaderDescription mDescription;
+  SDL_GPUShader* mShader;
+  Uint32 mHash;
+  Uint64 mLoadTimeNS;
+  Uint64 mCreateTimeNS;
+} ShaderCacheEntry;
+
+typedef struct ShaderCache {
+  // Held for lookups and bookkeeping, but not while a shader is being loaded or created.
+  SDL_Mutex* mMutex;
+  const char* mTargetName;
+  ShaderCacheEntry* mEntries;
+  Uint32 mEntriesCount;
+  Uint32 mEntriesCapacity;
+
+  // Statistics, the times are summed over every shader the cache created. Like the PipelineCache's,
+  // mLostRaces counts the misses whose shader was thrown away for another thread's.
+  Uint64 mHits;
+  Uint64 mMisses;
+  Uint64 mLostRaces;
+  Uint64 mLoadTimeNS;
+  Uint64 mCreateTimeNS;
+} ShaderCache;
+
+Uint32 HashShaderDescription(const ShaderDescription* aDescription);
+
+bool ShaderDescriptionsEqual(const ShaderDescription* aLeft, const ShaderDescription* aRight);
+
+ShaderCache CreateShaderCacheForTarget(const char* aTargetName);
+
+// Called with mMutex held. A technique only has a handful of shaders, a linear walk over the hashes
+// is plenty.
+ShaderCacheEntry* FindCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription, Uint32 aHash);
+
+void* LoadShaderCode(ShaderCache* aCache, const char* aName, size_t* aSize, Uint64* aLoadTimeNS);
+
+// Takes ownership of aCode.
+SDL_GPUShader* CreateCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription, Uint32 aHash, void* aCode, size_t aCodeSize, Uint64 aLoadTimeNS);
+
+// Loads and creates every shader of a technique that isn't cached yet. All the files are read
+// first and only then handed to the driver, rather than alternating between the two.
+bool PreloadShaders(ShaderCache* aCache, const ShaderDescription* aShaders, Uint32 aShadersCount);
+
+// The shader belongs to the cache, don't release it.
+SDL_GPUShader* GetCachedShader(ShaderCache* aCache, const ShaderDescription* aDescription);
+
+void LogShaderCache(const ShaderCache* aCache);
+
+void DestroyShaderCache(ShaderCache* aCache);
+
+//////////////////////////////////////////////////////
+// Thread Pool
+// A handful of worker threads running small jobs, for work like shader and pipeline creation that
+// doesn't have to happen on the main thread. Jobs can depend on jobs added before them and are only
+// run once those have finished. Jobs are added and waited on from a single thread.
+
+typedef void (*ThreadPoolJobFunction)(void* aUserData);
+
+typedef struct ThreadPoolJob {
+  ThreadPoolJobFunction mRun;
+  void* mUserData;
+
+  // Dependencies that haven't finished yet, the job is only ready once this reaches zero.
+  Uint32 mWaitingOn;
+  bool mFinished;
+
+  // Jobs waiting on this one.
+  Uint32* mDependents;
+  Uint32 mDependentsCount;
+  Uint32 mDependentsCapacity;
+} ThreadPoolJob;
+
+typedef struct ThreadPool {
+  SDL_Thread** mThreads;
+  Uint32 mThreadsCount;
+  SDL_Mutex* mMutex;
+  SDL_Condition* mJobReady;
+  SDL_Condition* mJobFinished;
+  bool mRunning;
+
+  // Guarded by mMutex. A job's handle is its index in mJobs, which is only cleared by
+  // WaitThreadPool, so mReady never holds more than mJobsCapacity handles.
+  ThreadPoolJob* mJobs;
+  Uint32 mJobsCount;
+  Uint32 mJobsCapacity;
+  Uint32* mReady;
+  Uint32 mReadyBegin;
+  Uint32 mReadyEnd;
+  Uint32 mUnfinishedCount;
+} ThreadPool;
+
+// Called with mMutex held, which is dropped while the job runs.
+void RunThreadPoolJob(ThreadPool* aPool, Uint32 aIndex);
+
+int ThreadPoolThread(void* aUserData);
+
+// With no threads, every job is run by WaitThreadPool on the calling thread instead.
+ThreadPool* CreateThreadPool(Uint32 aThreadsCount);
+
+// Returns the job's handle, which is what later jobs pass in aDependencies to wait on it.
+Uint32 AddThreadPoolJob(ThreadPool* aPool, ThreadPoolJobFunction aRun, void* aUserData, const Uint32* aDependencies, Uint32 aDependenciesCount);
+
+// Helps run jobs until every one added so far has finished, after which their handles are reused.
+void WaitThreadPool(ThreadPool* aPool);
+
+void DestroyThreadPool(ThreadPool* aPool);
+
+#ifdef __cplusplus
+}
+#endif
+
+// The few helpers only the earlier examples use, which 014 doesn't carry.
+#include "GpuCommonExtras.h"
+
+// The functions that look for files under the example's own name take it as a parameter, these pass
+// the including example's TARGET_NAME through.
+#ifdef TARGET_NAME
+static inline SDL_GPUShader* CreateShader(
+  const char* aShaderFilename,
+  SDL_GPUShaderStage aShaderStage,
+  Uint32 aSamplerCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aStorageBufferCount,
+  Uint32 aStorageTextureCount,
+  SDL_PropertiesID aProperties)
+{
+  return CreateShaderForTarget(
+    TARGET_NAME,
+    aShaderFilename,
+    aShaderStage,
+    aSamplerCount,
+    aUniformBufferCount,
+    aStorageBufferCount,
+    aStorageTextureCount,
+    aProperties);
+}
+
+static inline SDL_GPUComputePipeline* CreateComputePipeline(
+  const char* aShaderFilename,
+  Uint32 aSamplerCount,
+  Uint32 aReadOnlyStorageTextureCount,
+  Uint32 aReadOnlyStorageBufferCount,
+  Uint32 aReadWriteStorageTextureCount,
+  Uint32 aReadWriteStorageBufferCount,
+  Uint32 aUniformBufferCount,
+  Uint32 aThreadCountX,
+  Uint32 aThreadCountY,
+  Uint32 aThreadCountZ)
+{
+  return CreateComputePipelineForTarget(
+    TARGET_NAME,
+    aShaderFilename,
+    aSamplerCount,
+    aReadOnlyStorageTextureCount,
+    aReadOnlyStorageBufferCount,
+    aReadWriteStorageTextureCount,
+    aReadWriteStorageBufferCount,
+    aUniformBufferCount,
+    aThreadCountX,
+    aThreadCountY,
+    aThreadCountZ);
+}
+
+static inline ShaderCache CreateShaderCache(void)
+{
+  return CreateShaderCacheForTarget(TARGET_NAME);
+}
+#endif
+
+#endif // SDL_GPU_COMMON_H
@@ -0,0 +1,36 @@
+#ifndef SDL_GPU_COMMON_EXTRAS_H
+#define SDL_GPU_COMMON_EXTRAS_H
+
+// Helpers that 008 and 010 carry in their own MATH sections but 014 doesn't, kept apart from
+// GpuCommon.c so it stays the code 014 uses. Included at the end of GpuCommon.h.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Transform {
+  float4 mPosition;
+  float4 mScale;
+  float4 mRotation;
+} Transform;
+
+typedef struct Orientation {
+  float3 mForward;
+  float3 mRight;
+  float3 mUp;
+} Orientation;
+
+Transform GetDefaultTransform(void);
+float4 Float4_From3(float3 aFloat3, float aW);
+float2 Float2_Multiply(float2 aLeft, float2 aRight);
+float3 Float3_Multiply(float3 aLeft, float3 aRight);
+float4 Float4_Multiply(float4 aLeft, float4 aRight);
+float4x4 Float4x4_Inverse(const float4x4* aValue);
+float4x4 CreateModelMatrixFromTransform(const Transform* aTransform);
+Orientation GetOrientation(const Transform* aTransform);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDL_GPU_COMMON_EXTRAS_H
@@ -10,6 +10,11 @@
 namespace cpp_test {
 #endif
 
+// When built in the full repo with SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY, the MATH and Shared GPU Code
+// sections come from the sdl_gpu_common library (code/common) instead of being compiled again here.
+#ifdef SDL_GPU_COMMON
+#include "GpuCommon.h"
+#else
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MATH
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -427,6 +432,8 @@ SDL_GPUTexture* CreateAndUploadTexture(SDL_GPUCopyPass* aCopyPass, const char* a
   return texture;
 }
 
+#endif // SDL_GPU_COMMON
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Technique Code
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
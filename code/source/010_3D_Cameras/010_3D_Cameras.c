@@ -10,6 +10,11 @@
 namespace cpp_test {
 #endif
 
+// When built in the full repo with SDL_GPU_BY_EXAMPLE_COMMON_LIBRARY, the MATH and Shared GPU Code
+// sections come from the sdl_gpu_common library (code/common) instead of being compiled again here.
+#ifdef SDL_GPU_COMMON
+#include "GpuCommon.h"
+#else
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MATH
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -399,6 +404,47 @@ float4x4 Float4x4_Inverse(const float4x4* aValue)
   return toReturn;
 }
 
+// Inverse for matrices whose bottom row is (0, 0, 0, 1), which is everything CreateModelMatrix
+// produces. Only the upper 3x3 needs a real inverse, and the translation then falls out of it.
+float4x4 Float4x4_AffineInverse(const float4x4* aValue)
+{
+  const float3 a = Float4_XYZ(aValue->columns[0]);
+  const float3 b = Float4_XYZ(aValue->columns[1]);
+  const float3 c = Float4_XYZ(aValue->columns[2]);
+  const float3 d = Float4_XYZ(aValue->columns[3]);
+
+  // The rows of the inverse of [a b c] are the cross products of its columns, over the determinant.
+  const float3 bc = Float3_Cross(b, c);
+  const float determinant_inverse = 1.0f / Float3_Dot(a, bc);
+
+  const float3 row0 = Float3_Scalar_Multiply(bc, determinant_inverse);
+  const float3 row1 = Float3_Scalar_Multiply(Float3_Cross(c, a), determinant_inverse);
+  const float3 row2 = Float3_Scalar_Multiply(Float3_Cross(a, b), determinant_inverse);
+
+  float4x4 toReturn;
+  toReturn.data[0][0] = row0.x;
+  toReturn.data[0][1] = row1.x;
+  toReturn.data[0][2] = row2.x;
+  toReturn.data[0][3] = 0.0f;
+
+  toReturn.data[1][0] = row0.y;
+  toReturn.data[1][1] = row1.y;
+  toReturn.data[1][2] = row2.y;
+  toReturn.data[1][3] = 0.0f;
+
+  toReturn.data[2][0] = row0.z;
+  toReturn.data[2][1] = row1.z;
+  toReturn.data[2][2] = row2.z;
+  toReturn.data[2][3] = 0.0f;
+
+  toReturn.data[3][0] = -Float3_Dot(row0, d);
+  toReturn.data[3][1] = -Float3_Dot(row1, d);
+  toReturn.data[3][2] = -Float3_Dot(row2, d);
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
+}
+
 
 ////////////////////////////////////////////////////////////
 /// Core Matrices
@@ -478,14 +524,40 @@ float4x4 RotationMatrix(float4 aPosition) {
   return Float4x4_Multiply(&zRotation, &xyRotation);
 }
 
+// Same result as TranslationMatrix * RotationMatrix * ScaleMatrix, written out directly. The rotation
+// is Z * Y * X, so each axis only needs one sin and cos, and scaling and translating it only touch
+// the columns, none of the intermediate 4x4 multiplies are needed.
 float4x4 CreateModelMatrix(float4 aPosition, float4 aScale, float4 aRotation) {
-  float4x4 translation = TranslationMatrix(aPosition);
-  float4x4 rotation = RotationMatrix(aRotation);
-  float4x4 scale = ScaleMatrix(aScale);
+  const float sx = SDL_sinf(aRotation.x);
+  const float cx = SDL_cosf(aRotation.x);
+  const float sy = SDL_sinf(aRotation.y);
+  const float cy = SDL_cosf(aRotation.y);
+  const float sz = SDL_sinf(aRotation.z);
+  const float cz = SDL_cosf(aRotation.z);
+
+  float4x4 toReturn;
 
-  float4x4 scale_rotation = Float4x4_Multiply(&rotation, &scale);
+  toReturn.data[0][0] = (cy * cz) * aScale.x;
+  toReturn.data[0][1] = (cy * sz) * aScale.x;
+  toReturn.data[0][2] = -sy * aScale.x;
+  toReturn.data[0][3] = 0.0f;
 
-  return Float4x4_Multiply(&translation, &scale_rotation);
+  toReturn.data[1][0] = (cz * sy * sx - sz * cx) * aScale.y;
+  toReturn.data[1][1] = (sz * sy * sx + cz * cx) * aScale.y;
+  toReturn.data[1][2] = (cy * sx) * aScale.y;
+  toReturn.data[1][3] = 0.0f;
+
+  toReturn.data[2][0] = (cz * sy * cx + sz * sx) * aScale.z;
+  toReturn.data[2][1] = (sz * sy * cx - cz * sx) * aScale.z;
+  toReturn.data[2][2] = (cy * cx) * aScale.z;
+  toReturn.data[2][3] = 0.0f;
+
+  toReturn.data[3][0] = aPosition.x;
+  toReturn.data[3][1] = aPosition.y;
+  toReturn.data[3][2] = aPosition.z;
+  toReturn.data[3][3] = 1.0f;
+
+  return toReturn;
 }
 
 float4x4 CreateModelMatrixFromTransform(const Transform* aTransform) {
@@ -893,6 +965,8 @@ SDL_GPUBuffer* CreateAndUploadBuffer(const void* aData, Uint32 aSize, SDL_GPUBuf
   return buffer;
 }
 
+#endif // SDL_GPU_COMMON
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Technique Code
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1275,7 +1349,7 @@ int main(int argc, char** argv)
     );
 
     float4x4 modelMatrix = CreateModelMatrixFromTransform(&cameraTransform);
-    float4x4 viewMatrix = Float4x4_Inverse(&modelMatrix);
+    float4x4 viewMatrix = Float4x4_AffineInverse(&modelMatrix);
 
     SDL_PushGPUVertexUniformData(commandBuffer, 0, &viewMatrix, sizeof(viewMatrix));
 
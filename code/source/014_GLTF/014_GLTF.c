@@ -13,1244 +13,1834 @@
 namespace cpp_test {
 #endif
 
+// The MATH and Shared GPU Code sections live in code/common, they're shared with the earlier examples.
+#include "GpuCommon.h"
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// MATH
+// CGLTF Code
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-typedef struct float2 {
-  float x, y;
-} float2;
-
-typedef struct float3 {
-  float x, y, z;
-} float3;
-
-typedef struct float4 {
-  float x, y, z, w;
-} float4;
-
-typedef struct float4x4 {
-  union {
-    float4 columns[4];
-    float data[4][4];
-  };
-} float4x4;
-
-//////////////////////////////////////////////////////
-// Downcasts
-
-float2 Float3_XY(float3 aValue) {
-  float2 toReturn = { aValue.x, aValue.y };
-  return toReturn;
-}
-
-float2 Float4_XY(float4 aValue) {
-  float2 toReturn = { aValue.x, aValue.y };
-  return toReturn;
-}
-
-float3 Float4_XYZ(float4 aValue) {
-  float3 toReturn = { aValue.x, aValue.y, aValue.z };
-  return toReturn;
-}
+typedef struct SceneInfo {
+  Uint32 mIndicesCount;
+  Uint32 mPrimitivesCount;
+  Uint32 mPositionBytes;
+  Uint32 mNormalBytes;
+  Uint32 mTangentBytes;
+  Uint32 mTexcoordBytes;
+  Uint32 mTotalNodes;
+  Uint32 mRootNodes;
+} SceneInfo;
 
-//////////////////////////////////////////////////////
-// Subtraction
 
-float2 Float2_Subtract(float2 aLeft, float2 aRight) {
-  float2 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y };
-  return toReturn;
-}
+void ProcessNodeInfo(cgltf_node* aNode, SceneInfo* aSceneInfo)
+{
+  aSceneInfo->mTotalNodes += aNode->children_count;
 
-float3 Float3_Subtract(float3 aLeft, float3 aRight) {
-  float3 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z };
-  return toReturn;
-}
+  for (size_t i = 0; i < aNode->children_count; ++i) {
+    ProcessNodeInfo(aNode->children[i], aSceneInfo);
+  }
 
-float4 Float4_Subtract(float4 aLeft, float4 aRight) {
-  float4 toReturn = { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z, aLeft.w - aRight.w };
-  return toReturn;
-}
+  cgltf_mesh* mesh = aNode->mesh;
+  if (mesh == NULL) {
+    return;
+  }
 
-//////////////////////////////////////////////////////
-// Addition
+  aSceneInfo->mPrimitivesCount += (Uint32)mesh->primitives_count;
 
-float2 Float2_Add(float2 aLeft, float2 aRight) {
-  float2 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y };
-  return toReturn;
-}
+  for (size_t j = 0; j < mesh->primitives_count; ++j) {
+    cgltf_primitive* primitive = &mesh->primitives[j];
 
-float3 Float3_Add(float3 aLeft, float3 aRight) {
-  float3 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z };
-  return toReturn;
-}
+    aSceneInfo->mIndicesCount += primitive->indices->count;
 
-float4 Float4_Add(float4 aLeft, float4 aRight) {
-  float4 toReturn = { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z, aLeft.w + aRight.w };
-  return toReturn;
-}
+    SDL_assert(primitive->indices->type == cgltf_type_scalar);
+    SDL_assert(primitive->indices->component_type == cgltf_component_type_r_32u);
 
-//////////////////////////////////////////////////////
-// Scalar Addition
+    for (size_t k = 0; k < primitive->attributes_count; ++k) {
+      cgltf_attribute* attribute = &primitive->attributes[k];
 
-float2 Float2_Scalar_Add(float2 aLeft, float aRight) {
-  float2 toReturn = { aLeft.x + aRight, aLeft.y + aRight };
-  return toReturn;
-}
+      //primitive->material->
 
-float3 Float3_Scalar_Add(float3 aLeft, float aRight) {
-  float3 toReturn = { aLeft.x + aRight, aLeft.y + aRight, aLeft.z + aRight };
-  return toReturn;
-}
+      switch (attribute->type) {
+        case cgltf_attribute_type_position: {
+          SDL_assert(attribute->data->type == cgltf_type_vec3);
+          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
+          aSceneInfo->mPositionBytes += attribute->data->count * sizeof(float3);
 
-float4 Float4_Scalar_Add(float4 aLeft, float aRight) {
-  float4 toReturn = { aLeft.x + aRight, aLeft.y + aRight, aLeft.z + aRight, aLeft.w + aRight };
-  return toReturn;
+          // Every vertex gets a normal, tangent and TEXCOORD_0, zeroed if the primitive doesn't have
+          // them, so all of the streams line up and a single vertex offset works for each of them.
+          aSceneInfo->mNormalBytes += attribute->data->count * sizeof(float3);
+          aSceneInfo->mTangentBytes += attribute->data->count * sizeof(float4);
+          aSceneInfo->mTexcoordBytes += attribute->data->count * sizeof(float2);
+          break;
+        }
+        case cgltf_attribute_type_normal: {
+          SDL_assert(attribute->data->type == cgltf_type_vec3);
+          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
+          break;
+        }
+        case cgltf_attribute_type_tangent: {
+          SDL_assert(attribute->data->type == cgltf_type_vec4);
+          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
+          break;
+        }
+        default: break;
+      }
+    }
+  }
 }
 
-//////////////////////////////////////////////////////
-// Scalar Multiplication
 
-float2 Float2_Scalar_Multiply(float2 aLeft, float aRight) {
-  float2 toReturn = { aLeft.x * aRight, aLeft.y * aRight };
-  return toReturn;
-}
+SceneInfo GetSceneInfo(cgltf_data* aData)
+{
+  SceneInfo sceneInfo;
+  SDL_zero(sceneInfo);
 
-float3 Float3_Scalar_Multiply(float3 aLeft, float aRight) {
-  float3 toReturn = { aLeft.x * aRight, aLeft.y * aRight, aLeft.z * aRight };
-  return toReturn;
-}
+  if (!aData) {
+    return sceneInfo;
+  }
 
-float4 Float4_Scalar_Multiply(float4 aLeft, float aRight) {
-  float4 toReturn = { aLeft.x * aRight, aLeft.y * aRight, aLeft.z * aRight, aLeft.w * aRight };
-  return toReturn;
-}
+  if (!aData->scene) {
+    return sceneInfo;
+  }
 
-//////////////////////////////////////////////////////
-// Scalar Multiplication
+  sceneInfo.mRootNodes = (Uint32)aData->scene->nodes_count;
 
-float2 Float2_Scalar_Division(float2 aLeft, float aRight) {
-  float2 toReturn = { aLeft.x / aRight, aLeft.y / aRight };
-  return toReturn;
-}
+  for (size_t i = 0; i < aData->scene->nodes_count; ++i) {
+    sceneInfo.mTotalNodes++;
+    ProcessNodeInfo(aData->scene->nodes[i], &sceneInfo);
+  }
 
-float3 Float3_Scalar_Division(float3 aLeft, float aRight) {
-  float3 toReturn = { aLeft.x / aRight, aLeft.y / aRight, aLeft.z / aRight };
-  return toReturn;
+  return sceneInfo;
 }
 
-float4 Float4_Scalar_Division(float4 aLeft, float aRight) {
-  float4 toReturn = { aLeft.x / aRight, aLeft.y / aRight, aLeft.z / aRight, aLeft.w / aRight };
-  return toReturn;
-}
+// Each glTF primitive is drawn on its own, it has its own material and its indices only cover its
+// own vertices.
+typedef struct Primitive {
+  // Offsets into parent model position/normal/tangent/index buffers
+  Uint32 mPositionOffset;
+  Uint32 mNormalOffset;
+  Uint32 mTangentOffset;
+  Uint32 mTexcoordOffset;
+  Uint32 mIndexOffset;
 
-//////////////////////////////////////////////////////
-// Dot Product
+  Uint32 mIndicesCount;
 
-float Float2_Dot(float2 aLeft, float2 aRight) {
-  return
-    (aLeft.x * aRight.x) +
-    (aLeft.y * aRight.y);
-}
+  // Into Scene::mMaterials.
+  Uint32 mMaterialIndex;
 
-float Float3_Dot(float3 aLeft, float3 aRight) {
-  return
-    (aLeft.x * aRight.x) +
-    (aLeft.y * aRight.y) +
-    (aLeft.z * aRight.z);
-}
+  // Local space bounding box, as a center and half extents.
+  float3 mBoundsCenter;
+  float3 mBoundsExtent;
+} Primitive;
 
-float Float4_Dot(float4 aLeft, float4 aRight) {
-  return
-    (aLeft.x * aRight.x) +
-    (aLeft.y * aRight.y) +
-    (aLeft.z * aRight.z) +
-    (aLeft.w * aRight.w);
-}
+typedef struct Mesh {
+  float4x4 mTransform;
 
-//////////////////////////////////////////////////////
-// Cross Product
+  Uint32 mChildrenOffset;
+  Uint32 mChildrenCount;
 
-float3 Float3_Cross(float3 aLeft, float3 aRight) {
-  float3 toReturn = {
-    (aLeft.y * aRight.z) - (aLeft.z * aRight.y),
-    (aLeft.z * aRight.x) - (aLeft.x * aRight.z),
-    (aLeft.x * aRight.y) - (aLeft.y * aRight.x)
-  };
+  // Into Scene::mPrimitives, zero for the nodes that only carry a transform.
+  Uint32 mFirstPrimitive;
+  Uint32 mPrimitivesCount;
 
-  return toReturn;
-}
+  Uint8 mBaseColorTextureCoordinates;
+  Uint8 mMetallicRoughnessTextureCoordinates;
 
-// Convience function that ignores the 4th component, assuming it was irrelevant.
-float3 Float4_Cross(float4 aLeft, float4 aRight) {
-  float3 toReturn = {
-    (aLeft.y * aRight.z) - (aLeft.z * aRight.y),
-    (aLeft.z * aRight.x) - (aLeft.x * aRight.z),
-    (aLeft.x * aRight.y) - (aLeft.y * aRight.x)
-  };
+  Uint8 mDiffuseTextureCoordinates;
+  Uint8 mSpecularGlossinessTextureCoordinates;
 
-  return toReturn;
-}
+  Uint8 mNormalTextureCoordinates;
+  Uint8 mOcclusionTextureCoordinates;
+  Uint8 mEmissveTextureCoordinates;
+} Mesh;
 
-//////////////////////////////////////////////////////
-// Magnitude
+// Everything the draw loop needs to know about a single drawable Primitive, so it never has to
+// walk the hierarchy or skip over the transform-only nodes.
+typedef struct DrawPacket {
+  // Byte offsets into the buffers backing the Scene position/normal/tangent/texcoord allocations.
+  Uint32 mPositionOffset;
+  Uint32 mNormalOffset;
+  Uint32 mTangentOffset;
+  Uint32 mTexcoordOffset;
 
-float Float2_Magnitude(float2 aValue) {
-  return SDL_sqrt(Float2_Dot(aValue, aValue));
-}
+  // Range within the buffer backing the Scene index allocation, in indices rather than bytes.
+  Uint32 mFirstIndex;
+  Uint32 mIndicesCount;
 
-float Float3_Magnitude(float3 aValue) {
-  return SDL_sqrt(Float3_Dot(aValue, aValue));
-}
+  // Index into Scene::mWorldTransforms.
+  Uint32 mTransformIndex;
 
-float Float4_Magnitude(float4 aValue) {
-  return SDL_sqrt(Float4_Dot(aValue, aValue));
-}
+  // Index into Scene::mMaterials.
+  Uint32 mMaterialIndex;
 
-//////////////////////////////////////////////////////
-// Normalization
+  // Local space bounding box of the Primitive, as a center and half extents.
+  float3 mBoundsCenter;
+  float3 mBoundsExtent;
+} DrawPacket;
 
-float2 Float2_Normalize(float2 aValue) {
-  float magnitude = Float2_Magnitude(aValue);
+// Where a material's base color texture sits in Scene::mMaterialTexture, pushed as is as the
+// fragment uniforms. An atlas entry is scaled and offset into its rectangle of layer 0.
+typedef struct MaterialTexture {
+  float4 mUvScaleOffset;
 
-  float2 toReturn = {
-    aValue.x / magnitude,
-    aValue.y / magnitude
-  };
+  // -1 for materials without a base color texture, which are shaded with their normals instead.
+  Sint32 mLayer;
+  Uint32 mAtlas;
+  Uint32 mPadding[2];
+} MaterialTexture;
 
-  return toReturn;
-}
+typedef struct Scene {
+  // Suballocated out of a shared BufferHeap, so other Scenes can be drawn from the same buffers.
+  BufferHeapAllocation mPositions;
+  BufferHeapAllocation mNormals;
+  BufferHeapAllocation mTangents;
+  BufferHeapAllocation mTexcoords;
+  BufferHeapAllocation mIndices;
+
+  // The base color textures of every material in one 2D array, so the whole Scene draws with a
+  // single texture binding. mMaterials has an extra entry at the end for primitives without one.
+  SDL_GPUTexture* mMaterialTexture;
+  MaterialTexture* mMaterials;
+  size_t mMaterialsCount;
+
+  // The glTF sampler of each material's base color texture, only the filters and wrap modes. The
+  // SamplerCache isn't thread safe, so they're loaded with the Scene but only turned into
+  // mMaterialSamplers by AcquireSceneSamplers once it reaches the render thread.
+  cgltf_sampler* mMaterialGltfSamplers;
+  SDL_GPUSampler** mMaterialSamplers;
 
-float3 Float3_Normalize(float3 aValue) {
-  float magnitude = Float3_Magnitude(aValue);
+  Mesh* mMeshes;
+  size_t mRootMeshesCount;
 
-  float3 toReturn = {
-    aValue.x / magnitude,
-    aValue.y / magnitude,
-    aValue.z / magnitude
-  };
+  Primitive* mPrimitives;
+  size_t mPrimitivesCount;
+  size_t mMeshesCount;
+  //SDL_GPUBuffer* mTextureCoordinates; // float2
 
-  return toReturn;
-}
+  // One per Mesh, kept out of the Mesh itself so the draw loop only touches matrices.
+  float4x4* mWorldTransforms;
 
-float4 Float4_Normalize(float4 aValue) {
-  float magnitude = Float4_Magnitude(aValue);
+  // mWorldTransforms with the model matrix applied, rebuilt in one batch each frame by the CPU path.
+  float4x4* mModelTransforms;
 
-  float4 toReturn = {
-    aValue.x / magnitude,
-    aValue.y / magnitude,
-    aValue.z / magnitude,
-    aValue.w / magnitude
-  };
+  // Parent of each Mesh (cNoParent for roots), and every Mesh sorted by depth in the hierarchy so
+  // that each level can be transformed in parallel once the level above it is done.
+  Uint32* mParents;
+  Uint32* mLevelOrder;
+  Uint32* mLevelOffsets;
+  Uint32 mLevelsCount;
 
-  return toReturn;
-}
+  DrawPacket* mDrawPackets;
+  size_t mDrawPacketsCount;
 
-//////////////////////////////////////////////////////
-// Matrix Operations
+  // World space bounds of each DrawPacket as separate component arrays, refilled every frame for
+  // culling, and the indices of the packets that survived it.
+  float* mPacketCenters[3];
+  float* mPacketExtents[3];
+  Uint32* mVisiblePackets;
+  size_t mVisiblePacketsCount;
+} Scene;
 
-float4 Float4x4_Float4_Multiply(const float4x4* aLeft, const float4 aRight)
+void ApplyMeshTransformToChildren(Scene* aScene, Mesh* aMesh)
 {
-  float4 toReturn;
-  toReturn.x =
-    (aLeft->data[0][0] * aRight.x) +
-    (aLeft->data[1][0] * aRight.y) +
-    (aLeft->data[2][0] * aRight.z) +
-    (aLeft->data[3][0] * aRight.w);
-  toReturn.y =
-    (aLeft->data[0][1] * aRight.x) +
-    (aLeft->data[1][1] * aRight.y) +
-    (aLeft->data[2][1] * aRight.z) +
-    (aLeft->data[3][1] * aRight.w);
-  toReturn.z =
-    (aLeft->data[0][2] * aRight.x) +
-    (aLeft->data[1][2] * aRight.y) +
-    (aLeft->data[2][2] * aRight.z) +
-    (aLeft->data[3][2] * aRight.w);
-  toReturn.w =
-    (aLeft->data[0][3] * aRight.x) +
-    (aLeft->data[1][3] * aRight.y) +
-    (aLeft->data[2][3] * aRight.z) +
-    (aLeft->data[3][3] * aRight.w);
+  const float4x4* parentTransform = aScene->mWorldTransforms + (aMesh - aScene->mMeshes);
+  Mesh* meshChildren = aScene->mMeshes + aMesh->mChildrenOffset;
+  for (size_t i = 0; i < aMesh->mChildrenCount; ++i)
+  {
+    Mesh* childMesh = meshChildren + i;
 
-  return toReturn;
+    aScene->mWorldTransforms[aMesh->mChildrenOffset + i] = Float4x4_Multiply(parentTransform, &childMesh->mTransform);
+    ApplyMeshTransformToChildren(aScene, childMesh);
+  }
 }
 
-float4x4 Float4x4_Multiply(const float4x4* aLeft, const float4x4* aRight)
+void RecalculateSceneTransform(Scene* aScene)
 {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
-
-  for (size_t i = 0; i < 4; ++i)
+  for (size_t i = 0; i < aScene->mRootMeshesCount; ++i)
   {
-    toReturn.data[i][0] =
-      aLeft->data[0][0] * aRight->data[i][0] +
-      aLeft->data[1][0] * aRight->data[i][1] +
-      aLeft->data[2][0] * aRight->data[i][2] +
-      aLeft->data[3][0] * aRight->data[i][3];
-
-    toReturn.data[i][1] =
-      aLeft->data[0][1] * aRight->data[i][0] +
-      aLeft->data[1][1] * aRight->data[i][1] +
-      aLeft->data[2][1] * aRight->data[i][2] +
-      aLeft->data[3][1] * aRight->data[i][3];
-
-    toReturn.data[i][2] =
-      aLeft->data[0][2] * aRight->data[i][0] +
-      aLeft->data[1][2] * aRight->data[i][1] +
-      aLeft->data[2][2] * aRight->data[i][2] +
-      aLeft->data[3][2] * aRight->data[i][3];
-
-    toReturn.data[i][3] =
-      aLeft->data[0][3] * aRight->data[i][0] +
-      aLeft->data[1][3] * aRight->data[i][1] +
-      aLeft->data[2][3] * aRight->data[i][2] +
-      aLeft->data[3][3] * aRight->data[i][3];
+    Mesh* mesh = aScene->mMeshes + i;
+    aScene->mWorldTransforms[i] = mesh->mTransform;
+    ApplyMeshTransformToChildren(aScene, mesh);
   }
-  return toReturn;
 }
 
+static const Uint32 cNoParent = 0xFFFFFFFF;
 
-////////////////////////////////////////////////////////////
-/// Core Matrices
-
-float4x4 IdentityMatrix() {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
+// Children are always laid out after their parents in mMeshes, so a single forward walk is enough to
+// know every parent's depth before we get to its children.
+void BuildHierarchyLevels(Scene* aScene)
+{
+  Uint32 meshesCount = (Uint32)aScene->mMeshesCount;
+  Uint32* depths = SDL_calloc(SDL_max(meshesCount, 1), sizeof(Uint32));
 
-  toReturn.data[0][0] = 1.0f;
-  toReturn.data[1][1] = 1.0f;
-  toReturn.data[2][2] = 1.0f;
-  toReturn.data[3][3] = 1.0f;
+  aScene->mParents = SDL_calloc(SDL_max(meshesCount, 1), sizeof(Uint32));
+  aScene->mLevelOrder = SDL_calloc(SDL_max(meshesCount, 1), sizeof(Uint32));
+  aScene->mLevelsCount = 0;
 
-  return toReturn;
-}
+  for (Uint32 i = 0; i < meshesCount; ++i) {
+    aScene->mParents[i] = cNoParent;
+  }
 
-float4x4 TranslationMatrix(float4 aPosition) {
-  float4x4 toReturn = IdentityMatrix();
+  for (Uint32 i = 0; i < meshesCount; ++i) {
+    Mesh* mesh = aScene->mMeshes + i;
 
-  toReturn.data[3][0] = aPosition.x;
-  toReturn.data[3][1] = aPosition.y;
-  toReturn.data[3][2] = aPosition.z;
+    for (Uint32 j = 0; j < mesh->mChildrenCount; ++j) {
+      aScene->mParents[mesh->mChildrenOffset + j] = i;
+      depths[mesh->mChildrenOffset + j] = depths[i] + 1;
+    }
 
-  return toReturn;
-}
+    aScene->mLevelsCount = SDL_max(aScene->mLevelsCount, depths[i] + 1);
+  }
 
-float4x4 ScaleMatrix(float4 aScale) {
-  float4x4 toReturn = IdentityMatrix();
+  // Counting sort by depth, mLevelOffsets[level] to mLevelOffsets[level + 1] is a single level.
+  aScene->mLevelOffsets = SDL_calloc(aScene->mLevelsCount + 1, sizeof(Uint32));
 
-  toReturn.data[0][0] = aScale.x;
-  toReturn.data[1][1] = aScale.y;
-  toReturn.data[2][2] = aScale.z;
+  for (Uint32 i = 0; i < meshesCount; ++i) {
+    aScene->mLevelOffsets[depths[i] + 1]++;
+  }
 
-  return toReturn;
-}
+  for (Uint32 level = 0; level < aScene->mLevelsCount; ++level) {
+    aScene->mLevelOffsets[level + 1] += aScene->mLevelOffsets[level];
+  }
 
-float4x4 RotationMatrixX(float aAngle) {
-  float4x4 toReturn = IdentityMatrix();
+  Uint32* levelCursor = SDL_calloc(aScene->mLevelsCount + 1, sizeof(Uint32));
+  SDL_memcpy(levelCursor, aScene->mLevelOffsets, (aScene->mLevelsCount + 1) * sizeof(Uint32));
 
-  toReturn.data[1][1] = SDL_cosf(aAngle);
-  toReturn.data[1][2] = SDL_sinf(aAngle);
-  toReturn.data[2][1] = -SDL_sinf(aAngle);
-  toReturn.data[2][2] = SDL_cosf(aAngle);
+  for (Uint32 i = 0; i < meshesCount; ++i) {
+    aScene->mLevelOrder[levelCursor[depths[i]]++] = i;
+  }
 
-  return toReturn;
+  SDL_free(levelCursor);
+  SDL_free(depths);
 }
 
-float4x4 RotationMatrixY(float aAngle) {
-  float4x4 toReturn = IdentityMatrix();
+// Flattens the hierarchy down to just the Primitives that have something to draw, the ones of a
+// Mesh next to each other so they share its transform. Run when the Scene is
+// loaded, and again if its geometry is moved to other buffers. 014 never changes its structure
+// afterwards, moving things around only touches mWorldTransforms.
+void BuildDrawPackets(Scene* aScene)
+{
+  size_t drawableCount = 0;
+  for (size_t i = 0; i < aScene->mPrimitivesCount; ++i) {
+    if (aScene->mPrimitives[i].mIndicesCount != 0) {
+      ++drawableCount;
+    }
+  }
 
-  toReturn.data[0][0] = SDL_cosf(aAngle);
-  toReturn.data[0][2] = -SDL_sinf(aAngle);
-  toReturn.data[2][0] = SDL_sinf(aAngle);
-  toReturn.data[2][2] = SDL_cosf(aAngle);
+  SDL_free(aScene->mDrawPackets);
+  aScene->mDrawPackets = SDL_calloc(SDL_max(drawableCount, 1), sizeof(DrawPacket));
+  aScene->mDrawPacketsCount = 0;
 
-  return toReturn;
-}
+  for (size_t i = 0; i < aScene->mMeshesCount; ++i) {
+    Mesh* mesh = aScene->mMeshes + i;
 
-float4x4 RotationMatrixZ(float aAngle) {
-  float4x4 toReturn = IdentityMatrix();
+    for (size_t j = 0; j < mesh->mPrimitivesCount; ++j) {
+      const Primitive* primitive = aScene->mPrimitives + mesh->mFirstPrimitive + j;
 
-  toReturn.data[0][0] = SDL_cosf(aAngle);
-  toReturn.data[0][1] = SDL_sinf(aAngle);
-  toReturn.data[1][0] = -SDL_sinf(aAngle);
-  toReturn.data[1][1] = SDL_cosf(aAngle);
+      if (primitive->mIndicesCount == 0) {
+        continue;
+      }
 
-  return toReturn;
-}
+      DrawPacket* packet = aScene->mDrawPackets + aScene->mDrawPacketsCount++;
+      packet->mPositionOffset = aScene->mPositions.mOffset + primitive->mPositionOffset;
+      packet->mNormalOffset = aScene->mNormals.mOffset + primitive->mNormalOffset;
+      packet->mTangentOffset = aScene->mTangents.mOffset + primitive->mTangentOffset;
+      packet->mTexcoordOffset = aScene->mTexcoords.mOffset + primitive->mTexcoordOffset;
+      packet->mFirstIndex = (aScene->mIndices.mOffset + primitive->mIndexOffset) / sizeof(Uint32);
+      packet->mIndicesCount = primitive->mIndicesCount;
+      packet->mTransformIndex = (Uint32)i;
+      packet->mMaterialIndex = primitive->mMaterialIndex;
+      packet->mBoundsCenter = primitive->mBoundsCenter;
+      packet->mBoundsExtent = primitive->mBoundsExtent;
+    }
+  }
 
-float4x4 RotationMatrix(float4 aPosition) {
-  float4x4 xRotation = RotationMatrixX(aPosition.x);
-  float4x4 yRotation = RotationMatrixY(aPosition.y);
-  float4x4 zRotation = RotationMatrixZ(aPosition.z);
+  // The culling arrays share one allocation, mPacketCenters[0] owns it.
+  size_t packetsCapacity = SDL_max(drawableCount, 1);
+  SDL_free(aScene->mPacketCenters[0]);
+  SDL_free(aScene->mVisiblePackets);
 
-  float4x4 xyRotation = Float4x4_Multiply(&yRotation, &xRotation);
+  float* bounds = SDL_calloc(6 * packetsCapacity, sizeof(float));
+  for (size_t i = 0; i < 3; ++i) {
+    aScene->mPacketCenters[i] = bounds + (i * packetsCapacity);
+    aScene->mPacketExtents[i] = bounds + ((3 + i) * packetsCapacity);
+  }
 
-  return Float4x4_Multiply(&zRotation, &xyRotation);
+  aScene->mVisiblePackets = SDL_calloc(packetsCapacity, sizeof(Uint32));
+  aScene->mVisiblePacketsCount = 0;
 }
 
-float4x4 RotationMatrixFromQuaternion(float4 aQuaternion) {
-  float x2 = aQuaternion.x * aQuaternion.x;
-  float y2 = aQuaternion.y * aQuaternion.y;
-  float z2 = aQuaternion.z * aQuaternion.z;
-
-  float xy = aQuaternion.x * aQuaternion.y;
-  float xz = aQuaternion.x * aQuaternion.z;
-  float yz = aQuaternion.y * aQuaternion.z;
-
-  float wx = aQuaternion.w * aQuaternion.x;
-  float wy = aQuaternion.w * aQuaternion.y;
-  float wz = aQuaternion.w * aQuaternion.z;
-
-  float4x4 toReturn = IdentityMatrix();
-
-  toReturn.data[0][0] = 1.0f - 2.0f * (y2 - z2);
-  toReturn.data[0][1] =        2.0f * (xy + wz);
-  toReturn.data[0][2] =        2.0f * (xz - wy);
+// Moves the local bounds of every DrawPacket through aTransforms, one per Mesh, then keeps the ones
+// that intersect the frustum of aToNDC in mVisiblePackets. aToNDC has to pick up wherever aTransforms
+// leave off, so mWorldTransforms can be culled without the model matrix by folding it into aToNDC.
+void CullDrawPackets(Scene* aScene, const float4x4* aTransforms, const float4x4* aToNDC)
+{
+  for (size_t i = 0; i < aScene->mDrawPacketsCount; ++i) {
+    const DrawPacket* packet = aScene->mDrawPackets + i;
+    const float4x4* transform = aTransforms + packet->mTransformIndex;
+
+    float4 localCenter = { packet->mBoundsCenter.x, packet->mBoundsCenter.y, packet->mBoundsCenter.z, 1.0f };
+    float4 center = Float4x4_Float4_Multiply(transform, localCenter);
+
+    // The extents of the transformed box, each axis picks up the absolute contribution of every
+    // local axis, which is exact for the box and never smaller than the primitive.
+    for (size_t row = 0; row < 3; ++row) {
+      aScene->mPacketExtents[row][i] =
+        SDL_fabsf(transform->data[0][row]) * packet->mBoundsExtent.x +
+        SDL_fabsf(transform->data[1][row]) * packet->mBoundsExtent.y +
+        SDL_fabsf(transform->data[2][row]) * packet->mBoundsExtent.z;
+    }
 
-  toReturn.data[1][0] =        2.0f * (xy - wz);
-  toReturn.data[1][1] = 1.0f - 2.0f * (x2 - z2);
-  toReturn.data[1][2] =        2.0f * (yz + wx);
+    aScene->mPacketCenters[0][i] = center.x;
+    aScene->mPacketCenters[1][i] = center.y;
+    aScene->mPacketCenters[2][i] = center.z;
+  }
 
-  toReturn.data[2][0] =        2.0f * (xz + wy);
-  toReturn.data[2][1] =        2.0f * (yz - wx);
-  toReturn.data[2][2] = 1.0f - 2.0f * (x2 - y2);
+  Frustum frustum = ExtractFrustum(aToNDC);
 
-  return toReturn;
+  aScene->mVisiblePacketsCount = CullAabbs(
+    &frustum,
+    aScene->mPacketCenters[0], aScene->mPacketCenters[1], aScene->mPacketCenters[2],
+    aScene->mPacketExtents[0], aScene->mPacketExtents[1], aScene->mPacketExtents[2],
+    aScene->mDrawPacketsCount,
+    aScene->mVisiblePackets);
 }
 
-float4x4 CreateModelMatrix(float4 aPosition, float4 aScale, float4 aRotation) {
-  float4x4 translation = TranslationMatrix(aPosition);
-  float4x4 rotation = RotationMatrix(aRotation);
-  float4x4 scale = ScaleMatrix(aScale);
-
-  float4x4 scale_rotation = Float4x4_Multiply(&rotation, &scale);
+typedef struct SceneProcessing {
+  Uint32 mPositionOffset;
+  Uint32 mPositionOffsetSoFar;
+  Uint32 mNormalOffset;
+  Uint32 mNormalOffsetSoFar;
+  Uint32 mTangentOffset;
+  Uint32 mTangentOffsetSoFar;
+  Uint32 mTexcoordOffset;
+  Uint32 mTexcoordOffsetSoFar;
+  Uint32 mIndexOffset;
+  Uint32 mIndexOffsetSoFar;
+  Uint32 mCurrentMeshIndex;
+  Uint32 mCurrentChildrenIndex;
+  Uint32 mCurrentPrimitiveIndex;
 
-  return Float4x4_Multiply(&translation, &scale_rotation);
-}
+  // Primitives without a material use the entry after the last one.
+  const cgltf_material* mMaterials;
+  Uint32 mMaterialsCount;
+} SceneProcessing;
 
-float4x4 CreateModelMatrixWithQuaternion(float4 aPosition, float4 aScale, float4 aRotation) {
-  float4x4 translation = TranslationMatrix(aPosition);
-  float4x4 rotation = RotationMatrixFromQuaternion(aRotation);
-  float4x4 scale = ScaleMatrix(aScale);
+// For minification glTF folds the mipmap mode into the filter, this is only the filter part.
+SDL_GPUFilter GltfFilterToSDL(cgltf_filter_type aFilter)
+{
+  switch (aFilter) {
+    case cgltf_filter_type_nearest: return SDL_GPU_FILTER_NEAREST;
+    case cgltf_filter_type_linear: return SDL_GPU_FILTER_LINEAR;
+    case cgltf_filter_type_nearest_mipmap_nearest: return SDL_GPU_FILTER_NEAREST;
+    case cgltf_filter_type_linear_mipmap_nearest: return SDL_GPU_FILTER_LINEAR;
+    case cgltf_filter_type_nearest_mipmap_linear: return SDL_GPU_FILTER_NEAREST;
+    case cgltf_filter_type_linear_mipmap_linear: return SDL_GPU_FILTER_LINEAR;
 
-  float4x4 scale_rotation = Float4x4_Multiply(&rotation, &scale);
+    // Undefined leaves it up to us, most samplers leave the filters out.
+    case cgltf_filter_type_undefined: return SDL_GPU_FILTER_LINEAR;
 
-  return Float4x4_Multiply(&translation, &scale_rotation);
+    default: {
+      SDL_Log("Using unknown filter, defaulting to SDL_GPU_FILTER_NEAREST");
+      return SDL_GPU_FILTER_NEAREST;
+    }
+  }
 }
 
-float4x4 OrthographicProjectionLHZO(float aLeft, float aRight, float aBottom, float aTop, float aNear, float aFar) {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
-
-  toReturn.data[0][0] = 2.0f / (aRight - aLeft);
-  toReturn.data[1][1] = 2.0f / (aTop - aBottom);
-  toReturn.data[2][2] = 1.0f / (aFar - aNear);
-
-  toReturn.data[3][0] = -(aRight + aLeft) / (aRight - aLeft);
-  toReturn.data[3][1] = -(aTop + aBottom) / (aTop - aBottom);
-  toReturn.data[3][2] = -aNear / (aFar - aNear);
+SDL_GPUSamplerMipmapMode GltfMipmapModeToSDL(cgltf_filter_type aFilter)
+{
+  switch (aFilter) {
+    case cgltf_filter_type_nearest_mipmap_nearest: return SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+    case cgltf_filter_type_linear_mipmap_nearest: return SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+    case cgltf_filter_type_nearest_mipmap_linear: return SDL_GPU_SAMPLERMIPMAPMODE_LINEAR;
+    case cgltf_filter_type_linear_mipmap_linear: return SDL_GPU_SAMPLERMIPMAPMODE_LINEAR;
 
-  toReturn.data[3][3] = 1.0f;
+    // Undefined leaves it up to us, and trilinear is the sensible default.
+    case cgltf_filter_type_undefined: return SDL_GPU_SAMPLERMIPMAPMODE_LINEAR;
 
-  return toReturn;
+    default: return SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+  }
 }
 
-float4x4 PerspectiveProjectionLHZO(float aFovY, float aAspectRatio, float aNear, float aFar) {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
-
-  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
-  const float k = aFar / (aFar - aNear);
+// Plain nearest or linear minification means the sampler should only ever read the top level.
+bool GltfFilterUsesMipmaps(cgltf_filter_type aFilter)
+{
+  return aFilter != cgltf_filter_type_nearest && aFilter != cgltf_filter_type_linear;
+}
 
-  toReturn.data[0][0] = focalLength / aAspectRatio;
-  toReturn.data[1][1] = focalLength;
-  toReturn.data[2][2] = k;
-  toReturn.data[2][3] = 1.0f;
-  toReturn.data[3][2] = -aNear * k;
+SDL_GPUSamplerAddressMode GltfAddressModeToSDL(cgltf_wrap_mode aWrap)
+{
+  switch (aWrap) {
+    case cgltf_wrap_mode_clamp_to_edge: return SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+    case cgltf_wrap_mode_mirrored_repeat: return SDL_GPU_SAMPLERADDRESSMODE_MIRRORED_REPEAT;
+    case cgltf_wrap_mode_repeat: return SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
 
-  return toReturn;
+    default: {
+      SDL_Log("Using unknown address mode, defaulting to SDL_GPU_SAMPLERADDRESSMODE_REPEAT");
+      return SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
+    }
+  }
 }
 
-float4x4 PerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear, float aFar) {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
+// Higher than any texture will have levels, so the whole chain is available.
+static const float cMaxLod = 1000.f;
 
-  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
-  const float k = aNear / (aNear - aFar);
+// glTF files tend to repeat the same few samplers across all of their materials, so they come out
+// of aCache, and go back to it with ReleaseCachedSampler.
+SDL_GPUSampler* CreateSamplerFromGltf(SamplerCache* aCache, const cgltf_sampler* aSampler)
+{
+  SDL_GPUSamplerCreateInfo samplerCreateInfo;
+  SDL_zero(samplerCreateInfo);
 
-  toReturn.data[0][0] = focalLength / aAspectRatio;
-  toReturn.data[1][1] = focalLength;
-  toReturn.data[2][2] = k;
-  toReturn.data[2][3] = 1.0f;
-  toReturn.data[3][2] = -aFar * k;
+  samplerCreateInfo.mag_filter = GltfFilterToSDL(aSampler->mag_filter);
+  samplerCreateInfo.min_filter = GltfFilterToSDL(aSampler->min_filter);
+  samplerCreateInfo.mipmap_mode = GltfMipmapModeToSDL(aSampler->min_filter);
+  samplerCreateInfo.max_lod = GltfFilterUsesMipmaps(aSampler->min_filter) ? cMaxLod : 0.f;
+  samplerCreateInfo.address_mode_u = GltfAddressModeToSDL(aSampler->wrap_s);
+  samplerCreateInfo.address_mode_v = GltfAddressModeToSDL(aSampler->wrap_t);
 
-  return toReturn;
+  return AcquireCachedSampler(aCache, &samplerCreateInfo);
 }
 
-float4x4 InfinitePerspectiveProjectionLHOZ(float aFovY, float aAspectRatio, float aNear) {
-  float4x4 toReturn;
-  SDL_zero(toReturn);
+size_t transferBufferSize = 0;
 
-  const float focalLength = 1.0f / SDL_tan(aFovY * .5f);
+void GenerateGPUMesh(cgltf_node* aNode, Scene* aScene, SceneProcessing* aSceneProcessing, Mesh* aMesh, Uint8* aTransferPtr)
+{
+  aMesh->mChildrenOffset = aSceneProcessing->mCurrentChildrenIndex;
+  aMesh->mChildrenCount = (Uint32)aNode->children_count;
+  Mesh* meshChildren = aScene->mMeshes + aMesh->mChildrenOffset;
+  aSceneProcessing->mCurrentChildrenIndex += (Uint32)aNode->children_count;
 
-  // For ease of use we're hardcoding the epsilon to what's recommended in Foundations of Game Engine
-  // Development: Rendering, which is 2^(-20).
-  const float epsilon = SDL_powf(2, -20);
+  for (size_t i = 0; i < aNode->children_count; ++i) {
+    GenerateGPUMesh(aNode->children[i], aScene, aSceneProcessing, meshChildren + i, aTransferPtr);
+  }
 
-  toReturn.data[0][0] = focalLength / aAspectRatio;
-  toReturn.data[1][1] = focalLength;
-  toReturn.data[2][2] = epsilon;
-  toReturn.data[2][3] = 1.0f;
-  toReturn.data[3][2] = aNear / (1.0f - epsilon);
+  cgltf_node_transform_local(aNode, (float*)&aMesh->mTransform.data[0]);
+  cgltf_node_transform_world(aNode, (float*)&aScene->mWorldTransforms[aMesh - aScene->mMeshes].data[0]);
 
-  return toReturn;
-}
+  cgltf_mesh* mesh_file = aNode->mesh;
+  if (mesh_file == NULL) {
+    return;
+  }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Shared GPU Code
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-typedef struct GpuContext {
-  SDL_Window* mWindow;
-  SDL_GPUDevice* mDevice;
-  SDL_PropertiesID mProperties;
-  const char* mShaderEntryPoint;
-  SDL_GPUShaderFormat mChosenBackendFormat;
-  const char* mChosenBackendFormatExtension;
-  float4x4 WorldToNDC;
-} GpuContext;
+  aMesh->mFirstPrimitive = aSceneProcessing->mCurrentPrimitiveIndex;
+  aMesh->mPrimitivesCount = (Uint32)mesh_file->primitives_count;
+  aSceneProcessing->mCurrentPrimitiveIndex += (Uint32)mesh_file->primitives_count;
 
-GpuContext gContext;
+  for (size_t j = 0; j < mesh_file->primitives_count; ++j) {
+    cgltf_primitive* primitive = &mesh_file->primitives[j];
+    Primitive* gpuPrimitive = aScene->mPrimitives + aMesh->mFirstPrimitive + j;
 
-void CreateGpuContext(SDL_Window* aWindow) {
-  SDL_zero(gContext);
+    gpuPrimitive->mPositionOffset = aSceneProcessing->mPositionOffsetSoFar - aSceneProcessing->mPositionOffset;
+    gpuPrimitive->mNormalOffset = aSceneProcessing->mNormalOffsetSoFar - aSceneProcessing->mNormalOffset;
+    gpuPrimitive->mTangentOffset = aSceneProcessing->mTangentOffsetSoFar - aSceneProcessing->mTangentOffset;
+    gpuPrimitive->mTexcoordOffset = aSceneProcessing->mTexcoordOffsetSoFar - aSceneProcessing->mTexcoordOffset;
+    gpuPrimitive->mIndexOffset = aSceneProcessing->mIndexOffsetSoFar - aSceneProcessing->mIndexOffset;
 
-  gContext.mWindow = aWindow;
-  gContext.mDevice = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_MSL, true, NULL);
-  SDL_assert(gContext.mDevice);
+    gpuPrimitive->mMaterialIndex = aSceneProcessing->mMaterialsCount;
+    if (primitive->material) {
+      gpuPrimitive->mMaterialIndex = (Uint32)(primitive->material - aSceneProcessing->mMaterials);
+    }
 
-  SDL_assert(SDL_ClaimWindowForGPUDevice(gContext.mDevice, gContext.mWindow));
+    float3 boundsMin = { 0.0f, 0.0f, 0.0f };
+    float3 boundsMax = { 0.0f, 0.0f, 0.0f };
+    bool hasBounds = false;
 
-  gContext.mProperties = SDL_CreateProperties();
-  SDL_assert(gContext.mProperties);
+    gpuPrimitive->mIndicesCount = (Uint32)primitive->indices->count;
+    cgltf_accessor_unpack_indices(primitive->indices, (void*)(aTransferPtr + aSceneProcessing->mIndexOffsetSoFar), sizeof(Uint32), primitive->indices->count);
+    aSceneProcessing->mIndexOffsetSoFar += (Uint32)primitive->indices->count * sizeof(Uint32);
 
-  SDL_GPUShaderFormat availableFormats = SDL_GetGPUShaderFormats(gContext.mDevice);
-  gContext.mShaderEntryPoint = NULL;
+    SDL_assert(aSceneProcessing->mIndexOffsetSoFar <= transferBufferSize);
 
-  if (availableFormats & SDL_GPU_SHADERFORMAT_SPIRV)
-  {
-    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_SPIRV;
-    gContext.mShaderEntryPoint = "main";
-    gContext.mChosenBackendFormatExtension = "spv";
-  }
-  else if (availableFormats & SDL_GPU_SHADERFORMAT_MSL)
-  {
-    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_MSL;
-    gContext.mShaderEntryPoint = "main0";
-    gContext.mChosenBackendFormatExtension = "msl";
-  }
-  else if (availableFormats & SDL_GPU_SHADERFORMAT_DXIL)
-  {
-    gContext.mChosenBackendFormat = SDL_GPU_SHADERFORMAT_DXIL;
-    gContext.mShaderEntryPoint = "main";
-    gContext.mChosenBackendFormatExtension = "dxil";
-  }
-}
+    bool hasNormals = false;
+    bool hasTangents = false;
+    bool hasTexcoords = false;
 
-void DestroyGpuContext() {
-  SDL_DestroyProperties(gContext.mProperties);
-  SDL_DestroyGPUDevice(gContext.mDevice);
-  SDL_DestroyWindow(gContext.mWindow);
-  SDL_zero(gContext);
-}
+    for (size_t k = 0; k < primitive->attributes_count; ++k) {
+      Uint32* attributeCount = NULL;
+      cgltf_attribute* attribute = &primitive->attributes[k];
+      switch (attribute->type) {
+        case cgltf_attribute_type_position: attributeCount = &aSceneProcessing->mPositionOffsetSoFar; break;
+        case cgltf_attribute_type_normal: attributeCount = &aSceneProcessing->mNormalOffsetSoFar; hasNormals = true; break;
+        case cgltf_attribute_type_tangent: attributeCount = &aSceneProcessing->mTangentOffsetSoFar; hasTangents = true; break;
+        case cgltf_attribute_type_texcoord: {
+          if (attribute->index != 0) {
+            continue;
+          }
 
-SDL_GPUShader* CreateShader(
-  const char* aShaderFilename,
-  SDL_GPUShaderStage aShaderStage,
-  Uint32 aSamplerCount,
-  Uint32 aUniformBufferCount,
-  Uint32 aStorageBufferCount,
-  Uint32 aStorageTextureCount,
-  SDL_PropertiesID aProperties)
-{
-  char shader_path[4096];
-  SDL_snprintf(shader_path, SDL_arraysize(shader_path), "Assets/Shaders/%s/%s.%s", TARGET_NAME, aShaderFilename, gContext.mChosenBackendFormatExtension);
+          attributeCount = &aSceneProcessing->mTexcoordOffsetSoFar;
+          hasTexcoords = true;
+          break;
+        }
+        default: continue;
+      }
 
-  size_t fileSize = 0;
-  void* fileData = SDL_LoadFile(shader_path, &fileSize);
-  SDL_assert(fileData);
+      if (!attributeCount) {
+        continue;
+      }
 
-  SDL_GPUShaderCreateInfo shaderCreateInfo;
-  SDL_zero(shaderCreateInfo);
+      Uint32 attributeStart = *attributeCount;
 
-  SDL_PropertiesID properties = gContext.mProperties;
+      *attributeCount += cgltf_accessor_unpack_floats(
+        attribute->data,
+        (cgltf_float*)(aTransferPtr + *attributeCount),
+        attribute->data->count * cgltf_num_components(attribute->data->type)
+      ) * sizeof(float);
 
-  if (aProperties != SDL_PROPERTY_TYPE_INVALID) {
-    properties = aProperties;
-  }
+      SDL_assert(*attributeCount < transferBufferSize);
 
-  SDL_assert(SDL_SetStringProperty(properties, SDL_PROP_GPU_SHADER_CREATE_NAME_STRING, aShaderFilename));
+      // Grow the bounds using the positions we just unpacked.
+      if (attribute->type == cgltf_attribute_type_position) {
+        const float3* positions = (const float3*)(aTransferPtr + attributeStart);
+
+        for (size_t l = 0; l < attribute->data->count; ++l) {
+          if (!hasBounds) {
+            boundsMin = boundsMax = positions[l];
+            hasBounds = true;
+          }
+
+          boundsMin.x = SDL_min(boundsMin.x, positions[l].x);
+          boundsMin.y = SDL_min(boundsMin.y, positions[l].y);
+          boundsMin.z = SDL_min(boundsMin.z, positions[l].z);
+          boundsMax.x = SDL_max(boundsMax.x, positions[l].x);
+          boundsMax.y = SDL_max(boundsMax.y, positions[l].y);
+          boundsMax.z = SDL_max(boundsMax.z, positions[l].z);
+        }
+      }
+    }
 
-  shaderCreateInfo.entrypoint = gContext.mShaderEntryPoint;
-  shaderCreateInfo.format = gContext.mChosenBackendFormat;
-  shaderCreateInfo.code = (Uint8*)fileData;
-  shaderCreateInfo.code_size = fileSize;
-  shaderCreateInfo.stage = aShaderStage;
-  shaderCreateInfo.num_samplers = aSamplerCount;
-  shaderCreateInfo.num_uniform_buffers = aUniformBufferCount;
-  shaderCreateInfo.num_storage_buffers = aStorageBufferCount;
-  shaderCreateInfo.num_storage_textures = aStorageTextureCount;
-  shaderCreateInfo.props = properties;
+    // Zero whatever the primitive is missing, GetSceneInfo already counted it.
+    const cgltf_accessor* positions = cgltf_find_accessor(primitive, cgltf_attribute_type_position, 0);
+    Uint32 verticesCount = positions ? (Uint32)positions->count : 0;
 
-  SDL_GPUShader* shader = SDL_CreateGPUShader(gContext.mDevice, &shaderCreateInfo);
+    if (!hasNormals) {
+      SDL_memset(aTransferPtr + aSceneProcessing->mNormalOffsetSoFar, 0, verticesCount * sizeof(float3));
+      aSceneProcessing->mNormalOffsetSoFar += verticesCount * sizeof(float3);
+    }
 
-  SDL_free(fileData);
-  SDL_assert(shader);
+    if (!hasTangents) {
+      SDL_memset(aTransferPtr + aSceneProcessing->mTangentOffsetSoFar, 0, verticesCount * sizeof(float4));
+      aSceneProcessing->mTangentOffsetSoFar += verticesCount * sizeof(float4);
+    }
 
-  return shader;
+    if (!hasTexcoords) {
+      SDL_memset(aTransferPtr + aSceneProcessing->mTexcoordOffsetSoFar, 0, verticesCount * sizeof(float2));
+      aSceneProcessing->mTexcoordOffsetSoFar += verticesCount * sizeof(float2);
+    }
+
+    gpuPrimitive->mBoundsCenter = Float3_Scalar_Multiply(Float3_Add(boundsMin, boundsMax), 0.5f);
+    gpuPrimitive->mBoundsExtent = Float3_Scalar_Multiply(Float3_Subtract(boundsMax, boundsMin), 0.5f);
+  }
 }
 
-SDL_GPUBuffer* CreateGPUBuffer(Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+Scene GenerateGPUScene(UploadBatch* aBatch, BufferHeap* aHeap, cgltf_data* aData, SceneInfo aSceneInfo)
 {
-  SDL_GPUBufferCreateInfo createInfo;
+  Scene scene;
+  SDL_zero(scene);
+
+  Uint32 indexBytes = aSceneInfo.mIndicesCount * sizeof(Uint32);
+  scene.mPositions = AllocateFromBufferHeap(aHeap, aSceneInfo.mPositionBytes, sizeof(float));
+  scene.mNormals = AllocateFromBufferHeap(aHeap, aSceneInfo.mNormalBytes, sizeof(float));
+  scene.mTangents = AllocateFromBufferHeap(aHeap, aSceneInfo.mTangentBytes, sizeof(float));
+  scene.mTexcoords = AllocateFromBufferHeap(aHeap, aSceneInfo.mTexcoordBytes, sizeof(float));
+  scene.mIndices = AllocateFromBufferHeap(aHeap, indexBytes, sizeof(Uint32));
+  SDL_assert(scene.mPositions.mBuffer && scene.mNormals.mBuffer && scene.mTangents.mBuffer && scene.mTexcoords.mBuffer && scene.mIndices.mBuffer);
+
+  // All of the vertex streams and indices are written into one staging allocation, laid out back to back.
+  transferBufferSize = aSceneInfo.mPositionBytes + aSceneInfo.mNormalBytes + aSceneInfo.mTangentBytes + aSceneInfo.mTexcoordBytes + indexBytes;
+  UploadAllocation staging = AllocateUpload(aBatch, (Uint32)transferBufferSize);
+
+  SceneProcessing processing;
+  {
+    SDL_zero(processing);
+    processing.mPositionOffsetSoFar = processing.mPositionOffset = 0;
+    processing.mNormalOffsetSoFar = processing.mNormalOffset = aSceneInfo.mPositionBytes;
+    processing.mTangentOffsetSoFar = processing.mTangentOffset = processing.mNormalOffset + aSceneInfo.mNormalBytes;
+    processing.mTexcoordOffsetSoFar = processing.mTexcoordOffset = processing.mTangentOffset + aSceneInfo.mTangentBytes;
+    processing.mIndexOffsetSoFar = processing.mIndexOffset = processing.mTexcoordOffset + aSceneInfo.mTexcoordBytes;
+    processing.mMaterials = aData->materials;
+    processing.mMaterialsCount = (Uint32)aData->materials_count;
+  }
+
+  // Copy all of the scene data into the staging memory, generate Mesh hierarchy.
+  {
+
+    scene.mMeshesCount = aSceneInfo.mTotalNodes;
+    scene.mMeshes = SDL_calloc(scene.mMeshesCount, sizeof(Mesh));
+    scene.mPrimitivesCount = aSceneInfo.mPrimitivesCount;
+    scene.mPrimitives = SDL_calloc(SDL_max(scene.mPrimitivesCount, 1), sizeof(Primitive));
+    scene.mWorldTransforms = SDL_calloc(scene.mMeshesCount, sizeof(float4x4));
+    scene.mModelTransforms = SDL_calloc(scene.mMeshesCount, sizeof(float4x4));
+
+    scene.mRootMeshesCount = aSceneInfo.mRootNodes;
+
+    processing.mCurrentChildrenIndex += scene.mRootMeshesCount;
+
+    for (size_t i = 0; i < aData->scene->nodes_count; ++i) {
+      GenerateGPUMesh(aData->scene->nodes[i], &scene, &processing, scene.mMeshes + i, staging.mData);
+    }
+  }
 
-  SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_BUFFER_CREATE_NAME_STRING, aName);
-  createInfo.props = gContext.mProperties;
-  createInfo.size = aSize;
-  createInfo.usage = aUsage;
+  // Queue the copies out to the appropriate buffers, they go out with the rest of aBatch.
+  QueueBufferCopy(aBatch, &staging, processing.mPositionOffset, scene.mPositions.mBuffer, scene.mPositions.mOffset, aSceneInfo.mPositionBytes);
+  QueueBufferCopy(aBatch, &staging, processing.mNormalOffset, scene.mNormals.mBuffer, scene.mNormals.mOffset, aSceneInfo.mNormalBytes);
+  QueueBufferCopy(aBatch, &staging, processing.mTangentOffset, scene.mTangents.mBuffer, scene.mTangents.mOffset, aSceneInfo.mTangentBytes);
+  QueueBufferCopy(aBatch, &staging, processing.mTexcoordOffset, scene.mTexcoords.mBuffer, scene.mTexcoords.mOffset, aSceneInfo.mTexcoordBytes);
+  QueueBufferCopy(aBatch, &staging, processing.mIndexOffset, scene.mIndices.mBuffer, scene.mIndices.mOffset, indexBytes);
 
-  SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer(gContext.mDevice, &createInfo);
-  SDL_assert(buffer);
+  RecalculateSceneTransform(&scene);
+  BuildHierarchyLevels(&scene);
+  BuildDrawPackets(&scene);
 
-  return buffer;
+  return scene;
 }
 
-SDL_GPUTransferBuffer* CreateTransferBuffer(Uint32 aSize, SDL_GPUTransferBufferUsage aUsage, const char* aName)
-{
-  SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_TRANSFERBUFFER_CREATE_NAME_STRING, aName);
+// Material textures that all share a size go into the layers of one 2D array, with mipmaps. Any
+// difference in size and they're packed into an atlas in its only layer instead, which gets no
+// mipmaps so that the entries can't bleed into each other as they shrink. Either way it's a single
+// texture and sampler binding for the whole Scene, with the layer picked by the draw's uniforms.
+// Every image is decoded to RGBA8, so the format always matches.
+static const Uint32 cMaxAtlasSize = 8192;
+static const Uint32 cAtlasPadding = 4;
 
-  SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
-  SDL_zero(transferBufferCreateInfo);
-  transferBufferCreateInfo.props = gContext.mProperties;
-  transferBufferCreateInfo.size = aSize;
-  transferBufferCreateInfo.usage = aUsage;
+typedef struct AtlasEntry {
+  SDL_Surface* mSurface;
+  Uint32 mImageIndex;
+  Uint32 mX;
+  Uint32 mY;
+} AtlasEntry;
 
-  SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(gContext.mDevice, &transferBufferCreateInfo);
-  SDL_assert(transferBuffer);
+int CompareAtlasEntriesByHeight(const void* aLeft, const void* aRight)
+{
+  const AtlasEntry* left = (const AtlasEntry*)aLeft;
+  const AtlasEntry* right = (const AtlasEntry*)aRight;
 
-  return transferBuffer;
+  if (left->mSurface->h != right->mSurface->h) {
+    return left->mSurface->h > right->mSurface->h ? -1 : 1;
+  }
+  return 0;
 }
 
-SDL_GPUTexture* CreateTexture(Uint32 aWidth, Uint32 aHeight, Uint32 layers_or_depth, Uint32 levels, SDL_GPUTextureUsageFlags aUsage, SDL_GPUTextureFormat aFormat, const char* aName)
+// Images embedded in a .glb are read out of their buffer view, otherwise they're next to the model.
+SDL_Surface* LoadGltfImage(const cgltf_image* aImage)
 {
-  SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_TEXTURE_CREATE_NAME_STRING, aName);
+  SDL_Surface* surface = NULL;
 
-  SDL_GPUTextureCreateInfo textureCreateInfo;
-  SDL_zero(textureCreateInfo);
-  textureCreateInfo.width = aWidth;
-  textureCreateInfo.height = aHeight;
-  textureCreateInfo.layer_count_or_depth = layers_or_depth;
-  textureCreateInfo.num_levels = levels;
-  textureCreateInfo.usage = aUsage;
-  textureCreateInfo.format = aFormat;
-  textureCreateInfo.props = gContext.mProperties;
-  return SDL_CreateGPUTexture(gContext.mDevice, &textureCreateInfo);
-}
-
-SDL_GPUTexture* CreateAndUploadTexture(SDL_GPUCopyPass* aCopyPass, const char* aTextureName) {
-  char stringBuffer[4096];
-  SDL_snprintf(stringBuffer, SDL_arraysize(stringBuffer), "Assets/Images/%s", aTextureName);
-  SDL_Surface* surface = SDL_LoadSurface(stringBuffer);
-  if (surface->format != SDL_PIXELFORMAT_RGBA32)
-  {
+  if (aImage->buffer_view) {
+    const Uint8* data = cgltf_buffer_view_data(aImage->buffer_view);
+    if (data) {
+      surface = SDL_LoadSurface_IO(SDL_IOFromConstMem(data, aImage->buffer_view->size), true);
+    }
+  }
+  else if (aImage->uri && SDL_strncmp(aImage->uri, "data:", 5) != 0) {
+    char stringBuffer[4096];
+    SDL_snprintf(stringBuffer, SDL_arraysize(stringBuffer), "Assets/Models/%s", aImage->uri);
+    surface = SDL_LoadSurface(stringBuffer);
+  }
+
+  if (!surface) {
+    SDL_Log("Couldn't load image %s, its materials will be untextured: %s", aImage->name ? aImage->name : (aImage->uri ? aImage->uri : "(unnamed)"), SDL_GetError());
+    return NULL;
+  }
+
+  if (surface->format != SDL_PIXELFORMAT_RGBA32) {
     SDL_Surface* temp = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
     SDL_DestroySurface(surface);
     surface = temp;
   }
 
-  Uint32 textureSize = surface->h * surface->pitch;
-
-  SDL_snprintf(stringBuffer, SDL_arraysize(stringBuffer), "CreateAndUploadTexture Transfer Buffer for %s", aTextureName);
-
-  SDL_GPUTransferBuffer* transferBuffer = CreateTransferBuffer(textureSize, SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, stringBuffer);
+  return surface;
+}
 
-  void* transferPtr = SDL_MapGPUTransferBuffer(gContext.mDevice, transferBuffer, false);
-  memcpy(transferPtr, surface->pixels, textureSize);
-  SDL_UnmapGPUTransferBuffer(gContext.mDevice, transferBuffer);
+SDL_GPUTexture* CreateMaterialTexture(Uint32 aWidth, Uint32 aHeight, Uint32 aLayers, Uint32 aLevels)
+{
+  // Created on the upload worker.
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_SetStringProperty(properties, SDL_PROP_GPU_TEXTURE_CREATE_NAME_STRING, "MaterialTexture");
 
-  SDL_GPUCommandBuffer* commandBuffer = NULL;
-  SDL_GPUCopyPass* copyPass = aCopyPass;
-  bool needsToSubmit = NULL == copyPass;
-  if (needsToSubmit) {
-    commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
-    copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+  SDL_GPUTextureCreateInfo textureCreateInfo;
+  SDL_zero(textureCreateInfo);
+  textureCreateInfo.type = SDL_GPU_TEXTURETYPE_2D_ARRAY;
+  textureCreateInfo.width = aWidth;
+  textureCreateInfo.height = aHeight;
+  textureCreateInfo.layer_count_or_depth = aLayers;
+  textureCreateInfo.num_levels = aLevels;
+  textureCreateInfo.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
+  textureCreateInfo.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+  textureCreateInfo.props = properties;
+
+  if (aLevels > 1) {
+    textureCreateInfo.usage |= SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
   }
 
-  SDL_GPUTexture* texture = CreateTexture(surface->w, surface->h, 1, 1, SDL_GPU_TEXTUREUSAGE_SAMPLER, SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, aTextureName);
+  SDL_GPUTexture* texture = SDL_CreateGPUTexture(gContext.mDevice, &textureCreateInfo);
+  SDL_DestroyProperties(properties);
   SDL_assert(texture);
+  return texture;
+}
 
-  // Copy to GPU
-  SDL_GPUTextureTransferInfo textureTransferInfo;
-  SDL_zero(textureTransferInfo);
-  textureTransferInfo.pixels_per_row = surface->w;
-  textureTransferInfo.rows_per_layer = surface->h;
-  textureTransferInfo.transfer_buffer = transferBuffer;
-
-  SDL_GPUTextureRegion textureRegion;
-  SDL_zero(textureRegion);
-  textureRegion.texture = texture;
-  textureRegion.w = surface->w;
-  textureRegion.h = surface->h;
-  textureRegion.d = 1;
-
-  SDL_UploadToGPUTexture(
-    copyPass,
-    &textureTransferInfo,
-    &textureRegion,
-    false
-  );
-
-  if (needsToSubmit) {
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(commandBuffer);
+// Copies aSurface into aAllocation at aX, aY, with aAllocation being aPitch bytes per row.
+void CopySurfaceToUpload(const SDL_Surface* aSurface, UploadAllocation* aAllocation, Uint32 aPitch, Uint32 aX, Uint32 aY)
+{
+  Uint32 rowSize = aSurface->w * 4;
+  for (int y = 0; y < aSurface->h; ++y) {
+    SDL_memcpy(aAllocation->mData + ((aY + y) * aPitch) + (aX * 4), (Uint8*)aSurface->pixels + (y * aSurface->pitch), rowSize);
   }
-
-  SDL_ReleaseGPUTransferBuffer(gContext.mDevice, transferBuffer);
-  SDL_DestroySurface(surface);
-
-  return texture;
 }
 
-SDL_GPUTextureFormat GetSupportedDepthFormat()
+// Shelf packing, tallest first. Returns false if the entries don't fit in an aWidth wide atlas of
+// cMaxAtlasSize, aHeight is the height actually used otherwise.
+bool PackAtlas(AtlasEntry* aEntries, size_t aEntriesCount, Uint32 aWidth, Uint32* aHeight)
 {
-  SDL_GPUTextureFormat possibleFormats[] = {
-    SDL_GPU_TEXTUREFORMAT_D32_FLOAT_S8_UINT,
-    SDL_GPU_TEXTUREFORMAT_D24_UNORM_S8_UINT,
-    SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
-    SDL_GPU_TEXTUREFORMAT_D24_UNORM,
-    SDL_GPU_TEXTUREFORMAT_D16_UNORM,
-  };
+  Uint32 x = 0;
+  Uint32 y = 0;
+  Uint32 shelfHeight = 0;
+
+  for (size_t i = 0; i < aEntriesCount; ++i) {
+    Uint32 width = aEntries[i].mSurface->w + cAtlasPadding;
+    Uint32 height = aEntries[i].mSurface->h + cAtlasPadding;
+
+    if (x + width > aWidth) {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
 
-  for (size_t i = 0; i < SDL_arraysize(possibleFormats); ++i) {
-    if (SDL_GPUTextureSupportsFormat(gContext.mDevice,
-      possibleFormats[i],
-      SDL_GPU_TEXTURETYPE_2D,
-      SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET))
-    {
-      return possibleFormats[i];
+    if (width > aWidth || y + height > cMaxAtlasSize) {
+      return false;
     }
-  }
 
-  // Didn't find a suitable depth format.
-  SDL_assert(false);
+    aEntries[i].mX = x;
+    aEntries[i].mY = y;
+    x += width;
+    shelfHeight = SDL_max(shelfHeight, height);
+  }
 
-  return SDL_GPU_TEXTUREFORMAT_INVALID;
+  *aHeight = y + shelfHeight;
+  return true;
 }
 
-SDL_GPUBuffer* CreateAndUploadBuffer(const void* aData, Uint32 aSize, SDL_GPUBufferUsageFlags aUsage, const char* aName)
+// Packs aImages (NULL entries are skipped) and fills in where each one ended up in aPlacements.
+SDL_GPUTexture* PackMaterialImages(UploadBatch* aBatch, SDL_Surface** aImages, size_t aImagesCount, MaterialTexture* aPlacements)
 {
-  SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_BUFFER_CREATE_NAME_STRING, aName);
+  AtlasEntry* entries = (AtlasEntry*)SDL_calloc(SDL_max(aImagesCount, 1), sizeof(AtlasEntry));
+  size_t entriesCount = 0;
+  bool sameSize = true;
 
-  SDL_GPUBufferCreateInfo bufferCreateInfo;
-  SDL_zero(bufferCreateInfo);
+  for (size_t i = 0; i < aImagesCount; ++i) {
+    aPlacements[i].mLayer = -1;
 
-  bufferCreateInfo.usage = aUsage;
-  bufferCreateInfo.size = aSize;
-  bufferCreateInfo.props = gContext.mProperties;
+    if (!aImages[i]) {
+      continue;
+    }
 
-  SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer(gContext.mDevice, &bufferCreateInfo);
-  SDL_assert(buffer);
+    entries[entriesCount].mSurface = aImages[i];
+    entries[entriesCount].mImageIndex = (Uint32)i;
+    sameSize = sameSize && aImages[i]->w == entries[0].mSurface->w && aImages[i]->h == entries[0].mSurface->h;
+    ++entriesCount;
+  }
 
-  {
-    char tranfer_buffer_name[4096];
-    SDL_snprintf(tranfer_buffer_name, SDL_arraysize(tranfer_buffer_name), "CreateAndUploadBuffer Transfer Buffer for %s", aName);
+  SDL_GPUTexture* texture = NULL;
 
-    SDL_GPUTransferBuffer* transferBuffer = CreateTransferBuffer(aSize, SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, tranfer_buffer_name);
+  if (entriesCount == 0) {
+    // Nothing samples it, but the fragment shader still needs something bound.
+    texture = CreateMaterialTexture(1, 1, 1, 1);
 
-    {
-      void* mappedBuffer = SDL_MapGPUTransferBuffer(gContext.mDevice, transferBuffer, false);
-      SDL_memcpy(mappedBuffer, aData, aSize);
-      SDL_UnmapGPUTransferBuffer(gContext.mDevice, transferBuffer);
+    UploadAllocation allocation = AllocateUpload(aBatch, 4);
+    SDL_memset(allocation.mData, 0xFF, 4);
+
+    SDL_GPUTextureRegion textureRegion;
+    SDL_zero(textureRegion);
+    textureRegion.texture = texture;
+    textureRegion.w = 1;
+    textureRegion.h = 1;
+    textureRegion.d = 1;
+    QueueTextureCopy(aBatch, &allocation, 0, &textureRegion);
+  }
+  else if (sameSize) {
+    Uint32 width = entries[0].mSurface->w;
+    Uint32 height = entries[0].mSurface->h;
+    Uint32 levels = GetMipLevelsCount(width, height);
+    texture = CreateMaterialTexture(width, height, (Uint32)entriesCount, levels);
+
+    for (size_t i = 0; i < entriesCount; ++i) {
+      UploadAllocation allocation = AllocateUpload(aBatch, width * height * 4);
+      CopySurfaceToUpload(entries[i].mSurface, &allocation, width * 4, 0, 0);
+
+      SDL_GPUTextureRegion textureRegion;
+      SDL_zero(textureRegion);
+      textureRegion.texture = texture;
+      textureRegion.layer = (Uint32)i;
+      textureRegion.w = width;
+      textureRegion.h = height;
+      textureRegion.d = 1;
+      QueueTextureCopy(aBatch, &allocation, 0, &textureRegion);
+
+      MaterialTexture* placement = &aPlacements[entries[i].mImageIndex];
+      placement->mUvScaleOffset.x = 1.0f;
+      placement->mUvScaleOffset.y = 1.0f;
+      placement->mUvScaleOffset.z = 0.0f;
+      placement->mUvScaleOffset.w = 0.0f;
+      placement->mLayer = (Sint32)i;
+      placement->mAtlas = 0;
     }
 
-    SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
-    SDL_assert(commandBuffer);
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
-    SDL_assert(copyPass);
+    if (levels > 1) {
+      QueueTextureMipmaps(aBatch, texture);
+    }
 
-    SDL_GPUTransferBufferLocation source;
-    source.offset = 0;
-    source.transfer_buffer = transferBuffer;
+    SDL_Log("MaterialTexture: %u images of %ux%u in a 2D array", (Uint32)entriesCount, width, height);
+  }
+  else {
+    SDL_qsort(entries, entriesCount, sizeof(AtlasEntry), CompareAtlasEntriesByHeight);
+
+    Uint64 area = 0;
+    Uint32 widest = 0;
+    for (size_t i = 0; i < entriesCount; ++i) {
+      area += (Uint64)(entries[i].mSurface->w + cAtlasPadding) * (entries[i].mSurface->h + cAtlasPadding);
+      widest = SDL_max(widest, entries[i].mSurface->w + cAtlasPadding);
+    }
 
-    SDL_GPUBufferRegion destination;
-    destination.buffer = buffer;
-    destination.offset = 0;
-    destination.size = aSize;
+    // Start from a square that could hold everything and widen it until the shelves fit, halving
+    // every image if even the widest atlas can't hold them.
+    Uint32 side = (Uint32)SDL_ceilf(SDL_sqrtf((float)area));
+    Uint32 width = SDL_min(NextPowerOfTwo(SDL_max(side, widest)), cMaxAtlasSize);
+    Uint32 height = 0;
+    while (!PackAtlas(entries, entriesCount, width, &height)) {
+      if (width < cMaxAtlasSize) {
+        width *= 2;
+        continue;
+      }
 
-    SDL_UploadToGPUBuffer(copyPass, &source, &destination, false);
+      SDL_Log("MaterialTexture: images don't fit in a %ux%u atlas, halving them", cMaxAtlasSize, cMaxAtlasSize);
+      for (size_t i = 0; i < entriesCount; ++i) {
+        SDL_Surface* surface = entries[i].mSurface;
+        SDL_Surface* scaled = SDL_ScaleSurface(surface, SDL_max(surface->w / 2, 1), SDL_max(surface->h / 2, 1), SDL_SCALEMODE_LINEAR);
+        SDL_DestroySurface(surface);
+        entries[i].mSurface = scaled;
+        aImages[entries[i].mImageIndex] = scaled;
+      }
+    }
 
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(commandBuffer);
-    SDL_ReleaseGPUTransferBuffer(gContext.mDevice, transferBuffer);
-  }
+    texture = CreateMaterialTexture(width, height, 1, 1);
 
-  return buffer;
-}
+    // Zeroed so the padding between entries is transparent black rather than old staging.
+    UploadAllocation allocation = AllocateUpload(aBatch, width * height * 4);
+    SDL_memset(allocation.mData, 0, width * height * 4);
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// CGLTF Code
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-typedef struct SceneInfo {
-  Uint32 mIndicesCount;
-  Uint32 mPositionBytes;
-  Uint32 mNormalBytes;
-  Uint32 mTangentBytes;
-  Uint32 mTexcoordBytes[16];
-  Uint32 mTotalNodes;
-  Uint32 mRootNodes;
-} SceneInfo;
+    for (size_t i = 0; i < entriesCount; ++i) {
+      const SDL_Surface* surface = entries[i].mSurface;
+      CopySurfaceToUpload(surface, &allocation, width * 4, entries[i].mX, entries[i].mY);
 
+      MaterialTexture* placement = &aPlacements[entries[i].mImageIndex];
+      placement->mUvScaleOffset.x = (float)surface->w / (float)width;
+      placement->mUvScaleOffset.y = (float)surface->h / (float)height;
+      placement->mUvScaleOffset.z = (float)entries[i].mX / (float)width;
+      placement->mUvScaleOffset.w = (float)entries[i].mY / (float)height;
+      placement->mLayer = 0;
+      placement->mAtlas = 1;
+    }
 
-void ProcessNodeInfo(cgltf_node* aNode, SceneInfo* aSceneInfo)
-{
-  aSceneInfo->mTotalNodes += aNode->children_count;
+    SDL_GPUTextureRegion textureRegion;
+    SDL_zero(textureRegion);
+    textureRegion.texture = texture;
+    textureRegion.w = width;
+    textureRegion.h = height;
+    textureRegion.d = 1;
+    QueueTextureCopy(aBatch, &allocation, 0, &textureRegion);
 
-  for (size_t i = 0; i < aNode->children_count; ++i) {
-    ProcessNodeInfo(aNode->children[i], aSceneInfo);
+    SDL_Log("MaterialTexture: %u images of differing sizes in a %ux%u atlas", (Uint32)entriesCount, width, height);
   }
 
-  cgltf_mesh* mesh = aNode->mesh;
-  if (mesh == NULL) {
-    return;
-  }
+  SDL_free(entries);
+  return texture;
+}
 
-  for (size_t j = 0; j < mesh->primitives_count; ++j) {
-    cgltf_primitive* primitive = &mesh->primitives[j];
+// With aLoadTextures false, or for materials whose image can't be loaded, the Scene is drawn
+// untextured. Only TEXCOORD_0 is uploaded, so that's what every base color texture is sampled with.
+void LoadGltfMaterials(UploadBatch* aBatch, cgltf_data* aData, bool aLoadTextures, Scene* aScene)
+{
+  aScene->mMaterialsCount = aData->materials_count + 1;
+  aScene->mMaterials = (MaterialTexture*)SDL_calloc(aScene->mMaterialsCount, sizeof(MaterialTexture));
 
-    aSceneInfo->mIndicesCount += primitive->indices->count;
+  SDL_Surface** images = (SDL_Surface**)SDL_calloc(SDL_max(aData->images_count, 1), sizeof(SDL_Surface*));
+  bool* imagesTried = (bool*)SDL_calloc(SDL_max(aData->images_count, 1), sizeof(bool));
+  MaterialTexture* imagePlacements = (MaterialTexture*)SDL_calloc(SDL_max(aData->images_count, 1), sizeof(MaterialTexture));
 
-    SDL_assert(primitive->indices->type == cgltf_type_scalar);
-    SDL_assert(primitive->indices->component_type == cgltf_component_type_r_32u);
+  // Only the images some material uses as its base color are loaded, and each of those only once.
+  for (size_t i = 0; aLoadTextures && i < aData->materials_count; ++i) {
+    const cgltf_texture* texture = aData->materials[i].pbr_metallic_roughness.base_color_texture.texture;
+    if (!texture || !texture->image) {
+      continue;
+    }
 
-    for (size_t k = 0; k < primitive->attributes_count; ++k) {
-      cgltf_attribute* attribute = &primitive->attributes[k];
+    size_t imageIndex = texture->image - aData->images;
+    if (!imagesTried[imageIndex]) {
+      images[imageIndex] = LoadGltfImage(texture->image);
+      imagesTried[imageIndex] = true;
+    }
+  }
 
-      //primitive->material->
+  aScene->mMaterialTexture = PackMaterialImages(aBatch, images, aData->images_count, imagePlacements);
+  aScene->mMaterialGltfSamplers = (cgltf_sampler*)SDL_calloc(aScene->mMaterialsCount, sizeof(cgltf_sampler));
 
-      switch (attribute->type) {
-        case cgltf_attribute_type_position: {
-          SDL_assert(attribute->data->type == cgltf_type_vec3);
-          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
-          aSceneInfo->mPositionBytes += attribute->data->count * sizeof(float3);
-          break;
-        }
-        case cgltf_attribute_type_normal: {
-          SDL_assert(attribute->data->type == cgltf_type_vec3);
-          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
-          aSceneInfo->mNormalBytes += attribute->data->count * sizeof(float3);
-          break;
-        }
-        case cgltf_attribute_type_tangent: {
-          SDL_assert(attribute->data->type == cgltf_type_vec4);
-          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
-          aSceneInfo->mTangentBytes += attribute->data->count * sizeof(float4);
-          break;
-        }
-        case cgltf_attribute_type_texcoord: {
-          SDL_assert(attribute->data->type == cgltf_type_vec2);
-          SDL_assert(attribute->data->component_type == cgltf_component_type_r_32f);
+  for (size_t i = 0; i < aScene->mMaterialsCount; ++i) {
+    aScene->mMaterials[i].mLayer = -1;
 
-          int texcoordIndex = SDL_atoi(attribute->name + 9);
-          aSceneInfo->mTexcoordBytes[texcoordIndex] += attribute->data->count * sizeof(float2);
-          break;
-        }
-        default: break;
+    // Textures without a sampler repeat and leave the filtering up to us.
+    cgltf_sampler* sampler = aScene->mMaterialGltfSamplers + i;
+    sampler->wrap_s = cgltf_wrap_mode_repeat;
+    sampler->wrap_t = cgltf_wrap_mode_repeat;
+
+    const cgltf_texture* texture = i < aData->materials_count ? aData->materials[i].pbr_metallic_roughness.base_color_texture.texture : NULL;
+    if (texture && texture->image && images[texture->image - aData->images]) {
+      aScene->mMaterials[i] = imagePlacements[texture->image - aData->images];
+
+      // The rest of the cgltf_sampler points into aData, which is gone once the Scene is loaded.
+      if (texture->sampler) {
+        sampler->mag_filter = texture->sampler->mag_filter;
+        sampler->min_filter = texture->sampler->min_filter;
+        sampler->wrap_s = texture->sampler->wrap_s;
+        sampler->wrap_t = texture->sampler->wrap_t;
       }
     }
   }
-}
-
-
-SceneInfo GetSceneInfo(cgltf_data* aData)
-{
-  SceneInfo sceneInfo;
-  SDL_zero(sceneInfo);
 
-  if (!aData) {
-    return sceneInfo;
+  for (size_t i = 0; i < aData->images_count; ++i) {
+    if (images[i]) {
+      SDL_DestroySurface(images[i]);
+    }
   }
 
-  if (!aData->scene) {
-    return sceneInfo;
-  }
+  SDL_free(imagePlacements);
+  SDL_free(imagesTried);
+  SDL_free(images);
+}
 
-  sceneInfo.mRootNodes = (Uint32)aData->scene->nodes_count;
+// Has to be called on the render thread, the samplers go back to aCache with ReleaseSceneSamplers.
+void AcquireSceneSamplers(Scene* aScene, SamplerCache* aCache)
+{
+  aScene->mMaterialSamplers = (SDL_GPUSampler**)SDL_calloc(aScene->mMaterialsCount, sizeof(SDL_GPUSampler*));
+  for (size_t i = 0; i < aScene->mMaterialsCount; ++i) {
+    aScene->mMaterialSamplers[i] = CreateSamplerFromGltf(aCache, aScene->mMaterialGltfSamplers + i);
+  }
+}
 
-  for (size_t i = 0; i < aData->scene->nodes_count; ++i) {
-    sceneInfo.mTotalNodes++;
-    ProcessNodeInfo(aData->scene->nodes[i], &sceneInfo);
+void ReleaseSceneSamplers(Scene* aScene, SamplerCache* aCache)
+{
+  for (size_t i = 0; aScene->mMaterialSamplers && i < aScene->mMaterialsCount; ++i) {
+    ReleaseCachedSampler(aCache, aScene->mMaterialSamplers[i]);
   }
 
-  return sceneInfo;
+  SDL_free(aScene->mMaterialSamplers);
+  SDL_free(aScene->mMaterialGltfSamplers);
+  aScene->mMaterialSamplers = NULL;
+  aScene->mMaterialGltfSamplers = NULL;
 }
 
-typedef struct Mesh {
-  float4x4 mTransform;
+// aLoadMaterialTextures packs every material's base color texture into Scene::mMaterialTexture,
+// without it the Scene is drawn untextured.
+Scene LoadGltfModel(UploadBatch* aBatch, BufferHeap* aHeap, const char* aModelName, bool aLoadMaterialTextures) {
+  char model_path[4096];
+  SDL_snprintf(model_path, SDL_arraysize(model_path), "Assets/Models/%s", aModelName);
 
-  float4x4 mCurrentTransform; 
+  cgltf_options options;
+  SDL_zero(options);
 
-  Uint32 mIndicesCount;
+  cgltf_data* data = NULL;
+  cgltf_result result = cgltf_parse_file(&options, model_path, &data);
+  SDL_assert(result == cgltf_result_success);
 
-  Uint32 mChildrenOffset;
-  Uint32 mChildrenCount;
+  result = cgltf_load_buffers(&options, data, model_path);
+  SDL_assert(result == cgltf_result_success);
 
-  // Offsets into parent model position/normal/tangent/index buffers
-  Uint32 mPositionOffset;
-  Uint32 mNormalOffset;
-  Uint32 mTangentOffset;
-  Uint32 mIndexOffset;
+  SDL_Log("Model: %s", model_path);
 
-  Uint8 mBaseColorTextureCoordinates;
-  Uint8 mMetallicRoughnessTextureCoordinates;
+  SceneInfo sceneInfo = GetSceneInfo(data);
+  Scene scene = GenerateGPUScene(aBatch, aHeap, data, sceneInfo);
+  LoadGltfMaterials(aBatch, data, aLoadMaterialTextures, &scene);
+  return scene;
+}
 
-  Uint8 mDiffuseTextureCoordinates;
-  Uint8 mSpecularGlossinessTextureCoordinates;
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// GPU Hierarchy
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Keeps the local transforms and parent indices of a Scene on the GPU and propagates them down the
+// hierarchy with one compute dispatch per level, so the CPU never has to build a world matrix.
+typedef struct GpuHierarchy {
+  SDL_GPUComputePipeline* mPipeline;
+
+  // Rewritten through the UploadRing on the frame after MarkGpuHierarchyLocalTransformsDirty.
+  DynamicBuffer mLocalTransforms;
+  SDL_GPUBuffer* mParents;
+  SDL_GPUBuffer* mLevelOrder;
+  SDL_GPUBuffer* mWorldTransforms;
+
+  // Per instance vertex stream, DrawPacket i is drawn as instance i and reads its transform index from here.
+  SDL_GPUBuffer* mTransformIndices;
+
+  bool mLocalTransformsDirty;
+} GpuHierarchy;
+
+typedef struct PropagateTransformsUbo {
+  float4x4 mModelToWorld;
+  Uint32 mLevelOffset;
+  Uint32 mLevelCount;
+  Uint32 mPadding[2];
+} PropagateTransformsUbo;
+
+void WriteGpuHierarchyLocalTransforms(float4x4* aDestination, const Scene* aScene)
+{
+  for (size_t i = 0; i < aScene->mMeshesCount; ++i) {
+    aDestination[i] = aScene->mMeshes[i].mTransform;
+  }
+}
 
-  Uint8 mNormalTextureCoordinates;
-  Uint8 mOcclusionTextureCoordinates;
-  Uint8 mEmissveTextureCoordinates;
-} Mesh;
+// Call after changing any Mesh::mTransform, the whole buffer is uploaded again with the next update.
+void MarkGpuHierarchyLocalTransformsDirty(GpuHierarchy* aHierarchy)
+{
+  aHierarchy->mLocalTransformsDirty = true;
+}
 
-typedef struct Scene {
-  SDL_GPUBuffer* mPositions;
-  SDL_GPUBuffer* mNormals;
-  SDL_GPUBuffer* mTangents;
-  SDL_GPUBuffer* mTexcoords[16];
-  SDL_GPUBuffer* mIndices;
+// Writes straight into this frame's slice of the ring, the copy is recorded with the rest of the
+// ring's before the hierarchy is propagated.
+void UpdateGpuHierarchyLocalTransforms(GpuHierarchy* aHierarchy, UploadRing* aRing, const Scene* aScene)
+{
+  if (!aHierarchy->mLocalTransformsDirty) {
+    return;
+  }
 
-  Mesh* mMeshes;
-  size_t mRootMeshesCount;
-  size_t mMeshesCount;
-  //SDL_GPUBuffer* mTextureCoordinates; // float2
-} Scene;
+  float4x4* localTransforms = (float4x4*)UpdateDynamicBuffer(aRing, &aHierarchy->mLocalTransforms, 0, aHierarchy->mLocalTransforms.mSize);
+  WriteGpuHierarchyLocalTransforms(localTransforms, aScene);
+  aHierarchy->mLocalTransformsDirty = false;
+}
 
-void ApplyMeshTransformToChildren(Scene* aScene, Mesh* aMesh)
+// Needs to be redone whenever the DrawPackets are rebuilt.
+void UploadGpuHierarchyTransformIndices(GpuHierarchy* aHierarchy, UploadBatch* aBatch, const Scene* aScene)
 {
-  Mesh* meshChildren = aScene->mMeshes + aMesh->mChildrenOffset;
-  for (size_t i = 0; i < aMesh->mChildrenCount; ++i)
-  {
-    Mesh* childMesh = meshChildren + i;
+  Uint32 packetsCount = (Uint32)SDL_max(aScene->mDrawPacketsCount, 1);
+  Uint32* transformIndices = SDL_calloc(packetsCount, sizeof(Uint32));
 
-    float4x4 temp = childMesh->mCurrentTransform;
-    childMesh->mCurrentTransform = Float4x4_Multiply(&aMesh->mCurrentTransform, &childMesh->mTransform);
-    //childMesh->mCurrentTransform.columns[3].x += aMesh->mCurrentTransform.columns[3].x;
-    //childMesh->mCurrentTransform.columns[3].y += aMesh->mCurrentTransform.columns[3].y;
-    //childMesh->mCurrentTransform.columns[3].z += aMesh->mCurrentTransform.columns[3].z;
-    //childMesh->mCurrentTransform = Float4x4_Multiply(&childMesh->mTransform, &aMesh->mCurrentTransform);
-    ApplyMeshTransformToChildren(aScene, childMesh);
+  for (size_t i = 0; i < aScene->mDrawPacketsCount; ++i) {
+    transformIndices[i] = aScene->mDrawPackets[i].mTransformIndex;
   }
-}
 
-void RecalculateSceneTransform(Scene* aScene)
-{
-  for (size_t i = 0; i < aScene->mRootMeshesCount; ++i)
-  {
-    Mesh* mesh = aScene->mMeshes + i;
-    float4x4 temp = mesh->mCurrentTransform;
-    mesh->mCurrentTransform = mesh->mTransform;
-    ApplyMeshTransformToChildren(aScene, mesh);
+  if (aHierarchy->mTransformIndices) {
+    SDL_ReleaseGPUBuffer(gContext.mDevice, aHierarchy->mTransformIndices);
   }
-}
 
-typedef struct SceneProcessing {
-  Uint32 mPositionOffset;
-  Uint32 mPositionOffsetSoFar;
-  Uint32 mNormalOffset;
-  Uint32 mNormalOffsetSoFar;
-  Uint32 mTangentOffset;
-  Uint32 mTangentOffsetSoFar;
-  Uint32 mIndexOffset;
-  Uint32 mIndexOffsetSoFar;
-  Uint32 mCurrentMeshIndex;
-  Uint32 mCurrentChildrenIndex;
-} SceneProcessing;
+  aHierarchy->mTransformIndices = CreateAndUploadBufferBatched(aBatch, transformIndices, packetsCount * sizeof(Uint32), SDL_GPU_BUFFERUSAGE_VERTEX | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "GpuHierarchy TransformIndices");
+  SDL_free(transformIndices);
+}
 
-SDL_GPUFilter GltfFilterToSDL(cgltf_filter_type aFilter)
+GpuHierarchy CreateGpuHierarchy(UploadBatch* aBatch, const Scene* aScene)
 {
-  switch (aFilter) {
-    case cgltf_filter_type_nearest: return SDL_GPU_FILTER_NEAREST;
-    case cgltf_filter_type_linear: return SDL_GPU_FILTER_LINEAR;
-    case cgltf_filter_type_nearest_mipmap_nearest: return SDL_GPU_FILTER_NEAREST;
-    case cgltf_filter_type_linear_mipmap_nearest: return SDL_GPU_FILTER_LINEAR;
-    case cgltf_filter_type_nearest_mipmap_linear: return SDL_GPU_FILTER_NEAREST;
-    case cgltf_filter_type_linear_mipmap_linear: return SDL_GPU_FILTER_LINEAR;
+  GpuHierarchy hierarchy;
+  SDL_zero(hierarchy);
 
-    default:
-    case cgltf_filter_type_undefined: {
-      SDL_Log("Using unknown filter, defaulting to SDL_GPU_FILTER_NEAREST");
-      return SDL_GPU_FILTER_NEAREST;
-    }
-  }
+  hierarchy.mPipeline = CreateComputePipeline("PropagateTransforms.comp", 0, 0, 3, 0, 1, 1, 64, 1, 1);
+
+  Uint32 localTransformsSize = (Uint32)(aScene->mMeshesCount * sizeof(float4x4));
+  hierarchy.mLocalTransforms = CreateDynamicBuffer(localTransformsSize, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "GpuHierarchy LocalTransforms");
+
+  UploadAllocation localTransforms = AllocateUpload(aBatch, localTransformsSize);
+  WriteGpuHierarchyLocalTransforms((float4x4*)localTransforms.mData, aScene);
+  QueueBufferCopy(aBatch, &localTransforms, 0, hierarchy.mLocalTransforms.mBuffer, 0, localTransformsSize);
+
+  Uint32 meshesSize = (Uint32)(aScene->mMeshesCount * sizeof(Uint32));
+  hierarchy.mParents = CreateAndUploadBufferBatched(aBatch, aScene->mParents, meshesSize, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "GpuHierarchy Parents");
+  hierarchy.mLevelOrder = CreateAndUploadBufferBatched(aBatch, aScene->mLevelOrder, meshesSize, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "GpuHierarchy LevelOrder");
+
+  hierarchy.mWorldTransforms = CreateGPUBuffer(
+    (Uint32)(aScene->mMeshesCount * sizeof(float4x4)),
+    SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+    "GpuHierarchy WorldTransforms"
+  );
+
+  UploadGpuHierarchyTransformIndices(&hierarchy, aBatch, aScene);
+
+  return hierarchy;
 }
 
-SDL_GPUSamplerAddressMode GltfAddressModeToSDL(cgltf_wrap_mode aWrap)
+// Must be recorded outside of any render pass, each level gets its own compute pass so that
+// the writes of a level are visible to the next one.
+void PropagateGpuHierarchy(GpuHierarchy* aHierarchy, const Scene* aScene, SDL_GPUCommandBuffer* aCommandBuffer, const float4x4* aModelToWorld)
 {
-  switch (aWrap) {
-    case cgltf_wrap_mode_clamp_to_edge: return SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
-    case cgltf_wrap_mode_mirrored_repeat: return SDL_GPU_SAMPLERADDRESSMODE_MIRRORED_REPEAT;
-    case cgltf_wrap_mode_repeat: return SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
+  PropagateTransformsUbo ubo;
+  SDL_zero(ubo);
+  ubo.mModelToWorld = *aModelToWorld;
+
+  SDL_GPUBuffer* readOnlyBuffers[3] = {
+    aHierarchy->mLocalTransforms.mBuffer,
+    aHierarchy->mParents,
+    aHierarchy->mLevelOrder,
+  };
 
-    default: {
-      SDL_Log("Using unknown address mode, defaulting to SDL_GPU_SAMPLERADDRESSMODE_REPEAT");
-      return SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
-    }
+  for (Uint32 level = 0; level < aScene->mLevelsCount; ++level) {
+    ubo.mLevelOffset = aScene->mLevelOffsets[level];
+    ubo.mLevelCount = aScene->mLevelOffsets[level + 1] - aScene->mLevelOffsets[level];
+
+    SDL_GPUStorageBufferReadWriteBinding worldTransformsBinding;
+    SDL_zero(worldTransformsBinding);
+    worldTransformsBinding.buffer = aHierarchy->mWorldTransforms;
+    worldTransformsBinding.cycle = false;
+
+    SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(aCommandBuffer, NULL, 0, &worldTransformsBinding, 1);
+    SDL_BindGPUComputePipeline(computePass, aHierarchy->mPipeline);
+    SDL_BindGPUComputeStorageBuffers(computePass, 0, readOnlyBuffers, SDL_arraysize(readOnlyBuffers));
+    SDL_PushGPUComputeUniformData(aCommandBuffer, 0, &ubo, sizeof(ubo));
+    SDL_DispatchGPUCompute(computePass, (ubo.mLevelCount + 63) / 64, 1, 1);
+    SDL_EndGPUComputePass(computePass);
   }
 }
 
-SDL_GPUSampler* CreateSamplerFromGltf(cgltf_sampler* aSampler)
+void DestroyGpuHierarchy(GpuHierarchy* aHierarchy)
+{
+  SDL_ReleaseGPUComputePipeline(gContext.mDevice, aHierarchy->mPipeline);
+  DestroyDynamicBuffer(&aHierarchy->mLocalTransforms);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aHierarchy->mParents);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aHierarchy->mLevelOrder);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aHierarchy->mWorldTransforms);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aHierarchy->mTransformIndices);
+  SDL_zero(*aHierarchy);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Depth Pyramid
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A copy of the depth buffer with every mip level down to a single texel, each texel the farthest
+// depth of the four under it. It's built from the frame's depth once the frame is drawn, so the next
+// frame can check whether a mesh is behind everything drawn over where it lands. Depth is reversed,
+// cleared to 0 and tested GREATER_OR_EQUAL, so the farthest depth is the smallest one.
+typedef struct DepthPyramid {
+  SDL_GPUComputePipeline* mCopyPipeline;
+  SDL_GPUComputePipeline* mReducePipeline;
+
+  // The depth buffer is read with Load, but it still needs a sampler to be bound.
+  SamplerCache* mSamplerCache;
+  SDL_GPUSampler* mSampler;
+
+  SDL_GPUTexture* mTexture;
+  Uint32 mWidth;
+  Uint32 mHeight;
+  Uint32 mLevelsCount;
+
+  // What the depth in mTexture was drawn with, and whether it was built from the previous frame.
+  // Any frame that doesn't build it clears mValid, so turning occlusion culling back on never tests
+  // against depth from however long ago it was switched off.
+  float4x4 mWorldToNDC;
+  bool mValid;
+
+  // Needs a depth format that can be sampled, and a pyramid format each level can be read and
+  // written as storage in the same pass.
+  bool mSupported;
+} DepthPyramid;
+
+typedef struct CopyDepthPyramidUbo {
+  Uint32 mWidth;
+  Uint32 mHeight;
+  Uint32 mPadding[2];
+} CopyDepthPyramidUbo;
+
+typedef struct ReduceDepthPyramidUbo {
+  Uint32 mSourceWidth;
+  Uint32 mSourceHeight;
+  Uint32 mDestinationWidth;
+  Uint32 mDestinationHeight;
+} ReduceDepthPyramidUbo;
+
+static const SDL_GPUTextureUsageFlags cDepthPyramidUsage =
+  SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_SIMULTANEOUS_READ_WRITE;
+
+DepthPyramid CreateDepthPyramid(SamplerCache* aSamplerCache, SDL_GPUTextureFormat aDepthFormat)
 {
+  DepthPyramid pyramid;
+  SDL_zero(pyramid);
+
+  pyramid.mSupported =
+    SDL_GPUTextureSupportsFormat(gContext.mDevice, aDepthFormat, SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER) &&
+    SDL_GPUTextureSupportsFormat(gContext.mDevice, SDL_GPU_TEXTUREFORMAT_R32_FLOAT, SDL_GPU_TEXTURETYPE_2D, cDepthPyramidUsage);
+
+  pyramid.mCopyPipeline = CreateComputePipeline("CopyDepthPyramid.comp", 1, 0, 0, 1, 0, 1, 8, 8, 1);
+  pyramid.mReducePipeline = CreateComputePipeline("ReduceDepthPyramid.comp", 0, 0, 0, 2, 0, 1, 8, 8, 1);
+
   SDL_GPUSamplerCreateInfo samplerCreateInfo;
   SDL_zero(samplerCreateInfo);
+  samplerCreateInfo.min_filter = SDL_GPU_FILTER_NEAREST;
+  samplerCreateInfo.mag_filter = SDL_GPU_FILTER_NEAREST;
+  samplerCreateInfo.mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST;
+  samplerCreateInfo.address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.max_lod = cMaxLod;
+  pyramid.mSamplerCache = aSamplerCache;
+  pyramid.mSampler = AcquireCachedSampler(aSamplerCache, &samplerCreateInfo);
 
-  samplerCreateInfo.mag_filter = GltfFilterToSDL(aSampler->mag_filter);
-  samplerCreateInfo.min_filter = GltfFilterToSDL(aSampler->min_filter);
-  samplerCreateInfo.address_mode_u = GltfAddressModeToSDL(aSampler->wrap_s);
-  samplerCreateInfo.address_mode_v = GltfAddressModeToSDL(aSampler->wrap_t);
-
-  return SDL_CreateGPUSampler(gContext.mDevice, &samplerCreateInfo);
+  return pyramid;
 }
 
-size_t transferBufferSize = 0;
-
-void GenerateGPUMesh(cgltf_node* aNode, Scene* aScene, SceneProcessing* aSceneProcessing, Mesh* aMesh, Uint8* aTransferPtr)
+// Call whenever the depth buffer changes size, whatever was built so far is thrown out.
+void ResizeDepthPyramid(DepthPyramid* aPyramid, Uint32 aWidth, Uint32 aHeight)
 {
-  aMesh->mChildrenOffset = aSceneProcessing->mCurrentChildrenIndex;
-  aMesh->mChildrenCount = (Uint32)aNode->children_count;
-  Mesh* meshChildren = aScene->mMeshes + aMesh->mChildrenOffset;
-  aSceneProcessing->mCurrentChildrenIndex += (Uint32)aNode->children_count;
-
-  for (size_t i = 0; i < aNode->children_count; ++i) {
-    GenerateGPUMesh(aNode->children[i], aScene, aSceneProcessing, meshChildren + i, aTransferPtr);
+  if (aPyramid->mTexture) {
+    SDL_ReleaseGPUTexture(gContext.mDevice, aPyramid->mTexture);
   }
 
-  cgltf_node_transform_local(aNode, (float*)&aMesh->mTransform.data[0]);
-  cgltf_node_transform_world(aNode, (float*)&aMesh->mCurrentTransform.data[0]);
+  Uint32 levelsCount = 1;
+  while ((SDL_max(aWidth, aHeight) >> levelsCount) != 0) {
+    ++levelsCount;
+  }
 
-  aMesh->mPositionOffset = aSceneProcessing->mPositionOffsetSoFar - aSceneProcessing->mPositionOffset;
-  aMesh->mNormalOffset = aSceneProcessing->mNormalOffsetSoFar - aSceneProcessing->mNormalOffset;
-  aMesh->mTangentOffset = aSceneProcessing->mTangentOffsetSoFar - aSceneProcessing->mTangentOffset;
-  aMesh->mIndexOffset = aSceneProcessing->mIndexOffsetSoFar - aSceneProcessing->mIndexOffset;
+  // Even when it's never built, the culling still needs something to bind.
+  SDL_GPUTextureUsageFlags usage = aPyramid->mSupported ? cDepthPyramidUsage : SDL_GPU_TEXTUREUSAGE_SAMPLER;
+  aPyramid->mTexture = CreateTexture(aWidth, aHeight, 1, levelsCount, usage, SDL_GPU_TEXTUREFORMAT_R32_FLOAT, "DepthPyramid");
+  aPyramid->mWidth = aWidth;
+  aPyramid->mHeight = aHeight;
+  aPyramid->mLevelsCount = levelsCount;
+  aPyramid->mValid = false;
+}
 
-  cgltf_mesh* mesh_file = aNode->mesh;
-  if (mesh_file == NULL) {
+// Must be recorded outside of any render pass, after aDepthTexture has been drawn with aWorldToNDC
+// and stored.
+void BuildDepthPyramid(DepthPyramid* aPyramid, SDL_GPUCommandBuffer* aCommandBuffer, SDL_GPUTexture* aDepthTexture, const float4x4* aWorldToNDC)
+{
+  if (!aPyramid->mSupported) {
     return;
   }
 
-  for (size_t j = 0; j < mesh_file->primitives_count; ++j) {
-    cgltf_primitive* primitive = &mesh_file->primitives[j];
+  {
+    CopyDepthPyramidUbo ubo;
+    SDL_zero(ubo);
+    ubo.mWidth = aPyramid->mWidth;
+    ubo.mHeight = aPyramid->mHeight;
+
+    // Every level is rewritten, so last frame's can be cycled away from whatever still reads it.
+    SDL_GPUStorageTextureReadWriteBinding binding;
+    SDL_zero(binding);
+    binding.texture = aPyramid->mTexture;
+    binding.mip_level = 0;
+    binding.cycle = true;
+
+    SDL_GPUTextureSamplerBinding depthBinding;
+    SDL_zero(depthBinding);
+    depthBinding.texture = aDepthTexture;
+    depthBinding.sampler = aPyramid->mSampler;
+
+    SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(aCommandBuffer, &binding, 1, NULL, 0);
+    SDL_BindGPUComputePipeline(computePass, aPyramid->mCopyPipeline);
+    SDL_BindGPUComputeSamplers(computePass, 0, &depthBinding, 1);
+    SDL_PushGPUComputeUniformData(aCommandBuffer, 0, &ubo, sizeof(ubo));
+    SDL_DispatchGPUCompute(computePass, (ubo.mWidth + 7) / 8, (ubo.mHeight + 7) / 8, 1);
+    SDL_EndGPUComputePass(computePass);
+  }
 
-    aMesh->mIndicesCount = (Uint32)primitive->indices->count;
-    cgltf_accessor_unpack_indices(primitive->indices, (void*)(aTransferPtr + aSceneProcessing->mIndexOffsetSoFar), sizeof(Uint32), primitive->indices->count);
-    aSceneProcessing->mIndexOffsetSoFar += (Uint32)primitive->indices->count * sizeof(Uint32);
+  // A pass per level, so each one sees all of the writes to the level above it.
+  for (Uint32 level = 1; level < aPyramid->mLevelsCount; ++level) {
+    ReduceDepthPyramidUbo ubo;
+    ubo.mSourceWidth = SDL_max(aPyramid->mWidth >> (level - 1), 1);
+    ubo.mSourceHeight = SDL_max(aPyramid->mHeight >> (level - 1), 1);
+    ubo.mDestinationWidth = SDL_max(aPyramid->mWidth >> level, 1);
+    ubo.mDestinationHeight = SDL_max(aPyramid->mHeight >> level, 1);
+
+    SDL_GPUStorageTextureReadWriteBinding bindings[2];
+    SDL_zero(bindings);
+    bindings[0].texture = aPyramid->mTexture;
+    bindings[0].mip_level = level - 1;
+    bindings[0].cycle = false;
+    bindings[1].texture = aPyramid->mTexture;
+    bindings[1].mip_level = level;
+    bindings[1].cycle = false;
+
+    SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(aCommandBuffer, bindings, SDL_arraysize(bindings), NULL, 0);
+    SDL_BindGPUComputePipeline(computePass, aPyramid->mReducePipeline);
+    SDL_PushGPUComputeUniformData(aCommandBuffer, 0, &ubo, sizeof(ubo));
+    SDL_DispatchGPUCompute(computePass, (ubo.mDestinationWidth + 7) / 8, (ubo.mDestinationHeight + 7) / 8, 1);
+    SDL_EndGPUComputePass(computePass);
+  }
 
-    SDL_assert(aSceneProcessing->mIndexOffsetSoFar <= transferBufferSize);
+  aPyramid->mWorldToNDC = *aWorldToNDC;
+  aPyramid->mValid = true;
+}
 
-    for (size_t k = 0; k < primitive->attributes_count; ++k) {
-      Uint32* attributeCount = NULL;
-      cgltf_attribute* attribute = &primitive->attributes[k];
-      switch (attribute->type) {
-        case cgltf_attribute_type_position: attributeCount = &aSceneProcessing->mPositionOffsetSoFar; break;
-        case cgltf_attribute_type_normal: attributeCount = &aSceneProcessing->mNormalOffsetSoFar; break;
-        case cgltf_attribute_type_tangent: attributeCount = &aSceneProcessing->mTangentOffsetSoFar; break;
-        default: continue;
-      }
+void DestroyDepthPyramid(DepthPyramid* aPyramid)
+{
+  SDL_ReleaseGPUComputePipeline(gContext.mDevice, aPyramid->mCopyPipeline);
+  SDL_ReleaseGPUComputePipeline(gContext.mDevice, aPyramid->mReducePipeline);
+  ReleaseCachedSampler(aPyramid->mSamplerCache, aPyramid->mSampler);
+  SDL_ReleaseGPUTexture(gContext.mDevice, aPyramid->mTexture);
+  SDL_zerop(aPyramid);
+}
 
-      if (!attributeCount) {
-        continue;
-      }
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Indirect Draws
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The whole draw list of a Scene in GPU buffers, so it goes out in a single indirect draw instead of
+// a CPU loop of draws. Nothing can change between the draws of an indirect call, so the vertex
+// streams are bound once at the start of their allocations and every command has a vertex offset
+// into them, and the materials are looked up by the fragment shader.
+//
+// They can also be frustum culled on the GPU, a compute pass copies the commands of the visible
+// draws to the front of mCulledCommands, counting them with an atomic, and a second one empties out
+// the rest. The CPU never waits on the count, it always draws all of mCulledCommands, but it's read
+// back a frame or two late for the statistics. Given a DepthPyramid, the same pass also drops draws
+// hidden behind last frame's depth.
+typedef struct IndirectDraws {
+  SDL_GPUComputePipeline* mCullPipeline;
+  SDL_GPUComputePipeline* mFillPipeline;
+
+  // One command per DrawPacket, whose first instance is the index of the packet, so the per instance
+  // streams line up with GpuHierarchy::mTransformIndices.
+  SDL_GPUBuffer* mCommands;
+  Uint32 mCommandsCount;
+
+  // Per instance vertex stream of Scene::mMaterials indices.
+  SDL_GPUBuffer* mMaterialIndices;
+
+  // Scene::mMaterials as a storage buffer.
+  SDL_GPUBuffer* mMaterials;
+
+  // Local bounding sphere of each DrawPacket, and where the culling writes the visible commands.
+  SDL_GPUBuffer* mBounds;
+  SDL_GPUBuffer* mCulledCommands;
+
+  // Zeroed through the UploadRing every frame before the culling counts into it.
+  DynamicBuffer mVisibleCount;
+
+  // mVisibleCount is copied into mVisibleCountReadback on request, and mLastVisibleCount is updated
+  // once mVisibleCountFence signals.
+  SDL_GPUTransferBuffer* mVisibleCountReadback;
+  SDL_GPUFence* mVisibleCountFence;
+  Uint32 mLastVisibleCount;
+} IndirectDraws;
+
+typedef struct CullIndirectDrawsUbo {
+  float4x4 mModelToWorld;
+  float4x4 mPreviousWorldToNDC;
+  float4 mPlanes[6];
+  Uint32 mPlanesCount;
+  Uint32 mDrawsCount;
+  Uint32 mDepthPyramidWidth;
+  Uint32 mDepthPyramidHeight;
+  Uint32 mDepthPyramidLevels;
+  Uint32 mUseOcclusion;
+  Uint32 mPadding[2];
+} CullIndirectDrawsUbo;
+
+typedef struct FillCulledDrawsUbo {
+  Uint32 mDrawsCount;
+  Uint32 mPadding[3];
+} FillCulledDrawsUbo;
+
+// Needs to be redone whenever the DrawPackets are rebuilt.
+void UploadIndirectDraws(IndirectDraws* aDraws, UploadBatch* aBatch, const Scene* aScene)
+{
+  Uint32 packetsCount = (Uint32)SDL_max(aScene->mDrawPacketsCount, 1);
+  SDL_GPUIndexedIndirectDrawCommand* commands = SDL_calloc(packetsCount, sizeof(SDL_GPUIndexedIndirectDrawCommand));
+  Uint32* materialIndices = SDL_calloc(packetsCount, sizeof(Uint32));
+  float4* bounds = SDL_calloc(packetsCount, sizeof(float4));
+
+  for (size_t i = 0; i < aScene->mDrawPacketsCount; ++i) {
+    const DrawPacket* packet = aScene->mDrawPackets + i;
+
+    // The loader gives every vertex an entry in each stream, so the position offset is enough.
+    commands[i].num_indices = packet->mIndicesCount;
+    commands[i].num_instances = 1;
+    commands[i].first_index = packet->mFirstIndex;
+    commands[i].vertex_offset = (Sint32)((packet->mPositionOffset - aScene->mPositions.mOffset) / sizeof(float3));
+    commands[i].first_instance = (Uint32)i;
+
+    materialIndices[i] = packet->mMaterialIndex;
+
+    // The sphere around the primitive's bounding box.
+    bounds[i].x = packet->mBoundsCenter.x;
+    bounds[i].y = packet->mBoundsCenter.y;
+    bounds[i].z = packet->mBoundsCenter.z;
+    bounds[i].w = Float3_Magnitude(packet->mBoundsExtent);
+  }
 
-      *attributeCount += cgltf_accessor_unpack_floats(
-        attribute->data,
-        (cgltf_float*)(aTransferPtr + *attributeCount),
-        attribute->data->count * cgltf_num_components(attribute->data->type)
-      ) * sizeof(float);
+  if (aDraws->mCommands) {
+    SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mCommands);
+    SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mMaterialIndices);
+    SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mBounds);
+    SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mCulledCommands);
+  }
 
-      SDL_assert(*attributeCount < transferBufferSize);
-    }
+  Uint32 commandsSize = packetsCount * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+  aDraws->mCommands = CreateAndUploadBufferBatched(aBatch, commands, commandsSize, SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "IndirectDraws Commands");
+  aDraws->mMaterialIndices = CreateAndUploadBufferBatched(aBatch, materialIndices, packetsCount * sizeof(Uint32), SDL_GPU_BUFFERUSAGE_VERTEX, "IndirectDraws MaterialIndices");
+  aDraws->mBounds = CreateAndUploadBufferBatched(aBatch, bounds, packetsCount * sizeof(float4), SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, "IndirectDraws Bounds");
+  aDraws->mCulledCommands = CreateGPUBuffer(commandsSize, SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE, "IndirectDraws CulledCommands");
+  aDraws->mCommandsCount = (Uint32)aScene->mDrawPacketsCount;
+
+  // The materials don't change along with the DrawPackets.
+  if (!aDraws->mMaterials) {
+    aDraws->mMaterials = CreateAndUploadBufferBatched(aBatch, aScene->mMaterials, (Uint32)(aScene->mMaterialsCount * sizeof(MaterialTexture)), SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ, "IndirectDraws Materials");
   }
+
+  SDL_free(bounds);
+  SDL_free(materialIndices);
+  SDL_free(commands);
 }
 
-Scene GenerateGPUScene(cgltf_data* aData, SceneInfo aSceneInfo)
+IndirectDraws CreateIndirectDraws(UploadBatch* aBatch, const Scene* aScene)
 {
-  Scene scene;
-  SDL_zero(scene);
+  IndirectDraws draws;
+  SDL_zero(draws);
 
-  Uint32 indexBytes = aSceneInfo.mIndicesCount * sizeof(Uint32);
-  scene.mPositions = CreateGPUBuffer(aSceneInfo.mPositionBytes, SDL_GPU_BUFFERUSAGE_VERTEX, "Positions");
-  scene.mNormals = CreateGPUBuffer(aSceneInfo.mNormalBytes, SDL_GPU_BUFFERUSAGE_VERTEX, "Normals");
-  scene.mTangents = CreateGPUBuffer(aSceneInfo.mTangentBytes, SDL_GPU_BUFFERUSAGE_VERTEX, "Tangents");
+  draws.mCullPipeline = CreateComputePipeline("CullIndirectDraws.comp", 1, 0, 4, 0, 2, 1, 64, 1, 1);
+  draws.mFillPipeline = CreateComputePipeline("FillCulledDraws.comp", 0, 0, 1, 0, 1, 1, 64, 1, 1);
+  draws.mVisibleCount = CreateDynamicBuffer(sizeof(Uint32), SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE, "IndirectDraws VisibleCount");
+  draws.mVisibleCountReadback = CreateTransferBuffer(sizeof(Uint32), SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD, "IndirectDraws VisibleCount Readback");
 
-  for (size_t i = 0; i < 16; ++i) {
-    if (aSceneInfo.mTexcoordBytes[i] == 0) {
-      continue;
-    }
+  UploadIndirectDraws(&draws, aBatch, aScene);
+  return draws;
+}
 
-    scene.mTexcoords[i] = CreateGPUBuffer(aSceneInfo.mTexcoordBytes[i], SDL_GPU_BUFFERUSAGE_VERTEX, "Tangents");
+// Has to happen before the ring's copies are recorded, so the count starts from zero.
+void ResetIndirectDrawsVisibleCount(IndirectDraws* aDraws, UploadRing* aRing)
+{
+  Uint32* visibleCount = (Uint32*)UpdateDynamicBuffer(aRing, &aDraws->mVisibleCount, 0, sizeof(Uint32));
+  *visibleCount = 0;
+}
+
+// Must be recorded outside of any render pass, after aWorldTransforms have been written for the
+// frame. aModelToWorld is whatever still has to be applied on top of aWorldTransforms. aDepthPyramid
+// is always bound, but only tested against with aUseOcclusion once something has been built into it.
+void CullIndirectDraws(
+  IndirectDraws* aDraws,
+  SDL_GPUCommandBuffer* aCommandBuffer,
+  SDL_GPUBuffer* aTransformIndices,
+  SDL_GPUBuffer* aWorldTransforms,
+  const float4x4* aModelToWorld,
+  const float4x4* aWorldToNDC,
+  const DepthPyramid* aDepthPyramid,
+  bool aUseOcclusion)
+{
+  Uint32 groupsCount = (aDraws->mCommandsCount + 63) / 64;
+  if (groupsCount == 0) {
+    return;
   }
 
-  scene.mIndices = CreateGPUBuffer(indexBytes, SDL_GPU_BUFFERUSAGE_INDEX, "Indices");
-
-  SDL_GPUTransferBuffer* transferBuffer = NULL;
+  Frustum frustum = ExtractFrustum(aWorldToNDC);
 
-  {
-    SDL_GPUTransferBufferCreateInfo transferCreateInfo;
-    SDL_zero(transferCreateInfo);
-    SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_TEXTURE_CREATE_NAME_STRING, "ModelTransferBuffer");
-    transferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    transferCreateInfo.size = aSceneInfo.mPositionBytes + aSceneInfo.mNormalBytes + aSceneInfo.mTangentBytes + indexBytes;
-    transferCreateInfo.props = gContext.mProperties;
-
-    transferBufferSize = transferCreateInfo.size;
+  CullIndirectDrawsUbo cullUbo;
+  SDL_zero(cullUbo);
+  cullUbo.mModelToWorld = *aModelToWorld;
+  SDL_memcpy(cullUbo.mPlanes, frustum.mPlanes, sizeof(cullUbo.mPlanes));
+  cullUbo.mPlanesCount = frustum.mPlanesCount;
+  cullUbo.mDrawsCount = aDraws->mCommandsCount;
+  cullUbo.mPreviousWorldToNDC = aDepthPyramid->mWorldToNDC;
+  cullUbo.mDepthPyramidWidth = aDepthPyramid->mWidth;
+  cullUbo.mDepthPyramidHeight = aDepthPyramid->mHeight;
+  cullUbo.mDepthPyramidLevels = aDepthPyramid->mLevelsCount;
+  cullUbo.mUseOcclusion = aUseOcclusion && aDepthPyramid->mValid;
 
-    transferBuffer = SDL_CreateGPUTransferBuffer(gContext.mDevice, &transferCreateInfo);
-  }
-  SceneProcessing processing;
   {
-    SDL_zero(processing);
-    processing.mPositionOffsetSoFar = processing.mPositionOffset = 0;
-    processing.mNormalOffsetSoFar = processing.mNormalOffset = aSceneInfo.mPositionBytes;
-    processing.mTangentOffsetSoFar = processing.mTangentOffset = processing.mNormalOffset + aSceneInfo.mNormalBytes;
-    processing.mIndexOffsetSoFar = processing.mIndexOffset = processing.mTangentOffset + aSceneInfo.mTangentBytes;
+    SDL_GPUBuffer* readOnlyBuffers[4] = {
+      aDraws->mBounds,
+      aTransformIndices,
+      aWorldTransforms,
+      aDraws->mCommands,
+    };
+
+    // Every command gets rewritten between the two passes, so last frame's can be cycled away, but
+    // the count was just zeroed and has to be kept.
+    SDL_GPUStorageBufferReadWriteBinding bindings[2];
+    SDL_zero(bindings);
+    bindings[0].buffer = aDraws->mCulledCommands;
+    bindings[0].cycle = true;
+    bindings[1].buffer = aDraws->mVisibleCount.mBuffer;
+    bindings[1].cycle = false;
+
+    SDL_GPUTextureSamplerBinding depthPyramidBinding;
+    SDL_zero(depthPyramidBinding);
+    depthPyramidBinding.texture = aDepthPyramid->mTexture;
+    depthPyramidBinding.sampler = aDepthPyramid->mSampler;
+
+    SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(aCommandBuffer, NULL, 0, bindings, SDL_arraysize(bindings));
+    SDL_BindGPUComputePipeline(computePass, aDraws->mCullPipeline);
+    SDL_BindGPUComputeSamplers(computePass, 0, &depthPyramidBinding, 1);
+    SDL_BindGPUComputeStorageBuffers(computePass, 0, readOnlyBuffers, SDL_arraysize(readOnlyBuffers));
+    SDL_PushGPUComputeUniformData(aCommandBuffer, 0, &cullUbo, sizeof(cullUbo));
+    SDL_DispatchGPUCompute(computePass, groupsCount, 1, 1);
+    SDL_EndGPUComputePass(computePass);
   }
 
-  // Copy all of the scene data into the transfer buffer, generate Mesh hierarchy.
+  // Its own pass, so the count is final by the time it's read.
   {
-    Uint8* transferPtr = SDL_MapGPUTransferBuffer(gContext.mDevice, transferBuffer, false);
-
-    scene.mMeshesCount = aSceneInfo.mTotalNodes;
-    scene.mMeshes = SDL_calloc(scene.mMeshesCount, sizeof(Mesh));
-
-    scene.mRootMeshesCount = aSceneInfo.mRootNodes;
+    FillCulledDrawsUbo fillUbo;
+    SDL_zero(fillUbo);
+    fillUbo.mDrawsCount = aDraws->mCommandsCount;
+
+    SDL_GPUStorageBufferReadWriteBinding binding;
+    SDL_zero(binding);
+    binding.buffer = aDraws->mCulledCommands;
+    binding.cycle = false;
+
+    SDL_GPUComputePass* computePass = SDL_BeginGPUComputePass(aCommandBuffer, NULL, 0, &binding, 1);
+    SDL_BindGPUComputePipeline(computePass, aDraws->mFillPipeline);
+    SDL_BindGPUComputeStorageBuffers(computePass, 0, &aDraws->mVisibleCount.mBuffer, 1);
+    SDL_PushGPUComputeUniformData(aCommandBuffer, 0, &fillUbo, sizeof(fillUbo));
+    SDL_DispatchGPUCompute(computePass, groupsCount, 1, 1);
+    SDL_EndGPUComputePass(computePass);
+  }
+}
 
-    processing.mCurrentChildrenIndex += scene.mRootMeshesCount;
+// Call after the frame that culled has been submitted. Its own submit, so the fence only waits on
+// the copy, and does nothing while the last one is still being read back.
+void ReadBackIndirectDrawsVisibleCount(IndirectDraws* aDraws)
+{
+  if (aDraws->mVisibleCountFence) {
+    return;
+  }
 
-    for (size_t i = 0; i < aData->scene->nodes_count; ++i) {
-      GenerateGPUMesh(aData->scene->nodes[i], &scene, &processing, scene.mMeshes + i, transferPtr);
-    }
+  SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
 
-    SDL_UnmapGPUTransferBuffer(gContext.mDevice, transferBuffer);
-  }
+  SDL_GPUBufferRegion source;
+  SDL_zero(source);
+  source.buffer = aDraws->mVisibleCount.mBuffer;
+  source.size = sizeof(Uint32);
 
-  // Upload to the appropriate buffers
-  {
-    SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
-    SDL_assert(commandBuffer);
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
-    SDL_assert(copyPass);
+  SDL_GPUTransferBufferLocation destination;
+  SDL_zero(destination);
+  destination.transfer_buffer = aDraws->mVisibleCountReadback;
 
-    SDL_GPUTransferBufferLocation source;
-    source.offset = 0;
-    source.transfer_buffer = transferBuffer;
+  SDL_DownloadFromGPUBuffer(copyPass, &source, &destination);
+  SDL_EndGPUCopyPass(copyPass);
 
-    SDL_GPUBufferRegion destination;
-    destination.offset = 0;
+  aDraws->mVisibleCountFence = SDL_SubmitGPUCommandBufferAndAcquireFence(commandBuffer);
+}
 
-    // Positions
-    {
-      source.offset = processing.mPositionOffset;
-      destination.buffer = scene.mPositions;
-      destination.size = aSceneInfo.mPositionBytes;
+// Call once a frame, returns true when mLastVisibleCount has just been updated.
+bool UpdateIndirectDrawsVisibleCount(IndirectDraws* aDraws)
+{
+  if (!aDraws->mVisibleCountFence || !SDL_QueryGPUFence(gContext.mDevice, aDraws->mVisibleCountFence)) {
+    return false;
+  }
 
-      SDL_UploadToGPUBuffer(copyPass, &source, &destination, false);
-    }
+  SDL_ReleaseGPUFence(gContext.mDevice, aDraws->mVisibleCountFence);
+  aDraws->mVisibleCountFence = NULL;
 
-    // Normals
-    {
-      source.offset = processing.mNormalOffset;
+  const Uint32* visibleCount = (const Uint32*)SDL_MapGPUTransferBuffer(gContext.mDevice, aDraws->mVisibleCountReadback, false);
+  aDraws->mLastVisibleCount = *visibleCount;
+  SDL_UnmapGPUTransferBuffer(gContext.mDevice, aDraws->mVisibleCountReadback);
+  return true;
+}
 
-      destination.buffer = scene.mNormals;
-      destination.size = aSceneInfo.mNormalBytes;
+void DestroyIndirectDraws(IndirectDraws* aDraws)
+{
+  if (aDraws->mVisibleCountFence) {
+    SDL_WaitForGPUFences(gContext.mDevice, true, &aDraws->mVisibleCountFence, 1);
+    SDL_ReleaseGPUFence(gContext.mDevice, aDraws->mVisibleCountFence);
+  }
 
-      SDL_UploadToGPUBuffer(copyPass, &source, &destination, false);
-    }
+  SDL_ReleaseGPUComputePipeline(gContext.mDevice, aDraws->mCullPipeline);
+  SDL_ReleaseGPUComputePipeline(gContext.mDevice, aDraws->mFillPipeline);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mCommands);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mMaterialIndices);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mMaterials);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mBounds);
+  SDL_ReleaseGPUBuffer(gContext.mDevice, aDraws->mCulledCommands);
+  DestroyDynamicBuffer(&aDraws->mVisibleCount);
+  SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aDraws->mVisibleCountReadback);
+  SDL_zerop(aDraws);
+}
 
-    // Tangents
-    {
-      source.offset = processing.mTangentOffset;
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Technique Code
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Each frame in flight, as many as GpuConfig allows, gets its own slice of the UploadRing for its
+// dynamic data.
+static const Uint32 cUploadRingFrameSize = 2 * 1024 * 1024;
 
-      destination.buffer = scene.mTangents;
-      destination.size = aSceneInfo.mTangentBytes;
+static const Uint32 cGeometryHeapPageSize = 32 * 1024 * 1024;
 
-      SDL_UploadToGPUBuffer(copyPass, &source, &destination, false);
-    }
+static const SDL_GPUTextureFormat cOverdrawFormat = SDL_GPU_TEXTUREFORMAT_R8_UNORM;
 
-    // Indices
-    {
-      source.offset = processing.mIndexOffset;
+typedef struct ModelUbo {
+  float4 mPosition;
+  float4 mScale;
+  float4 mRotation;
+} ModelUbo;
 
-      destination.buffer = scene.mIndices;
-      destination.size = indexBytes;
+typedef struct ModelShaderJob {
+  ShaderCache* mCache;
+  ShaderDescription mDescription;
+  SDL_GPUShader* mShader;
+} ModelShaderJob;
+
+// Everything the startup jobs read and write, it has to outlive them so it's kept on the heap until
+// FinishModelPipelines.
+typedef struct ModelPipelineBuild {
+  PipelineCache* mPipelineCache;
+  ModelShaderJob mShaders[9];
+  SDL_GPUColorTargetDescription mColorTarget;
+  SDL_GPUVertexAttribute mAttributes[6];
+  SDL_GPUVertexBufferDescription mBufferDescriptions[6];
+  SDL_GPUGraphicsPipelineCreateInfo mCreateInfo;
+
+  // The main pass after a depth prepass, which only shades what matches the depth it laid down.
+  SDL_GPUGraphicsPipelineCreateInfo mDepthEqualCreateInfo;
+
+  // The depth prepass only reads positions, and keeps the color target without writing to it so
+  // it's compatible with the render pass the main pass is drawn in.
+  SDL_GPUColorTargetDescription mDepthOnlyColorTarget;
+  SDL_GPUVertexAttribute mDepthOnlyAttributes[2];
+  SDL_GPUVertexBufferDescription mDepthOnlyBufferDescriptions[2];
+  SDL_GPUGraphicsPipelineCreateInfo mDepthOnlyCreateInfo;
+
+  // Counts the fragments shaded for each pixel, for the OverdrawCounter. It measures with a depth
+  // prepass too, which needs the prepass and the DepthEqual pass on its own target format.
+  SDL_GPUColorTargetDescription mOverdrawColorTarget;
+  SDL_GPUGraphicsPipelineCreateInfo mOverdrawCreateInfo;
+  SDL_GPUColorTargetDescription mOverdrawDepthOnlyColorTarget;
+  SDL_GPUGraphicsPipelineCreateInfo mOverdrawDepthOnlyCreateInfo;
+  SDL_GPUGraphicsPipelineCreateInfo mOverdrawDepthEqualCreateInfo;
 
-      SDL_UploadToGPUBuffer(copyPass, &source, &destination, false);
-    }
+  SDL_GPUGraphicsPipeline* mPipeline;
+  SDL_GPUGraphicsPipeline* mGpuHierarchyPipeline;
+  SDL_GPUGraphicsPipeline* mIndirectPipeline;
+  SDL_GPUGraphicsPipeline* mDepthEqualPipeline;
+  SDL_GPUGraphicsPipeline* mDepthEqualGpuHierarchyPipeline;
+  SDL_GPUGraphicsPipeline* mDepthEqualIndirectPipeline;
+  SDL_GPUGraphicsPipeline* mDepthOnlyPipeline;
+  SDL_GPUGraphicsPipeline* mDepthOnlyTransformsPipeline;
+  SDL_GPUGraphicsPipeline* mOverdrawPipeline;
+  SDL_GPUGraphicsPipeline* mOverdrawDepthOnlyPipeline;
+  SDL_GPUGraphicsPipeline* mOverdrawDepthEqualPipeline;
+} ModelPipelineBuild;
 
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(commandBuffer);
+typedef struct ModelContext {
+  // All of the pipelines come out of mPipelineCache, they're built on the ThreadPool and nothing can
+  // be drawn until FinishModelPipelines has picked them up out of mPipelineBuild.
+  PipelineCache* mPipelineCache;
+  ModelPipelineBuild* mPipelineBuild;
+  SDL_GPUGraphicsPipeline* mPipeline;
 
-    SDL_ReleaseGPUTransferBuffer(gContext.mDevice, transferBuffer);
-  }
+  // Both samplers come out of mSamplerCache.
+  SamplerCache* mSamplerCache;
+  SDL_GPUSampler* mSampler;
+  SDL_GPUSampler* mBaseLevelSampler;
+  bool mUseMipmaps;
+  ModelUbo mUbo[2];
 
-  RecalculateSceneTransform(&scene);
+  // Loaded on the UploadWorker, nothing below is usable until mModelReady. The heap belongs to the
+  // worker while a load is in flight.
+  Scene mModel;
+  BufferHeap mGeometryHeap;
+  bool mModelReady;
+
+  // Optional mode where world transforms are only ever computed and read on the GPU. The storage
+  // transforms below draw through the same pipeline.
+  SDL_GPUGraphicsPipeline* mGpuHierarchyPipeline;
+  GpuHierarchy mGpuHierarchy;
+  bool mUseGpuHierarchy;
+
+  // Optional mode for the CPU path, instead of a push per draw the frame's world transforms are
+  // written once into mStorageTransforms and the model matrix is applied in the vertex shader.
+  DynamicBuffer mStorageTransforms;
+  bool mUseStorageTransforms;
+
+  // Optional mode where the whole draw list is a single indirect draw. It reads its transforms from
+  // the GPU hierarchy when that's on, otherwise from mStorageTransforms, and is culled on the GPU.
+  SDL_GPUGraphicsPipeline* mIndirectPipeline;
+  IndirectDraws mIndirectDraws;
+  bool mUseIndirectDraws;
+
+  // Occlusion culling against last frame's depth, on top of the GPU frustum culling.
+  bool mUseOcclusionCulling;
+
+  // Optional depth only pass before the main pass, so the main pass only shades the nearest
+  // fragment of each pixel. Each of the main pipelines has a DepthEqual version for after it.
+  SDL_GPUGraphicsPipeline* mDepthEqualPipeline;
+  SDL_GPUGraphicsPipeline* mDepthEqualGpuHierarchyPipeline;
+  SDL_GPUGraphicsPipeline* mDepthEqualIndirectPipeline;
+  SDL_GPUGraphicsPipeline* mDepthOnlyPipeline;
+  SDL_GPUGraphicsPipeline* mDepthOnlyTransformsPipeline;
+  bool mUseDepthPrepass;
+
+  // Draw into the OverdrawCounter's own targets, never into the main pass.
+  SDL_GPUGraphicsPipeline* mOverdrawPipeline;
+  SDL_GPUGraphicsPipeline* mOverdrawDepthOnlyPipeline;
+  SDL_GPUGraphicsPipeline* mOverdrawDepthEqualPipeline;
+
+  // Frustum culling of the DrawPackets, on the CPU unless the indirect draws are on.
+  bool mUseCulling;
+} ModelContext;
 
-  return scene;
+void LoadModelShaderJob(void* aUserData)
+{
+  ModelShaderJob* job = (ModelShaderJob*)aUserData;
+  job->mShader = GetCachedShader(job->mCache, &job->mDescription);
+  SDL_assert(job->mShader);
 }
 
-Scene LoadGltfModel(const char* aModelName) {
-  char model_path[4096];
-  SDL_snprintf(model_path, SDL_arraysize(model_path), "Assets/Models/%s", aModelName);
+SDL_GPUGraphicsPipeline* AcquireModelPipeline(ModelPipelineBuild* aBuild, const SDL_GPUGraphicsPipelineCreateInfo* aCreateInfo, SDL_GPUShader* aVertexShader, SDL_GPUShader* aFragmentShader, Uint32 aVertexInputsCount, const char* aName)
+{
+  SDL_GPUGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = *aCreateInfo;
+  graphicsPipelineCreateInfo.vertex_shader = aVertexShader;
+  graphicsPipelineCreateInfo.fragment_shader = aFragmentShader;
+  graphicsPipelineCreateInfo.vertex_input_state.num_vertex_attributes = aVertexInputsCount;
+  graphicsPipelineCreateInfo.vertex_input_state.num_vertex_buffers = aVertexInputsCount;
 
-  cgltf_options options;
-  SDL_zero(options);
+  // Properties of its own, the other pipeline is being created on another thread at the same time.
+  SDL_PropertiesID properties = SDL_CreateProperties();
+  SDL_assert(SDL_SetStringProperty(properties, SDL_PROP_GPU_GRAPHICSPIPELINE_CREATE_NAME_STRING, aName));
+  graphicsPipelineCreateInfo.props = properties;
 
-  cgltf_data* data = NULL;
-  cgltf_result result = cgltf_parse_file(&options, model_path, &data);
-  SDL_assert(result == cgltf_result_success);
+  SDL_GPUGraphicsPipeline* pipeline = AcquireCachedPipeline(aBuild->mPipelineCache, &graphicsPipelineCreateInfo);
+  SDL_DestroyProperties(properties);
+  return pipeline;
+}
 
-  result = cgltf_load_buffers(&options, data, model_path);
-  SDL_assert(result == cgltf_result_success);
+void CreateModelPipelineJob(void* aUserData)
+{
+  ModelPipelineBuild* build = (ModelPipelineBuild*)aUserData;
+  build->mPipeline = AcquireModelPipeline(build, &build->mCreateInfo, build->mShaders[0].mShader, build->mShaders[1].mShader, 4, "ModelContext");
+  build->mDepthEqualPipeline = AcquireModelPipeline(build, &build->mDepthEqualCreateInfo, build->mShaders[0].mShader, build->mShaders[1].mShader, 4, "ModelContext DepthEqual");
+}
 
-  SDL_Log("Model: %s", model_path);
+// Same pipeline, but the vertex shader pulls its ObjectToWorld out of the GPU hierarchy.
+void CreateModelGpuHierarchyPipelineJob(void* aUserData)
+{
+  ModelPipelineBuild* build = (ModelPipelineBuild*)aUserData;
+  build->mGpuHierarchyPipeline = AcquireModelPipeline(build, &build->mCreateInfo, build->mShaders[2].mShader, build->mShaders[1].mShader, 5, "ModelContext GpuHierarchy");
+  build->mDepthEqualGpuHierarchyPipeline = AcquireModelPipeline(build, &build->mDepthEqualCreateInfo, build->mShaders[2].mShader, build->mShaders[1].mShader, 5, "ModelContext DepthEqual GpuHierarchy");
+}
 
-  SceneInfo sceneInfo = GetSceneInfo(data);
-  return GenerateGPUScene(data, sceneInfo);
+// Like the GPU hierarchy pipeline, plus a material index per instance for the fragment shader.
+void CreateModelIndirectPipelineJob(void* aUserData)
+{
+  ModelPipelineBuild* build = (ModelPipelineBuild*)aUserData;
+  build->mIndirectPipeline = AcquireModelPipeline(build, &build->mCreateInfo, build->mShaders[3].mShader, build->mShaders[4].mShader, 6, "ModelContext Indirect");
+  build->mDepthEqualIndirectPipeline = AcquireModelPipeline(build, &build->mDepthEqualCreateInfo, build->mShaders[3].mShader, build->mShaders[4].mShader, 6, "ModelContext DepthEqual Indirect");
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Technique Code
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-typedef struct ModelUbo {
-  float4 mPosition;
-  float4 mScale;
-  float4 mRotation;
-} ModelUbo;
+// The depth prepass pipelines, with and without a transform index stream, and the overdraw
+// counting ones, which only differ from the first in their fragment shader and target.
+void CreateModelDepthOnlyPipelinesJob(void* aUserData)
+{
+  ModelPipelineBuild* build = (ModelPipelineBuild*)aUserData;
+  build->mDepthOnlyPipeline = AcquireModelPipeline(build, &build->mDepthOnlyCreateInfo, build->mShaders[5].mShader, build->mShaders[7].mShader, 1, "ModelContext DepthOnly");
+  build->mDepthOnlyTransformsPipeline = AcquireModelPipeline(build, &build->mDepthOnlyCreateInfo, build->mShaders[6].mShader, build->mShaders[7].mShader, 2, "ModelContext DepthOnly Transforms");
+  build->mOverdrawPipeline = AcquireModelPipeline(build, &build->mOverdrawCreateInfo, build->mShaders[5].mShader, build->mShaders[8].mShader, 1, "ModelContext Overdraw");
+  build->mOverdrawDepthOnlyPipeline = AcquireModelPipeline(build, &build->mOverdrawDepthOnlyCreateInfo, build->mShaders[5].mShader, build->mShaders[7].mShader, 1, "ModelContext Overdraw DepthOnly");
+  build->mOverdrawDepthEqualPipeline = AcquireModelPipeline(build, &build->mOverdrawDepthEqualCreateInfo, build->mShaders[5].mShader, build->mShaders[8].mShader, 1, "ModelContext Overdraw DepthEqual");
+}
 
-typedef struct ModelContext {
-  SDL_GPUGraphicsPipeline* mPipeline;
-  SDL_GPUTexture* mTexture;
-  SDL_GPUSampler* mSampler;
-  ModelUbo mUbo[2];
-  Scene mModel;
-} ModelContext;
+// Only queues up the shader and pipeline creation on aThreadPool, FinishModelPipelines has to be
+// called once it's been waited on.
+ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat, ShaderCache* aShaderCache, SamplerCache* aSamplerCache, PipelineCache* aPipelineCache, ThreadPool* aThreadPool) {
+  ModelPipelineBuild* build = (ModelPipelineBuild*)SDL_calloc(1, sizeof(ModelPipelineBuild));
+  build->mPipelineCache = aPipelineCache;
 
-ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
-  SDL_GPUColorTargetDescription colorTargetDescription;
-  SDL_zero(colorTargetDescription);
-  colorTargetDescription.format = SDL_GetGPUSwapchainTextureFormat(gContext.mDevice, gContext.mWindow);
+  SDL_GPUColorTargetDescription* colorTargetDescription = &build->mColorTarget;
+  colorTargetDescription->format = SDL_GetGPUSwapchainTextureFormat(gContext.mDevice, gContext.mWindow);
 
   SDL_GPUGraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
   SDL_zero(graphicsPipelineCreateInfo);
 
   graphicsPipelineCreateInfo.target_info.num_color_targets = 1;
-  graphicsPipelineCreateInfo.target_info.color_target_descriptions = &colorTargetDescription;
+  graphicsPipelineCreateInfo.target_info.color_target_descriptions = colorTargetDescription;
   graphicsPipelineCreateInfo.target_info.depth_stencil_format = aDepthFormat;
   graphicsPipelineCreateInfo.target_info.has_depth_stencil_target = true;
   graphicsPipelineCreateInfo.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
@@ -1259,7 +1849,7 @@ ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
   graphicsPipelineCreateInfo.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_NONE;
 
 
-  SDL_GPUVertexAttribute attributes[3];
+  SDL_GPUVertexAttribute* attributes = build->mAttributes;
 
   // Position
   attributes[0].location = 0;
@@ -1279,10 +1869,27 @@ ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
   attributes[2].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4;
   attributes[2].offset = 0;
 
+  // Texcoord
+  attributes[3].location = 3;
+  attributes[3].buffer_slot = 3;
+  attributes[3].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2;
+  attributes[3].offset = 0;
+
+  // Transform Index, only used by the GPU hierarchy and indirect pipelines.
+  attributes[4].location = 4;
+  attributes[4].buffer_slot = 4;
+  attributes[4].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+  attributes[4].offset = 0;
+
+  // Material Index, only used by the indirect pipeline.
+  attributes[5].location = 5;
+  attributes[5].buffer_slot = 5;
+  attributes[5].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+  attributes[5].offset = 0;
+
   graphicsPipelineCreateInfo.vertex_input_state.vertex_attributes = attributes;
-  graphicsPipelineCreateInfo.vertex_input_state.num_vertex_attributes = SDL_arraysize(attributes);
 
-  SDL_GPUVertexBufferDescription bufferDescription[3];
+  SDL_GPUVertexBufferDescription* bufferDescription = build->mBufferDescriptions;
   bufferDescription[0].slot = 0;
   bufferDescription[0].pitch = sizeof(float3);
   bufferDescription[0].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
@@ -1295,9 +1902,20 @@ ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
   bufferDescription[2].pitch = sizeof(float4);
   bufferDescription[2].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
   bufferDescription[2].instance_step_rate = 0;
+  bufferDescription[3].slot = 3;
+  bufferDescription[3].pitch = sizeof(float2);
+  bufferDescription[3].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+  bufferDescription[3].instance_step_rate = 0;
+  bufferDescription[4].slot = 4;
+  bufferDescription[4].pitch = sizeof(Uint32);
+  bufferDescription[4].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+  bufferDescription[4].instance_step_rate = 0;
+  bufferDescription[5].slot = 5;
+  bufferDescription[5].pitch = sizeof(Uint32);
+  bufferDescription[5].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+  bufferDescription[5].instance_step_rate = 0;
 
   graphicsPipelineCreateInfo.vertex_input_state.vertex_buffer_descriptions = bufferDescription;
-  graphicsPipelineCreateInfo.vertex_input_state.num_vertex_buffers = SDL_arraysize(bufferDescription);
 
   // Remember to come back to this later in the tutorial, don't show it off immediately.
   graphicsPipelineCreateInfo.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_GREATER_OR_EQUAL;
@@ -1305,42 +1923,118 @@ ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
   graphicsPipelineCreateInfo.depth_stencil_state.enable_depth_test = true;
   graphicsPipelineCreateInfo.depth_stencil_state.enable_depth_write = true;
 
-  graphicsPipelineCreateInfo.vertex_shader = CreateShader(
-    "VertexAndIndexBuffer.vert",
-    SDL_GPU_SHADERSTAGE_VERTEX,
-    0,
-    2,
-    0,
-    0,
-    SDL_PROPERTY_TYPE_INVALID
-  );
-  SDL_assert(graphicsPipelineCreateInfo.vertex_shader);
-
-  graphicsPipelineCreateInfo.fragment_shader = CreateShader(
-    "VertexAndIndexBuffer.frag",
-    SDL_GPU_SHADERSTAGE_FRAGMENT,
-    1,
-    0,
-    0,
-    0,
-    SDL_PROPERTY_TYPE_INVALID
-  );
-  SDL_assert(graphicsPipelineCreateInfo.fragment_shader);
+  // Shaders and the vertex input counts are filled in by the jobs.
+  build->mCreateInfo = graphicsPipelineCreateInfo;
+
+  build->mDepthEqualCreateInfo = graphicsPipelineCreateInfo;
+  build->mDepthEqualCreateInfo.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_EQUAL;
+  build->mDepthEqualCreateInfo.depth_stencil_state.enable_depth_write = false;
+
+  // Position
+  build->mDepthOnlyAttributes[0] = attributes[0];
+
+  // Transform Index, on the same slot as the main pipelines so the binding carries over.
+  build->mDepthOnlyAttributes[1] = attributes[4];
+  build->mDepthOnlyAttributes[1].location = 1;
+
+  build->mDepthOnlyBufferDescriptions[0] = bufferDescription[0];
+  build->mDepthOnlyBufferDescriptions[1] = bufferDescription[4];
+
+  build->mDepthOnlyColorTarget = *colorTargetDescription;
+  build->mDepthOnlyColorTarget.blend_state.enable_color_write_mask = true;
+  build->mDepthOnlyColorTarget.blend_state.color_write_mask = 0;
+
+  build->mDepthOnlyCreateInfo = graphicsPipelineCreateInfo;
+  build->mDepthOnlyCreateInfo.target_info.color_target_descriptions = &build->mDepthOnlyColorTarget;
+  build->mDepthOnlyCreateInfo.vertex_input_state.vertex_attributes = build->mDepthOnlyAttributes;
+  build->mDepthOnlyCreateInfo.vertex_input_state.vertex_buffer_descriptions = build->mDepthOnlyBufferDescriptions;
+
+  // Each fragment adds one step of an R8_UNORM, so a pixel counts up to 255 fragments.
+  build->mOverdrawColorTarget.format = cOverdrawFormat;
+  build->mOverdrawColorTarget.blend_state.enable_blend = true;
+  build->mOverdrawColorTarget.blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+  build->mOverdrawColorTarget.blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+  build->mOverdrawColorTarget.blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
+  build->mOverdrawColorTarget.blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+  build->mOverdrawColorTarget.blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+  build->mOverdrawColorTarget.blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
+
+  build->mOverdrawCreateInfo = build->mDepthOnlyCreateInfo;
+  build->mOverdrawCreateInfo.target_info.color_target_descriptions = &build->mOverdrawColorTarget;
+
+  build->mOverdrawDepthOnlyColorTarget = build->mDepthOnlyColorTarget;
+  build->mOverdrawDepthOnlyColorTarget.format = cOverdrawFormat;
+
+  build->mOverdrawDepthOnlyCreateInfo = build->mDepthOnlyCreateInfo;
+  build->mOverdrawDepthOnlyCreateInfo.target_info.color_target_descriptions = &build->mOverdrawDepthOnlyColorTarget;
+
+  build->mOverdrawDepthEqualCreateInfo = build->mOverdrawCreateInfo;
+  build->mOverdrawDepthEqualCreateInfo.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_EQUAL;
+  build->mOverdrawDepthEqualCreateInfo.depth_stencil_state.enable_depth_write = false;
+
+  // Name, stage, then sampler, uniform buffer, storage buffer and storage texture counts.
+  const ShaderDescription shaders[] = {
+    { "VertexAndIndexBuffer.vert", SDL_GPU_SHADERSTAGE_VERTEX, 0, 2, 0, 0 },
+    { "VertexAndIndexBuffer.frag", SDL_GPU_SHADERSTAGE_FRAGMENT, 1, 1, 0, 0 },
+    { "GpuHierarchy.vert", SDL_GPU_SHADERSTAGE_VERTEX, 0, 1, 1, 0 },
+    { "IndirectDraw.vert", SDL_GPU_SHADERSTAGE_VERTEX, 0, 1, 1, 0 },
+    { "IndirectDraw.frag", SDL_GPU_SHADERSTAGE_FRAGMENT, 1, 0, 1, 0 },
+    { "DepthOnly.vert", SDL_GPU_SHADERSTAGE_VERTEX, 0, 2, 0, 0 },
+    { "DepthOnlyTransforms.vert", SDL_GPU_SHADERSTAGE_VERTEX, 0, 1, 1, 0 },
+    { "DepthOnly.frag", SDL_GPU_SHADERSTAGE_FRAGMENT, 0, 0, 0, 0 },
+    { "CountOverdraw.frag", SDL_GPU_SHADERSTAGE_FRAGMENT, 0, 0, 0, 0 },
+  };
 
-  SDL_assert(SDL_SetStringProperty(gContext.mProperties, SDL_PROP_GPU_GRAPHICSPIPELINE_CREATE_NAME_STRING, "ModelContext"));
+  Uint32 shaderJobs[SDL_arraysize(shaders)];
+  for (Uint32 i = 0; i < SDL_arraysize(shaders); ++i) {
+    build->mShaders[i].mCache = aShaderCache;
+    build->mShaders[i].mDescription = shaders[i];
+    shaderJobs[i] = AddThreadPoolJob(aThreadPool, LoadModelShaderJob, &build->mShaders[i], NULL, 0);
+  }
+
+  // Each pipeline only waits on the shaders it uses.
+  Uint32 pipelineDependencies[2] = { shaderJobs[0], shaderJobs[1] };
+  AddThreadPoolJob(aThreadPool, CreateModelPipelineJob, build, pipelineDependencies, 2);
+
+  Uint32 gpuHierarchyPipelineDependencies[2] = { shaderJobs[2], shaderJobs[1] };
+  AddThreadPoolJob(aThreadPool, CreateModelGpuHierarchyPipelineJob, build, gpuHierarchyPipelineDependencies, 2);
+
+  Uint32 indirectPipelineDependencies[2] = { shaderJobs[3], shaderJobs[4] };
+  AddThreadPoolJob(aThreadPool, CreateModelIndirectPipelineJob, build, indirectPipelineDependencies, 2);
+
+  Uint32 depthOnlyPipelinesDependencies[4] = { shaderJobs[5], shaderJobs[6], shaderJobs[7], shaderJobs[8] };
+  AddThreadPoolJob(aThreadPool, CreateModelDepthOnlyPipelinesJob, build, depthOnlyPipelinesDependencies, 4);
 
   ModelContext context;
+  SDL_zero(context);
 
-  // Broke the name so that we don't waste time zipping it while the example isn't done.
-  context.mModel = LoadGltfModel("buster_drone.glb");
+  // Any other models loaded alongside this one would share its buffers.
+  context.mGeometryHeap = CreateBufferHeap(cGeometryHeapPageSize, SDL_GPU_BUFFERUSAGE_VERTEX | SDL_GPU_BUFFERUSAGE_INDEX, "GeometryHeap");
 
-  context.mPipeline = SDL_CreateGPUGraphicsPipeline(gContext.mDevice, &graphicsPipelineCreateInfo);
-  context.mTexture = CreateAndUploadTexture(NULL, "sample.bmp");
+  context.mPipelineCache = aPipelineCache;
+  context.mPipelineBuild = build;
+
+  context.mUseGpuHierarchy = false;
+  context.mUseStorageTransforms = false;
+  context.mUseIndirectDraws = false;
+  context.mUseOcclusionCulling = false;
+  context.mUseDepthPrepass = false;
+  context.mUseCulling = true;
 
   SDL_GPUSamplerCreateInfo samplerCreateInfo;
   SDL_zero(samplerCreateInfo);
-  context.mSampler = SDL_CreateGPUSampler(gContext.mDevice, &samplerCreateInfo);
-  SDL_assert(context.mPipeline);
+  samplerCreateInfo.min_filter = SDL_GPU_FILTER_LINEAR;
+  samplerCreateInfo.mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR;
+  samplerCreateInfo.max_lod = cMaxLod;
+  context.mSamplerCache = aSamplerCache;
+  context.mSampler = AcquireCachedSampler(aSamplerCache, &samplerCreateInfo);
+  SDL_assert(context.mSampler);
+
+  // Same filtering but stuck on the top level, to compare against when the model is minified.
+  samplerCreateInfo.max_lod = 0.f;
+  context.mBaseLevelSampler = AcquireCachedSampler(aSamplerCache, &samplerCreateInfo);
+  SDL_assert(context.mBaseLevelSampler);
+  context.mUseMipmaps = true;
 
   context.mUbo[0].mPosition.x = 0.f;
   context.mUbo[0].mPosition.y = -1.f;
@@ -1368,100 +2062,702 @@ ModelContext CreateModelContext(SDL_GPUTextureFormat aDepthFormat) {
   context.mUbo[1].mRotation.z = 0.f;
   context.mUbo[1].mRotation.w = 0.f;
 
-  SDL_ReleaseGPUShader(gContext.mDevice, graphicsPipelineCreateInfo.vertex_shader);
-  SDL_ReleaseGPUShader(gContext.mDevice, graphicsPipelineCreateInfo.fragment_shader);
-
   return context;
 }
 
-void DrawModelContext(ModelContext* aContext, SDL_GPUCommandBuffer* aCommandBuffer, SDL_GPURenderPass* aRenderPass)
+typedef struct ModelLoad {
+  ModelContext* mContext;
+  const char* mModelName;
+  Uint64 mQueuedTicks;
+
+  Scene mModel;
+  GpuHierarchy mGpuHierarchy;
+  IndirectDraws mIndirectDraws;
+} ModelLoad;
+
+// Runs on the UploadWorker, everything the model needs on the GPU goes out in aBatch in one submit.
+void RunModelLoad(UploadBatch* aBatch, void* aUserData)
+{
+  ModelLoad* load = (ModelLoad*)aUserData;
+
+  load->mModel = LoadGltfModel(aBatch, &load->mContext->mGeometryHeap, load->mModelName, true);
+  load->mGpuHierarchy = CreateGpuHierarchy(aBatch, &load->mModel);
+  load->mIndirectDraws = CreateIndirectDraws(aBatch, &load->mModel);
+}
+
+// Runs on the render thread once the uploads have landed.
+void PublishModelLoad(void* aUserData)
+{
+  ModelLoad* load = (ModelLoad*)aUserData;
+  ModelContext* context = load->mContext;
+
+  context->mModel = load->mModel;
+  AcquireSceneSamplers(&context->mModel, context->mSamplerCache);
+  context->mGpuHierarchy = load->mGpuHierarchy;
+  context->mIndirectDraws = load->mIndirectDraws;
+  // Read by the vertex shader, and by the culling of the indirect draws.
+  context->mStorageTransforms = CreateDynamicBuffer(
+    (Uint32)(context->mModel.mMeshesCount * sizeof(float4x4)),
+    SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+    "ModelContext StorageTransforms"
+  );
+  context->mModelReady = true;
+
+  double milliseconds = (double)(SDL_GetTicksNS() - load->mQueuedTicks) / 1000000.0;
+  SDL_Log("ModelContext: %s ready %.2f ms after it was queued", load->mModelName, milliseconds);
+
+  BufferHeapStats stats = GetBufferHeapStats(&context->mGeometryHeap);
+  SDL_Log("GeometryHeap: %u allocations, %" SDL_PRIu64 " of %" SDL_PRIu64 " bytes in blocks for %" SDL_PRIu64 " requested, %u pages, largest free block %u",
+    stats.mAllocationsCount, stats.mAllocatedBytes, stats.mReservedBytes, stats.mRequestedBytes, stats.mPagesCount, stats.mLargestFreeBlock);
+
+  SDL_free(load);
+}
+
+// The frame loop keeps going while the model loads, drawing nothing for it until it's published.
+void LoadModelContextAsync(ModelContext* aContext, UploadWorker* aWorker, const char* aModelName)
+{
+  ModelLoad* load = (ModelLoad*)SDL_calloc(1, sizeof(ModelLoad));
+  load->mContext = aContext;
+  load->mModelName = aModelName;
+  load->mQueuedTicks = SDL_GetTicksNS();
+
+  QueueUploadJob(aWorker, RunModelLoad, PublishModelLoad, load);
+}
+
+// The indirect draws need their transforms in a storage buffer too.
+bool ModelContextUsesStorageTransforms(const ModelContext* aContext)
+{
+  return !aContext->mUseGpuHierarchy && (aContext->mUseStorageTransforms || aContext->mUseIndirectDraws);
+}
+
+// Only the indirect draws are culled on the GPU, where the depth pyramid can be read.
+bool ModelContextUsesOcclusionCulling(const ModelContext* aContext)
+{
+  return aContext->mUseIndirectDraws && aContext->mUseCulling && aContext->mUseOcclusionCulling;
+}
+
+// Packs the model's geometry into as few GeometryHeap pages as it fits in. The moves are recorded
+// into aCommandBuffer and the rebuilt indirect commands are queued into aRing, so this has to come
+// before the ring's copies are recorded and before anything draws the model. Returns false if it
+// wouldn't have freed up a page, in which case nothing was moved.
+bool DefragmentModelContextGeometry(ModelContext* aContext, SDL_GPUCommandBuffer* aCommandBuffer, UploadRing* aRing)
 {
-  SDL_BindGPUGraphicsPipeline(aRenderPass, aContext->mPipeline);
+  if (!aContext->mModelReady) {
+    return false;
+  }
+
+  Scene* scene = &aContext->mModel;
+  BufferHeapAllocation* allocations[5] = {
+    &scene->mPositions,
+    &scene->mNormals,
+    &scene->mTangents,
+    &scene->mTexcoords,
+    &scene->mIndices,
+  };
+
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(aCommandBuffer);
+  bool moved = DefragmentBufferHeap(&aContext->mGeometryHeap, copyPass, allocations, SDL_arraysize(allocations));
+  SDL_EndGPUCopyPass(copyPass);
+
+  if (!moved) {
+    return false;
+  }
+
+  // Both hold offsets into the old pages.
+  BuildDrawPackets(scene);
+  UploadIndirectDraws(&aContext->mIndirectDraws, &aRing->mBatch, scene);
+  return true;
+}
+
+// Call after changing the local transforms of the Scene's Meshes. With the GPU hierarchy they're
+// only uploaded, otherwise the world transforms are rebuilt on the CPU.
+void ModelContextLocalTransformsChanged(ModelContext* aContext)
+{
+  if (aContext->mUseGpuHierarchy) {
+    MarkGpuHierarchyLocalTransformsDirty(&aContext->mGpuHierarchy);
+  }
+  else {
+    RecalculateSceneTransform(&aContext->mModel);
+  }
+}
+
+// Spins every root Mesh about its own Y axis, which moves everything below it along with it.
+void AnimateModelContext(ModelContext* aContext, float aDeltaTime)
+{
+  if (!aContext->mModelReady) {
+    return;
+  }
+
+  Scene* scene = &aContext->mModel;
+  float4x4 spin = RotationMatrixY(aDeltaTime);
+  for (size_t i = 0; i < scene->mRootMeshesCount; ++i) {
+    scene->mMeshes[i].mTransform = Float4x4_Multiply(&scene->mMeshes[i].mTransform, &spin);
+  }
+
+  ModelContextLocalTransformsChanged(aContext);
+}
+
+// Writes this frame's dynamic data into aRing, before the ring's copies are recorded.
+void UpdateModelContext(ModelContext* aContext, UploadRing* aRing)
+{
+  if (!aContext->mModelReady) {
+    return;
+  }
+
+  if (aContext->mUseGpuHierarchy) {
+    UpdateGpuHierarchyLocalTransforms(&aContext->mGpuHierarchy, aRing, &aContext->mModel);
+  }
+  else if (ModelContextUsesStorageTransforms(aContext)) {
+    // The whole buffer is rewritten, so it cycles and last frame's draws keep their copy.
+    void* worldTransforms = UpdateDynamicBuffer(aRing, &aContext->mStorageTransforms, 0, aContext->mStorageTransforms.mSize);
+    SDL_memcpy(worldTransforms, aContext->mModel.mWorldTransforms, aContext->mStorageTransforms.mSize);
+  }
+
+  if (aContext->mUseIndirectDraws && aContext->mUseCulling) {
+    ResetIndirectDrawsVisibleCount(&aContext->mIndirectDraws, aRing);
+  }
+}
+
+// Work that has to happen outside of the render pass, such as the GPU hierarchy propagation and the
+// culling of the indirect draws against the frustum and aDepthPyramid.
+void PrepareModelContext(ModelContext* aContext, SDL_GPUCommandBuffer* aCommandBuffer, const DepthPyramid* aDepthPyramid)
+{
+  if (!aContext->mModelReady) {
+    return;
+  }
 
   float4x4 model = CreateModelMatrix(aContext->mUbo[0].mPosition, aContext->mUbo[0].mScale, aContext->mUbo[0].mRotation);
-  SDL_PushGPUVertexUniformData(aCommandBuffer, 1, &gContext.WorldToNDC, sizeof(gContext.WorldToNDC));
 
-  for (size_t i = 0; i < aContext->mModel.mMeshesCount; ++i) {
-    Mesh* mesh = aContext->mModel.mMeshes + i;
+  if (aContext->mUseGpuHierarchy) {
+    PropagateGpuHierarchy(&aContext->mGpuHierarchy, &aContext->mModel, aCommandBuffer, &model);
+  }
 
-    // I should preprocess this list and iterate that instead so I don't have to do this.
-    if (mesh->mIndicesCount == 0) {
-      continue;
+  if (aContext->mUseIndirectDraws && aContext->mUseCulling) {
+    // The GPU hierarchy already has the model matrix in its transforms.
+    float4x4 identity = IdentityMatrix();
+    bool useGpuHierarchy = aContext->mUseGpuHierarchy;
+
+    CullIndirectDraws(
+      &aContext->mIndirectDraws,
+      aCommandBuffer,
+      aContext->mGpuHierarchy.mTransformIndices,
+      useGpuHierarchy ? aContext->mGpuHierarchy.mWorldTransforms : aContext->mStorageTransforms.mBuffer,
+      useGpuHierarchy ? &identity : &model,
+      &gContext.WorldToNDC,
+      aDepthPyramid,
+      ModelContextUsesOcclusionCulling(aContext));
+  }
+}
+
+// Returns how many DrawPackets were drawn. With aDepthOnly only the positions are bound and only
+// depth is written, for the depth prepass. When mUseDepthPrepass is on, the main pass has to come
+// after it in the same frame, it reuses the prepass's culling and only shades what matches its depth.
+size_t DrawModelContext(ModelContext* aContext, SDL_GPUCommandBuffer* aCommandBuffer, SDL_GPURenderPass* aRenderPass, bool aDepthOnly)
+{
+  if (!aContext->mModelReady) {
+    return 0;
+  }
+
+  Scene* scene = &aContext->mModel;
+
+  // Both the GPU hierarchy and the storage transforms read a storage buffer of transforms through
+  // the same pipeline, and never push anything per draw.
+  bool useGpuHierarchy = aContext->mUseGpuHierarchy;
+  bool useStorageTransforms = ModelContextUsesStorageTransforms(aContext);
+  bool useTransformIndices = useGpuHierarchy || useStorageTransforms;
+  bool useIndirectDraws = aContext->mUseIndirectDraws;
+  bool afterDepthPrepass = !aDepthOnly && aContext->mUseDepthPrepass;
+
+  SDL_GPUGraphicsPipeline* pipeline = NULL;
+  if (aDepthOnly) {
+    pipeline = useTransformIndices ? aContext->mDepthOnlyTransformsPipeline : aContext->mDepthOnlyPipeline;
+  }
+  else if (useIndirectDraws) {
+    pipeline = afterDepthPrepass ? aContext->mDepthEqualIndirectPipeline : aContext->mIndirectPipeline;
+  }
+  else if (useTransformIndices) {
+    pipeline = afterDepthPrepass ? aContext->mDepthEqualGpuHierarchyPipeline : aContext->mGpuHierarchyPipeline;
+  }
+  else {
+    pipeline = afterDepthPrepass ? aContext->mDepthEqualPipeline : aContext->mPipeline;
+  }
+
+  SDL_BindGPUGraphicsPipeline(aRenderPass, pipeline);
+
+  // Without culling every packet is drawn, in order.
+  const Uint32* visiblePackets = NULL;
+  size_t drawCount = scene->mDrawPacketsCount;
+
+  if (useTransformIndices) {
+    SDL_GPUBufferBinding binding;
+    binding.buffer = aContext->mGpuHierarchy.mTransformIndices;
+    binding.offset = 0;
+    SDL_BindGPUVertexBuffers(aRenderPass, 4, &binding, 1);
+  }
+
+  if (useGpuHierarchy) {
+    SDL_PushGPUVertexUniformData(aCommandBuffer, 0, &gContext.WorldToNDC, sizeof(gContext.WorldToNDC));
+    SDL_BindGPUVertexStorageBuffers(aRenderPass, 0, &aContext->mGpuHierarchy.mWorldTransforms, 1);
+  }
+  else if (useStorageTransforms) {
+    // mWorldTransforms don't have the model matrix in them, so it goes into the one matrix the
+    // shader takes and every vertex picks it up on the GPU.
+    float4x4 model = CreateModelMatrix(aContext->mUbo[0].mPosition, aContext->mUbo[0].mScale, aContext->mUbo[0].mRotation);
+    float4x4 modelToNDC = Float4x4_Multiply(&gContext.WorldToNDC, &model);
+    SDL_PushGPUVertexUniformData(aCommandBuffer, 0, &modelToNDC, sizeof(modelToNDC));
+    SDL_BindGPUVertexStorageBuffers(aRenderPass, 0, &aContext->mStorageTransforms.mBuffer, 1);
+
+    // The indirect draws are culled on the GPU, in PrepareModelContext. After the depth prepass the
+    // packets it kept are still in mVisiblePackets.
+    if (aContext->mUseCulling && !useIndirectDraws) {
+      if (!afterDepthPrepass) {
+        CullDrawPackets(scene, scene->mWorldTransforms, &modelToNDC);
+      }
+
+      visiblePackets = scene->mVisiblePackets;
+      drawCount = scene->mVisiblePacketsCount;
+    }
+  }
+  else {
+    if (!afterDepthPrepass) {
+      float4x4 model = CreateModelMatrix(aContext->mUbo[0].mPosition, aContext->mUbo[0].mScale, aContext->mUbo[0].mRotation);
+      Float4x4_Multiply_Batch(&model, scene->mWorldTransforms, scene->mModelTransforms, scene->mMeshesCount);
     }
 
-    {
-      SDL_GPUBufferBinding binding[3];
-      binding[0].buffer = aContext->mModel.mPositions;
-      binding[0].offset = mesh->mPositionOffset;
-      binding[1].buffer = aContext->mModel.mNormals;
-      binding[1].offset = mesh->mNormalOffset;
-      binding[2].buffer = aContext->mModel.mTangents;
-      binding[2].offset = mesh->mTangentOffset;
-      SDL_BindGPUVertexBuffers(aRenderPass, 0, binding, SDL_arraysize(binding));
-    
+    SDL_PushGPUVertexUniformData(aCommandBuffer, 1, &gContext.WorldToNDC, sizeof(gContext.WorldToNDC));
+
+    if (aContext->mUseCulling) {
+      if (!afterDepthPrepass) {
+        CullDrawPackets(scene, scene->mModelTransforms, &gContext.WorldToNDC);
+      }
+
+      visiblePackets = scene->mVisiblePackets;
+      drawCount = scene->mVisiblePacketsCount;
     }
-    
-    {
-      SDL_GPUBufferBinding binding;
-      binding.buffer = aContext->mModel.mIndices;
-      binding.offset = mesh->mIndexOffset;
-      SDL_BindGPUIndexBuffer(aRenderPass, &binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+  }
+
+  // None of these change between packets, so they're bound once up front.
+  {
+    SDL_GPUBufferBinding binding;
+    binding.buffer = scene->mIndices.mBuffer;
+    binding.offset = 0;
+    SDL_BindGPUIndexBuffer(aRenderPass, &binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+  }
+
+  // The indirect draws are a single call, so they all sample with the ModelContext's sampler. The
+  // loop below switches to each material's own glTF sampler.
+  SDL_GPUTextureSamplerBinding textureBinding;
+  SDL_zero(textureBinding);
+  textureBinding.texture = scene->mMaterialTexture;
+  textureBinding.sampler = aContext->mUseMipmaps ? aContext->mSampler : aContext->mBaseLevelSampler;
+  if (!aDepthOnly) {
+    SDL_BindGPUFragmentSamplers(aRenderPass, 0, &textureBinding, 1);
+  }
+
+  // The depth only pipelines take the positions and nothing else out of the vertex streams.
+  Uint32 streamsCount = aDepthOnly ? 1 : 4;
+
+  if (useIndirectDraws) {
+    SDL_GPUBufferBinding binding[4];
+    binding[0].buffer = scene->mPositions.mBuffer;
+    binding[0].offset = scene->mPositions.mOffset;
+    binding[1].buffer = scene->mNormals.mBuffer;
+    binding[1].offset = scene->mNormals.mOffset;
+    binding[2].buffer = scene->mTangents.mBuffer;
+    binding[2].offset = scene->mTangents.mOffset;
+    binding[3].buffer = scene->mTexcoords.mBuffer;
+    binding[3].offset = scene->mTexcoords.mOffset;
+    SDL_BindGPUVertexBuffers(aRenderPass, 0, binding, streamsCount);
+
+    if (!aDepthOnly) {
+      SDL_GPUBufferBinding materialIndicesBinding;
+      materialIndicesBinding.buffer = aContext->mIndirectDraws.mMaterialIndices;
+      materialIndicesBinding.offset = 0;
+      SDL_BindGPUVertexBuffers(aRenderPass, 5, &materialIndicesBinding, 1);
+      SDL_BindGPUFragmentStorageBuffers(aRenderPass, 0, &aContext->mIndirectDraws.mMaterials, 1);
+    }
+
+    // Culled or not, every command is drawn, the culled ones just come out empty. What's reported is
+    // how many weren't culled, as of the last count read back.
+    SDL_GPUBuffer* commands = aContext->mUseCulling ? aContext->mIndirectDraws.mCulledCommands : aContext->mIndirectDraws.mCommands;
+    SDL_DrawGPUIndexedPrimitivesIndirect(aRenderPass, commands, 0, aContext->mIndirectDraws.mCommandsCount);
+    return aContext->mUseCulling ? aContext->mIndirectDraws.mLastVisibleCount : drawCount;
+  }
+
+  // Which layer to sample, and with which sampler, is all that changes between materials, and only
+  // when it does. With the mipmaps off everything keeps to the top level sampler, for comparison.
+  Uint32 currentMaterial = SDL_MAX_UINT32;
+
+  for (size_t j = 0; j < drawCount; ++j) {
+    size_t i = visiblePackets ? visiblePackets[j] : j;
+    const DrawPacket* packet = scene->mDrawPackets + i;
+
+    if (!aDepthOnly && packet->mMaterialIndex != currentMaterial) {
+      currentMaterial = packet->mMaterialIndex;
+      SDL_PushGPUFragmentUniformData(aCommandBuffer, 0, scene->mMaterials + currentMaterial, sizeof(MaterialTexture));
+
+      SDL_GPUSampler* sampler = aContext->mUseMipmaps ? scene->mMaterialSamplers[currentMaterial] : aContext->mBaseLevelSampler;
+      if (sampler != textureBinding.sampler) {
+        textureBinding.sampler = sampler;
+        SDL_BindGPUFragmentSamplers(aRenderPass, 0, &textureBinding, 1);
+      }
     }
 
     {
-      SDL_GPUTextureSamplerBinding textureBinding;
-      SDL_zero(textureBinding);
-      textureBinding.texture = aContext->mTexture;
-      textureBinding.sampler = aContext->mSampler;
-      SDL_BindGPUFragmentSamplers(aRenderPass, 0, &textureBinding, 1);
+      SDL_GPUBufferBinding binding[4];
+      binding[0].buffer = scene->mPositions.mBuffer;
+      binding[0].offset = packet->mPositionOffset;
+      binding[1].buffer = scene->mNormals.mBuffer;
+      binding[1].offset = packet->mNormalOffset;
+      binding[2].buffer = scene->mTangents.mBuffer;
+      binding[2].offset = packet->mTangentOffset;
+      binding[3].buffer = scene->mTexcoords.mBuffer;
+      binding[3].offset = packet->mTexcoordOffset;
+      SDL_BindGPUVertexBuffers(aRenderPass, 0, binding, streamsCount);
     }
 
-    //float4x4 meshMatrix = Float4x4_Multiply(&mesh->mCurrentTransform, &model);
-    float4x4 meshMatrix = Float4x4_Multiply(&model, &mesh->mCurrentTransform);
-    //float4x4 meshMatrix = model;
+    if (useTransformIndices) {
+      // The instance index picks this packet's entry out of the TransformIndices stream.
+      SDL_DrawGPUIndexedPrimitives(aRenderPass, packet->mIndicesCount, 1, packet->mFirstIndex, 0, (Uint32)i);
+      continue;
+    }
 
-    SDL_PushGPUVertexUniformData(aCommandBuffer, 0, &meshMatrix, sizeof(meshMatrix));
+    SDL_PushGPUVertexUniformData(aCommandBuffer, 0, scene->mModelTransforms + packet->mTransformIndex, sizeof(float4x4));
 
-    SDL_DrawGPUIndexedPrimitives(aRenderPass, mesh->mIndicesCount, 1, 0, 0, 0);
+    SDL_DrawGPUIndexedPrimitives(aRenderPass, packet->mIndicesCount, 1, packet->mFirstIndex, 0, 0);
   }
+
+  return drawCount;
 }
 
-void DestroyModelContext(ModelContext* aContext)
+// Call once the ThreadPool CreateModelContext was given has been waited on.
+void FinishModelPipelines(ModelContext* aContext)
 {
-  SDL_ReleaseGPUBuffer(gContext.mDevice, aContext->mModel.mPositions);
-  SDL_ReleaseGPUBuffer(gContext.mDevice, aContext->mModel.mNormals);
-  SDL_ReleaseGPUBuffer(gContext.mDevice, aContext->mModel.mTangents);
-  SDL_ReleaseGPUBuffer(gContext.mDevice, aContext->mModel.mIndices);
+  ModelPipelineBuild* build = aContext->mPipelineBuild;
+  if (!build) {
+    return;
+  }
 
-  SDL_ReleaseGPUTexture(gContext.mDevice, aContext->mTexture);
-  SDL_ReleaseGPUSampler(gContext.mDevice, aContext->mSampler);
-  SDL_ReleaseGPUGraphicsPipeline(gContext.mDevice, aContext->mPipeline);
+  aContext->mPipeline = build->mPipeline;
+  aContext->mGpuHierarchyPipeline = build->mGpuHierarchyPipeline;
+  aContext->mIndirectPipeline = build->mIndirectPipeline;
+  aContext->mDepthEqualPipeline = build->mDepthEqualPipeline;
+  aContext->mDepthEqualGpuHierarchyPipeline = build->mDepthEqualGpuHierarchyPipeline;
+  aContext->mDepthEqualIndirectPipeline = build->mDepthEqualIndirectPipeline;
+  aContext->mDepthOnlyPipeline = build->mDepthOnlyPipeline;
+  aContext->mDepthOnlyTransformsPipeline = build->mDepthOnlyTransformsPipeline;
+  aContext->mOverdrawPipeline = build->mOverdrawPipeline;
+  aContext->mOverdrawDepthOnlyPipeline = build->mOverdrawDepthOnlyPipeline;
+  aContext->mOverdrawDepthEqualPipeline = build->mOverdrawDepthEqualPipeline;
+  SDL_assert(aContext->mPipeline);
+  SDL_assert(aContext->mGpuHierarchyPipeline);
+  SDL_assert(aContext->mIndirectPipeline);
+  SDL_assert(aContext->mDepthEqualPipeline && aContext->mDepthEqualGpuHierarchyPipeline && aContext->mDepthEqualIndirectPipeline);
+  SDL_assert(aContext->mDepthOnlyPipeline && aContext->mDepthOnlyTransformsPipeline);
+  SDL_assert(aContext->mOverdrawPipeline && aContext->mOverdrawDepthOnlyPipeline && aContext->mOverdrawDepthEqualPipeline);
+
+  SDL_free(build);
+  aContext->mPipelineBuild = NULL;
+}
 
-  SDL_ReleaseGPUGraphicsPipeline(gContext.mDevice, aContext->mPipeline);
+void DestroyModelContext(ModelContext* aContext)
+{
+  FreeFromBufferHeap(&aContext->mGeometryHeap, &aContext->mModel.mPositions);
+  FreeFromBufferHeap(&aContext->mGeometryHeap, &aContext->mModel.mNormals);
+  FreeFromBufferHeap(&aContext->mGeometryHeap, &aContext->mModel.mTangents);
+  FreeFromBufferHeap(&aContext->mGeometryHeap, &aContext->mModel.mTexcoords);
+  FreeFromBufferHeap(&aContext->mGeometryHeap, &aContext->mModel.mIndices);
+  DestroyBufferHeap(&aContext->mGeometryHeap);
+
+  SDL_free(aContext->mModel.mMeshes);
+  SDL_free(aContext->mModel.mPrimitives);
+  SDL_free(aContext->mModel.mWorldTransforms);
+  SDL_free(aContext->mModel.mModelTransforms);
+  SDL_free(aContext->mModel.mParents);
+  SDL_free(aContext->mModel.mLevelOrder);
+  SDL_free(aContext->mModel.mLevelOffsets);
+  SDL_free(aContext->mModel.mDrawPackets);
+  SDL_free(aContext->mModel.mPacketCenters[0]);
+  SDL_free(aContext->mModel.mVisiblePackets);
+  SDL_free(aContext->mModel.mMaterials);
+  ReleaseSceneSamplers(&aContext->mModel, aContext->mSamplerCache);
+
+  DestroyGpuHierarchy(&aContext->mGpuHierarchy);
+  DestroyDynamicBuffer(&aContext->mStorageTransforms);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mGpuHierarchyPipeline);
+  DestroyIndirectDraws(&aContext->mIndirectDraws);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mIndirectPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mDepthEqualPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mDepthEqualGpuHierarchyPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mDepthEqualIndirectPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mDepthOnlyPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mDepthOnlyTransformsPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mOverdrawPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mOverdrawDepthOnlyPipeline);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mOverdrawDepthEqualPipeline);
+
+  SDL_ReleaseGPUTexture(gContext.mDevice, aContext->mModel.mMaterialTexture);
+  ReleaseCachedSampler(aContext->mSamplerCache, aContext->mSampler);
+  ReleaseCachedSampler(aContext->mSamplerCache, aContext->mBaseLevelSampler);
+  ReleaseCachedPipeline(aContext->mPipelineCache, aContext->mPipeline);
   SDL_zero(*aContext);
 }
 
+// Draws the model into targets of its own and counts the fragments shaded for each pixel, once the
+// way the main pass shades them without a depth prepass, and once after a prepass, where the
+// DepthEqual pass only shades what matches the nearest depth. Both counts are read back, the
+// difference is what the prepass saves in fragment work, for the cost of drawing the geometry twice.
+typedef struct OverdrawCounter {
+  SDL_GPUTexture* mCountTexture;
+  SDL_GPUTexture* mPrepassCountTexture;
+  SDL_GPUTexture* mDepthTexture;
+
+  // The counts without the prepass, then the ones with it.
+  SDL_GPUTransferBuffer* mReadback;
+  Uint32 mWidth;
+  Uint32 mHeight;
+
+  // Signaled once the counts are in mReadback.
+  SDL_GPUFence* mFence;
+  size_t mDrawCount;
+} OverdrawCounter;
+
+// Every DrawPacket in order, pushing its transform, which is how the main pass draws them.
+void DrawOverdrawPackets(SDL_GPUCommandBuffer* aCommandBuffer, SDL_GPURenderPass* aRenderPass, SDL_GPUGraphicsPipeline* aPipeline, const Scene* aScene)
+{
+  SDL_BindGPUGraphicsPipeline(aRenderPass, aPipeline);
+  SDL_PushGPUVertexUniformData(aCommandBuffer, 1, &gContext.WorldToNDC, sizeof(gContext.WorldToNDC));
+
+  {
+    SDL_GPUBufferBinding binding;
+    binding.buffer = aScene->mIndices.mBuffer;
+    binding.offset = 0;
+    SDL_BindGPUIndexBuffer(aRenderPass, &binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+  }
+
+  for (size_t i = 0; i < aScene->mDrawPacketsCount; ++i) {
+    const DrawPacket* packet = aScene->mDrawPackets + i;
+
+    SDL_GPUBufferBinding binding;
+    binding.buffer = aScene->mPositions.mBuffer;
+    binding.offset = packet->mPositionOffset;
+    SDL_BindGPUVertexBuffers(aRenderPass, 0, &binding, 1);
+
+    SDL_PushGPUVertexUniformData(aCommandBuffer, 0, aScene->mModelTransforms + packet->mTransformIndex, sizeof(float4x4));
+    SDL_DrawGPUIndexedPrimitives(aRenderPass, packet->mIndicesCount, 1, packet->mFirstIndex, 0, 0);
+  }
+}
+
+// Clears both targets, so each measurement starts from an empty depth buffer.
+SDL_GPURenderPass* BeginOverdrawPass(OverdrawCounter* aCounter, SDL_GPUCommandBuffer* aCommandBuffer, SDL_GPUTexture* aCountTexture)
+{
+  SDL_GPUColorTargetInfo colorTargetInfo;
+  SDL_zero(colorTargetInfo);
+  colorTargetInfo.texture = aCountTexture;
+  colorTargetInfo.load_op = SDL_GPU_LOADOP_CLEAR;
+  colorTargetInfo.store_op = SDL_GPU_STOREOP_STORE;
+
+  SDL_GPUDepthStencilTargetInfo depthStencilTargetInfo;
+  SDL_zero(depthStencilTargetInfo);
+  depthStencilTargetInfo.texture = aCounter->mDepthTexture;
+  depthStencilTargetInfo.clear_depth = 0.f;
+  depthStencilTargetInfo.load_op = SDL_GPU_LOADOP_CLEAR;
+  depthStencilTargetInfo.store_op = SDL_GPU_STOREOP_DONT_CARE;
+  depthStencilTargetInfo.stencil_load_op = SDL_GPU_LOADOP_CLEAR;
+  depthStencilTargetInfo.stencil_store_op = SDL_GPU_STOREOP_DONT_CARE;
+
+  return SDL_BeginGPURenderPass(aCommandBuffer, &colorTargetInfo, 1, &depthStencilTargetInfo);
+}
+
+// Does nothing while the last measurement is still being read back.
+void MeasureModelOverdraw(OverdrawCounter* aCounter, ModelContext* aContext, SDL_GPUTextureFormat aDepthFormat, Uint32 aWidth, Uint32 aHeight)
+{
+  if (aCounter->mFence || !aContext->mModelReady) {
+    return;
+  }
+
+  if (aCounter->mWidth != aWidth || aCounter->mHeight != aHeight) {
+    if (aCounter->mCountTexture) {
+      SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mCountTexture);
+      SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mPrepassCountTexture);
+      SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mDepthTexture);
+      SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aCounter->mReadback);
+    }
+
+    aCounter->mCountTexture = CreateTexture(aWidth, aHeight, 1, 1, SDL_GPU_TEXTUREUSAGE_COLOR_TARGET, cOverdrawFormat, "OverdrawCounter Counts");
+    aCounter->mPrepassCountTexture = CreateTexture(aWidth, aHeight, 1, 1, SDL_GPU_TEXTUREUSAGE_COLOR_TARGET, cOverdrawFormat, "OverdrawCounter Prepass Counts");
+    aCounter->mDepthTexture = CreateTexture(aWidth, aHeight, 1, 1, SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET, aDepthFormat, "OverdrawCounter Depth");
+    aCounter->mReadback = CreateTransferBuffer(2 * aWidth * aHeight, SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD, "OverdrawCounter Readback");
+    aCounter->mWidth = aWidth;
+    aCounter->mHeight = aHeight;
+  }
+
+  // Its own submit, so the fence only waits on the measurement.
+  SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(gContext.mDevice);
+
+  Scene* scene = &aContext->mModel;
+  float4x4 model = CreateModelMatrix(aContext->mUbo[0].mPosition, aContext->mUbo[0].mScale, aContext->mUbo[0].mRotation);
+  Float4x4_Multiply_Batch(&model, scene->mWorldTransforms, scene->mModelTransforms, scene->mMeshesCount);
+
+  SDL_GPURenderPass* renderPass = BeginOverdrawPass(aCounter, commandBuffer, aCounter->mCountTexture);
+  DrawOverdrawPackets(commandBuffer, renderPass, aContext->mOverdrawPipeline, scene);
+  SDL_EndGPURenderPass(renderPass);
+
+  // Same draws again, but counting only behind a depth prepass like mUseDepthPrepass does it.
+  renderPass = BeginOverdrawPass(aCounter, commandBuffer, aCounter->mPrepassCountTexture);
+  DrawOverdrawPackets(commandBuffer, renderPass, aContext->mOverdrawDepthOnlyPipeline, scene);
+  DrawOverdrawPackets(commandBuffer, renderPass, aContext->mOverdrawDepthEqualPipeline, scene);
+  SDL_EndGPURenderPass(renderPass);
+
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+
+  SDL_GPUTexture* countTextures[] = { aCounter->mCountTexture, aCounter->mPrepassCountTexture };
+  for (Uint32 i = 0; i < SDL_arraysize(countTextures); ++i) {
+    SDL_GPUTextureRegion region;
+    SDL_zero(region);
+    region.texture = countTextures[i];
+    region.w = aWidth;
+    region.h = aHeight;
+    region.d = 1;
+
+    SDL_GPUTextureTransferInfo transferInfo;
+    SDL_zero(transferInfo);
+    transferInfo.transfer_buffer = aCounter->mReadback;
+    transferInfo.offset = i * aWidth * aHeight;
+    transferInfo.pixels_per_row = aWidth;
+    transferInfo.rows_per_layer = aHeight;
+
+    SDL_DownloadFromGPUTexture(copyPass, &region, &transferInfo);
+  }
+
+  SDL_EndGPUCopyPass(copyPass);
+
+  aCounter->mFence = SDL_SubmitGPUCommandBufferAndAcquireFence(commandBuffer);
+  aCounter->mDrawCount = scene->mDrawPacketsCount;
+}
+
+typedef struct OverdrawCounts {
+  Uint64 mFragments;
+  Uint64 mCoveredPixels;
+  Uint64 mSaturatedPixels;
+} OverdrawCounts;
+
+OverdrawCounts SumOverdrawCounts(const Uint8* aCounts, size_t aPixelsCount)
+{
+  OverdrawCounts sums;
+  SDL_zero(sums);
+
+  for (size_t i = 0; i < aPixelsCount; ++i) {
+    sums.mFragments += aCounts[i];
+    sums.mCoveredPixels += aCounts[i] != 0;
+    sums.mSaturatedPixels += aCounts[i] == 255;
+  }
+
+  return sums;
+}
+
+// Call once a frame, logs the last measurement once it has been read back.
+void UpdateOverdrawCounter(OverdrawCounter* aCounter)
+{
+  if (!aCounter->mFence || !SDL_QueryGPUFence(gContext.mDevice, aCounter->mFence)) {
+    return;
+  }
+
+  SDL_ReleaseGPUFence(gContext.mDevice, aCounter->mFence);
+  aCounter->mFence = NULL;
+
+  size_t pixelsCount = (size_t)aCounter->mWidth * aCounter->mHeight;
+  const Uint8* counts = (const Uint8*)SDL_MapGPUTransferBuffer(gContext.mDevice, aCounter->mReadback, false);
+  OverdrawCounts before = SumOverdrawCounts(counts, pixelsCount);
+  OverdrawCounts after = SumOverdrawCounts(counts + pixelsCount, pixelsCount);
+  SDL_UnmapGPUTransferBuffer(gContext.mDevice, aCounter->mReadback);
+
+  double overdrawBefore = before.mCoveredPixels ? (double)before.mFragments / (double)before.mCoveredPixels : 0.0;
+  double overdrawAfter = after.mCoveredPixels ? (double)after.mFragments / (double)after.mCoveredPixels : 0.0;
+  SDL_Log(
+    "Overdraw: %" SDL_PRIu64 " fragments shaded for %" SDL_PRIu64 " covered pixels (%.2fx) over %zu draws without a depth prepass, %" SDL_PRIu64 " (%.2fx) with one",
+    before.mFragments,
+    before.mCoveredPixels,
+    overdrawBefore,
+    aCounter->mDrawCount,
+    after.mFragments,
+    overdrawAfter
+  );
+
+  if (before.mSaturatedPixels) {
+    SDL_Log("Overdraw: %" SDL_PRIu64 " pixels saturated at 255 fragments, the real count is higher", before.mSaturatedPixels);
+  }
+}
+
+void DestroyOverdrawCounter(OverdrawCounter* aCounter)
+{
+  if (aCounter->mFence) {
+    SDL_WaitForGPUFences(gContext.mDevice, true, &aCounter->mFence, 1);
+    SDL_ReleaseGPUFence(gContext.mDevice, aCounter->mFence);
+  }
+
+  SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mCountTexture);
+  SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mPrepassCountTexture);
+  SDL_ReleaseGPUTexture(gContext.mDevice, aCounter->mDepthTexture);
+  SDL_ReleaseGPUTransferBuffer(gContext.mDevice, aCounter->mReadback);
+  SDL_zerop(aCounter);
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Main
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char** argv)
 {
-  (void)argc;
-  (void)argv;
+  Uint64 startupBegin = SDL_GetTicksNS();
   SDL_assert(SDL_Init(SDL_INIT_VIDEO));
 
+  GpuConfig config = LoadGpuConfig(argc, argv);
+
   SDL_Window* window = SDL_CreateWindow(TARGET_NAME, 1280, 720, 0);
   SDL_assert(window);
 
-  CreateGpuContext(window);
+  CreateGpuContextWithConfig(window, &config);
+  SDL_Log(
+    "GpuConfig: %s presentation, %u frames in flight, debug %s, frame rate cap %u",
+    GetPresentModeName(gContext.mConfig.mPresentMode),
+    gContext.mConfig.mFramesInFlight,
+    gContext.mConfig.mDebug ? "on" : "off",
+    gContext.mConfig.mMaxFramesPerSecond
+  );
 
   SDL_GPUTexture* depthTexture = NULL;
   Uint32 depthWidth = 0;
   Uint32 depthHeight = 0;
   SDL_GPUTextureFormat depthFormat = GetSupportedDepthFormat();
 
-  ModelContext context = CreateModelContext(depthFormat);
+  // With no threads every job runs on the main thread once it's waited on, in the order added.
+  Uint32 startupThreads = gContext.mConfig.mParallelStartup ? (Uint32)SDL_max(SDL_GetNumLogicalCPUCores() - 1, 1) : 0;
+  ThreadPool* threadPool = CreateThreadPool(startupThreads);
+
+  ShaderCache shaderCache = CreateShaderCache();
+  SamplerCache samplerCache = CreateSamplerCache();
+  PipelineCache pipelineCache = CreatePipelineCache();
+  ModelContext context = CreateModelContext(depthFormat, &shaderCache, &samplerCache, &pipelineCache, threadPool);
+  DepthPyramid depthPyramid = CreateDepthPyramid(&samplerCache, depthFormat);
+  UploadRing uploadRing = CreateUploadRing(gContext.mConfig.mFramesInFlight, cUploadRingFrameSize);
+  UploadWorker* uploadWorker = CreateUploadWorker();
+
+  // Broke the name so that we don't waste time zipping it while the example isn't done.
+  LoadModelContextAsync(&context, uploadWorker, "buster_drone.glb");
+
+  // Everything above ran alongside the shader and pipeline jobs, the first frame needs them though.
+  Uint64 pipelineWaitBegin = SDL_GetTicksNS();
+  WaitThreadPool(threadPool);
+  FinishModelPipelines(&context);
+
+  Uint64 startupEnd = SDL_GetTicksNS();
+  SDL_Log(
+    "Startup: %.3f ms until the first frame, %.3f ms of it waiting on shaders and pipelines (%u threads)",
+    (double)(startupEnd - startupBegin) / 1000000.0,
+    (double)(startupEnd - pipelineWaitBegin) / 1000000.0,
+    startupThreads
+  );
 
   const float speed = 5.f;
   Uint64 last_frame_ticks_so_far = SDL_GetTicksNS();
@@ -1469,6 +2765,21 @@ int main(int argc, char** argv)
   const bool* key_map = SDL_GetKeyboardState(&keys);
   bool running = true;
 
+  // CPU time spent recording the draws, averaged and logged every so often.
+  Uint64 drawRecordTicks = 0;
+  Uint32 drawRecordFrames = 0;
+
+  // Measured on request, to see whether the depth prepass pays for itself.
+  OverdrawCounter overdrawCounter;
+  SDL_zero(overdrawCounter);
+  bool measureOverdraw = false;
+
+  // Done on request, to exercise DefragmentBufferHeap on the GeometryHeap.
+  bool defragmentGeometry = false;
+
+  // Changes the local transforms every frame, so the GPU hierarchy has something to propagate.
+  bool animateModel = false;
+
   while (running) {
     Uint64 current_frame_ticks_so_far = SDL_GetTicksNS();
     float dt = (current_frame_ticks_so_far - last_frame_ticks_so_far) / 1000000000.f;
@@ -1480,6 +2791,51 @@ int main(int argc, char** argv)
       case SDL_EVENT_QUIT:
         running = false;
         break;
+      case SDL_EVENT_KEY_DOWN:
+        if (event.key.scancode == SDL_SCANCODE_F1) {
+          context.mUseGpuHierarchy = !context.mUseGpuHierarchy;
+          SDL_Log("GPU hierarchy: %s", context.mUseGpuHierarchy ? "on" : "off");
+
+          // Whichever side now owns the world transforms may have missed animated frames.
+          if (context.mModelReady) {
+            ModelContextLocalTransformsChanged(&context);
+          }
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F2) {
+          context.mUseCulling = !context.mUseCulling;
+          SDL_Log("Frustum culling: %s", context.mUseCulling ? "on" : "off");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F3) {
+          context.mUseMipmaps = !context.mUseMipmaps;
+          SDL_Log("Mipmaps: %s", context.mUseMipmaps ? "on" : "top level only");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F4) {
+          context.mUseStorageTransforms = !context.mUseStorageTransforms;
+          SDL_Log("Storage transforms: %s", context.mUseStorageTransforms ? "on" : "push per draw");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F5) {
+          context.mUseIndirectDraws = !context.mUseIndirectDraws;
+          SDL_Log("Indirect draws: %s", context.mUseIndirectDraws ? "on" : "off");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F7) {
+          context.mUseDepthPrepass = !context.mUseDepthPrepass;
+          SDL_Log("Depth prepass: %s", context.mUseDepthPrepass ? "on" : "off");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F8) {
+          measureOverdraw = true;
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F9) {
+          defragmentGeometry = true;
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F10) {
+          animateModel = !animateModel;
+          SDL_Log("Animation: %s", animateModel ? "spinning the root nodes" : "off");
+        }
+        else if (event.key.scancode == SDL_SCANCODE_F6) {
+          context.mUseOcclusionCulling = !context.mUseOcclusionCulling && depthPyramid.mSupported;
+          SDL_Log("Occlusion culling: %s", context.mUseOcclusionCulling ? "on, with indirect draws and culling" : (depthPyramid.mSupported ? "off" : "not supported"));
+        }
+        break;
       }
     }
 
@@ -1522,22 +2878,60 @@ int main(int argc, char** argv)
     if (!SDL_WaitAndAcquireGPUSwapchainTexture(commandBuffer, gContext.mWindow, &swapchainTexture, &swapchainWidth, &swapchainHeight))
     {
       SDL_Log("WaitAndAcquireGPUSwapchainTexture failed: %s", SDL_GetError());
+      SDL_CancelGPUCommandBuffer(commandBuffer);
+      continue;
+    }
+
+    // There's nothing to draw to while the window is minimized, but the command buffer holding the
+    // acquire still has to be submitted.
+    if (!swapchainTexture)
+    {
+      SDL_SubmitGPUCommandBuffer(commandBuffer);
+      LimitFrameRate();
       continue;
     }
 
+    // Only once there's a frame to submit, so every slice that's mapped is also submitted with the
+    // fence that guards it, and a published model is drawn the frame it's published.
+    PublishUploadJobs(uploadWorker);
+    BeginUploadRingFrame(&uploadRing);
+
     if (depthWidth != swapchainWidth || depthHeight != swapchainHeight)
     {
       if (depthTexture) {
         SDL_ReleaseGPUTexture(gContext.mDevice, depthTexture);
       }
 
-      depthTexture = CreateTexture(swapchainWidth, swapchainHeight, 1, 1, SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET, depthFormat, "DepthTexture");
+      // Sampled to build the DepthPyramid, when it can be.
+      SDL_GPUTextureUsageFlags depthUsage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
+      if (depthPyramid.mSupported) {
+        depthUsage |= SDL_GPU_TEXTUREUSAGE_SAMPLER;
+      }
+
+      depthTexture = CreateTexture(swapchainWidth, swapchainHeight, 1, 1, depthUsage, depthFormat, "DepthTexture");
       SDL_assert(depthTexture);
+      ResizeDepthPyramid(&depthPyramid, swapchainWidth, swapchainHeight);
 
       depthWidth = swapchainWidth;
       depthHeight = swapchainHeight;
     }
 
+    if (defragmentGeometry) {
+      bool moved = DefragmentModelContextGeometry(&context, commandBuffer, &uploadRing);
+      BufferHeapStats stats = GetBufferHeapStats(&context.mGeometryHeap);
+      SDL_Log("GeometryHeap: %s, %u pages, largest free block %u", moved ? "defragmented" : "nothing to free up", stats.mPagesCount, stats.mLargestFreeBlock);
+      defragmentGeometry = false;
+    }
+
+    if (animateModel) {
+      AnimateModelContext(&context, dt);
+    }
+
+    UpdateModelContext(&context, &uploadRing);
+    RecordUploadRingFrame(&uploadRing, commandBuffer);
+    PrepareModelContext(&context, commandBuffer, &depthPyramid);
+    bool buildDepthPyramid = ModelContextUsesOcclusionCulling(&context);
+
     SDL_GPUColorTargetInfo colorTargetInfo;
     SDL_zero(colorTargetInfo);
 
@@ -1558,7 +2952,7 @@ int main(int argc, char** argv)
     depthStencilTargetInfo.clear_depth = 0.f;
     depthStencilTargetInfo.clear_stencil = 0.f;
     depthStencilTargetInfo.load_op = SDL_GPU_LOADOP_CLEAR;
-    depthStencilTargetInfo.store_op = SDL_GPU_STOREOP_DONT_CARE;
+    depthStencilTargetInfo.store_op = buildDepthPyramid ? SDL_GPU_STOREOP_STORE : SDL_GPU_STOREOP_DONT_CARE;
     depthStencilTargetInfo.stencil_load_op = SDL_GPU_LOADOP_CLEAR;
     depthStencilTargetInfo.stencil_store_op = SDL_GPU_STOREOP_DONT_CARE;
     depthStencilTargetInfo.cycle = true; // NOTE: Introduce cycling
@@ -1570,16 +2964,84 @@ int main(int argc, char** argv)
       &depthStencilTargetInfo
     );
 
-    DrawModelContext(&context, commandBuffer, renderPass);
+    Uint64 drawRecordStart = SDL_GetPerformanceCounter();
+    if (context.mUseDepthPrepass) {
+      DrawModelContext(&context, commandBuffer, renderPass, true);
+    }
+    size_t drawCount = DrawModelContext(&context, commandBuffer, renderPass, false);
+    drawRecordTicks += SDL_GetPerformanceCounter() - drawRecordStart;
+
+    if (++drawRecordFrames == 500) {
+      double microseconds = (double)drawRecordTicks * 1000000.0 / (double)SDL_GetPerformanceFrequency();
+      const char* transformsMode = context.mUseGpuHierarchy ? "gpu hierarchy" : ModelContextUsesStorageTransforms(&context) ? "storage transforms" : "push per draw";
+      SDL_Log("DrawModelContext (%s%s%s): %.2f us/frame for %zu of %zu draws", transformsMode, context.mUseIndirectDraws ? ", indirect" : "", context.mUseDepthPrepass ? ", depth prepass" : "", microseconds / drawRecordFrames, drawCount, context.mModel.mDrawPacketsCount);
+      SDL_Log("UploadRing: peak %u of %u bytes per frame, %" SDL_PRIu64 " stalls (%.2f ms), %" SDL_PRIu64 " overflows in %" SDL_PRIu64 " frames",
+        uploadRing.mPeakUsed, uploadRing.mFrameSize, uploadRing.mStalls, (double)uploadRing.mStallNS / 1000000.0, uploadRing.mOverflows, uploadRing.mFrameCount);
+      if (context.mUseIndirectDraws && context.mUseCulling) {
+        Uint32 drawsCount = context.mIndirectDraws.mCommandsCount;
+        Uint32 visibleCount = context.mIndirectDraws.mLastVisibleCount;
+        SDL_Log("GPU culling%s: %u of %u draws visible, %u culled", ModelContextUsesOcclusionCulling(&context) ? " with occlusion" : "", visibleCount, drawsCount, drawsCount - visibleCount);
+      }
+      drawRecordTicks = 0;
+      drawRecordFrames = 0;
+    }
 
     SDL_EndGPURenderPass(renderPass);
-    SDL_SubmitGPUCommandBuffer(commandBuffer);
+
+    if (buildDepthPyramid) {
+      BuildDepthPyramid(&depthPyramid, commandBuffer, depthTexture, &gContext.WorldToNDC);
+    }
+    else {
+      depthPyramid.mValid = false;
+    }
+
+    SubmitUploadRingFrame(&uploadRing, commandBuffer);
+
+    // Only a 4 byte copy, and only one is in flight at a time, so this keeps up without the frame
+    // ever waiting on it.
+    if (context.mModelReady && context.mUseIndirectDraws && context.mUseCulling) {
+      UpdateIndirectDrawsVisibleCount(&context.mIndirectDraws);
+      ReadBackIndirectDrawsVisibleCount(&context.mIndirectDraws);
+    }
+
+    if (measureOverdraw) {
+      MeasureModelOverdraw(&overdrawCounter, &context, depthFormat, depthWidth, depthHeight);
+      measureOverdraw = false;
+    }
+    UpdateOverdrawCounter(&overdrawCounter);
+
+    LimitFrameRate();
   }
 
+  DestroyUploadRing(&uploadRing);
+
+  // Has to go before the ModelContext, a load still in flight is finished and published first.
+  DestroyUploadWorker(uploadWorker);
+
   SDL_ReleaseGPUTexture(gContext.mDevice, depthTexture);
+  DestroyDepthPyramid(&depthPyramid);
+  DestroyOverdrawCounter(&overdrawCounter);
 
   DestroyModelContext(&context);
 
+  SDL_Log("SamplerCache: %" SDL_PRIu64 " hits and %" SDL_PRIu64 " misses", samplerCache.mHits, samplerCache.mMisses);
+  DestroySamplerCache(&samplerCache);
+
+  SDL_Log(
+    "PipelineCache: %" SDL_PRIu64 " hits and %" SDL_PRIu64 " misses (%" SDL_PRIu64 " lost a race), %.3f ms spent creating pipelines",
+    pipelineCache.mHits,
+    pipelineCache.mMisses,
+    pipelineCache.mLostRaces,
+    (double)pipelineCache.mCreateTimeNS / 1000000.0
+  );
+  DestroyPipelineCache(&pipelineCache);
+
+  // After the pipelines, which were created from these shaders.
+  LogShaderCache(&shaderCache);
+  DestroyShaderCache(&shaderCache);
+
+  DestroyThreadPool(threadPool);
+
   DestroyGpuContext();
 
   SDL_Quit();
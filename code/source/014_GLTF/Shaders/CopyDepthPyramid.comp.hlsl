@@ -0,0 +1,21 @@
+Texture2D<float> Depth : register(t0, space0);
+SamplerState Sampler : register(s0, space0);
+
+RWTexture2D<float> Destination : register(u0, space1);
+
+cbuffer UBO : register(b0, space2)
+{
+  uint2 Size;
+};
+
+// The top level of the pyramid is the depth buffer as is.
+[numthreads(8, 8, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+  if (any(GlobalInvocationID.xy >= Size))
+  {
+    return;
+  }
+
+  Destination[GlobalInvocationID.xy] = Depth.Load(int3(GlobalInvocationID.xy, 0));
+}
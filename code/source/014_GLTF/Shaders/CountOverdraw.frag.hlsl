@@ -0,0 +1,6 @@
+// Blended additively into an R8_UNORM target, so each texel ends up with how many fragments were
+// shaded for it, out of 255.
+float4 main() : SV_Target0
+{
+  return float4(1.0f / 255.0f, 0.0f, 0.0f, 0.0f);
+}
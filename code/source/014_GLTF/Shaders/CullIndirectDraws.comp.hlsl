@@ -0,0 +1,127 @@
+struct Transform
+{
+  column_major float4x4 Value;
+};
+
+struct IndexedIndirectDrawCommand
+{
+  uint IndicesCount;
+  uint InstancesCount;
+  uint FirstIndex;
+  int VertexOffset;
+  uint FirstInstance;
+};
+
+// Last frame's depth, reduced down to a single texel.
+Texture2D<float> DepthPyramid : register(t0, space0);
+SamplerState Sampler : register(s0, space0);
+
+// Local bounding sphere of each draw, center in xyz and radius in w.
+StructuredBuffer<float4> Bounds : register(t1, space0);
+StructuredBuffer<uint> TransformIndices : register(t2, space0);
+StructuredBuffer<Transform> WorldTransforms : register(t3, space0);
+StructuredBuffer<IndexedIndirectDrawCommand> Commands : register(t4, space0);
+
+RWStructuredBuffer<IndexedIndirectDrawCommand> CulledCommands : register(u0, space1);
+RWStructuredBuffer<uint> VisibleCount : register(u1, space1);
+
+cbuffer UBO : register(b0, space2)
+{
+  // Identity when the WorldTransforms already have the model matrix in them.
+  float4x4 ModelToWorld;
+
+  // What DepthPyramid was drawn with.
+  float4x4 PreviousWorldToNDC;
+
+  float4 Planes[6];
+  uint PlanesCount;
+  uint DrawsCount;
+  uint2 DepthPyramidSize;
+  uint DepthPyramidLevels;
+  uint UseOcclusion;
+};
+
+// Whether the sphere is behind everything last frame drew over where it lands on screen.
+bool IsOccluded(float3 center, float radius)
+{
+  float2 ndcMin = float2(1.0f, 1.0f);
+  float2 ndcMax = float2(-1.0f, -1.0f);
+  float nearestDepth = 0.0f;
+
+  for (uint i = 0; i < 8; ++i)
+  {
+    float3 corner = center + radius * float3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+    float4 clip = mul(PreviousWorldToNDC, float4(corner, 1.0f));
+
+    // Reaches behind the camera, there's nothing to compare against.
+    if (clip.w <= 0.0f)
+    {
+      return false;
+    }
+
+    float3 ndc = clip.xyz / clip.w;
+    ndcMin = min(ndcMin, ndc.xy);
+    ndcMax = max(ndcMax, ndc.xy);
+
+    // Reversed depth, bigger is nearer.
+    nearestDepth = max(nearestDepth, ndc.z);
+  }
+
+  ndcMin = clamp(ndcMin, -1.0f, 1.0f);
+  ndcMax = clamp(ndcMax, -1.0f, 1.0f);
+
+  // Texture space runs down where NDC runs up.
+  float2 uvMin = float2(ndcMin.x, -ndcMax.y) * 0.5f + 0.5f;
+  float2 uvMax = float2(ndcMax.x, -ndcMin.y) * 0.5f + 0.5f;
+
+  // The level where the rectangle is at most a texel across, so it touches at most 2x2 texels.
+  float2 texelsSize = (uvMax - uvMin) * float2(DepthPyramidSize);
+  uint level = (uint)ceil(log2(max(max(texelsSize.x, texelsSize.y), 1.0f)));
+  level = min(level, DepthPyramidLevels - 1);
+
+  uint2 levelSize = max(DepthPyramidSize >> level, uint2(1, 1));
+  uint2 texelMin = min(uint2(uvMin * float2(levelSize)), levelSize - 1);
+  uint2 texelMax = min(uint2(uvMax * float2(levelSize)), levelSize - 1);
+
+  float occluderDepth = min(
+    min(DepthPyramid.Load(int3(texelMin, level)), DepthPyramid.Load(int3(texelMax.x, texelMin.y, level))),
+    min(DepthPyramid.Load(int3(texelMin.x, texelMax.y, level)), DepthPyramid.Load(int3(texelMax, level))));
+
+  return nearestDepth < occluderDepth;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+  uint draw = GlobalInvocationID.x;
+
+  if (draw >= DrawsCount)
+  {
+    return;
+  }
+
+  float4x4 objectToWorld = mul(ModelToWorld, WorldTransforms[TransformIndices[draw]].Value);
+  float4 bounds = Bounds[draw];
+  float3 center = mul(objectToWorld, float4(bounds.xyz, 1.0f)).xyz;
+
+  // The largest scale along any axis keeps the sphere around the mesh.
+  float scale = max(length(objectToWorld._11_21_31), max(length(objectToWorld._12_22_32), length(objectToWorld._13_23_33)));
+  float radius = bounds.w * scale;
+
+  for (uint i = 0; i < PlanesCount; ++i)
+  {
+    if (dot(Planes[i].xyz, center) + Planes[i].w < -radius)
+    {
+      return;
+    }
+  }
+
+  if (UseOcclusion != 0 && IsOccluded(center, radius))
+  {
+    return;
+  }
+
+  uint slot;
+  InterlockedAdd(VisibleCount[0], 1, slot);
+  CulledCommands[slot] = Commands[draw];
+}
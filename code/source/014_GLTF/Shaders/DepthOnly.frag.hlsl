@@ -0,0 +1,4 @@
+// Nothing to shade, the depth prepass only writes depth.
+void main()
+{
+}
@@ -0,0 +1,23 @@
+struct Input
+{
+  float3 Position : TEXCOORD0;
+};
+
+cbuffer UBO : register(b0, space1)
+{
+    float4x4 ObjectToWorld;
+};
+
+cbuffer UB1 : register(b1, space1)
+{
+    float4x4 WorldToNDC;
+};
+
+// Has to come out to exactly the depth VertexAndIndexBuffer.vert does, the main pass tests EQUAL.
+// The position is precise here and in every main pass vertex shader, so the compiler can't fuse or
+// reorder the multiplies differently in each of them and end up a bit off.
+float4 main(Input input) : SV_Position
+{
+  precise float4 position = mul(WorldToNDC, mul(ObjectToWorld, float4(input.Position, 1.0f)));
+  return position;
+}
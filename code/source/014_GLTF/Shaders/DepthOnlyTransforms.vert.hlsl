@@ -0,0 +1,26 @@
+struct Input
+{
+  float3 Position : TEXCOORD0;
+  uint TransformIndex : TEXCOORD1;
+};
+
+struct Transform
+{
+  column_major float4x4 Value;
+};
+
+StructuredBuffer<Transform> WorldTransforms : register(t0, space0);
+
+cbuffer UBO : register(b0, space1)
+{
+    float4x4 WorldToNDC;
+};
+
+// Has to come out to exactly the depth GpuHierarchy.vert and IndirectDraw.vert do, the main pass
+// tests EQUAL.
+float4 main(Input input) : SV_Position
+{
+  float4x4 objectToWorld = WorldTransforms[input.TransformIndex].Value;
+  precise float4 position = mul(WorldToNDC, mul(objectToWorld, float4(input.Position, 1.0f)));
+  return position;
+}
@@ -0,0 +1,33 @@
+struct IndexedIndirectDrawCommand
+{
+  uint IndicesCount;
+  uint InstancesCount;
+  uint FirstIndex;
+  int VertexOffset;
+  uint FirstInstance;
+};
+
+StructuredBuffer<uint> VisibleCount : register(t0, space0);
+
+RWStructuredBuffer<IndexedIndirectDrawCommand> CulledCommands : register(u0, space1);
+
+cbuffer UBO : register(b0, space2)
+{
+  uint DrawsCount;
+};
+
+// The draw count of an indirect draw is set on the CPU, so everything after the visible draws is
+// emptied out rather than left over from last frame.
+[numthreads(64, 1, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+  uint draw = GlobalInvocationID.x;
+
+  if (draw >= DrawsCount || draw < VisibleCount[0])
+  {
+    return;
+  }
+
+  IndexedIndirectDrawCommand empty = (IndexedIndirectDrawCommand)0;
+  CulledCommands[draw] = empty;
+}
@@ -0,0 +1,40 @@
+struct Input
+{
+  float3 Position : TEXCOORD0;
+  float3 Normal : TEXCOORD1;
+  float4 Tangent : TEXCOORD2;
+  float2 TexCoord : TEXCOORD3;
+  uint TransformIndex : TEXCOORD4;
+};
+
+struct Output
+{
+  float3 Color : TEXCOORD0;
+  float2 TexCoord : TEXCOORD1;
+  float4 Position : SV_Position;
+};
+
+struct Transform
+{
+  column_major float4x4 Value;
+};
+
+StructuredBuffer<Transform> WorldTransforms : register(t0, space0);
+
+// When the transforms are the Scene's world transforms without the model matrix, the model matrix
+// is folded into this one, so it's applied here rather than once per mesh on the CPU.
+cbuffer UBO : register(b0, space1)
+{
+    float4x4 WorldToNDC;
+};
+
+Output main(Input input)
+{
+  Output output;
+  float4x4 objectToWorld = WorldTransforms[input.TransformIndex].Value;
+  precise float4 position = mul(WorldToNDC, mul(objectToWorld, float4(input.Position, 1.0f)));
+  output.Position = position;
+  output.Color = input.Normal;
+  output.TexCoord = input.TexCoord;
+  return output;
+}
@@ -0,0 +1,43 @@
+struct Material
+{
+  float4 UvScaleOffset;
+  int Layer;
+  uint Atlas;
+  uint2 Padding;
+};
+
+Texture2DArray<float4> Texture : register(t0, space2);
+SamplerState Sampler : register(s0, space2);
+
+// Every draw of an indirect call shares the same bindings, so the materials are looked up here
+// instead of being pushed between draws.
+StructuredBuffer<Material> Materials : register(t1, space2);
+
+struct Output
+{
+  float4 Color : SV_Target0;
+};
+
+Output main(float3 aColor : TEXCOORD0, float2 aTexCoord : TEXCOORD1, nointerpolation uint aMaterialIndex : TEXCOORD2)
+{
+  Output output;
+  Material material = Materials[aMaterialIndex];
+
+  // Untextured materials keep showing their normals.
+  if (material.Layer < 0)
+  {
+    output.Color = float4(aColor, 1.0f);
+    return output;
+  }
+
+  // Atlas entries can't rely on the sampler to wrap, so it's done here before moving into the entry.
+  float2 texCoord = aTexCoord;
+  if (material.Atlas != 0)
+  {
+    texCoord = frac(texCoord);
+  }
+
+  texCoord = texCoord * material.UvScaleOffset.xy + material.UvScaleOffset.zw;
+  output.Color = Texture.Sample(Sampler, float3(texCoord, material.Layer));
+  return output;
+}
@@ -0,0 +1,43 @@
+struct Transform
+{
+  column_major float4x4 Value;
+};
+
+StructuredBuffer<Transform> LocalTransforms : register(t0, space0);
+StructuredBuffer<uint> Parents : register(t1, space0);
+StructuredBuffer<uint> LevelOrder : register(t2, space0);
+
+RWStructuredBuffer<Transform> WorldTransforms : register(u0, space1);
+
+cbuffer UBO : register(b0, space2)
+{
+  float4x4 ModelToWorld;
+  uint LevelOffset;
+  uint LevelCount;
+};
+
+// Roots have no parent, they're placed by the model matrix instead.
+static const uint NoParent = 0xFFFFFFFF;
+
+[numthreads(64, 1, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+  uint levelIndex = GlobalInvocationID.x;
+
+  if (levelIndex >= LevelCount)
+  {
+    return;
+  }
+
+  uint node = LevelOrder[LevelOffset + levelIndex];
+  uint parent = Parents[node];
+
+  float4x4 parentTransform = ModelToWorld;
+
+  if (parent != NoParent)
+  {
+    parentTransform = WorldTransforms[parent].Value;
+  }
+
+  WorldTransforms[node].Value = mul(parentTransform, LocalTransforms[node].Value);
+}
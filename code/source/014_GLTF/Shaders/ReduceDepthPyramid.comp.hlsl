@@ -0,0 +1,44 @@
+RWTexture2D<float> Source : register(u0, space1);
+RWTexture2D<float> Destination : register(u1, space1);
+
+cbuffer UBO : register(b0, space2)
+{
+  uint2 SourceSize;
+  uint2 DestinationSize;
+};
+
+// Depth is reversed, so the farthest depth under each texel is the smallest one, and that's what
+// anything has to be behind to be hidden by all of it.
+[numthreads(8, 8, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+  uint2 texel = GlobalInvocationID.xy;
+
+  if (any(texel >= DestinationSize))
+  {
+    return;
+  }
+
+  // An odd sized source leaves a row or column over, the last texels pick it up as well.
+  uint2 extent = uint2(2, 2);
+  if ((SourceSize.x & 1) != 0 && texel.x == DestinationSize.x - 1)
+  {
+    extent.x = 3;
+  }
+  if ((SourceSize.y & 1) != 0 && texel.y == DestinationSize.y - 1)
+  {
+    extent.y = 3;
+  }
+
+  float depth = 1.0f;
+  for (uint y = 0; y < extent.y; ++y)
+  {
+    for (uint x = 0; x < extent.x; ++x)
+    {
+      uint2 source = min(texel * 2 + uint2(x, y), SourceSize - 1);
+      depth = min(depth, Source[source]);
+    }
+  }
+
+  Destination[texel] = depth;
+}
@@ -1,14 +1,37 @@
-Texture2D<float4> Texture : register(t0, space2);
+Texture2DArray<float4> Texture : register(t0, space2);
 SamplerState Sampler : register(s0, space2);
 
+cbuffer UBO : register(b0, space3)
+{
+  float4 UvScaleOffset;
+  int Layer;
+  uint Atlas;
+};
+
 struct Output
 {
   float4 Color : SV_Target0;
 };
 
-Output main(float3 aColor : TEXCOORD0)
+Output main(float3 aColor : TEXCOORD0, float2 aTexCoord : TEXCOORD1)
 {
   Output output;
-  output.Color = float4(aColor, 1.0f);
+
+  // Untextured materials keep showing their normals.
+  if (Layer < 0)
+  {
+    output.Color = float4(aColor, 1.0f);
+    return output;
+  }
+
+  // Atlas entries can't rely on the sampler to wrap, so it's done here before moving into the entry.
+  float2 texCoord = aTexCoord;
+  if (Atlas != 0)
+  {
+    texCoord = frac(texCoord);
+  }
+
+  texCoord = texCoord * UvScaleOffset.xy + UvScaleOffset.zw;
+  output.Color = Texture.Sample(Sampler, float3(texCoord, Layer));
   return output;
 }
@@ -3,11 +3,13 @@ struct Input
   float3 Position : TEXCOORD0;
   float3 Normal : TEXCOORD1;
   float4 Tangent : TEXCOORD2;
+  float2 TexCoord : TEXCOORD3;
 };
 
 struct Output
 {
   float3 Color : TEXCOORD0;
+  float2 TexCoord : TEXCOORD1;
   float4 Position : SV_Position;
 };
 
@@ -24,8 +26,10 @@ cbuffer UB1 : register(b1, space1)
 Output main(Input input)
 {
   Output output;
-  output.Position = mul(WorldToNDC, mul(ObjectToWorld, float4(input.Position, 1.0f)));
+  precise float4 position = mul(WorldToNDC, mul(ObjectToWorld, float4(input.Position, 1.0f)));
+  output.Position = position;
   output.Color = input.Normal;
+  output.TexCoord = input.TexCoord;
   return output;
 }
 